@@ -66,21 +66,77 @@ void flash_write_option_byte(uint16_t addr, uint8_t byte) {
 
 
 
+/*----------------------------------------------------------
+    MODULE VARIABLES
+----------------------------------------------------------*/
+
+/// RAM copy of block for flash_program_block(). Source of flash_write_buffer() may be in flash
+static uint8_t        s_blockBuf[FLASH_BLOCK_SIZE];
+
+#if defined(__SDCC)
+
+/// source of block for RAM routine (see flash_block_ram())
+static const uint8_t  *s_blockSrc;
+
+/// RAM copy of flash_block_ram(). Block programming must not be executed from flash
+static uint8_t        s_ramCode[FLASH_RAM_CODE];
+
+/// state of RAM routine: 0=not yet copied, 1=ready, 2=length mismatch (program words instead)
+static uint8_t        s_ramState = 0;
+
+#endif // __SDCC
+
+
+
 /**
-  \fn void flash_write_byte(uint32_t addr, uint8_t ch)
+  \fn void flash_init(void)
   
-  \brief write single byte to flash
+  \brief reset module state
   
-  \param[in] addr   address to write to
-  \param[in] ch     byte to program
+  required if the C startup was skipped, e.g. for the updater, which is
+  entered via BSL GO. Then module variables are not initialized
+*/
+void flash_init(void) {
+
+#if defined(__SDCC)
+  s_ramState = 0;
+#endif // __SDCC
+
+} // flash_init
 
-  write single byte to address in P-flash or EEPROM
+
+
+/**
+  \fn void flash_unlock(void)
+  
+  \brief unlock P-flash and EEPROM
+  
+  unlock w/e access to P-flash and EEPROM once before a sequence of
+  flash_program_*() calls, and disable interrupts (interrupt vectors are in
+  flash, which is not accessible during programming)
 */
-void flash_write_byte(uint32_t addr, uint8_t ch) {
-    
+void flash_unlock(void) {
+
   // disable interrupts
   DISABLE_INTERRUPTS;
 
+  // unlock P-flash and EEPROM
+  flash_unlock_nvm();
+
+} // flash_unlock
+
+
+
+/**
+  \fn void flash_unlock_nvm(void)
+  
+  \brief unlock P-flash and EEPROM without changing interrupts
+  
+  for callers which keep interrupts disabled throughout, e.g. the updater.
+  Interrupts must be disabled before
+*/
+void flash_unlock_nvm(void) {
+
   // unlock w/e access to P-flash
   FLASH_PUKR.byte = 0x56;
   FLASH_PUKR.byte = 0xAE;
@@ -93,6 +149,56 @@ void flash_write_byte(uint32_t addr, uint8_t ch) {
   while(!FLASH_IAPSR.reg.PUL);
   while(!FLASH_IAPSR.reg.DUL);
 
+} // flash_unlock_nvm
+
+
+
+/**
+  \fn void flash_lock(void)
+  
+  \brief lock P-flash and EEPROM
+  
+  lock P-flash and EEPROM again against accidental erase/write and enable
+  interrupts
+*/
+void flash_lock(void) {
+
+  // lock P-flash and EEPROM
+  flash_lock_nvm();
+  
+  // enable interrupts
+  ENABLE_INTERRUPTS;
+
+} // flash_lock
+
+
+
+/**
+  \fn void flash_lock_nvm(void)
+  
+  \brief lock P-flash and EEPROM without changing interrupts
+  
+  counterpart of flash_unlock_nvm(), interrupts stay disabled
+*/
+void flash_lock_nvm(void) {
+
+  // lock P-flash again against accidental erase/write
+  FLASH_IAPSR.reg.PUL = 0;
+  
+  // lock EEPROM again against accidental erase/write
+  FLASH_IAPSR.reg.DUL = 0;
+
+} // flash_lock_nvm
+
+
+
+/**
+  \fn static void flash_store(uint32_t addr, uint8_t ch)
+  
+  \brief store byte to 24b address (starts programming if unlocked)
+*/
+static void flash_store(uint32_t addr, uint8_t ch) {
+
 // Cosmic compiler (supports far pointer)
 #if defined(__CSMC__)
 
@@ -114,17 +220,282 @@ ASM_END
 
 #endif // SDCC
 
+} // flash_store
+
+
+
+/**
+  \fn static uint8_t flash_wait(void)
+  
+  \brief wait until program cycle is done
+  
+  \return 0 on success, 1 if write to protected page was attempted
+
+  reading FLASH_IAPSR clears EOP and WR_PG_DIS, therefore both are evaluated
+  from the same read. A protected page sets WR_PG_DIS instead of EOP
+*/
+static uint8_t flash_wait(void) {
+
+  uint8_t   status;
+
+  do {
+    status = FLASH_IAPSR.byte & 0x05;
+  } while (!status);
+  return(status & 0x01);
+
+} // flash_wait
+
+
+
+/**
+  \fn uint8_t flash_program_byte(uint32_t addr, uint8_t ch)
+  
+  \brief program single byte (flash must be unlocked)
+  
+  \param[in] addr   address to write to
+  \param[in] ch     byte to program
+
+  \return 0 on success, 1 if write to protected page was attempted
+
+  program single byte to address in P-flash or EEPROM. Takes a full
+  program cycle (~6ms), use word or block programming for bulk data
+*/
+uint8_t flash_program_byte(uint32_t addr, uint8_t ch) {
+    
+  // write byte and wait until done
+  flash_store(addr, ch);
+  return(flash_wait());
+  
+} // flash_program_byte
+
+
+
+/**
+  \fn uint8_t flash_program_word(uint32_t addr, const uint8_t *buf)
+  
+  \brief program 4 bytes at once (flash must be unlocked)
+  
+  \param[in] addr   address to write to (4B aligned)
+  \param[in] buf    4 bytes to program
+
+  \return 0 on success, 1 if write to protected page was attempted
+
+  program word to address in P-flash or EEPROM in a single program cycle.
+  Can be executed from flash (CPU is stalled until done)
+*/
+uint8_t flash_program_word(uint32_t addr, const uint8_t *buf) {
+    
+  uint8_t   i;
+
+  // enable word programming
+  FLASH_CR2.reg.WPRG  = 1;
+  FLASH_NCR2.reg.WPRG = 0;
+
+  // write 4 bytes in sequence
+  for (i=0; i<4; i++)
+    flash_store(addr+i, buf[i]);
+
   // wait until done
-  while (!FLASH_IAPSR.reg.EOP);
+  return(flash_wait());
   
-  // lock P-flash again against accidental erase/write
-  FLASH_IAPSR.reg.PUL = 0;
+} // flash_program_word
+
+
+
+#if defined(__SDCC)
+
+/**
+  \fn static uint8_t flash_block_ram(void)
   
-  // lock EEPROM again against accidental erase/write
-  FLASH_IAPSR.reg.DUL = 0;
+  \brief write block from s_blockSrc to g_addr and wait until done
   
-  // enable interrupts
-  ENABLE_INTERRUPTS;
+  \return FLASH_IAPSR & 0x05 (EOP, WR_PG_DIS) in A, as polling clears the flags
+
+  executed from a RAM copy (see s_ramCode), so it may only use relative
+  jumps. Programming mode must be set in FLASH_CR2 before.
+  Exactly FLASH_RAM_CODE bytes are copied, therefore update it when changing
+  the code (opcode length in [B] see PM0044). The last byte must be 'ret'
+*/
+static uint8_t flash_block_ram(void) __naked {
+
+ASM_START
+  clrw	x                       ; 1
+00001$:
+  ld	a,([_s_blockSrc],x)     ; 4
+  ldf	([_g_addr+1].e,x),a     ; 4
+  incw	x                       ; 1
+  cpw	x,#FLASH_BLOCK_SIZE     ; 3
+  jrne	00001$                  ; 2
+00002$:
+  ld	a,0x505F                ; 3
+  and	a,#0x05                 ; 2
+  jreq	00002$                  ; 2
+  ret                           ; 1 -> 23
+ASM_END
+
+} // flash_block_ram
+
+#endif // __SDCC
+
+
+
+/**
+  \fn uint8_t flash_program_block(uint32_t addr, const uint8_t *buf, uint8_t fast)
+  
+  \brief program block in single cycle (flash must be unlocked)
+  
+  \param[in] addr   address to write to (FLASH_BLOCK_SIZE aligned)
+  \param[in] buf    FLASH_BLOCK_SIZE bytes to program (must be in RAM)
+  \param[in] fast   1=fast programming without erase (block must be erased), 0=erase and program
+
+  \return 0 on success, 1 if write to protected page was attempted
+
+  program block to address in P-flash or EEPROM from a RAM routine. With SDCC the
+  routine is copied to RAM at first call. Cosmic requires a linker section for RAM
+  code, therefore words are programmed instead
+*/
+uint8_t flash_program_block(uint32_t addr, const uint8_t *buf, uint8_t fast) {
+
+#if defined(__CSMC__)
+
+  uint8_t   i, err = 0;
+
+  // no RAM routine -> program words
+  for (i=0; i<FLASH_BLOCK_SIZE; i+=4)
+    err |= flash_program_word(addr+i, buf+i);
+  return(err);
+
+#elif defined(__SDCC)
+
+  uint8_t   i, err = 0;
+  
+  // copy RAM routine of fixed length once. If it doesn't end with 'ret' (0x81), the length is wrong -> program words
+  if (s_ramState == 0) {
+    for (i=0; i<FLASH_RAM_CODE; i++)
+      s_ramCode[i] = ((const uint8_t*) flash_block_ram)[i];
+    s_ramState = (s_ramCode[FLASH_RAM_CODE-1] == 0x81) ? 1 : 2;
+  }
+  if (s_ramState != 1) {
+    for (i=0; i<FLASH_BLOCK_SIZE; i+=4)
+      err |= flash_program_word(addr+i, buf+i);
+    return(err);
+  }
+
+  // enable standard (erase + program) or fast block programming
+  if (fast) {
+    FLASH_CR2.reg.FPRG  = 1;
+    FLASH_NCR2.reg.FPRG = 0;
+  }
+  else {
+    FLASH_CR2.reg.PRG  = 1;
+    FLASH_NCR2.reg.PRG = 0;
+  }
+
+  // write block and wait from RAM. Status is returned by routine, as reading FLASH_IAPSR cleared it
+  s_blockSrc = buf;
+  g_addr     = addr;
+  return(((uint8_t (*)(void)) s_ramCode)() & 0x01);
+
+#endif // SDCC
+
+} // flash_program_block
+
+
+
+/**
+  \fn uint8_t flash_program_buffer(uint32_t addr, const uint8_t *buf, uint16_t numBytes)
+  
+  \brief program buffer to P-flash or EEPROM (flash must be unlocked)
+  
+  \param[in] addr       address to write to
+  \param[in] buf        data to program (RAM or flash)
+  \param[in] numBytes   number of bytes
+
+  \return 0 on success, 1 if write to protected page was attempted
+
+  program unaligned head and tail bytewise or wordwise, aligned blocks in a
+  single cycle each. Compared to flash_program_byte() this saves up to
+  FLASH_BLOCK_SIZE-1 program cycles per block. Blocks are copied to RAM first,
+  as flash can't be read during block programming
+*/
+uint8_t flash_program_buffer(uint32_t addr, const uint8_t *buf, uint16_t numBytes) {
+
+  uint8_t   i, err = 0;
+
+  while (numBytes > 0) {
+
+    // aligned block
+    if (((addr % FLASH_BLOCK_SIZE) == 0) && (numBytes >= FLASH_BLOCK_SIZE)) {
+      for (i=0; i<FLASH_BLOCK_SIZE; i++)
+        s_blockBuf[i] = buf[i];
+      err |= flash_program_block(addr, s_blockBuf, 0);
+      addr += FLASH_BLOCK_SIZE; buf += FLASH_BLOCK_SIZE; numBytes -= FLASH_BLOCK_SIZE;
+    }
+
+    // aligned word
+    else if (((addr % 4) == 0) && (numBytes >= 4)) {
+      err |= flash_program_word(addr, buf);
+      addr += 4; buf += 4; numBytes -= 4;
+    }
+
+    // single byte
+    else {
+      err |= flash_program_byte(addr, *buf);
+      addr++; buf++; numBytes--;
+    }
+
+  } // while numBytes
+
+  return(err);
+
+} // flash_program_buffer
+
+
+
+/**
+  \fn uint8_t flash_write_buffer(uint32_t addr, const uint8_t *buf, uint16_t numBytes)
+  
+  \brief write buffer to P-flash or EEPROM
+  
+  \param[in] addr       address to write to
+  \param[in] buf        data to program (RAM or flash)
+  \param[in] numBytes   number of bytes
+
+  \return 0 on success, 1 if write to protected page was attempted
+
+  unlock flash once, program buffer via flash_program_buffer(), then lock
+  again and enable interrupts
+*/
+uint8_t flash_write_buffer(uint32_t addr, const uint8_t *buf, uint16_t numBytes) {
+
+  uint8_t   err;
+
+  flash_unlock();
+  err = flash_program_buffer(addr, buf, numBytes);
+  flash_lock();
+
+  return(err);
+
+} // flash_write_buffer
+
+
+
+/**
+  \fn void flash_write_byte(uint32_t addr, uint8_t ch)
+  
+  \brief write single byte to flash
+  
+  \param[in] addr   address to write to
+  \param[in] ch     byte to program
+
+  write single byte to address in P-flash or EEPROM. For more than a few
+  bytes use flash_write_buffer()
+*/
+void flash_write_byte(uint32_t addr, uint8_t ch) {
+    
+  flash_unlock();
+  flash_program_byte(addr, ch);
+  flash_lock();
 
 } // flash_write_byte
 
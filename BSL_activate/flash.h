@@ -4,6 +4,12 @@
 #ifndef _FLASH_H_
 #define _FLASH_H_
 
+/// size of flash block [B] (medium and high density devices, e.g. STM8S105 and STM8S207)
+#define FLASH_BLOCK_SIZE      128
+
+/// size of RAM routine for block programming [B] (assembled length of flash_block_ram(), see there)
+#define FLASH_RAM_CODE        23
+
 /// base address for option bytes
 #define BASE_ADDR_OPT         0x4800
 
@@ -40,12 +46,42 @@
 #define NOPT17 (BASE_ADDR_OPT+0x7F)  //!< Complementary Option byte 17 */
 
 
+/// reset module state, if C startup was skipped (e.g. entry via BSL GO)
+void    flash_init(void);
+
 /// write option byte
 void    flash_write_option_byte(uint16_t addr, uint8_t ch);
 
-/// write single byte to P-flash or EEPROM
+/// write single byte to P-flash or EEPROM (unlock, program, lock)
 void    flash_write_byte(uint32_t addr, uint8_t ch);
 
+/// write buffer to P-flash or EEPROM with block, word and byte programming. Returns 1 if page is protected
+uint8_t flash_write_buffer(uint32_t addr, const uint8_t *buf, uint16_t numBytes);
+
+/// unlock P-flash and EEPROM and disable interrupts (before flash_program_*())
+void    flash_unlock(void);
+
+/// lock P-flash and EEPROM and enable interrupts
+void    flash_lock(void);
+
+/// unlock P-flash and EEPROM without changing interrupts (interrupts must be disabled)
+void    flash_unlock_nvm(void);
+
+/// lock P-flash and EEPROM without changing interrupts
+void    flash_lock_nvm(void);
+
+/// program single byte (requires flash_unlock()). Returns 1 if page is protected
+uint8_t flash_program_byte(uint32_t addr, uint8_t ch);
+
+/// program 4B aligned word (requires flash_unlock()). Returns 1 if page is protected
+uint8_t flash_program_word(uint32_t addr, const uint8_t *buf);
+
+/// program buffer with block, word and byte programming (requires flash_unlock()). Returns 1 if page is protected
+uint8_t flash_program_buffer(uint32_t addr, const uint8_t *buf, uint16_t numBytes);
+
+/// program aligned block from RAM routine (requires flash_unlock()). Returns 1 if page is protected
+uint8_t flash_program_block(uint32_t addr, const uint8_t *buf, uint8_t fast);
+
 /// read single byte from memory
 uint8_t read_byte(uint32_t addr);
 
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include "stm8as.h"
 #include "flash.h"
+#include "updater.h"
 #define _MAIN_
   #include "globals.h"
 #undef _MAIN_
@@ -133,6 +134,19 @@ void main (void) {
 
   } // if option byte was changed
        
+
+#if defined(UPDATER)
+
+  ///////////////////
+  // resident updater: publish entry for host, then start application if present
+  ///////////////////
+  updater_install();
+  
+  // application vector table starts with 'int' opcode (0x82)
+  if (read_byte(UPD_APP_START) == 0x82)
+    ((void (*)(void)) UPD_APP_START)();
+
+#endif // UPDATER
     
 
   /////////////////
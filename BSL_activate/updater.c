@@ -0,0 +1,478 @@
+/**
+  \file updater.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief implementation of resident fast updater
+
+  implementation of the updater protocol described in updater.h. The updater
+  is entered via BSL GO, i.e. the C startup is skipped and all module state is
+  initialized explicitly. The UART is polled and interrupts stay disabled, also
+  while programming (see flash_unlock_nvm()). While
+  a block is programmed, the UART cannot receive (flash is stalled), therefore
+  each frame is acknowledged after programming. Compared to the ROM bootloader
+  this saves the upload of the RAM routines, the ACK per command, address and
+  data, and allows baudrates beyond the BSL autobaud range.
+*/
+
+/*----------------------------------------------------------
+    INCLUDE FILES
+----------------------------------------------------------*/
+#include <stdint.h>
+#include "stm8as.h"
+#include "flash.h"
+#include "updater.h"
+
+#if defined(UPDATER)
+
+
+/*----------------------------------------------------------
+    MODULE MACROS
+----------------------------------------------------------*/
+
+// UART of ROM bootloader
+#if defined(STM8S105)
+  #define UPD_SR      LINUART_SR
+  #define UPD_DR      LINUART_DR
+  #define UPD_BRR1    LINUART_BRR1
+  #define UPD_BRR2    LINUART_BRR2
+  #define UPD_CR1     LINUART_CR1
+  #define UPD_CR2     LINUART_CR2
+  #define UPD_CR3     LINUART_CR3
+#elif defined(STM8S207)
+  #define UPD_SR      USART_SR
+  #define UPD_DR      USART_DR
+  #define UPD_BRR1    USART_BRR1
+  #define UPD_BRR2    USART_BRR2
+  #define UPD_CR1     USART_CR1
+  #define UPD_CR2     USART_CR2
+  #define UPD_CR3     USART_CR3
+#endif
+
+/// end of P-flash (exclusive)
+#define UPD_FLASH_END       (0x8000L + (uint32_t) UPD_FLASH_KB * 1024L)
+
+/// polling loops for inter-byte timeout within frame (approx. 10ms)
+#define UPD_BYTE_TIMEOUT    20000
+
+
+/*----------------------------------------------------------
+    MODULE VARIABLES
+----------------------------------------------------------*/
+
+/// received frame: cmd, len, payload (programmed directly from RAM)
+static uint8_t    s_cmd, s_len;
+static uint8_t    s_payload[UPD_PAYLOAD_MAX];
+
+/// response payload
+static uint8_t    s_resp[UPD_READ_MAX];
+
+
+
+/**
+  \fn static uint16_t upd_crc(uint16_t crc, uint8_t ch)
+
+  \brief update CRC16-CCITT with one byte
+*/
+static uint16_t upd_crc(uint16_t crc, uint8_t ch) {
+
+  uint8_t   i;
+
+  crc ^= (uint16_t) ch << 8;
+  for (i=0; i<8; i++)
+    crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+  return(crc);
+
+} // upd_crc
+
+
+
+/**
+  \fn static void upd_setBaud(uint32_t baud)
+
+  \brief configure UART for 8E1 with given baudrate (pending transmission is finished)
+*/
+static void upd_setBaud(uint32_t baud) {
+
+  uint16_t  div = (uint16_t) ((UPD_FCPU + baud/2) / baud);
+
+  // wait until last byte is sent
+  while (!UPD_SR.reg.TC);
+
+  // 9 bits incl. even parity, 1 stop bit. BRR2 must be written before BRR1
+  UPD_CR2.byte  = 0x00;
+  UPD_CR1.byte  = 0x14;
+  UPD_CR3.byte  = 0x00;
+  UPD_BRR2.byte = (uint8_t) (((div >> 8) & 0xF0) | (div & 0x0F));
+  UPD_BRR1.byte = (uint8_t) (div >> 4);
+
+  // enable transmitter and receiver, no interrupts
+  UPD_CR2.byte  = 0x0C;
+
+} // upd_setBaud
+
+
+
+/**
+  \fn static uint8_t upd_getc(uint8_t *ch)
+
+  \brief receive byte with timeout. Returns 1 on success
+*/
+static uint8_t upd_getc(uint8_t *ch) {
+
+  uint16_t  count;
+
+  for (count=0; count<UPD_BYTE_TIMEOUT; count++) {
+    if (UPD_SR.reg.RXNE) {
+      *ch = UPD_DR.byte;
+      return(1);
+    }
+  }
+  return(0);
+
+} // upd_getc
+
+
+
+/**
+  \fn static void upd_putc(uint8_t ch)
+
+  \brief send byte
+*/
+static void upd_putc(uint8_t ch) {
+
+  while (!UPD_SR.reg.TXE);
+  UPD_DR.byte = ch;
+
+} // upd_putc
+
+
+
+/**
+  \fn static void upd_respond(uint8_t status, uint8_t len)
+
+  \brief send response frame with len bytes from s_resp
+*/
+static void upd_respond(uint8_t status, uint8_t len) {
+
+  uint16_t  crc = 0xFFFF;
+  uint8_t   i;
+
+  upd_putc(UPD_SOF_TARGET);
+  upd_putc(status);
+  upd_putc(len);
+  crc = upd_crc(crc, status);
+  crc = upd_crc(crc, len);
+  for (i=0; i<len; i++) {
+    upd_putc(s_resp[i]);
+    crc = upd_crc(crc, s_resp[i]);
+  }
+  upd_putc((uint8_t) (crc >> 8));
+  upd_putc((uint8_t) crc);
+
+} // upd_respond
+
+
+
+/**
+  \fn static uint8_t upd_receive(void)
+
+  \brief receive frame from host into s_cmd, s_len and s_payload
+
+  \return status (0=no frame, UPD_ACK=ok, UPD_CRCERR=corrupted)
+
+  wait for start of frame without timeout. A gap within a frame discards it,
+  then the host repeats after its response timeout
+*/
+static uint8_t upd_receive(void) {
+
+  uint16_t  crc = 0xFFFF;
+  uint8_t   ch, crcHi, crcLo, i;
+
+  // wait for start of frame
+  do {
+    while (!UPD_SR.reg.RXNE);
+    ch = UPD_DR.byte;
+  } while (ch != UPD_SOF_HOST);
+
+  // header
+  if ((!upd_getc(&s_cmd)) || (!upd_getc(&s_len)))
+    return(0);
+  if (s_len > UPD_PAYLOAD_MAX)
+    return(0);
+  crc = upd_crc(crc, s_cmd);
+  crc = upd_crc(crc, s_len);
+
+  // payload and CRC
+  for (i=0; i<s_len; i++) {
+    if (!upd_getc(&(s_payload[i])))
+      return(0);
+    crc = upd_crc(crc, s_payload[i]);
+  }
+  if ((!upd_getc(&crcHi)) || (!upd_getc(&crcLo)))
+    return(0);
+  if (crc != (((uint16_t) crcHi << 8) | crcLo))
+    return(UPD_CRCERR);
+  return(UPD_ACK);
+
+} // upd_receive
+
+
+
+/**
+  \fn static uint32_t upd_addr(uint8_t idx)
+
+  \brief get 24b address (MSB first) from payload
+*/
+static uint32_t upd_addr(uint8_t idx) {
+
+  return(((uint32_t) s_payload[idx] << 16) | ((uint16_t) s_payload[idx+1] << 8) | s_payload[idx+2]);
+
+} // upd_addr
+
+
+
+/**
+  \fn static uint8_t upd_writable(uint32_t addr, uint16_t numBytes)
+
+  \brief check if range may be written (application flash or EEPROM without descriptor)
+*/
+static uint8_t upd_writable(uint32_t addr, uint16_t numBytes) {
+
+  if ((addr >= UPD_APP_START) && (addr + numBytes <= UPD_FLASH_END))
+    return(1);
+  if ((addr >= 0x4000) && (addr + numBytes <= UPD_DESC_ADDR))
+    return(1);
+  return(0);
+
+} // upd_writable
+
+
+
+/**
+  \fn static uint8_t upd_erased(uint32_t addr)
+
+  \brief check if block is erased (allows fast programming without erase cycle)
+*/
+static uint8_t upd_erased(uint32_t addr) {
+
+  uint8_t   i;
+
+  for (i=0; i<FLASH_BLOCK_SIZE; i++)
+    if (read_byte(addr+i) != 0x00)
+      return(0);
+  return(1);
+
+} // upd_erased
+
+
+
+/**
+  \fn static uint8_t upd_write(uint32_t addr, const uint8_t *buf, uint8_t numBytes)
+
+  \brief write data to flash or EEPROM. Returns response status
+*/
+static uint8_t upd_write(uint32_t addr, const uint8_t *buf, uint8_t numBytes) {
+
+  uint8_t   err;
+
+  if ((numBytes == 0) || (!upd_writable(addr, numBytes)))
+    return(UPD_NACK);
+
+  // complete block -> single program cycle, skip erase if already erased
+  if (((addr % FLASH_BLOCK_SIZE) == 0) && (numBytes == FLASH_BLOCK_SIZE)) {
+    err = upd_erased(addr);
+    flash_unlock_nvm();
+    err = flash_program_block(addr, buf, err);
+    flash_lock_nvm();
+    return(err ? UPD_NACK : UPD_ACK);
+  }
+
+  // partial block (start or end of image)
+  flash_unlock_nvm();
+  err = flash_program_buffer(addr, buf, numBytes);
+  flash_lock_nvm();
+  return(err ? UPD_NACK : UPD_ACK);
+
+} // upd_write
+
+
+
+/**
+  \fn static void upd_execute(void)
+
+  \brief execute received command and send response
+*/
+static void upd_execute(void) {
+
+  uint32_t  addr, num, baud;
+  uint16_t  crc;
+  uint8_t   i, status;
+
+  status = UPD_NACK;
+  switch (s_cmd) {
+
+    // device information
+    case UPD_INFO:
+      s_resp[0] = UPD_VERSION;
+      s_resp[1] = (uint8_t) (UPD_FLASH_KB >> 8);
+      s_resp[2] = (uint8_t) UPD_FLASH_KB;
+      s_resp[3] = FLASH_BLOCK_SIZE;
+      s_resp[4] = (uint8_t) ((uint32_t) UPD_APP_START >> 16);
+      s_resp[5] = (uint8_t) (UPD_APP_START >> 8);
+      s_resp[6] = (uint8_t) UPD_APP_START;
+      upd_respond(UPD_ACK, 7);
+      return;
+
+    // change baudrate after response
+    case UPD_BAUD:
+      if (s_len != 4)
+        break;
+      baud = ((uint32_t) upd_addr(0) << 8) | s_payload[3];
+      if ((baud < 4800) || (baud > UPD_BAUD_MAX))
+        break;
+      upd_respond(UPD_ACK, 0);
+      upd_setBaud(baud);
+      return;
+
+    // write data
+    case UPD_WRITE:
+      if (s_len < 4)
+        break;
+      status = upd_write(upd_addr(0), s_payload+3, s_len-3);
+      break;
+
+    // read data
+    case UPD_READ:
+      if ((s_len != 4) || (s_payload[3] == 0) || (s_payload[3] > UPD_READ_MAX))
+        break;
+      addr = upd_addr(0);
+      for (i=0; i<s_payload[3]; i++)
+        s_resp[i] = read_byte(addr+i);
+      upd_respond(UPD_ACK, s_payload[3]);
+      return;
+
+    // CRC16 of memory range
+    case UPD_CRC:
+      if (s_len != 6)
+        break;
+      addr = upd_addr(0);
+      num  = upd_addr(3);
+      crc  = 0xFFFF;
+      while (num--)
+        crc = upd_crc(crc, read_byte(addr++));
+      s_resp[0] = (uint8_t) (crc >> 8);
+      s_resp[1] = (uint8_t) crc;
+      upd_respond(UPD_ACK, 2);
+      return;
+
+    // erase application area. Erased state is 0x00 -> program empty blocks
+    case UPD_ERASE:
+      for (i=0; i<FLASH_BLOCK_SIZE; i++)
+        s_payload[i] = 0x00;
+      status = UPD_ACK;
+      for (addr=UPD_APP_START; addr<UPD_FLASH_END; addr+=FLASH_BLOCK_SIZE) {
+        if (!upd_erased(addr)) {
+          flash_unlock_nvm();
+          if (flash_program_block(addr, s_payload, 0))
+            status = UPD_NACK;
+          flash_lock_nvm();
+        }
+      }
+      break;
+
+    // jump to address after response
+    case UPD_GO:
+      if ((s_len != 3) || (upd_addr(0) > 0xFFFF))
+        break;
+      upd_respond(UPD_ACK, 0);
+      while (!UPD_SR.reg.TC);
+      ((void (*)(void)) (uint16_t) upd_addr(0))();
+      return;
+
+  } // switch (s_cmd)
+
+  upd_respond(status, 0);
+
+} // upd_execute
+
+
+
+/**
+  \fn void updater_start(void)
+
+  \brief entry point of updater
+
+  entered from ROM bootloader via GO. Set 16MHz clock and UART, then process
+  host commands until UPD_GO
+*/
+void updater_start(void) {
+
+  uint8_t   status;
+
+  // BSL may have enabled interrupts. Vectors of this firmware must not be used
+  DISABLE_INTERRUPTS;
+
+  // switch to 16MHz (default is 2MHz)
+  CLK_CKDIVR.byte = 0x00;
+
+  // C startup was skipped -> init modules
+  flash_init();
+  upd_setBaud(UPD_BAUD_INIT);
+
+  // process commands
+  while (1) {
+    status = upd_receive();
+    if (status == UPD_ACK)
+      upd_execute();
+    else if (status == UPD_CRCERR)
+      upd_respond(UPD_CRCERR, 0);
+  }
+
+} // updater_start
+
+
+
+/**
+  \fn void updater_install(void)
+
+  \brief write descriptor to EEPROM if missing or outdated
+
+  the descriptor contains the address of updater_start(), which changes
+  when the firmware is re-built
+*/
+void updater_install(void) {
+
+  uint8_t   desc[UPD_DESC_SIZE];
+  uint16_t  entry = (uint16_t) updater_start;
+  uint8_t   i, diff;
+
+  // build descriptor
+  desc[0] = 'U';
+  desc[1] = 'P';
+  desc[2] = UPD_VERSION;
+  desc[3] = (uint8_t) (entry >> 8);
+  desc[4] = (uint8_t) entry;
+  desc[5] = (uint8_t) (UPD_APP_START >> 8);
+  desc[6] = (uint8_t) UPD_APP_START;
+  desc[7] = 0x00;
+  for (i=0; i<UPD_DESC_SIZE-1; i++)
+    desc[7] ^= desc[i];
+
+  // write only if changed (EEPROM endurance)
+  diff = 0;
+  for (i=0; i<UPD_DESC_SIZE; i++)
+    if (read_byte(UPD_DESC_ADDR+i) != desc[i])
+      diff = 1;
+  if (diff)
+    flash_write_buffer(UPD_DESC_ADDR, desc, UPD_DESC_SIZE);
+
+} // updater_install
+
+#endif // UPDATER
+
+/*-----------------------------------------------------------------------------
+    END OF MODULE
+-----------------------------------------------------------------------------*/
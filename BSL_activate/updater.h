@@ -0,0 +1,94 @@
+/**
+  \file updater.h
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief declaration of resident fast updater
+
+  optional flash-resident updater (build with 'make UPDATER=1'). The host
+  flasher reads the descriptor at UPD_DESC_ADDR via the ROM bootloader and,
+  if present, jumps to the updater entry with the BSL GO command. The
+  updater then speaks a CRC protected frame protocol on the BSL UART at up
+  to 1MBaud and programs P-flash in 128B blocks. Frames:
+    host -> STM8:   UPD_SOF_HOST,   cmd,    len, payload[len], CRC16 (MSB first)
+    STM8 -> host:   UPD_SOF_TARGET, status, len, payload[len], CRC16 (MSB first)
+  CRC16 is CCITT (poly 0x1021, init 0xFFFF) over cmd/status, len and payload.
+  UART format is 8E1 (like ROM BSL in duplex mode), start baudrate UPD_BAUD_INIT.
+*/
+
+/*-----------------------------------------------------------------------------
+    MODULE DEFINITION FOR MULTIPLE INCLUSION
+-----------------------------------------------------------------------------*/
+#ifndef _UPDATER_H_
+#define _UPDATER_H_
+
+/// protocol version (reported in descriptor and UPD_INFO)
+#define UPD_VERSION           0x01
+
+/// descriptor in EEPROM: 'U','P', version, entry address (16b), UPD_APP_START (16b), XOR checksum. MSB first
+#define UPD_DESC_ADDR         0x43F8
+
+/// size of descriptor [B]
+#define UPD_DESC_SIZE         8
+
+/// first P-flash address not occupied by this firmware (application area)
+#ifndef UPD_APP_START
+  #define UPD_APP_START       0xA000
+#endif
+
+/// P-flash size [kB]
+#if defined(STM8S105)
+  #define UPD_FLASH_KB        32
+#elif defined(STM8S207)
+  #define UPD_FLASH_KB        128
+#endif
+
+/// CPU clock [Hz]
+#define UPD_FCPU              16000000L
+
+/// baudrate after entry [Baud]
+#define UPD_BAUD_INIT         115200L
+
+/// max. baudrate [Baud] (UART divider >= 16)
+#define UPD_BAUD_MAX          1000000L
+
+/// max. payload of a frame [B] (3B address + 1 block)
+#define UPD_PAYLOAD_MAX       (3+128)
+
+/// max. number of bytes per UPD_READ
+#define UPD_READ_MAX          128
+
+//////
+// frame start and commands (host -> STM8)
+//////
+#define UPD_SOF_HOST          0x5A    //!< start of host frame
+#define UPD_INFO              'I'     //!< get info: version, flash size [kB] (16b), block size, application start (24b)
+#define UPD_BAUD              'B'     //!< set baudrate (32b). Response is sent with old baudrate
+#define UPD_WRITE             'W'     //!< write data: address (24b), 1..128B data
+#define UPD_READ              'R'     //!< read data: address (24b), number of bytes (1..UPD_READ_MAX)
+#define UPD_CRC               'C'     //!< CRC16 of memory: address (24b), number of bytes (24b)
+#define UPD_ERASE             'E'     //!< erase application area of P-flash
+#define UPD_GO                'G'     //!< jump to address (16b range) after response
+
+//////
+// frame start and status (STM8 -> host)
+//////
+#define UPD_SOF_TARGET        0xA5    //!< start of target frame
+#define UPD_ACK               0x79    //!< command executed
+#define UPD_NACK              0x1F    //!< command refused (unknown, invalid parameter or protected address)
+#define UPD_CRCERR            0x2E    //!< frame CRC error, host should repeat
+
+
+/// entry point of updater (called via BSL GO, C startup is skipped). Never returns
+void    updater_start(void);
+
+/// write descriptor to EEPROM if missing or outdated
+void    updater_install(void);
+
+
+/*-----------------------------------------------------------------------------
+    END OF MODULE DEFINITION FOR MULTIPLE INLUSION
+-----------------------------------------------------------------------------*/
+#endif // _UPDATER_H_
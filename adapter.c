@@ -0,0 +1,102 @@
+/**
+  \file adapter.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief implementation of USB-serial adapter profiles
+
+  implementation of the adapter table and its lookup. Notes on the defaults:
+    - FTDI: latency timer (default 16ms) delays each ACK, so it is set to 1ms
+    - CP210x, CH340, PL2303: no adjustable latency timer. Echoing each byte
+      separately costs a USB round-trip, so all bytes are echoed at once
+    - CH340: 32B bulk packets overrun at high baudrates, so frames are shorter
+    - PL2303 (legacy HX): unreliable above 230.4kBaud
+    - Raspberry Pi PL011 UART: no USB, echo can be bytewise
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "adapter.h"
+#include "serial_comm.h"
+#include "misc.h"
+#include "globals.h"
+
+
+// known adapters
+static const adapter_profile_t s_adapter[] = {
+  // vid     pid    device    name               maxBaud  lat  write read echo
+  { 0x0403, 0x6001, NULL,     "FTDI FT232R",      921600,  1,  128,  256,  1 },
+  { 0x0403, 0x6010, NULL,     "FTDI FT2232",      921600,  1,  128,  256,  1 },
+  { 0x0403, 0x6011, NULL,     "FTDI FT4232H",     921600,  1,  128,  256,  1 },
+  { 0x0403, 0x6014, NULL,     "FTDI FT232H",      921600,  1,  128,  256,  1 },
+  { 0x0403, 0x6015, NULL,     "FTDI FT-X",        921600,  1,  128,  256,  1 },
+  { 0x10c4, 0xea60, NULL,     "SiLabs CP210x",    921600,  0,  128,  256,  1 },
+  { 0x1a86, 0x7523, NULL,     "WCH CH340",        460800,  0,   64,  128,  1 },
+  { 0x1a86, 0x5523, NULL,     "WCH CH341",        460800,  0,   64,  128,  1 },
+  { 0x1a86, 0x55d4, NULL,     "WCH CH9102",       921600,  0,  128,  256,  1 },
+  { 0x067b, 0x2303, NULL,     "Prolific PL2303",  230400,  0,   64,  128,  1 },
+  { 0x0000, 0x0000, "ttyAMA", "Raspberry UART",   921600,  0,  128,  256,  0 },
+};
+#define NUM_ADAPTER   (sizeof(s_adapter)/sizeof(s_adapter[0]))
+
+
+
+/**
+  \fn const adapter_profile_t *adapter_find(const char *port)
+
+  \brief get profile of adapter of port
+
+  \param[in] port     name of port
+
+  \return profile of adapter, or NULL if unknown (incl. VID/PID not available on OS)
+*/
+const adapter_profile_t *adapter_find(const char *port) {
+
+  uint16_t  vid, pid;
+  uint8_t   usb;
+  uint32_t  i;
+
+  usb = get_port_usbid(port, &vid, &pid);
+  for (i=0; i<NUM_ADAPTER; i++) {
+    if ((s_adapter[i].vid == 0) && (strstr(port, s_adapter[i].device)))
+      return(&(s_adapter[i]));
+    if ((usb) && (s_adapter[i].vid == vid) && (s_adapter[i].pid == pid))
+      return(&(s_adapter[i]));
+  }
+  return(NULL);
+
+} // adapter_find
+
+
+
+/**
+  \fn uint32_t adapter_baudrate(const char *ports, uint32_t baudrate)
+
+  \brief limit baudrate to adapters of ports
+
+  \param[in] ports      name of port or comma separated list
+  \param[in] baudrate   requested baudrate
+
+  \return requested baudrate, or highest reliable baudrate of slowest adapter if lower
+*/
+uint32_t adapter_baudrate(const char *ports, uint32_t baudrate) {
+
+  char                      *list, *tok;
+  const adapter_profile_t   *adapter;
+
+  if (!(list = strdup(ports)))
+    return(baudrate);
+  for (tok=strtok(list, ","); tok; tok=strtok(NULL, ","))
+    if ((adapter = adapter_find(tok)) && (adapter->maxBaud < baudrate))
+      baudrate = adapter->maxBaud;
+  free(list);
+  return(baudrate);
+
+} // adapter_baudrate
+
+// end of file
@@ -0,0 +1,48 @@
+/**
+  \file adapter.h
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief declaration of USB-serial adapter profiles
+
+  declaration of a table of known USB-serial adapters, identified by USB
+  vendor and product ID (from sysfs). Each entry holds transport defaults,
+  which differ widely between chips: highest reliable baudrate, latency
+  timer, frame sizes and echo strategy in reply mode. Tuned port profiles
+  (see tune.h) override these defaults.
+*/
+
+// for including file only once
+#ifndef _ADAPTER_H_
+#define _ADAPTER_H_
+
+
+// include files
+#include <stdint.h>
+
+
+/// transport defaults of a USB-serial adapter
+typedef struct {
+  uint16_t    vid;          ///< USB vendor ID (0=match by device name)
+  uint16_t    pid;          ///< USB product ID
+  const char  *device;      ///< part of device name (only if vid==0), e.g. "ttyAMA"
+  const char  *name;        ///< name of adapter chip
+  uint32_t    maxBaud;      ///< highest reliable baudrate [Baud]
+  uint8_t     latency;      ///< latency timer [ms] (0=none or not adjustable)
+  uint16_t    writeSize;    ///< bytes per WRITE frame (1..128)
+  uint16_t    readSize;     ///< bytes per READ command (1..256)
+  uint8_t     echoBlock;    ///< reply mode: echo all received bytes at once (0=bytewise)
+} adapter_profile_t;
+
+
+/// get profile of adapter of port. Returns NULL if unknown
+const adapter_profile_t *adapter_find(const char *port);
+
+/// limit baudrate to highest reliable baudrate of adapters of ports (comma separated list)
+uint32_t    adapter_baudrate(const char *ports, uint32_t baudrate);
+
+#endif // _ADAPTER_H_
+
+// end of file
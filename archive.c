@@ -0,0 +1,526 @@
+/**
+  \file archive.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief implementation of deduplicated memory dump archive
+
+  implementation of a content-addressed store for memory dumps. Blocks are
+  written to a temporary file and renamed, so several flasher processes can
+  share an archive. A block with the same hash is never written twice.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#if defined(WIN32)
+  #include <direct.h>
+#endif
+#include "archive.h"
+#include "misc.h"
+#include "globals.h"
+
+
+/// header line of manifest
+#define ARCHIVE_MAGIC       "STM8 dump archive 1"
+
+
+// SHA-256 round constants
+static const uint32_t s_k[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR(x,n)   (((x) >> (n)) | ((x) << (32-(n))))
+
+
+
+/**
+  \fn static void archive_sha256Block(uint32_t *state, const uint8_t *block)
+
+  \brief SHA-256 compression of one 64B block
+*/
+static void archive_sha256Block(uint32_t *state, const uint8_t *block) {
+
+  uint32_t  w[64], a, b, c, d, e, f, g, h, t1, t2;
+  int       i;
+
+  for (i=0; i<16; i++)
+    w[i] = ((uint32_t) block[4*i] << 24) | ((uint32_t) block[4*i+1] << 16) | ((uint32_t) block[4*i+2] << 8) | block[4*i+3];
+  for (i=16; i<64; i++)
+    w[i] = w[i-16] + (ROTR(w[i-15],7) ^ ROTR(w[i-15],18) ^ (w[i-15] >> 3)) + w[i-7] + (ROTR(w[i-2],17) ^ ROTR(w[i-2],19) ^ (w[i-2] >> 10));
+
+  a = state[0]; b = state[1]; c = state[2]; d = state[3];
+  e = state[4]; f = state[5]; g = state[6]; h = state[7];
+  for (i=0; i<64; i++) {
+    t1 = h + (ROTR(e,6) ^ ROTR(e,11) ^ ROTR(e,25)) + ((e & f) ^ (~e & g)) + s_k[i] + w[i];
+    t2 = (ROTR(a,2) ^ ROTR(a,13) ^ ROTR(a,22)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  }
+  state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+  state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+
+} // archive_sha256Block
+
+
+
+/**
+  \fn void archive_sha256(const uint8_t *buf, uint32_t numBytes, uint8_t *hash)
+
+  \brief SHA-256 of buffer
+
+  \param[in]  buf         data
+  \param[in]  numBytes    number of bytes
+  \param[out] hash        hash (ARCHIVE_HASH bytes)
+*/
+void archive_sha256(const uint8_t *buf, uint32_t numBytes, uint8_t *hash) {
+
+  uint32_t  state[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+  uint8_t   tail[128];
+  uint64_t  numBits = (uint64_t) numBytes * 8;
+  uint32_t  i, rest, lenTail;
+
+  // full blocks
+  for (i=0; i+64<=numBytes; i+=64)
+    archive_sha256Block(state, buf+i);
+
+  // padding: 0x80, zeros, length in bits (64b MSB first)
+  rest = numBytes - i;
+  lenTail = (rest < 56) ? 64 : 128;
+  memset(tail, 0, sizeof(tail));
+  memcpy(tail, buf+i, rest);
+  tail[rest] = 0x80;
+  for (i=0; i<8; i++)
+    tail[lenTail-1-i] = (uint8_t) (numBits >> (8*i));
+  archive_sha256Block(state, tail);
+  if (lenTail == 128)
+    archive_sha256Block(state, tail+64);
+
+  for (i=0; i<8; i++) {
+    hash[4*i]   = (uint8_t) (state[i] >> 24);
+    hash[4*i+1] = (uint8_t) (state[i] >> 16);
+    hash[4*i+2] = (uint8_t) (state[i] >> 8);
+    hash[4*i+3] = (uint8_t) state[i];
+  }
+
+} // archive_sha256
+
+
+
+/**
+  \fn static void archive_mkdir(const char *path)
+
+  \brief create directory if it doesn't exist, exit on error
+*/
+static void archive_mkdir(const char *path) {
+
+  struct stat   st;
+  int           res;
+
+  if ((stat(path, &st) == 0) && (S_ISDIR(st.st_mode)))
+    return;
+  #if defined(WIN32)
+    res = mkdir(path);
+  #else
+    res = mkdir(path, 0755);
+  #endif
+  if ((res != 0) && ((stat(path, &st) != 0) || (!S_ISDIR(st.st_mode)))) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'archive_mkdir()': cannot create directory '%s', exit!\n\n", path);
+    Exit(1, g_pauseOnExit);
+  }
+
+} // archive_mkdir
+
+
+
+/**
+  \fn static void archive_blockPath(const archive_t *ar, const uint8_t *hash, char *path, uint8_t dirOnly)
+
+  \brief get path of block in store (dir/blocks/ab/cdef...) or of its subdirectory
+*/
+static void archive_blockPath(const archive_t *ar, const uint8_t *hash, char *path, uint8_t dirOnly) {
+
+  int   i, len;
+
+  len = snprintf(path, ARCHIVE_PATHLEN, "%s/blocks/%02x", ar->dir, hash[0]);
+  if (dirOnly)
+    return;
+  path[len++] = '/';
+  for (i=1; i<ARCHIVE_HASH; i++)
+    len += sprintf(path+len, "%02x", hash[i]);
+
+} // archive_blockPath
+
+
+
+/**
+  \fn static void archive_replace(const char *tmp, const char *path)
+
+  \brief replace file by temporary file (atomic for concurrent readers), exit on error
+*/
+static void archive_replace(const char *tmp, const char *path) {
+
+  #if defined(WIN32)
+    remove(path);
+  #endif
+  if (rename(tmp, path) != 0) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'archive_replace()': cannot rename '%s', exit!\n\n", tmp);
+    Exit(1, g_pauseOnExit);
+  }
+
+} // archive_replace
+
+
+
+/**
+  \fn static uint8_t archive_blockWrite(archive_t *ar, const uint8_t *hash, const char *data, uint32_t len)
+
+  \brief write block to store, if not yet present
+
+  \return 1 if block was written, 0 if it already exists
+*/
+static uint8_t archive_blockWrite(archive_t *ar, const uint8_t *hash, const char *data, uint32_t len) {
+
+  char          path[ARCHIVE_PATHLEN], tmp[ARCHIVE_PATHLEN+20];
+  struct stat   st;
+  FILE          *fp;
+
+  archive_blockPath(ar, hash, path, 0);
+  if (stat(path, &st) == 0)
+    return(0);
+  archive_blockPath(ar, hash, tmp, 1);
+  archive_mkdir(tmp);
+  snprintf(tmp, sizeof(tmp), "%s.%d", path, (int) getpid());
+  fp = fopen(tmp, "wb");
+  if ((!fp) || (fwrite(data, 1, len, fp) != len) || (fclose(fp) != 0)) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'archive_blockWrite()': cannot write '%s', exit!\n\n", tmp);
+    Exit(1, g_pauseOnExit);
+  }
+  archive_replace(tmp, path);
+  return(1);
+
+} // archive_blockWrite
+
+
+
+/**
+  \fn uint32_t archive_manifest(archive_t *ar, const char *name, uint32_t *addrStart, uint32_t *numBytes, uint8_t **hash)
+
+  \brief read manifest of dump
+
+  \param[in]  ar          archive
+  \param[in]  name        name of dump
+  \param[out] addrStart   start address of dump
+  \param[out] numBytes    size of dump [B]
+  \param[out] hash        block hashes (allocated, release with free()), or NULL if not found
+
+  \return number of blocks (0 if not found or invalid)
+*/
+uint32_t archive_manifest(archive_t *ar, const char *name, uint32_t *addrStart, uint32_t *numBytes, uint8_t **hash) {
+
+  char      path[ARCHIVE_PATHLEN+20], line[200];
+  FILE      *fp;
+  uint32_t  i, k, numBlocks, blockSize, val;
+
+  *hash = NULL;
+  snprintf(path, sizeof(path), "%s/dumps/%s.idx", ar->dir, name);
+  fp = fopen(path, "r");
+  if (!fp)
+    return(0);
+
+  // header
+  if ((!fgets(line, sizeof(line), fp)) || (strncmp(line, ARCHIVE_MAGIC, strlen(ARCHIVE_MAGIC))) ||
+      (fscanf(fp, " start %x bytes %u block %u", addrStart, numBytes, &blockSize) != 3) ||
+      (blockSize != ARCHIVE_BLOCK) || (*numBytes == 0)) {
+    fclose(fp);
+    return(0);
+  }
+
+  // one hash per block
+  numBlocks = (*numBytes + ARCHIVE_BLOCK - 1) / ARCHIVE_BLOCK;
+  *hash = (uint8_t*) malloc(numBlocks * ARCHIVE_HASH);
+  if (!(*hash)) {
+    fclose(fp);
+    return(0);
+  }
+  for (i=0; i<numBlocks; i++) {
+    for (k=0; k<ARCHIVE_HASH; k++) {
+      if (fscanf(fp, " %2x", &val) != 1) {
+        fclose(fp);
+        free(*hash);
+        *hash = NULL;
+        return(0);
+      }
+      (*hash)[i*ARCHIVE_HASH+k] = (uint8_t) val;
+    }
+  }
+  fclose(fp);
+
+  return(numBlocks);
+
+} // archive_manifest
+
+
+
+/**
+  \fn static char *archive_load(archive_t *ar, const char *name, uint32_t *addrStart, uint32_t *numBytes, uint8_t **hash, uint8_t verify)
+
+  \brief read manifest and blocks of dump, optionally check block hashes
+
+  \return data (allocated) or NULL if not found, block missing or corrupted
+*/
+static char *archive_load(archive_t *ar, const char *name, uint32_t *addrStart, uint32_t *numBytes, uint8_t **hash, uint8_t verify) {
+
+  char      path[ARCHIVE_PATHLEN], *buf;
+  uint8_t   check[ARCHIVE_HASH];
+  uint32_t  i, len, numBlocks;
+  FILE      *fp;
+
+  numBlocks = archive_manifest(ar, name, addrStart, numBytes, hash);
+  if (numBlocks == 0)
+    return(NULL);
+  buf = (char*) malloc(*numBytes);
+  if (!buf) {
+    free(*hash);
+    *hash = NULL;
+    return(NULL);
+  }
+
+  // read blocks
+  for (i=0; i<numBlocks; i++) {
+    len = *numBytes - i*ARCHIVE_BLOCK;
+    if (len > ARCHIVE_BLOCK)
+      len = ARCHIVE_BLOCK;
+    archive_blockPath(ar, *hash + i*ARCHIVE_HASH, path, 0);
+    fp = fopen(path, "rb");
+    if ((!fp) || (fread(buf + i*ARCHIVE_BLOCK, 1, len, fp) != len)) {
+      if (fp)
+        fclose(fp);
+      break;
+    }
+    fclose(fp);
+    if (verify) {
+      archive_sha256((uint8_t*) (buf + i*ARCHIVE_BLOCK), len, check);
+      if (memcmp(check, *hash + i*ARCHIVE_HASH, ARCHIVE_HASH))
+        break;
+    }
+  }
+  if (i < numBlocks) {
+    free(buf);
+    free(*hash);
+    *hash = NULL;
+    return(NULL);
+  }
+
+  return(buf);
+
+} // archive_load
+
+
+
+/**
+  \fn archive_t *archive_open(const char *dir)
+
+  \brief open or create archive
+
+  \param[in] dir    archive directory
+
+  \return archive (release with archive_close())
+*/
+archive_t *archive_open(const char *dir) {
+
+  archive_t *ar;
+  char      path[ARCHIVE_PATHLEN+20], name[ARCHIVE_PATHLEN];
+  FILE      *fp;
+
+  ar = (archive_t*) calloc(1, sizeof(archive_t));
+  if (!ar) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'archive_open()': cannot allocate memory, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+  strncpy(ar->dir, dir, ARCHIVE_PATHLEN-1);
+  archive_mkdir(ar->dir);
+  snprintf(path, sizeof(path), "%s/blocks", ar->dir);
+  archive_mkdir(path);
+  snprintf(path, sizeof(path), "%s/dumps", ar->dir);
+  archive_mkdir(path);
+
+  // last stored dump is reference. Its blocks were hashed when stored
+  snprintf(path, sizeof(path), "%s/last", ar->dir);
+  fp = fopen(path, "r");
+  if (fp) {
+    if (fgets(name, sizeof(name), fp)) {
+      name[strcspn(name, "\r\n")] = '\0';
+      ar->refData = (uint8_t*) archive_load(ar, name, &(ar->refStart), &(ar->refBytes), &(ar->refHash), 0);
+      if (!ar->refData)
+        ar->refBytes = 0;
+    }
+    fclose(fp);
+  }
+
+  return(ar);
+
+} // archive_open
+
+
+
+/**
+  \fn uint32_t archive_write(archive_t *ar, char *name, const char *buf, uint32_t addrStart, uint32_t numBytes)
+
+  \brief store dump in archive and use it as reference for the next one
+
+  \param[in]     ar           archive
+  \param[in,out] name         name of dump (ARCHIVE_PATHLEN). A suffix is appended if it exists
+  \param[in]     buf          dump data
+  \param[in]     addrStart    start address of dump
+  \param[in]     numBytes     size of dump [B]
+
+  \return number of new blocks written to store
+*/
+uint32_t archive_write(archive_t *ar, char *name, const char *buf, uint32_t addrStart, uint32_t numBytes) {
+
+  char          path[ARCHIVE_PATHLEN+20], tmp[ARCHIVE_PATHLEN+40], base[ARCHIVE_PATHLEN-12];
+  uint8_t       *hash;
+  uint32_t      i, k, len, offset, numBlocks, numNew = 0;
+  struct stat   st;
+  FILE          *fp;
+
+  if (numBytes == 0)
+    return(0);
+  numBlocks = (numBytes + ARCHIVE_BLOCK - 1) / ARCHIVE_BLOCK;
+  hash = (uint8_t*) malloc(numBlocks * ARCHIVE_HASH);
+  if (!hash) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'archive_write()': cannot allocate memory, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+
+  // blocks equal to same address in reference reuse its hash, others are hashed and stored if new
+  for (i=0; i<numBlocks; i++) {
+    len = numBytes - i*ARCHIVE_BLOCK;
+    if (len > ARCHIVE_BLOCK)
+      len = ARCHIVE_BLOCK;
+    offset = addrStart + i*ARCHIVE_BLOCK - ar->refStart;
+    if ((ar->refBytes > 0) && (addrStart + i*ARCHIVE_BLOCK >= ar->refStart) && ((offset % ARCHIVE_BLOCK) == 0) &&
+        (offset + len <= ar->refBytes) && ((offset + len == ar->refBytes) || (len == ARCHIVE_BLOCK)) &&
+        (!memcmp(buf + i*ARCHIVE_BLOCK, ar->refData + offset, len))) {
+      memcpy(hash + i*ARCHIVE_HASH, ar->refHash + (offset/ARCHIVE_BLOCK)*ARCHIVE_HASH, ARCHIVE_HASH);
+      ar->numReused++;
+      continue;
+    }
+    archive_sha256((uint8_t*) (buf + i*ARCHIVE_BLOCK), len, hash + i*ARCHIVE_HASH);
+    ar->numHashed++;
+    numNew += archive_blockWrite(ar, hash + i*ARCHIVE_HASH, buf + i*ARCHIVE_BLOCK, len);
+  }
+  ar->numStored += numNew;
+
+  // unique name of manifest
+  strncpy(base, name, sizeof(base)-1);
+  base[sizeof(base)-1] = '\0';
+  for (k=2; ; k++) {
+    snprintf(path, sizeof(path), "%s/dumps/%s.idx", ar->dir, name);
+    if (stat(path, &st) != 0)
+      break;
+    snprintf(name, ARCHIVE_PATHLEN, "%s_%d", base, (int) k);
+  }
+
+  // write manifest
+  snprintf(tmp, sizeof(tmp), "%s.%d", path, (int) getpid());
+  fp = fopen(tmp, "w");
+  if (!fp) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'archive_write()': cannot write '%s', exit!\n\n", tmp);
+    Exit(1, g_pauseOnExit);
+  }
+  fprintf(fp, "%s\nstart 0x%04x\nbytes %u\nblock %u\n", ARCHIVE_MAGIC, (unsigned) addrStart, (unsigned) numBytes, (unsigned) ARCHIVE_BLOCK);
+  for (i=0; i<numBlocks; i++) {
+    for (k=0; k<ARCHIVE_HASH; k++)
+      fprintf(fp, "%02x", hash[i*ARCHIVE_HASH+k]);
+    fprintf(fp, "\n");
+  }
+  fclose(fp);
+  archive_replace(tmp, path);
+
+  // remember as reference for next dump
+  snprintf(path, sizeof(path), "%s/last", ar->dir);
+  snprintf(tmp, sizeof(tmp), "%s.%d", path, (int) getpid());
+  fp = fopen(tmp, "w");
+  if (fp) {
+    fprintf(fp, "%s\n", name);
+    fclose(fp);
+    archive_replace(tmp, path);
+  }
+  free(ar->refHash);
+  free(ar->refData);
+  ar->refHash  = hash;
+  ar->refData  = (uint8_t*) malloc(numBytes);
+  ar->refStart = addrStart;
+  ar->refBytes = ar->refData ? numBytes : 0;
+  if (ar->refData)
+    memcpy(ar->refData, buf, numBytes);
+
+  return(numNew);
+
+} // archive_write
+
+
+
+/**
+  \fn char *archive_read(archive_t *ar, const char *name, uint32_t *addrStart, uint32_t *numBytes)
+
+  \brief read dump from archive and check block hashes
+
+  \param[in]  ar          archive
+  \param[in]  name        name of dump
+  \param[out] addrStart   start address of dump
+  \param[out] numBytes    size of dump [B]
+
+  \return data (allocated, release with free()), or NULL if not found or corrupted
+*/
+char *archive_read(archive_t *ar, const char *name, uint32_t *addrStart, uint32_t *numBytes) {
+
+  uint8_t   *hash;
+  char      *buf;
+
+  buf = archive_load(ar, name, addrStart, numBytes, &hash, 1);
+  free(hash);
+  return(buf);
+
+} // archive_read
+
+
+
+/**
+  \fn void archive_close(archive_t *ar)
+
+  \brief close archive and release reference dump
+*/
+void archive_close(archive_t *ar) {
+
+  if (!ar)
+    return;
+  free(ar->refHash);
+  free(ar->refData);
+  free(ar);
+
+} // archive_close
+
+// end of file
@@ -0,0 +1,72 @@
+/**
+  \file archive.h
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief declaration of deduplicated memory dump archive
+
+  declaration of routines for storing memory dumps of many boards in a
+  content-addressed archive. Each dump is a list of block hashes (SHA-256),
+  the block data is stored once per content in a shared block store:
+    dir/blocks/ab/cdef...   block data, file name is hash in hex
+    dir/dumps/name.idx      manifest: start address, size, block hashes
+    dir/last                name of last stored dump (reference for next one)
+  Blocks which are identical to the same block of the reference dump reuse its
+  hash without hashing or writing, which is the common case for a fleet.
+*/
+
+// for including file only once
+#ifndef _ARCHIVE_H_
+#define _ARCHIVE_H_
+
+
+// include files
+#include <stdint.h>
+
+
+/// size of a block [B] (last block of a dump may be shorter)
+#define ARCHIVE_BLOCK       1024
+
+/// size of block hash [B] (SHA-256)
+#define ARCHIVE_HASH        32
+
+/// max. length of archive path and dump names
+#define ARCHIVE_PATHLEN     1000
+
+
+/// open archive and reference dump
+typedef struct {
+  char        dir[ARCHIVE_PATHLEN];   ///< archive directory
+  uint32_t    refStart;               ///< start address of reference dump
+  uint32_t    refBytes;               ///< size of reference dump [B] (0=none)
+  uint8_t     *refData;               ///< data of reference dump
+  uint8_t     *refHash;               ///< block hashes of reference dump
+  uint32_t    numHashed;              ///< statistics: blocks hashed
+  uint32_t    numStored;              ///< statistics: new blocks written to store
+  uint32_t    numReused;              ///< statistics: blocks reused from reference without hashing
+} archive_t;
+
+
+/// SHA-256 of buffer
+void        archive_sha256(const uint8_t *buf, uint32_t numBytes, uint8_t *hash);
+
+/// open or create archive directory. Last stored dump is used as reference
+archive_t   *archive_open(const char *dir);
+
+/// store dump under given name (made unique). Returns number of new blocks
+uint32_t    archive_write(archive_t *ar, char *name, const char *buf, uint32_t addrStart, uint32_t numBytes);
+
+/// read manifest of dump. Returns number of blocks, hashes are allocated (or NULL if not found)
+uint32_t    archive_manifest(archive_t *ar, const char *name, uint32_t *addrStart, uint32_t *numBytes, uint8_t **hash);
+
+/// read dump, buffer is allocated (NULL if not found or block missing)
+char        *archive_read(archive_t *ar, const char *name, uint32_t *addrStart, uint32_t *numBytes);
+
+/// close archive and release reference dump
+void        archive_close(archive_t *ar);
+
+#endif // _ARCHIVE_H_
+
+// end of file
@@ -13,10 +13,126 @@
 
 #include "bootloader.h"
 #include "serial_comm.h"
+#include "trace.h"
+#include "rto.h"
 #include "misc.h"
 #include "globals.h"
 
 
+// send-to-ACK round-trip times [us] per ACK stage
+static hist_t   s_ackRtt[ACK_NUM_STAGES];
+
+// adaptive timeouts (see rto.h)
+static rto_t    s_rto;                  // measured response latency
+static uint32_t s_baudrate = 0;         // baudrate of port [Baud]
+static uint32_t s_timeout = 0;          // current port timeout [ms], 0=unknown
+static int      s_flashsize = 256;      // flash size [kB] for mass erase (set by bsl_getInfo())
+
+// speculative pipelining (see bsl_setPipeline())
+static uint8_t  s_pipeline = 0;         // send next command before ACK of previous data phase
+static uint8_t  s_cmdPending = 0;       // command of next WRITE/READ already sent, ACK outstanding
+static uint32_t s_numSpeculative = 0;   // number of speculatively sent commands
+static uint32_t s_numDesync = 0;        // number of desyncs (-> fallback to lock-step)
+
+
+
+/**
+  \fn static void bsl_setTimeout(HANDLE ptrPort, uint16_t lenTx, uint16_t lenRx, uint32_t device)
+   
+  \brief set port timeout for next response
+   
+  \param[in] ptrPort    handle to communication port
+  \param[in] lenTx      number of sent bytes
+  \param[in] lenRx      number of expected bytes
+  \param[in] device     max. processing time of device [us], e.g. rto_program()
+
+  the timeout is derived from line time, device time and measured latency.
+  Posix port timeouts have a resolution of 100ms, so it is rounded up and
+  only set if changed
+*/
+static void bsl_setTimeout(HANDLE ptrPort, uint16_t lenTx, uint16_t lenRx, uint32_t device) {
+
+  uint32_t  timeout;
+
+  timeout = rto_timeout(&s_rto, rto_transfer(s_baudrate, g_UARTmode, lenTx, lenRx), device);
+  timeout = (timeout + 99999) / 100000 * 100;
+  if (timeout != s_timeout) {
+    set_timeout(ptrPort, timeout);
+    s_timeout = timeout;
+  }
+
+} // bsl_setTimeout
+
+
+
+/**
+  \fn static void bsl_addAck(uint8_t stage, uint64_t timeTx, uint16_t lenTx)
+   
+  \brief record send-to-ACK round-trip time of command or address (no device processing)
+*/
+static void bsl_addAck(uint8_t stage, uint64_t timeTx, uint16_t lenTx) {
+
+  uint32_t  rtt = (uint32_t) (time_us() - timeTx);
+
+  hist_add(&(s_ackRtt[stage]), rtt);
+  rto_sample(&s_rto, rtt, rto_transfer(s_baudrate, g_UARTmode, lenTx, 1));
+
+} // bsl_addAck
+
+
+
+/**
+  \fn static uint8_t bsl_desync(HANDLE ptrPort)
+   
+  \brief handle missing or wrong ACK in pipelined mode
+   
+  \param[in] ptrPort    handle to communication port
+
+  \return 1 if BSL is back in command state for a retry in lock-step, 0 if not pipelined or resync failed
+
+  a speculative command may be lost by the BSL while it programs flash or
+  sends data. Then the BSL waits for the rest of the command, or for the
+  address if only the ACK was lost. Pending responses are drained, then single
+  0xFF bytes are sent until a NACK is received: 0xFF is neither a command nor
+  the complement of one, and 5x 0xFF is an address with wrong checksum.
+  Pipelining is then disabled for the rest of the board
+*/
+static uint8_t bsl_desync(HANDLE ptrPort) {
+
+  char      Tx[1], Rx[1];
+  int       i;
+
+  // error in lock-step -> handled by caller
+  if (!s_pipeline)
+    return(0);
+  s_pipeline   = 0;
+  s_cmdPending = 0;
+  s_numDesync++;
+  printf("\n  pipeline desync, retry in lock-step ... ");
+  fflush(stdout);
+
+  // drain late responses incl. ACK of programmed data
+  bsl_setTimeout(ptrPort, 1, 1, rto_program(PFLASH_START, 128));
+  while (receive_port(ptrPort, 1, Rx) == 1);
+
+  // send invalid bytes until BSL replies NACK (max. address + checksum)
+  Tx[0] = (char) 0xFF;
+  for (i=0; i<5; i++) {
+    send_port(ptrPort, 1, Tx);
+    if ((receive_port(ptrPort, 1, Rx) == 1) && (Rx[0] == NACK)) {
+      printf("ok\n");
+      bsl_setTimeout(ptrPort, 2, 257, 0);
+      return(1);
+    }
+  }
+  printf("failed\n");
+
+  return(0);
+
+} // bsl_desync
+
+
+
 /**
   \fn uint8_t bsl_sync(HANDLE ptrPort)
    
@@ -31,9 +147,11 @@
 */
 uint8_t bsl_sync(HANDLE ptrPort) {
   
-  int   i, count;
-  int   lenTx, lenRx, len;
-  char  Tx[1000], Rx[1000];
+  int       i, count;
+  int       lenTx, lenRx, len;
+  char      Tx[1000], Rx[1000];
+  uint32_t  timeout;
+  uint8_t   numBits, parity, numStop, RTS, DTR;
 
   // print message
   printf("  synchronize ... ");
@@ -49,6 +167,14 @@ uint8_t bsl_sync(HANDLE ptrPort) {
     fprintf(stderr, "\n\nerror in 'bsl_sync()': port not open, exit!\n\n");
     Exit(1, g_pauseOnExit);
   }
+
+  // new board or port: restart latency measurement, derive timeout from baudrate
+  get_port_attribute(ptrPort, &s_baudrate, &timeout, &numBits, &parity, &numStop, &RTS, &DTR);
+  rto_init(&s_rto);
+  s_timeout = 0;
+  bsl_setTimeout(ptrPort, 1, 1, 0);
+
+  trace_begin(TRACE_TID(ptrPort), "command", "SYNC");
   
   
   // purge input buffer
@@ -103,6 +229,8 @@ uint8_t bsl_sync(HANDLE ptrPort) {
     Exit(1, g_pauseOnExit);
   }
 
+  trace_end(TRACE_TID(ptrPort), "command", "SYNC");
+
   // return success
   return(0);
 
@@ -158,8 +286,8 @@ uint8_t bsl_getInfo(HANDLE ptrPort, int *flashsize, uint8_t *vers, uint8_t *fami
   // determine device flash size for selecting w/e routines (flash starts at PFLASH_START)
   /////////
 
-  // reduce timeout for faster check
-  set_timeout(ptrPort, 200);
+  // timeout for memory check (no device processing)
+  bsl_setTimeout(ptrPort, 5, 2, 0);
   
   // check address of EEPROM. STM8L starts at 0x1000, STM8S starts at 0x4000
   if (bsl_memCheck(ptrPort, 0x004000))       // STM8S
@@ -202,10 +330,13 @@ uint8_t bsl_getInfo(HANDLE ptrPort, int *flashsize, uint8_t *vers, uint8_t *fami
 #endif
   
 
-  // restore timeout to avoid timeouts during flash operation
-  set_timeout(ptrPort, 1000);
+  // default timeout for max. READ (256B)
+  s_flashsize = *flashsize;
+  bsl_setTimeout(ptrPort, 2, 257, 0);
   
   
+  trace_begin(TRACE_TID(ptrPort), "command", "GET");
+
   /////////
   // get BSL version
   /////////
@@ -291,6 +422,8 @@ uint8_t bsl_getInfo(HANDLE ptrPort, int *flashsize, uint8_t *vers, uint8_t *fami
     fflush(stdout);
   }
   
+  trace_end(TRACE_TID(ptrPort), "command", "GET");
+
   // avoid compiler warnings
   return(0);
   
@@ -298,6 +431,197 @@ uint8_t bsl_getInfo(HANDLE ptrPort, int *flashsize, uint8_t *vers, uint8_t *fami
 
 
 
+/**
+  \fn static uint8_t bsl_readChunk(HANDLE ptrPort, uint32_t addr, uint32_t numBytes, char *buf, uint8_t last)
+   
+  \brief read up to 256B via READ command
+   
+  \param[in] ptrPort    handle to communication port
+  \param[in] addr       starting address to read from
+  \param[in] numBytes   number of bytes to read (1..256)
+  \param[out] buf       buffer to store data to
+  \param[in] last       no READ follows, i.e. don't send next command speculatively
+  
+  \return 0=ok, 1=desync in pipelined mode -> retry chunk in lock-step
+  
+  send READ command, address and number of bytes and receive the data. In
+  pipelined mode the command of the next chunk is sent before the data is
+  received, and its ACK is checked by the next call. Used by bsl_memRead()
+*/
+static uint8_t bsl_readChunk(HANDLE ptrPort, uint32_t addr, uint32_t numBytes, char *buf, uint8_t last) {
+
+  int       i, lenTx, lenRx, len;
+  char      Tx[1000], Rx[1000];
+  uint64_t  timeTx = 0;             // for ACK round-trip time
+  uint8_t   speculative;            // command was sent with previous chunk
+
+
+  trace_begin(TRACE_TID(ptrPort), "command", "READ");
+
+  /////
+  // send read command
+  /////
+
+  // construct command
+  lenTx = 2;
+  Tx[0] = READ;
+  Tx[1] = (Tx[0] ^ 0xFF);
+  lenRx = 1;
+
+  // send command, unless already sent with previous chunk
+  speculative  = s_cmdPending;
+  s_cmdPending = 0;
+  if (!speculative) {
+    timeTx = time_us();
+    len = send_port(ptrPort, lenTx, Tx);
+    if (len != lenTx) {
+      setConsoleColor(PRM_COLOR_RED);
+      fprintf(stderr, "\n\nerror in 'bsl_memRead()': sending command failed, exit!\n\n");
+      Exit(1, g_pauseOnExit);
+    }
+  }
+  
+  // receive response with timeout
+  len = receive_port(ptrPort, lenRx, Rx);
+  if (len != lenRx) {
+    if (bsl_desync(ptrPort)) {
+      trace_end(TRACE_TID(ptrPort), "command", "READ");
+      return(1);
+    }
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'bsl_memRead()': ACK1 timeout, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+  
+  // check acknowledge
+  if (Rx[0]!=ACK) {
+    if (bsl_desync(ptrPort)) {
+      trace_end(TRACE_TID(ptrPort), "command", "READ");
+      return(1);
+    }
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'bsl_memRead()': ACK1 failure 0x%2x, exit!\n\n", Rx[0]);
+    Exit(1, g_pauseOnExit);
+  }
+  if (!speculative)
+    bsl_addAck(ACK_STAGE_CMD, timeTx, lenTx);
+
+
+  /////
+  // send address
+  /////
+
+  // construct address + checksum (XOR over address)
+  lenTx = 5;
+  Tx[0] = (char) (addr >> 24);
+  Tx[1] = (char) (addr >> 16);
+  Tx[2] = (char) (addr >> 8);
+  Tx[3] = (char) (addr);
+  Tx[4] = (Tx[0] ^ Tx[1] ^ Tx[2] ^ Tx[3]);
+  lenRx = 1;
+
+  // send command
+  timeTx = time_us();
+  len = send_port(ptrPort, lenTx, Tx);
+  if (len != lenTx) {      
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'bsl_memRead()': sending address failed, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+
+  // receive response with timeout
+  len = receive_port(ptrPort, lenRx, Rx);
+  if (len != lenRx) {
+    if (bsl_desync(ptrPort)) {
+      trace_end(TRACE_TID(ptrPort), "command", "READ");
+      return(1);
+    }
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'bsl_memRead()': ACK2 timeout, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+  
+  // check acknowledge
+  if (Rx[0]!=ACK) {
+    if (bsl_desync(ptrPort)) {
+      trace_end(TRACE_TID(ptrPort), "command", "READ");
+      return(1);
+    }
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'bsl_memRead()': ACK2 failure, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+  bsl_addAck(ACK_STAGE_ADDR, timeTx, lenTx);
+
+
+  /////
+  // send number of bytes
+  /////
+
+  // construct number of bytes + checksum
+  lenTx = 2;
+  Tx[0] = numBytes-1;     // -1 from BSL
+  Tx[1] = (Tx[0] ^ 0xFF);
+  lenRx = numBytes + 1;
+
+  // send command
+  len = send_port(ptrPort, lenTx, Tx);
+  if (len != lenTx) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'bsl_memRead()': sending range failed, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+
+  // pipelined: send next command while BSL sends the data
+  if ((s_pipeline) && (!last)) {
+    Tx[0] = READ;
+    Tx[1] = (Tx[0] ^ 0xFF);
+    if (send_port(ptrPort, 2, Tx) != 2) {
+      setConsoleColor(PRM_COLOR_RED);
+      fprintf(stderr, "\n\nerror in 'bsl_memRead()': sending command failed, exit!\n\n");
+      Exit(1, g_pauseOnExit);
+    }
+    s_cmdPending = 1;
+    s_numSpeculative++;
+  }
+
+  // receive response with timeout
+  len = receive_port(ptrPort, lenRx, Rx);
+  if (len != lenRx) {
+    if (bsl_desync(ptrPort)) {
+      trace_end(TRACE_TID(ptrPort), "command", "READ");
+      return(1);
+    }
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'bsl_memRead()': data timeout, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+  
+  // check acknowledge
+  if (Rx[0]!=ACK) {
+    if (bsl_desync(ptrPort)) {
+      trace_end(TRACE_TID(ptrPort), "command", "READ");
+      return(1);
+    }
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'bsl_memRead()': ACK3 failure, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+
+  // copy data to buffer
+  for (i=1; i<lenRx; i++) {
+    buf[i-1] = Rx[i];
+    //printf("%d 0x%02x\n", i, (uint8_t) (Rx[i])); fflush(stdout);
+  }
+
+  trace_end(TRACE_TID(ptrPort), "command", "READ");
+
+  return(0);
+
+} // bsl_readChunk
+
+
+
 /**
   \fn uint8_t bsl_memRead(HANDLE ptrPort, uint32_t addrStart, uint32_t numBytes, char *buf)
    
@@ -314,8 +638,7 @@ uint8_t bsl_getInfo(HANDLE ptrPort, int *flashsize, uint8_t *vers, uint8_t *fami
 */
 uint8_t bsl_memRead(HANDLE ptrPort, uint32_t addrStart, uint32_t numBytes, char *buf, uint8_t verbose) {
 
-  int       i, lenTx, lenRx, len;
-  char      Tx[1000], Rx[1000];
+  int       i;
   uint32_t  addrTmp, addrStep, idx=0;
 
 
@@ -328,10 +651,6 @@ uint8_t bsl_memRead(HANDLE ptrPort, uint32_t addrStart, uint32_t numBytes, char
     fflush(stdout);
   }
   
-  // init receive buffer
-  for (i=0; i<1000; i++)
-    Rx[i] = 0;
-
   // check if port is open
   if (!ptrPort) {
     setConsoleColor(PRM_COLOR_RED);
@@ -353,116 +672,9 @@ uint8_t bsl_memRead(HANDLE ptrPort, uint32_t addrStart, uint32_t numBytes, char
     if (addrTmp+256 > addrStart+numBytes)
       addrStep = addrStart+numBytes-addrTmp;
 
-  
-    /////
-    // send read command
-    /////
-  
-    // construct command
-    lenTx = 2;
-    Tx[0] = READ;
-    Tx[1] = (Tx[0] ^ 0xFF);
-    lenRx = 1;
-  
-    // send command
-    len = send_port(ptrPort, lenTx, Tx);
-    if (len != lenTx) {
-      setConsoleColor(PRM_COLOR_RED);
-      fprintf(stderr, "\n\nerror in 'bsl_memRead()': sending command failed, exit!\n\n");
-      Exit(1, g_pauseOnExit);
-    }
-    
-    // receive response with timeout
-    len = receive_port(ptrPort, lenRx, Rx);
-    if (len != lenRx) {
-      setConsoleColor(PRM_COLOR_RED);
-      fprintf(stderr, "\n\nerror in 'bsl_memRead()': ACK1 timeout, exit!\n\n");
-      Exit(1, g_pauseOnExit);
-    }
-    
-    // check acknowledge
-    if (Rx[0]!=ACK) {
-      setConsoleColor(PRM_COLOR_RED);
-      fprintf(stderr, "\n\nerror in 'bsl_memRead()': ACK1 failure 0x%2x, exit!\n\n", Rx[0]);
-      Exit(1, g_pauseOnExit);
-    }
-
-  
-    /////
-    // send address
-    /////
-  
-    // construct address + checksum (XOR over address)
-    lenTx = 5;
-    Tx[0] = (char) (addrTmp >> 24);
-    Tx[1] = (char) (addrTmp >> 16);
-    Tx[2] = (char) (addrTmp >> 8);
-    Tx[3] = (char) (addrTmp);
-    Tx[4] = (Tx[0] ^ Tx[1] ^ Tx[2] ^ Tx[3]);
-    lenRx = 1;
-  
-    // send command
-    len = send_port(ptrPort, lenTx, Tx);
-    if (len != lenTx) {      
-      setConsoleColor(PRM_COLOR_RED);
-      fprintf(stderr, "\n\nerror in 'bsl_memRead()': sending address failed, exit!\n\n");
-      Exit(1, g_pauseOnExit);
-    }
-
-    // receive response with timeout
-    len = receive_port(ptrPort, lenRx, Rx);
-    if (len != lenRx) {      
-      setConsoleColor(PRM_COLOR_RED);
-      fprintf(stderr, "\n\nerror in 'bsl_memRead()': ACK2 timeout, exit!\n\n");
-      Exit(1, g_pauseOnExit);
-    }
-    
-    // check acknowledge
-    if (Rx[0]!=ACK) {
-      setConsoleColor(PRM_COLOR_RED);
-      fprintf(stderr, "\n\nerror in 'bsl_memRead()': ACK2 failure, exit!\n\n");
-      Exit(1, g_pauseOnExit);
-    }
-
-  
-    /////
-    // send number of bytes
-    /////
-  
-    // construct number of bytes + checksum
-    lenTx = 2;
-    Tx[0] = addrStep-1;     // -1 from BSL
-    Tx[1] = (Tx[0] ^ 0xFF);
-    lenRx = addrStep + 1;
-  
-    // send command
-    len = send_port(ptrPort, lenTx, Tx);
-    if (len != lenTx) {
-      setConsoleColor(PRM_COLOR_RED);
-      fprintf(stderr, "\n\nerror in 'bsl_memRead()': sending range failed, exit!\n\n");
-      Exit(1, g_pauseOnExit);
-    }
-
-    // receive response with timeout
-    len = receive_port(ptrPort, lenRx, Rx);
-    if (len != lenRx) {
-      setConsoleColor(PRM_COLOR_RED);
-      fprintf(stderr, "\n\nerror in 'bsl_memRead()': data timeout, exit!\n\n");
-      Exit(1, g_pauseOnExit);
-    }
-    
-    // check acknowledge
-    if (Rx[0]!=ACK) {
-      setConsoleColor(PRM_COLOR_RED);
-      fprintf(stderr, "\n\nerror in 'bsl_memRead()': ACK3 failure, exit!\n\n");
-      Exit(1, g_pauseOnExit);
-    }
-
-    // copy data to buffer
-    for (i=1; i<lenRx; i++) {
-      buf[idx++] = Rx[i];
-      //printf("%d 0x%02x\n", i, (uint8_t) (Rx[i])); fflush(stdout);
-    }
+    // send READ command, address and number of bytes. Retry in lock-step after desync
+    while (bsl_readChunk(ptrPort, addrTmp, addrStep, buf+idx, (addrTmp+addrStep >= addrStart+numBytes)));
+    idx += addrStep;
     
     // print progress
     if (verbose) {
@@ -537,6 +749,8 @@ uint8_t bsl_memCheck(HANDLE ptrPort, uint32_t addr) {
     fprintf(stderr, "\n\nerror in 'bsl_memCheck()': port not open, exit!\n\n");
     Exit(1, g_pauseOnExit);
   }
+
+  trace_begin(TRACE_TID(ptrPort), "command", "READ");
   
 
   /////
@@ -604,6 +818,7 @@ uint8_t bsl_memCheck(HANDLE ptrPort, uint32_t addr) {
     
   // check acknowledge -> on NACK memory cannot be read -> return 0
   if (Rx[0]!=ACK) {
+    trace_end(TRACE_TID(ptrPort), "command", "READ");
     return(0);
   }
 
@@ -641,6 +856,8 @@ uint8_t bsl_memCheck(HANDLE ptrPort, uint32_t addr) {
     Exit(1, g_pauseOnExit);
   }
 
+  trace_end(TRACE_TID(ptrPort), "command", "READ");
+
   // memory read succeeded -> memory exists
   return(1);
   
@@ -748,6 +965,7 @@ uint8_t bsl_flashSectorErase(HANDLE ptrPort, uint32_t addr) {
   
   // wait for erase to avoid communication timeout
   //SLEEP(10000);
+  bsl_setTimeout(ptrPort, lenTx, 1, rto_erase(1));
   
   
   // receive response with timeout
@@ -764,6 +982,7 @@ uint8_t bsl_flashSectorErase(HANDLE ptrPort, uint32_t addr) {
     fprintf(stderr, "\n\nerror in 'bsl_flashSectorErase()': ACK2 failure, exit!\n\n");
     Exit(1, g_pauseOnExit);
   }
+  bsl_setTimeout(ptrPort, 2, 257, 0);
 
     
   // print message
@@ -808,6 +1027,8 @@ uint8_t bsl_flashMassErase(HANDLE ptrPort) {
     fprintf(stderr, "\n\nerror in 'bsl_flashMassErase()': port not open, exit!\n\n");
     Exit(1, g_pauseOnExit);
   }
+
+  trace_begin(TRACE_TID(ptrPort), "command", "ERASE");
   
 
   /////
@@ -867,7 +1088,7 @@ uint8_t bsl_flashMassErase(HANDLE ptrPort) {
   //SLEEP(10000);
   
   // mass erase takes longer -> increase timeout
-  set_timeout(ptrPort, 5000);
+  bsl_setTimeout(ptrPort, 2, 1, rto_erase(s_flashsize + RTO_EEPROM_KB));
   
   // receive response with timeout
   len = receive_port(ptrPort, lenRx, Rx);
@@ -884,14 +1105,16 @@ uint8_t bsl_flashMassErase(HANDLE ptrPort) {
     Exit(1, g_pauseOnExit);
   }
 
-  // restore timeout
-  set_timeout(ptrPort, 1000);
+  // restore default timeout
+  bsl_setTimeout(ptrPort, 2, 257, 0);
 
     
   // print message
   printf("ok\n");
   fflush(stdout);
   
+  trace_end(TRACE_TID(ptrPort), "command", "ERASE");
+
   // avoid compiler warnings
   return(0);
 
@@ -899,6 +1122,191 @@ uint8_t bsl_flashMassErase(HANDLE ptrPort) {
 
 
 
+/**
+  \fn static uint8_t bsl_writeFrame(HANDLE ptrPort, uint32_t addr, uint32_t lenFrame, char *frame, uint8_t last)
+   
+  \brief send one WRITE command with address and data frame
+   
+  \param[in] ptrPort    handle to communication port
+  \param[in] addr       starting address of frame
+  \param[in] lenFrame   number of bytes in frame (N-1 + data + checksum)
+  \param[in] frame      frame to send
+  \param[in] last       no WRITE follows, i.e. don't send next command speculatively
+  
+  \return 0=ok, 1=desync in pipelined mode -> retry frame in lock-step
+  
+  send WRITE command, address and pre-built data frame and check the 3 ACKs.
+  In pipelined mode the command of the next frame is sent directly after the
+  data, and its ACK is checked by the next call.
+  Used by bsl_memWrite() and bsl_imageWrite()
+*/
+static uint8_t bsl_writeFrame(HANDLE ptrPort, uint32_t addr, uint32_t lenFrame, char *frame, uint8_t last) {
+
+  int       lenTx, lenRx, len;
+  char      Tx[1000], Rx[1000];
+  uint64_t  timeTx = 0;             // for ACK round-trip time
+  uint8_t   speculative;            // command was sent with previous frame
+
+
+  trace_begin(TRACE_TID(ptrPort), "command", "WRITE");
+
+  /////
+  // send write command
+  /////
+
+  // construct command
+  lenTx = 2;
+  Tx[0] = WRITE;
+  Tx[1] = (Tx[0] ^ 0xFF);
+  lenRx = 1;
+
+  // send command, unless already sent with previous frame
+  speculative  = s_cmdPending;
+  s_cmdPending = 0;
+  if (!speculative) {
+    timeTx = time_us();
+    len = send_port(ptrPort, lenTx, Tx);
+    if (len != lenTx) {
+      setConsoleColor(PRM_COLOR_RED);
+      fprintf(stderr, "\n\nerror in 'bsl_memWrite()': sending command failed, exit!\n\n");
+      Exit(1, g_pauseOnExit);
+    }
+  }
+  
+  // receive response with timeout
+  len = receive_port(ptrPort, lenRx, Rx);
+  if (len != lenRx) {
+    if (bsl_desync(ptrPort)) {
+      trace_end(TRACE_TID(ptrPort), "command", "WRITE");
+      return(1);
+    }
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'bsl_memWrite()': ACK1 timeout, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+  
+  // check acknowledge
+  if (Rx[0]!=ACK) {
+    if (bsl_desync(ptrPort)) {
+      trace_end(TRACE_TID(ptrPort), "command", "WRITE");
+      return(1);
+    }
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'bsl_memWrite()': ACK1 failure, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+  if (!speculative)
+    bsl_addAck(ACK_STAGE_CMD, timeTx, lenTx);
+
+
+  /////
+  // send address
+  /////
+
+  // construct address + checksum (XOR over address)
+  lenTx = 5;
+  Tx[0] = (char) (addr >> 24);
+  Tx[1] = (char) (addr >> 16);
+  Tx[2] = (char) (addr >> 8);
+  Tx[3] = (char) (addr);
+  Tx[4] = (Tx[0] ^ Tx[1] ^ Tx[2] ^ Tx[3]);
+  lenRx = 1;
+
+  // send command
+  timeTx = time_us();
+  len = send_port(ptrPort, lenTx, Tx);
+  if (len != lenTx) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'bsl_memWrite()': sending address failed, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+  
+  // receive response with timeout
+  len = receive_port(ptrPort, lenRx, Rx);
+  if (len != lenRx) {
+    if (bsl_desync(ptrPort)) {
+      trace_end(TRACE_TID(ptrPort), "command", "WRITE");
+      return(1);
+    }
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'bsl_memWrite()': ACK2 timeout, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+  
+  // check acknowledge
+  if (Rx[0]!=ACK) {
+    if (bsl_desync(ptrPort)) {
+      trace_end(TRACE_TID(ptrPort), "command", "WRITE");
+      return(1);
+    }
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'bsl_memWrite()': ACK2 failure, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+  bsl_addAck(ACK_STAGE_ADDR, timeTx, lenTx);
+
+
+  /////
+  // send number of bytes and data
+  /////
+
+  // send frame. Timeout includes programming
+  lenRx = 1;
+  bsl_setTimeout(ptrPort, lenFrame, lenRx, rto_program(addr, lenFrame-2));
+  timeTx = time_us();
+  len = send_port(ptrPort, lenFrame, frame);
+  if (len != lenFrame) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'bsl_memWrite()': sending data failed, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+
+  // pipelined: send next command while BSL programs the data
+  if ((s_pipeline) && (!last)) {
+    Tx[0] = WRITE;
+    Tx[1] = (Tx[0] ^ 0xFF);
+    if (send_port(ptrPort, 2, Tx) != 2) {
+      setConsoleColor(PRM_COLOR_RED);
+      fprintf(stderr, "\n\nerror in 'bsl_memWrite()': sending command failed, exit!\n\n");
+      Exit(1, g_pauseOnExit);
+    }
+    s_cmdPending = 1;
+    s_numSpeculative++;
+  }
+  
+  // receive response with timeout
+  len = receive_port(ptrPort, lenRx, Rx);
+  if (len != lenRx) {
+    if (bsl_desync(ptrPort)) {
+      trace_end(TRACE_TID(ptrPort), "command", "WRITE");
+      return(1);
+    }
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'bsl_memWrite()': ACK3 timeout, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+  
+  // check acknowledge
+  if (Rx[0]!=ACK) {
+    if (bsl_desync(ptrPort)) {
+      trace_end(TRACE_TID(ptrPort), "command", "WRITE");
+      return(1);
+    }
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'bsl_memWrite()': ACK3 failure, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+  hist_add(&(s_ackRtt[ACK_STAGE_DATA]), time_us() - timeTx);
+  bsl_setTimeout(ptrPort, 2, 257, 0);
+
+  trace_end(TRACE_TID(ptrPort), "command", "WRITE");
+
+  return(0);
+
+} // bsl_writeFrame
+
+
+
 /**
   \fn uint8_t bsl_memWrite(HANDLE ptrPort, uint32_t addrStart, uint32_t numBytes, char *buf)
    
@@ -916,9 +1324,9 @@ uint8_t bsl_flashMassErase(HANDLE ptrPort) {
 */
 uint8_t bsl_memWrite(HANDLE ptrPort, uint32_t addrStart, uint32_t numBytes, char *buf, uint8_t verbose) {
 
-  int       i, lenTx, lenRx, len;
-  char      Tx[1000], Rx[1000];
-  uint32_t  addrTmp, addrStep, idx=0, idx2=0;
+  int       i, lenTx;
+  char      Tx[1000];
+  uint32_t  addrTmp, addrStep, idx=0, idx2=0, next;
   uint8_t   chk, flagEmpty;
 
 
@@ -931,10 +1339,6 @@ uint8_t bsl_memWrite(HANDLE ptrPort, uint32_t addrStart, uint32_t numBytes, char
     fflush(stdout);
   }
   
-  // init receive buffer
-  for (i=0; i<1000; i++)
-    Rx[i] = 0;
-
   // check if port is open
   if (!ptrPort) {
     setConsoleColor(PRM_COLOR_RED);
@@ -966,82 +1370,6 @@ uint8_t bsl_memWrite(HANDLE ptrPort, uint32_t addrStart, uint32_t numBytes, char
       continue;
     }
       
-
-    /////
-    // send write command
-    /////
-  
-    // construct command
-    lenTx = 2;
-    Tx[0] = WRITE;
-    Tx[1] = (Tx[0] ^ 0xFF);
-    lenRx = 1;
-  
-    // send command
-    len = send_port(ptrPort, lenTx, Tx);
-    if (len != lenTx) {
-      setConsoleColor(PRM_COLOR_RED);
-      fprintf(stderr, "\n\nerror in 'bsl_memWrite()': sending command failed, exit!\n\n");
-      Exit(1, g_pauseOnExit);
-    }
-    
-    // receive response with timeout
-    len = receive_port(ptrPort, lenRx, Rx);
-    if (len != lenRx) {
-      setConsoleColor(PRM_COLOR_RED);
-      fprintf(stderr, "\n\nerror in 'bsl_memWrite()': ACK1 timeout, exit!\n\n");
-      Exit(1, g_pauseOnExit);
-    }
-    
-    // check acknowledge
-    if (Rx[0]!=ACK) {
-      setConsoleColor(PRM_COLOR_RED);
-      fprintf(stderr, "\n\nerror in 'bsl_memWrite()': ACK1 failure, exit!\n\n");
-      Exit(1, g_pauseOnExit);
-    }
- 
-  
-    /////
-    // send address
-    /////
-  
-    // construct address + checksum (XOR over address)
-    lenTx = 5;
-    Tx[0] = (char) (addrTmp >> 24);
-    Tx[1] = (char) (addrTmp >> 16);
-    Tx[2] = (char) (addrTmp >> 8);
-    Tx[3] = (char) (addrTmp);
-    Tx[4] = (Tx[0] ^ Tx[1] ^ Tx[2] ^ Tx[3]);
-    lenRx = 1;
-  
-    // send command
-    len = send_port(ptrPort, lenTx, Tx);
-    if (len != lenTx) {
-      setConsoleColor(PRM_COLOR_RED);
-      fprintf(stderr, "\n\nerror in 'bsl_memWrite()': sending address failed, exit!\n\n");
-      Exit(1, g_pauseOnExit);
-    }
-    
-    // receive response with timeout
-    len = receive_port(ptrPort, lenRx, Rx);
-    if (len != lenRx) {
-      setConsoleColor(PRM_COLOR_RED);
-      fprintf(stderr, "\n\nerror in 'bsl_memWrite()': ACK2 timeout, exit!\n\n");
-      Exit(1, g_pauseOnExit);
-    }
-    
-    // check acknowledge
-    if (Rx[0]!=ACK) {
-      setConsoleColor(PRM_COLOR_RED);
-      fprintf(stderr, "\n\nerror in 'bsl_memWrite()': ACK2 failure, exit!\n\n");
-      Exit(1, g_pauseOnExit);
-    }
-
-  
-    /////
-    // send number of bytes and data
-    /////
-  
     // construct number of bytes + data + checksum
     lenTx = 0;
     Tx[lenTx++] = addrStep-1;     // -1 from BSL
@@ -1053,31 +1381,10 @@ uint8_t bsl_memWrite(HANDLE ptrPort, uint32_t addrStart, uint32_t numBytes, char
       lenTx++;
     }
     Tx[lenTx++] = chk;
-    lenRx = 1;
 
-      
-    // send command
-    len = send_port(ptrPort, lenTx, Tx);
-    if (len != lenTx) {
-      setConsoleColor(PRM_COLOR_RED);
-      fprintf(stderr, "\n\nerror in 'bsl_memWrite()': sending data failed, exit!\n\n");
-      Exit(1, g_pauseOnExit);
-    }
-    
-    // receive response with timeout
-    len = receive_port(ptrPort, lenRx, Rx);
-    if (len != lenRx) {
-      setConsoleColor(PRM_COLOR_RED);
-      fprintf(stderr, "\n\nerror in 'bsl_memWrite()': ACK3 timeout, exit!\n\n");
-      Exit(1, g_pauseOnExit);
-    }
-    
-    // check acknowledge
-    if (Rx[0]!=ACK) {
-      setConsoleColor(PRM_COLOR_RED);
-      fprintf(stderr, "\n\nerror in 'bsl_memWrite()': ACK3 failure, exit!\n\n");
-      Exit(1, g_pauseOnExit);
-    }
+    // send WRITE command, address and data. Next command may be sent speculatively, if another block with data follows
+    for (next=idx; (next<numBytes) && (!buf[next]); next++);
+    while (bsl_writeFrame(ptrPort, addrTmp, lenTx, Tx, (next >= numBytes)));
     
     // print progress
     if (((idx2 % 1024) == 0) && (verbose)){
@@ -1106,6 +1413,72 @@ uint8_t bsl_memWrite(HANDLE ptrPort, uint32_t addrStart, uint32_t numBytes, char
 
 
 
+/**
+  \fn uint8_t bsl_imageWrite(HANDLE ptrPort, const image_t *image, uint8_t verbose)
+   
+  \brief upload prepared image to microcontroller flash or RAM
+   
+  \param[in] ptrPort    handle to communication port
+  \param[in] image      prepared image (see image_load())
+  \param[in] verbose    print output to console?
+  
+  \return communication status (0=ok, 1=fail)
+  
+  upload memory image via WRITE command using the frames pre-built by image_load().
+  Equivalent to bsl_memWrite(), but without framing cost during upload
+*/
+uint8_t bsl_imageWrite(HANDLE ptrPort, const image_t *image, uint8_t verbose) {
+
+  uint32_t  i, numBytes = 0;
+
+
+  // print message
+  if (verbose) {
+    printf("  write 0B starting from 0x%04x ", (int) image->addrStart);
+    fflush(stdout);
+  }
+  
+  // check if port is open
+  if (!ptrPort) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'bsl_imageWrite()': port not open, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+
+  // loop over pre-built frames
+  for (i=0; i<image->numFrames; i++) {
+
+    // send WRITE command, address and data. Retry in lock-step after desync
+    while (bsl_writeFrame(ptrPort, image->frames[i].addr, image->frames[i].lenTx, (char*) image->frames[i].Tx, (i+1 == image->numFrames)));
+    numBytes += image->frames[i].lenTx - 2;
+
+    // print progress
+    if (((numBytes % 1024) == 0) && (verbose)) {
+      if (numBytes > 1024)
+        printf("%c  write %1.1fkB starting from 0x%04x ", '\r', (float) numBytes/1024.0, (int) image->addrStart);
+      else
+        printf("%c  write %dB starting from 0x%04x ", '\r', numBytes, (int) image->addrStart);
+      fflush(stdout);
+    }
+
+  } // loop over frames
+
+  // print message
+  if (verbose) {
+    if (numBytes > 1024)
+      printf("%c  write %1.1fkB starting from 0x%04x ... ok   \n", '\r', (float) numBytes/1024.0, (int) image->addrStart);
+    else
+      printf("%c  write %dB starting from 0x%04x ... ok   \n", '\r', numBytes, (int) image->addrStart);
+    fflush(stdout);
+  }
+
+  // avoid compiler warnings
+  return(0);
+
+} // bsl_imageWrite
+
+
+
 /**
   \fn uint8_t bsl_jumpTo(HANDLE ptrPort, uint32_t addr)
    
@@ -1140,6 +1513,8 @@ uint8_t bsl_jumpTo(HANDLE ptrPort, uint32_t addr) {
     fprintf(stderr, "\n\nerror in 'bsl_jumpTo()': port not open, exit!\n\n");
     Exit(1, g_pauseOnExit);
   }
+
+  trace_begin(TRACE_TID(ptrPort), "command", "GO");
   
 
   /////
@@ -1217,10 +1592,112 @@ uint8_t bsl_jumpTo(HANDLE ptrPort, uint32_t addr) {
   printf("ok\n");
   fflush(stdout);
   
+  trace_end(TRACE_TID(ptrPort), "command", "GO");
+
   // avoid compiler warnings
   return(0);
   
 } // bsl_jumpTo
 
 
+/**
+  \fn void bsl_setPipeline(uint8_t enable)
+   
+  \brief enable speculative pipelining of WRITE and READ commands
+   
+  \param[in] enable     1=send next command before ACK of previous data phase, 0=strict lock-step
+  
+  saves one turnaround per frame, i.e. at least one USB frame. Only for BSL
+  versions which tolerate bytes received during programming or sending (see
+  pipeline.h) and duplex mode. On a desync the BSL is resynchronized and the
+  frame is retried in lock-step. Also resets the counters of bsl_pipelineStats()
+*/
+void bsl_setPipeline(uint8_t enable) {
+
+  s_pipeline       = enable;
+  s_cmdPending     = 0;
+  s_numSpeculative = 0;
+  s_numDesync      = 0;
+  
+} // bsl_setPipeline
+
+
+
+/**
+  \fn void bsl_pipelineStats(uint32_t *numSpeculative, uint32_t *numDesync)
+   
+  \brief get number of speculatively sent commands and desyncs since bsl_setPipeline()
+   
+  \param[out] numSpeculative   number of commands sent before ACK of previous data phase
+  \param[out] numDesync        number of desyncs, i.e. fallbacks to lock-step
+*/
+void bsl_pipelineStats(uint32_t *numSpeculative, uint32_t *numDesync) {
+
+  *numSpeculative = s_numSpeculative;
+  *numDesync      = s_numDesync;
+  
+} // bsl_pipelineStats
+
+
+
+/**
+  \fn const hist_t *bsl_ackRtt(void)
+   
+  \brief get send-to-ACK round-trip histograms
+   
+  \return array of ACK_NUM_STAGES histograms [us]
+  
+  round-trip times from start of sending until reception of the ACK, recorded
+  for command and address of READ, and command, address and data of WRITE.
+  Mass erase is excluded, as its ACK includes the erase time
+*/
+const hist_t *bsl_ackRtt(void) {
+
+  return(s_ackRtt);
+  
+} // bsl_ackRtt
+
+
+
+/**
+  \fn void bsl_resetAckRtt(void)
+   
+  \brief clear send-to-ACK round-trip histograms, e.g. per board
+*/
+void bsl_resetAckRtt(void) {
+
+  int   i;
+
+  for (i=0; i<ACK_NUM_STAGES; i++)
+    hist_reset(&(s_ackRtt[i]));
+  
+} // bsl_resetAckRtt
+
+
+
+/**
+  \fn void bsl_printAckRtt(const hist_t *hist)
+   
+  \brief print p50, p99 and max of send-to-ACK round-trip histograms
+   
+  \param[in] hist    array of ACK_NUM_STAGES histograms [us]
+*/
+void bsl_printAckRtt(const hist_t *hist) {
+
+  const char  *name[ACK_NUM_STAGES] = { "command", "address", "data" };
+  int         i;
+
+  // nothing recorded, e.g. only memory read
+  if (hist[ACK_STAGE_CMD].num == 0)
+    return;
+
+  printf("  ACK round-trip [us]:    %8s %8s %8s %8s\n", "num", "p50", "p99", "max");
+  for (i=0; i<ACK_NUM_STAGES; i++)
+    printf("    %-21s %8d %8d %8d %8d\n", name[i], (int) hist[i].num, (int) hist_percentile(&(hist[i]), 50.0),
+      (int) hist_percentile(&(hist[i]), 99.0), (int) hist[i].max);
+  fflush(stdout);
+  
+} // bsl_printAckRtt
+
+
 // end of file
@@ -21,6 +21,8 @@
 #include <string.h>
 #include <stdint.h>
 #include "serial_comm.h"
+#include "image.h"
+#include "hist.h"
 
 
 // STM8 family
@@ -43,6 +45,12 @@
 #define PFLASH_START      0x8000    // starting address of flash (same for all STM8 devices)
 #define PFLASH_BLOCKSIZE  1024      // size of flash block for erase or block write (same for all STM8 devices)
 
+// ACK stages of a BSL command (for round-trip statistics)
+#define ACK_STAGE_CMD     0         // ACK1 after command
+#define ACK_STAGE_ADDR    1         // ACK2 after address
+#define ACK_STAGE_DATA    2         // ACK3 after WRITE data
+#define ACK_NUM_STAGES    3
+
 
 
 /// synchronize to microcontroller BSL
@@ -66,9 +74,27 @@ uint8_t bsl_flashMassErase(HANDLE ptrPort);
 /// upload to microcontroller flash or RAM
 uint8_t bsl_memWrite(HANDLE ptrPort, uint32_t addrStart, uint32_t numBytes, char *buf, uint8_t verbose);
 
+/// upload prepared image to microcontroller flash or RAM
+uint8_t bsl_imageWrite(HANDLE ptrPort, const image_t *image, uint8_t verbose);
+
 /// jump to flash or RAM
 uint8_t bsl_jumpTo(HANDLE ptrPort, uint32_t addr);
 
+/// enable speculative pipelining of WRITE and READ commands (see pipeline.h)
+void bsl_setPipeline(uint8_t enable);
+
+/// get number of speculatively sent commands and desyncs since bsl_setPipeline()
+void bsl_pipelineStats(uint32_t *numSpeculative, uint32_t *numDesync);
+
+/// get send-to-ACK round-trip histograms [us] of above routines (ACK_NUM_STAGES entries)
+const hist_t *bsl_ackRtt(void);
+
+/// clear send-to-ACK round-trip histograms, e.g. per board
+void bsl_resetAckRtt(void);
+
+/// print p50, p99 and max of send-to-ACK round-trip histograms
+void bsl_printAckRtt(const hist_t *hist);
+
 #endif // _BOOTLOADER_H_
 
 // end of file
@@ -0,0 +1,1085 @@
+/**
+  \file bsl_sm.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief implementation of non-blocking BSL session state machine
+
+  implementation of the flash sequence of bootloader.c as a chain of explicit
+  continuations. A step sends a request and registers the function which checks
+  the response. Phase functions (st_*) start a phase, command functions (sm_*)
+  perform one BSL command and call sm->then when done, and response functions
+  (c_*) process the result of a single exchange.
+  Errors don't terminate the application, but only abort the affected session.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include "bsl_sm.h"
+#include "bootloader.h"
+#include "routines.h"
+#include "rto.h"
+#include "trace.h"
+#include "misc.h"
+#include "globals.h"
+
+// OS specific: Posix
+#if defined(__APPLE__) || defined(__unix__)
+  #include <unistd.h>
+  #include <fcntl.h>
+  #include <errno.h>
+  #include <poll.h>
+#endif
+
+
+// device processing time [us] of exchanges without flash program/erase. Timeouts see rto.h
+#define SM_DEVICE_NONE      0
+
+// addresses for memory probing (see bsl_getInfo())
+static const uint32_t s_probeFamily[] = { 0x004000, 0x000100 };
+static const uint8_t  s_family[]      = { STM8S, STM8L };
+static const uint32_t s_probeSize[]   = { 0x047FFF, 0x027FFF, 0x00FFFF, 0x009FFF };
+static const int      s_flashsize[]   = { 256, 128, 32, 8 };
+
+// WRITE frame for enabling the ROM bootloader (0x55 0xAA at 0x487E)
+static const uint8_t  s_frameBSL[]    = { 2-1, 0x55, 0xAA, (2-1) ^ 0x55 ^ 0xAA };
+
+// names of phases for output
+static const char     *s_phaseName[]  = { "idle", "sync", "identify", "RAM routines", "erase", "write", "verify", "activate", "jump", "done" };
+
+
+// forward declarations
+static void sm_next(bsl_sm_t *sm, uint8_t status);
+static uint8_t sm_recover(bsl_sm_t *sm, uint8_t event);
+static uint8_t sm_linkOk(bsl_sm_t *sm);
+
+
+
+/**
+  \fn const char *bsl_sm_phaseName(uint8_t phase)
+
+  \brief get name of phase
+
+  \param[in] phase    session phase (SM_PHASE_*)
+
+  \return name of phase for output
+*/
+const char *bsl_sm_phaseName(uint8_t phase) {
+
+  if (phase > SM_PHASE_DONE)
+    return("unknown");
+  return(s_phaseName[phase]);
+
+} // bsl_sm_phaseName
+
+
+
+/**
+  \fn void bsl_sm_init(bsl_sm_t *sm, HANDLE fd, const char *name, const bsl_sm_cfg_t *cfg)
+
+  \brief init session
+
+  \param[out] sm      session to init
+  \param[in]  fd      handle of opened port
+  \param[in]  name    name of port or session (for output)
+  \param[in]  cfg     settings (must stay valid until session is finished)
+
+  init session state. The port handle is switched to non-blocking mode
+*/
+void bsl_sm_init(bsl_sm_t *sm, HANDLE fd, const char *name, const bsl_sm_cfg_t *cfg) {
+
+  memset(sm, 0, sizeof(bsl_sm_t));
+  sm->fd  = fd;
+  sm->cfg = cfg;
+  strncpy(sm->name, name, sizeof(sm->name)-1);
+  trace_threadName(TRACE_TID(fd), name);
+  sm->phase  = SM_PHASE_IDLE;
+  sm->status = SM_STATUS_RUNNING;
+  sm->serialNo = -1;
+  sm->queueLatency = -1;
+  linkmon_init(&(sm->link), cfg->baudrate);
+  rto_init(&(sm->rto));
+
+#if defined(__APPLE__) || defined(__unix__)
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+} // bsl_sm_init
+
+
+
+#if defined(__APPLE__) || defined(__unix__)
+
+/////////////////
+// exchange of data with port
+/////////////////
+
+/**
+  \fn static void sm_fail(bsl_sm_t *sm, const char *format, ...)
+
+  \brief abort session with error message
+*/
+static void sm_fail(bsl_sm_t *sm, const char *format, ...) {
+
+  va_list   vargs;
+
+  va_start(vargs, format);
+  vsnprintf(sm->error, sizeof(sm->error), format, vargs);
+  va_end(vargs);
+  sm->status   = SM_STATUS_FAILED;
+  sm->cont     = NULL;
+  sm->deadline = 0;
+  sm->lenTx    = sm->numTx = 0;
+  sm->timeEnd  = time_us();
+  progress_end(sm->progress, SM_STATUS_FAILED);
+
+  // close open spans of trace
+  if (sm->cmd)
+    trace_complete(TRACE_TID(sm->fd), "command", sm->cmd, sm->timeCmd, sm->timeEnd, -1);
+  trace_complete(TRACE_TID(sm->fd), "phase", bsl_sm_phaseName(sm->phase), sm->phaseStart[sm->phase], sm->timeEnd, -1);
+
+} // sm_fail
+
+
+
+/**
+  \fn static void sm_complete(bsl_sm_t *sm, uint8_t status)
+
+  \brief finish current exchange and call continuation
+*/
+static void sm_complete(bsl_sm_t *sm, uint8_t status) {
+
+  bsl_sm_cont_t   cont = sm->cont;
+  uint64_t        now  = time_us();
+
+  // trace wait, or response wait after all data was sent
+  if (sm->lenTx == 0)
+    trace_complete(TRACE_TID(sm->fd), "io", "sleep", sm->timeTx, now, -1);
+  else {
+    trace_complete(TRACE_TID(sm->fd), "io", (sm->lenRx == 1) ? "ACK wait" : "receive", sm->timeRx, now, sm->numRx);
+    trace_counter(TRACE_TID(sm->fd), "bytes in flight", 0);
+  }
+
+  sm->cont     = NULL;
+  sm->deadline = 0;
+  if (cont)
+    cont(sm, status);
+
+} // sm_complete
+
+
+
+/**
+  \fn static void sm_write(bsl_sm_t *sm)
+
+  \brief send pending data as far as possible without blocking
+*/
+static void sm_write(bsl_sm_t *sm) {
+
+  ssize_t   len;
+
+  while (sm->numTx < sm->lenTx) {
+    len = write(sm->fd, sm->ptrTx + sm->numTx, sm->lenTx - sm->numTx);
+    sm->io.numWrite++;
+    if (len < 0) {
+      if (errno == EAGAIN)
+        sm->io.numAgain++;
+      if ((errno == EAGAIN) || (errno == EINTR))
+        return;
+      sm_fail(sm, "sending failed (%s)", strerror(errno));
+      return;
+    }
+    sm->numTx      += len;
+    sm->io.bytesTx += len;
+    trace_counter(TRACE_TID(sm->fd), "bytes in flight", sm->numTx);
+    if (sm->numTx == sm->lenTx) {
+      sm->timeRx = time_us();
+      trace_complete(TRACE_TID(sm->fd), "io", "send", sm->timeTx, sm->timeRx, sm->lenTx);
+    }
+
+    // for 1-wire interface, own data is received as echo
+    if (sm->cfg->UARTmode == 1)
+      sm->numEcho += len;
+  }
+
+} // sm_write
+
+
+
+/**
+  \fn static void sm_reply(bsl_sm_t *sm)
+
+  \brief send pending reply mode echo as far as possible without blocking
+*/
+static void sm_reply(bsl_sm_t *sm) {
+
+  ssize_t   len;
+
+  while (sm->lenReply > 0) {
+    len = write(sm->fd, sm->reply, sm->lenReply);
+    sm->io.numWrite++;
+    if (len < 0) {
+      if (errno == EAGAIN)
+        sm->io.numAgain++;
+      if ((errno == EAGAIN) || (errno == EINTR))
+        return;
+      sm_fail(sm, "sending echo failed (%s)", strerror(errno));
+      return;
+    }
+    sm->io.bytesTx   += len;
+    sm->io.bytesEcho += len;
+    sm->lenReply     -= len;
+    memmove(sm->reply, sm->reply + len, sm->lenReply);
+  }
+
+} // sm_reply
+
+
+
+/**
+  \fn static void sm_check(bsl_sm_t *sm)
+
+  \brief complete exchange if all data was sent and received
+*/
+static void sm_check(bsl_sm_t *sm) {
+
+  if ((sm->status == SM_STATUS_RUNNING) && (sm->cont) && (sm->lenRx > 0) && (sm->numRx == sm->lenRx) &&
+    (sm->numEcho == 0) && (sm->lenReply == 0) && (sm->numTx == sm->lenTx))
+    sm_complete(sm, SM_OK);
+
+} // sm_check
+
+
+
+/**
+  \fn static void sm_read(bsl_sm_t *sm)
+
+  \brief receive available data and complete exchange if all bytes were received
+*/
+static void sm_read(bsl_sm_t *sm) {
+
+  uint8_t   buf[300];
+  ssize_t   len, i;
+  uint32_t  want;
+
+  // read echo and response only, don't consume data of next response
+  want = sm->numEcho + (sm->lenRx - sm->numRx);
+  if ((want == 0) || (want > sizeof(buf)))
+    want = sizeof(buf);
+  len = read(sm->fd, buf, want);
+  sm->io.numRead++;
+  if (len < 0) {
+    if (errno == EAGAIN)
+      sm->io.numAgain++;
+    if ((errno == EAGAIN) || (errno == EINTR))
+      return;
+    sm_fail(sm, "receiving failed (%s)", strerror(errno));
+    return;
+  }
+  if (len == 0) {
+    sm_fail(sm, "port closed");
+    return;
+  }
+  sm->io.bytesRx += len;
+
+  // process received bytes
+  for (i=0; i<len; i++) {
+
+    // ignore 1-wire echo
+    if (sm->numEcho > 0) {
+      sm->numEcho--;
+      sm->io.bytesEcho++;
+      continue;
+    }
+
+    // for UART reply mode echo each received byte, or collect for block echo.
+    // Echo not accepted by the port is sent on POLLOUT (see bsl_sm_io())
+    if ((sm->cfg->UARTmode == 2) && (sm->lenReply < sizeof(sm->reply))) {
+      sm->reply[sm->lenReply++] = buf[i];
+      if (!sm->cfg->echoBlock)
+        sm_reply(sm);
+    }
+
+    // store response. Ignore unexpected data
+    if (sm->numRx < sm->lenRx)
+      sm->Rx[sm->numRx++] = buf[i];
+  }
+
+  // reply mode with block echo: single write for all received bytes
+  if (sm->lenReply > 0)
+    sm_reply(sm);
+
+  // exchange completed
+  sm_check(sm);
+
+} // sm_read
+
+
+
+/**
+  \fn static void sm_start(bsl_sm_t *sm, const uint8_t *Tx, uint16_t lenTx, uint16_t lenRx, uint32_t timeout, bsl_sm_cont_t cont)
+
+  \brief start exchange with given timeout [us] (see sm_exchange())
+*/
+static void sm_start(bsl_sm_t *sm, const uint8_t *Tx, uint16_t lenTx, uint16_t lenRx, uint32_t timeout, bsl_sm_cont_t cont) {
+
+  sm->ptrTx    = Tx;
+  sm->lenTx    = lenTx;
+  sm->numTx    = 0;
+  sm->lenRx    = lenRx;
+  sm->numRx    = 0;
+  sm->lenReply = 0;
+  sm->cont     = cont;
+  sm->timeTx   = time_us();
+  sm->deadline = sm->timeTx + timeout;
+
+  // send immediately to save a poll cycle
+  sm_write(sm);
+
+} // sm_start
+
+
+
+/**
+  \fn static void sm_exchange(bsl_sm_t *sm, const uint8_t *Tx, uint16_t lenTx, uint16_t lenRx, uint32_t device, bsl_sm_cont_t cont)
+
+  \brief start exchange: send data, then wait for response
+
+  \param[in] sm       session
+  \param[in] Tx       data to send (must stay valid until sent)
+  \param[in] lenTx    number of bytes to send
+  \param[in] lenRx    number of bytes to receive
+  \param[in] device   max. processing time of device [us], e.g. for flash programming
+  \param[in] cont     continuation, called with SM_OK or SM_TIMEOUT
+
+  the timeout is derived from the line time at the current baudrate, the
+  device time and the measured response latency (see rto.h)
+*/
+static void sm_exchange(bsl_sm_t *sm, const uint8_t *Tx, uint16_t lenTx, uint16_t lenRx, uint32_t device, bsl_sm_cont_t cont) {
+
+  sm->transfer = rto_transfer(sm->link.baud, sm->cfg->UARTmode, lenTx, lenRx);
+  sm->device   = device;
+
+  // reply mode with bytewise echo: BSL waits for the echo of each byte
+  if ((sm->cfg->UARTmode == 2) && (!sm->cfg->echoBlock) && (lenRx > 1))
+    device += (uint32_t) (lenRx-1) * sm->rto.srtt;
+
+  sm_start(sm, Tx, lenTx, lenRx, rto_timeout(&(sm->rto), sm->transfer, device), cont);
+
+} // sm_exchange
+
+
+
+/**
+  \fn static void sm_wait(bsl_sm_t *sm, uint32_t ms, bsl_sm_cont_t cont)
+
+  \brief wait without blocking other sessions. Received data is discarded
+*/
+static void sm_wait(bsl_sm_t *sm, uint32_t ms, bsl_sm_cont_t cont) {
+
+  sm_start(sm, NULL, 0, 0, ms * 1000, cont);
+
+} // sm_wait
+
+
+
+/**
+  \fn static void sm_setAddr(bsl_sm_t *sm, uint32_t addr)
+
+  \brief store address + checksum (XOR over address) in Tx
+*/
+static void sm_setAddr(bsl_sm_t *sm, uint32_t addr) {
+
+  sm->Tx[0] = (uint8_t) (addr >> 24);
+  sm->Tx[1] = (uint8_t) (addr >> 16);
+  sm->Tx[2] = (uint8_t) (addr >> 8);
+  sm->Tx[3] = (uint8_t) (addr);
+  sm->Tx[4] = (sm->Tx[0] ^ sm->Tx[1] ^ sm->Tx[2] ^ sm->Tx[3]);
+
+} // sm_setAddr
+
+
+
+/**
+  \fn static void sm_cmdStart(bsl_sm_t *sm, uint8_t cmd)
+
+  \brief start span of BSL command in trace
+*/
+static void sm_cmdStart(bsl_sm_t *sm, uint8_t cmd) {
+
+  switch (cmd) {
+    case GET:   sm->cmd = "GET";   break;
+    case READ:  sm->cmd = "READ";  break;
+    case WRITE: sm->cmd = "WRITE"; break;
+    case ERASE: sm->cmd = "ERASE"; break;
+    case GO:    sm->cmd = "GO";    break;
+    default:    sm->cmd = "unknown";
+  }
+  sm->timeCmd = time_us();
+
+} // sm_cmdStart
+
+
+
+/**
+  \fn static void sm_cmdEnd(bsl_sm_t *sm)
+
+  \brief end span of BSL command in trace (after last ACK)
+*/
+static void sm_cmdEnd(bsl_sm_t *sm) {
+
+  trace_complete(TRACE_TID(sm->fd), "command", sm->cmd, sm->timeCmd, time_us(), -1);
+  sm->cmd = NULL;
+
+} // sm_cmdEnd
+
+
+
+/**
+  \fn static void sm_command(bsl_sm_t *sm, uint8_t cmd, uint32_t device, bsl_sm_cont_t cont)
+
+  \brief send BSL command + complement and wait for ACK
+*/
+static void sm_command(bsl_sm_t *sm, uint8_t cmd, uint32_t device, bsl_sm_cont_t cont) {
+
+  sm_cmdStart(sm, cmd);
+  sm->Tx[0] = cmd;
+  sm->Tx[1] = (cmd ^ 0xFF);
+  sm_exchange(sm, sm->Tx, 2, 1, device, cont);
+
+} // sm_command
+
+
+
+/**
+  \fn static uint8_t sm_checkAck(bsl_sm_t *sm, uint8_t status, const char *step)
+
+  \brief check for ACK response. On timeout or NACK renegotiate link or abort session
+
+  \return 1 if ACK was received, else 0
+
+  for single byte responses the round-trip time is recorded for the ACK stage
+  given by step ("ACK1".."ACK3"). As in bootloader.c mass erase is excluded.
+  ACKs without device processing also update the latency for timeouts
+*/
+static uint8_t sm_checkAck(bsl_sm_t *sm, uint8_t status, const char *step) {
+
+  uint8_t   event;
+
+  if (status != SM_OK)
+    event = LINK_EVENT_TIMEOUT;
+  else if (sm->Rx[0] == ACK)
+    event = LINK_EVENT_OK;
+  else
+    event = (sm->Rx[0] == NACK) ? LINK_EVENT_NACK : LINK_EVENT_CORRUPT;
+  if (event != LINK_EVENT_OK) {
+    if (sm_recover(sm, event))
+      return(0);
+    if (status != SM_OK)
+      sm_fail(sm, "%s timeout", step);
+    else
+      sm_fail(sm, "%s failure 0x%02x", step, sm->Rx[0]);
+    return(0);
+  }
+  if ((sm->lenRx == 1) && (sm->phase != SM_PHASE_ERASE))
+    hist_add(&(sm->ackRtt[step[3]-'1']), time_us() - sm->timeTx);
+  if ((sm->lenRx == 1) && (sm->device == SM_DEVICE_NONE))
+    rto_sample(&(sm->rto), (uint32_t) (time_us() - sm->timeTx), sm->transfer);
+  return(1);
+
+} // sm_checkAck
+
+
+
+/////////////////
+// BSL commands. Call sm->then when done
+/////////////////
+
+// memory check (see bsl_memCheck()). Calls sm->then with status 1 if address exists, else 0
+static void c_check_data(bsl_sm_t *sm, uint8_t status) {
+  if (!sm_checkAck(sm, status, "ACK3"))
+    return;
+  sm_cmdEnd(sm);
+  sm->then(sm, 1);
+}
+static void c_check_addr(bsl_sm_t *sm, uint8_t status) {
+  if (status != SM_OK) {
+    sm_fail(sm, "ACK2 timeout");
+    return;
+  }
+  if (sm->Rx[0] != ACK) {                     // NACK -> address doesn't exist
+    sm_cmdEnd(sm);
+    sm->then(sm, 0);
+    return;
+  }
+  sm->Tx[0] = 1-1;                            // -1 from BSL
+  sm->Tx[1] = (sm->Tx[0] ^ 0xFF);
+  sm_exchange(sm, sm->Tx, 2, 2, SM_DEVICE_NONE, c_check_data);
+}
+static void c_check_cmd(bsl_sm_t *sm, uint8_t status) {
+  if (!sm_checkAck(sm, status, "ACK1"))
+    return;
+  sm_setAddr(sm, sm->addr);
+  sm_exchange(sm, sm->Tx, 5, 1, SM_DEVICE_NONE, c_check_addr);
+}
+static void sm_memCheck(bsl_sm_t *sm, uint32_t addr, bsl_sm_cont_t then) {
+  sm->addr = addr;
+  sm->then = then;
+  sm_command(sm, READ, SM_DEVICE_NONE, c_check_cmd);
+}
+
+
+// write single frame (see bsl_writeFrame()). Frame must stay valid until done
+static void c_wr_data(bsl_sm_t *sm, uint8_t status) {
+  if (!sm_checkAck(sm, status, "ACK3"))
+    return;
+  sm->numFrames++;
+  sm_cmdEnd(sm);
+  if ((sm->phase == SM_PHASE_WRITE) && (!sm->relink))
+  {
+    sm->bytesPayload += sm->lenFrame-2;           // frame is N-1, data, checksum
+    progress_add(sm->progress, sm->lenFrame-2);
+  }
+  if (sm_linkOk(sm))
+    return;
+  sm->then(sm, SM_OK);
+}
+static void c_wr_addr(bsl_sm_t *sm, uint8_t status) {
+  if (sm_checkAck(sm, status, "ACK2"))
+    sm_exchange(sm, sm->frame, sm->lenFrame, 1, rto_program(sm->addr, sm->lenFrame-2), c_wr_data);
+}
+static void c_wr_cmd(bsl_sm_t *sm, uint8_t status) {
+  if (!sm_checkAck(sm, status, "ACK1"))
+    return;
+  sm_setAddr(sm, sm->addr);
+  sm_exchange(sm, sm->Tx, 5, 1, SM_DEVICE_NONE, c_wr_addr);
+}
+static void sm_writeFrame(bsl_sm_t *sm, uint32_t addr, const uint8_t *frame, uint16_t lenFrame, bsl_sm_cont_t then) {
+  sm->addr     = addr;
+  sm->frame    = frame;
+  sm->lenFrame = lenFrame;
+  sm->then     = then;
+  sm_command(sm, WRITE, SM_DEVICE_NONE, c_wr_cmd);
+}
+
+
+// write all frames of prepared image (see bsl_imageWrite()). Calls sm->imgDone when done
+static void c_img_frame(bsl_sm_t *sm, uint8_t status) {
+  const image_frame_t *frame;
+  if (sm->idx >= sm->wrImage->numFrames) {
+    sm->imgDone(sm, SM_OK);
+    return;
+  }
+  frame = sm->wrImage->frames + (sm->idx++);
+  sm_writeFrame(sm, frame->addr, (const uint8_t*) frame->Tx, frame->lenTx, c_img_frame);
+}
+static void sm_imageWrite(bsl_sm_t *sm, const image_t *image, bsl_sm_cont_t done) {
+  sm->wrImage = image;
+  sm->imgDone = done;
+  sm->idx     = 0;
+  c_img_frame(sm, SM_OK);
+}
+
+
+// mass erase (see bsl_flashMassErase())
+static void c_erase_data(bsl_sm_t *sm, uint8_t status) {
+  if (!sm_checkAck(sm, status, "ACK2"))
+    return;
+  sm_cmdEnd(sm);
+  sm_linkOk(sm);
+  sm_next(sm, SM_OK);
+}
+static void c_erase_cmd(bsl_sm_t *sm, uint8_t status) {
+  if (!sm_checkAck(sm, status, "ACK1"))
+    return;
+  sm->Tx[0] = 0xFF;                           // mass erase
+  sm->Tx[1] = (sm->Tx[0] ^ 0xFF);
+  sm_exchange(sm, sm->Tx, 2, 1, rto_erase(sm->flashsize + RTO_EEPROM_KB), c_erase_data);
+}
+
+
+// verify image by reading back in chunks of max. 256B (see bsl_memRead()). sm->idx is the offset in image,
+// gaps between the address ranges of a merged image are skipped
+static void c_verify_chunk(bsl_sm_t *sm, uint8_t status);
+static void c_verify_data(bsl_sm_t *sm, uint8_t status) {
+  const image_t *image = sm->cfg->image;
+  uint32_t      i;
+  if (!sm_checkAck(sm, status, "ACK3"))
+    return;
+  sm_cmdEnd(sm);
+  for (i=1; i<sm->lenRx; i++, sm->idx++) {
+    if ((uint8_t) image->data[sm->idx] != sm->Rx[i]) {
+      sm_fail(sm, "verify failed at address 0x%04x (0x%02x vs 0x%02x)", (int) (image->addrStart + sm->idx),
+        (uint8_t) image->data[sm->idx], sm->Rx[i]);
+      return;
+    }
+  }
+  sm->bytesPayload += sm->lenRx-1;
+  progress_add(sm->progress, sm->lenRx-1);
+  if (sm_linkOk(sm))
+    return;
+  c_verify_chunk(sm, SM_OK);
+}
+static void c_verify_addr(bsl_sm_t *sm, uint8_t status) {
+  uint32_t  len = image_range(sm->cfg->image, &(sm->idx));
+  uint32_t  size = ((sm->cfg->readSize > 0) && (sm->cfg->readSize < 256)) ? sm->cfg->readSize : 256;
+  if (!sm_checkAck(sm, status, "ACK2"))
+    return;
+  if (len > size)
+    len = size;
+  sm->Tx[0] = len-1;                          // -1 from BSL
+  sm->Tx[1] = (sm->Tx[0] ^ 0xFF);
+  sm_exchange(sm, sm->Tx, 2, len+1, SM_DEVICE_NONE, c_verify_data);
+}
+static void c_verify_cmd(bsl_sm_t *sm, uint8_t status) {
+  if (!sm_checkAck(sm, status, "ACK1"))
+    return;
+  sm_setAddr(sm, sm->cfg->image->addrStart + sm->idx);
+  sm_exchange(sm, sm->Tx, 5, 1, SM_DEVICE_NONE, c_verify_addr);
+}
+static void c_verify_chunk(bsl_sm_t *sm, uint8_t status) {
+  if (image_range(sm->cfg->image, &(sm->idx)) == 0)
+    sm_next(sm, SM_OK);
+  else
+    sm_command(sm, READ, SM_DEVICE_NONE, c_verify_cmd);
+}
+
+
+// jump to flash (see bsl_jumpTo())
+static void c_jump_addr(bsl_sm_t *sm, uint8_t status) {
+  if (!sm_checkAck(sm, status, "ACK2"))
+    return;
+  sm_cmdEnd(sm);
+  sm_next(sm, SM_OK);
+}
+static void c_jump_cmd(bsl_sm_t *sm, uint8_t status) {
+  if (!sm_checkAck(sm, status, "ACK1"))
+    return;
+  sm_setAddr(sm, PFLASH_START);
+  sm_exchange(sm, sm->Tx, 5, 1, SM_DEVICE_NONE, c_jump_addr);
+}
+
+
+
+/////////////////
+// synchronization and identification
+/////////////////
+
+// SYNC with up to 15 retries (see bsl_sync())
+static void st_sync(bsl_sm_t *sm, uint8_t status);
+static void st_identify(bsl_sm_t *sm, uint8_t status);
+static void c_relink_synced(bsl_sm_t *sm, uint8_t status);
+static void c_sync(bsl_sm_t *sm, uint8_t status) {
+  if ((status == SM_OK) && ((sm->Rx[0] == ACK) || (sm->Rx[0] == NACK))) {
+    sm_wait(sm, 50, sm->relink ? c_relink_synced : st_identify);    // see bsl_getInfo()
+    return;
+  }
+  if (++(sm->retry) < 15) {
+    progress_retry(sm->progress);
+    sm_wait(sm, 10, st_sync);
+    return;
+  }
+  if (status == SM_OK)
+    sm_fail(sm, "wrong response 0x%02x from BSL", sm->Rx[0]);
+  else if (sm->relink)
+    sm_fail(sm, "no response from BSL after reset at %d Baud", (int) sm->link.baud);
+  else
+    sm_fail(sm, "no response from BSL");
+}
+static void st_sync(bsl_sm_t *sm, uint8_t status) {
+  sm->Tx[0] = SYNCH;
+  sm_exchange(sm, sm->Tx, 1, 1, SM_DEVICE_NONE, c_sync);
+}
+
+
+// get BSL version (see bsl_getInfo())
+static void c_get(bsl_sm_t *sm, uint8_t status) {
+  if (status != SM_OK) {
+    sm_fail(sm, "ACK timeout");
+    return;
+  }
+  if ((sm->Rx[0] != ACK) || (sm->Rx[8] != ACK)) {
+    sm_fail(sm, "ACK failure");
+    return;
+  }
+  if ((sm->Rx[3] != GET) || (sm->Rx[4] != READ) || (sm->Rx[5] != GO) || (sm->Rx[6] != WRITE) || (sm->Rx[7] != ERASE)) {
+    sm_fail(sm, "wrong command codes");
+    return;
+  }
+  sm->versBSL = sm->Rx[2];
+  sm_cmdEnd(sm);
+  sm_next(sm, SM_OK);
+}
+
+
+// determine flash size (sm->idx is index of probe)
+static void c_size(bsl_sm_t *sm, uint8_t exists) {
+  if (exists) {
+    sm->flashsize = s_flashsize[sm->idx];
+    sm_cmdStart(sm, GET);
+    sm->Tx[0] = GET;
+    sm->Tx[1] = (GET ^ 0xFF);
+    sm_exchange(sm, sm->Tx, 2, 9, SM_DEVICE_NONE, c_get);
+  }
+  else if (++(sm->idx) < sizeof(s_probeSize)/sizeof(s_probeSize[0]))
+    sm_memCheck(sm, s_probeSize[sm->idx], c_size);
+  else
+    sm_fail(sm, "cannot identify device");
+}
+
+
+// determine family via EEPROM address (sm->idx is index of probe)
+static void c_family(bsl_sm_t *sm, uint8_t exists) {
+  if (exists) {
+    sm->family = s_family[sm->idx];
+    sm->idx = 0;
+    sm_memCheck(sm, s_probeSize[0], c_size);
+  }
+  else if (++(sm->idx) < sizeof(s_probeFamily)/sizeof(s_probeFamily[0]))
+    sm_memCheck(sm, s_probeFamily[sm->idx], c_family);
+  else
+    sm_fail(sm, "cannot identify family");
+}
+static void st_identify(bsl_sm_t *sm, uint8_t status) {
+  sm->phaseEnd[SM_PHASE_SYNC] = sm->phaseStart[SM_PHASE_IDENTIFY] = time_us();
+  trace_complete(TRACE_TID(sm->fd), "phase", "sync", sm->phaseStart[SM_PHASE_SYNC], sm->phaseEnd[SM_PHASE_SYNC], -1);
+  sm->phase = SM_PHASE_IDENTIFY;
+  sm->idx   = 0;
+  progress_phase(sm->progress, sm->phase);
+  sm_memCheck(sm, s_probeFamily[0], c_family);
+}
+
+
+
+/////////////////
+// link renegotiation: reset STM8 via DTR, change baudrate, SYNC and upload
+// RAM routines again, then repeat failed command (see linkmon.h)
+/////////////////
+
+// resume interrupted phase
+static void c_relink_resume(bsl_sm_t *sm, uint8_t status) {
+  sm->relink = 0;
+  trace_end(TRACE_TID(sm->fd), "link", "relink");
+  switch (sm->relinkPhase) {
+    case SM_PHASE_ERASE:
+      sm_command(sm, ERASE, SM_DEVICE_NONE, c_erase_cmd);
+      break;
+    case SM_PHASE_WRITE:
+      sm->wrImage = sm->cfg->image;
+      sm->imgDone = sm_next;
+      sm->idx     = sm->relinkIdx;
+      c_img_frame(sm, SM_OK);
+      break;
+    case SM_PHASE_VERIFY:
+      sm->idx = sm->relinkIdx;
+      c_verify_chunk(sm, SM_OK);
+      break;
+    default:                                  // RAM routines already uploaded
+      sm_next(sm, SM_OK);
+  }
+}
+static void c_relink_synced(bsl_sm_t *sm, uint8_t status) {
+  if (routines_required(sm->flashsize, sm->family))
+    sm_imageWrite(sm, routines_get(sm->flashsize, sm->versBSL), c_relink_resume);
+  else
+    c_relink_resume(sm, SM_OK);
+}
+static void c_relink_reset(bsl_sm_t *sm, uint8_t status) {
+  set_DTR(sm->fd, 0);
+  set_baudrate(sm->fd, sm->link.baud);
+  flush_port(sm->fd);
+  sm->retry = 0;
+  sm_wait(sm, 5, st_sync);                    // allow BSL to initialize
+}
+
+
+
+/**
+  \fn static void sm_relink(bsl_sm_t *sm, uint8_t action)
+
+  \brief start renegotiation of link
+
+  \param[in] sm       session
+  \param[in] action   proposed action of link monitor (LINK_RETRY, LINK_DOWN or LINK_UP)
+*/
+static void sm_relink(bsl_sm_t *sm, uint8_t action) {
+
+  // keep resume point of first renegotiation. WRITE repeats failed frame
+  if (!sm->relink) {
+    sm->relinkPhase = sm->phase;
+    sm->relinkIdx   = sm->idx;
+    if ((sm->phase == SM_PHASE_WRITE) && (action != LINK_UP) && (sm->idx > 0))
+      sm->relinkIdx--;
+    trace_begin(TRACE_TID(sm->fd), "link", "relink");
+  }
+  if (sm->cmd) {
+    trace_complete(TRACE_TID(sm->fd), "command", sm->cmd, sm->timeCmd, time_us(), -1);
+    sm->cmd = NULL;
+  }
+  linkmon_apply(&(sm->link), action);
+  sm->numRelink += (action != LINK_UP);
+  sm->relink     = 1;
+  sm->numEcho    = 0;
+  progress_retry(sm->progress);
+
+  // reset STM8 via DTR pulse
+  set_DTR(sm->fd, 1);
+  sm_wait(sm, 10, c_relink_reset);
+
+} // sm_relink
+
+
+
+/**
+  \fn static uint8_t sm_recover(bsl_sm_t *sm, uint8_t event)
+
+  \brief track failed command and renegotiate link, if possible
+
+  \param[in] sm       session
+  \param[in] event    type of error (LINK_EVENT_*)
+
+  \return 1 if renegotiation was started, 0 if session has to be aborted
+
+  renegotiation requires reset via DTR (see bsl_sm_cfg_t) and is limited to
+  the phases, which can be resumed
+*/
+static uint8_t sm_recover(bsl_sm_t *sm, uint8_t event) {
+
+  uint8_t   action = linkmon_event(&(sm->link), event);
+
+  if ((!sm->cfg->linkAdapt) || (sm->numRelink >= LINK_MAX_RELINK))
+    return(0);
+  if ((sm->phase != SM_PHASE_ROUTINES) && (sm->phase != SM_PHASE_ERASE) && (sm->phase != SM_PHASE_WRITE) && (sm->phase != SM_PHASE_VERIFY))
+    return(0);
+  sm_relink(sm, action);
+  return(1);
+
+} // sm_recover
+
+
+
+/**
+  \fn static uint8_t sm_linkOk(bsl_sm_t *sm)
+
+  \brief track successful command and step up baudrate after long error-free run
+
+  \return 1 if renegotiation was started, else 0 (continue with next command)
+*/
+static uint8_t sm_linkOk(bsl_sm_t *sm) {
+
+  if (linkmon_event(&(sm->link), LINK_EVENT_OK) != LINK_UP)
+    return(0);
+  if ((!sm->cfg->linkAdapt) || (sm->relink) || ((sm->phase != SM_PHASE_WRITE) && (sm->phase != SM_PHASE_VERIFY)))
+    return(0);
+  sm_relink(sm, LINK_UP);
+  return(1);
+
+} // sm_linkOk
+
+
+
+/**
+  \fn static void sm_next(bsl_sm_t *sm, uint8_t status)
+
+  \brief start next applicable phase
+
+  \param[in] sm       session
+  \param[in] status   not used (continuation signature)
+
+  advance to the next phase required by the settings and start it. After the
+  last phase the session is marked as successful. Skipped phases keep a start
+  time but no end time
+*/
+static void sm_next(bsl_sm_t *sm, uint8_t status) {
+
+  const bsl_sm_cfg_t  *cfg = sm->cfg;
+  const image_t       *routines;
+  uint64_t            now = time_us();
+
+  sm->phaseEnd[sm->phase] = now;
+  trace_complete(TRACE_TID(sm->fd), "phase", bsl_sm_phaseName(sm->phase), sm->phaseStart[sm->phase], now, -1);
+  while (1) {
+    sm->phase++;
+    sm->phaseStart[sm->phase] = now;
+    progress_phase(sm->progress, sm->phase);
+    switch (sm->phase) {
+
+      // for STM8S and 8kB STM8L upload RAM routines, else skip
+      case SM_PHASE_ROUTINES:
+        if (!routines_required(sm->flashsize, sm->family))
+          continue;
+        routines = routines_get(sm->flashsize, sm->versBSL);
+        if (!routines) {
+          sm_fail(sm, "unsupported device (%dkB, BSL v%x.%x)", sm->flashsize, (sm->versBSL >> 4) & 0x0F, sm->versBSL & 0x0F);
+          return;
+        }
+        sm_imageWrite(sm, routines, sm_next);
+        return;
+
+      // mass erase
+      case SM_PHASE_ERASE:
+        if (!cfg->flashErase)
+          continue;
+        sm_command(sm, ERASE, SM_DEVICE_NONE, c_erase_cmd);
+        return;
+
+      // upload image
+      case SM_PHASE_WRITE:
+        if (!cfg->image)
+          continue;
+        sm_imageWrite(sm, cfg->image, sm_next);
+        return;
+
+      // read back and compare
+      case SM_PHASE_VERIFY:
+        if ((!cfg->image) || (!cfg->verifyUpload))
+          continue;
+        sm->idx = 0;
+        c_verify_chunk(sm, SM_OK);
+        return;
+
+      // enable ROM bootloader (option bytes always on same address)
+      case SM_PHASE_ACTIVATE:
+        if ((!cfg->image) || (!cfg->enableBSL))
+          continue;
+        sm_writeFrame(sm, 0x487E, s_frameBSL, sizeof(s_frameBSL), sm_next);
+        return;
+
+      // jump to flash start address (reset vector always on same address)
+      case SM_PHASE_JUMP:
+        if (!cfg->jumpFlash)
+          continue;
+        sm_command(sm, GO, SM_DEVICE_NONE, c_jump_cmd);
+        return;
+
+      // all done
+      default:
+        sm->phase   = SM_PHASE_DONE;
+        sm->status  = SM_STATUS_OK;
+        sm->timeEnd = time_us();
+        progress_end(sm->progress, SM_STATUS_OK);
+        return;
+
+    } // switch (phase)
+  } // loop over phases
+
+} // sm_next
+
+
+
+/////////////////
+// interface to event loop
+/////////////////
+
+/**
+  \fn void bsl_sm_start(bsl_sm_t *sm)
+
+  \brief start session
+
+  \param[in] sm     session
+
+  start session by sending the first SYNC. The STM8 must already be in bootloader mode
+*/
+void bsl_sm_start(bsl_sm_t *sm) {
+
+  sm->timeStart = time_us();
+  sm->phase     = SM_PHASE_SYNC;
+  sm->phaseStart[SM_PHASE_SYNC] = sm->timeStart;
+  sm->status    = SM_STATUS_RUNNING;
+  sm->retry     = 0;
+  if (sm->cfg->linkAdapt)
+    set_baudrate(sm->fd, sm->link.baud);
+
+  // bytes to write and verify for dashboard
+  if (sm->cfg->image)
+    progress_begin(sm->progress, image_dataBytes(sm->cfg->image) * (sm->cfg->verifyUpload ? 2 : 1));
+  else
+    progress_begin(sm->progress, 0);
+  progress_phase(sm->progress, sm->phase);
+
+  st_sync(sm, SM_OK);
+
+} // bsl_sm_start
+
+
+
+/**
+  \fn short bsl_sm_events(const bsl_sm_t *sm)
+
+  \brief get poll() events the session waits for
+
+  \param[in] sm     session
+
+  \return POLLIN, plus POLLOUT if data or echo is pending to be sent
+*/
+short bsl_sm_events(const bsl_sm_t *sm) {
+
+  if ((sm->numTx < sm->lenTx) || (sm->lenReply > 0))
+    return(POLLIN | POLLOUT);
+  return(POLLIN);
+
+} // bsl_sm_events
+
+
+
+/**
+  \fn void bsl_sm_io(bsl_sm_t *sm, short revents)
+
+  \brief handle poll() events of session
+
+  \param[in] sm       session
+  \param[in] revents  events returned by poll()
+
+  send pending data, process received data and continue with the next step
+  when the response is complete
+*/
+void bsl_sm_io(bsl_sm_t *sm, short revents) {
+
+  if (sm->status != SM_STATUS_RUNNING)
+    return;
+
+  if (revents & POLLOUT) {
+    sm_reply(sm);
+    if (sm->status == SM_STATUS_RUNNING)
+      sm_write(sm);
+    sm_check(sm);
+  }
+  if ((sm->status == SM_STATUS_RUNNING) && (revents & POLLIN))
+    sm_read(sm);
+  else if ((sm->status == SM_STATUS_RUNNING) && (revents & (POLLERR | POLLHUP | POLLNVAL)))
+    sm_fail(sm, "port closed");
+
+} // bsl_sm_io
+
+
+
+/**
+  \fn void bsl_sm_timeout(bsl_sm_t *sm, uint64_t now)
+
+  \brief handle timeout of current exchange
+
+  \param[in] sm     session
+  \param[in] now    current time [us] (see time_us())
+
+  if the deadline of the current exchange has passed, call its continuation
+  with SM_TIMEOUT. Also used for finishing waits
+*/
+void bsl_sm_timeout(bsl_sm_t *sm, uint64_t now) {
+
+  if ((sm->status == SM_STATUS_RUNNING) && (sm->deadline != 0) && (now >= sm->deadline)) {
+    if (sm->lenRx > 0)
+      sm->io.numTimeout++;
+    sm_complete(sm, SM_TIMEOUT);
+  }
+
+} // bsl_sm_timeout
+
+#endif // __APPLE__ || __unix__
+
+// end of file
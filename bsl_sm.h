@@ -0,0 +1,171 @@
+/**
+  \file bsl_sm.h
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief declaration of non-blocking BSL session state machine
+
+  declaration of a resumable state machine, which performs the complete flash
+  sequence of bootloader.c (sync, identify, RAM routines, erase, write, verify,
+  activate BSL, jump) for one port without blocking. Each protocol step is an
+  explicit continuation, which is called by an event loop (see reactor.h) when
+  the expected response has been received or a timeout occurred. This allows
+  many sessions in a single thread with only ~7kB state per session, most of
+  it the ACK round-trip histograms (3x 1.8kB, see hist.h).
+*/
+
+// for including file only once
+#ifndef _BSL_SM_H_
+#define _BSL_SM_H_
+
+
+// include files
+#include <stdint.h>
+#include "serial_comm.h"
+#include "image.h"
+#include "progress.h"
+#include "bootloader.h"
+#include "hist.h"
+#include "linkmon.h"
+#include "rto.h"
+
+
+// session phases (in order of execution)
+#define SM_PHASE_IDLE       0       // not yet started
+#define SM_PHASE_SYNC       1       // synchronize baudrate
+#define SM_PHASE_IDENTIFY   2       // determine family, flash size and BSL version
+#define SM_PHASE_ROUTINES   3       // upload RAM flash routines
+#define SM_PHASE_ERASE      4       // mass erase flash
+#define SM_PHASE_WRITE      5       // upload image
+#define SM_PHASE_VERIFY     6       // read back and compare image
+#define SM_PHASE_ACTIVATE   7       // enable ROM bootloader in option bytes
+#define SM_PHASE_JUMP       8       // jump to flash
+#define SM_PHASE_DONE       9       // sequence completed
+
+// session status
+#define SM_STATUS_RUNNING   0       // session in progress
+#define SM_STATUS_OK        1       // session completed successfully
+#define SM_STATUS_FAILED    2       // session aborted, see error
+
+// result of a single exchange
+#define SM_OK               0       // expected number of bytes received
+#define SM_TIMEOUT          1       // timeout waiting for response
+
+
+/// settings shared by all sessions of a run
+typedef struct {
+  const image_t   *image;           ///< image to upload (NULL=skip)
+  uint8_t         flashErase;       ///< mass erase prior to upload
+  uint8_t         verifyUpload;     ///< verify memory after upload
+  uint8_t         enableBSL;        ///< enable ROM bootloader after upload
+  uint8_t         jumpFlash;        ///< jump to flash when done
+  uint8_t         UARTmode;         ///< 0=duplex, 1=1-wire echo, 2=reply mode
+  uint32_t        baudrate;         ///< configured baudrate (max. for link adaptation)
+  uint8_t         linkAdapt;        ///< renegotiate baudrate on link errors (requires reset via DTR)
+  uint16_t        readSize;         ///< bytes per READ command for verify (1..256, 0=256)
+  uint8_t         echoBlock;        ///< reply mode: echo all bytes of a read at once (0=bytewise)
+  uint32_t        serialAddr;       ///< address of per-board serial number in image (0=none, see serialno.h)
+} bsl_sm_cfg_t;
+
+
+/// session state machine
+typedef struct bsl_sm bsl_sm_t;
+
+/// continuation, called when the current step has finished
+typedef void (*bsl_sm_cont_t)(bsl_sm_t *sm, uint8_t status);
+
+/// state of one BSL session
+struct bsl_sm {
+
+  // configuration
+  HANDLE              fd;           ///< non-blocking handle of port
+  char                name[64];     ///< name of port or session (for output)
+  const bsl_sm_cfg_t  *cfg;         ///< shared settings
+
+  // state
+  uint8_t             phase;        ///< current phase (SM_PHASE_*)
+  uint8_t             status;       ///< session status (SM_STATUS_*)
+  char                error[80];    ///< error message if status==SM_STATUS_FAILED
+  int64_t             serialNo;     ///< serial number patched into image (-1=none, set by caller)
+  int64_t             queueLatency; ///< time of job in scheduler queue [us] (-1=no job, set by caller)
+  bsl_sm_cont_t       cont;         ///< continuation after current exchange
+  bsl_sm_cont_t       then;         ///< continuation after current BSL command
+  uint64_t            deadline;     ///< timeout of current exchange [us], 0=none
+
+  // current exchange: send Tx, then receive lenRx bytes
+  const uint8_t       *ptrTx;       ///< data to send (Tx or pre-built frame)
+  uint16_t            lenTx;        ///< number of bytes to send
+  uint16_t            numTx;        ///< number of bytes already sent
+  uint16_t            numEcho;      ///< 1-wire echo bytes still to discard
+  uint16_t            lenReply;     ///< reply mode echo bytes still to send
+  uint8_t             reply[300];   ///< reply mode echo bytes, sent on POLLOUT if port is busy
+  uint16_t            lenRx;        ///< number of bytes expected
+  uint16_t            numRx;        ///< number of bytes received
+  uint8_t             Tx[8];        ///< buffer for commands and addresses
+  uint8_t             Rx[260];      ///< response buffer (ACK + max. 256B READ data)
+  uint64_t            timeTx;       ///< start of exchange [us] (for trace)
+  uint64_t            timeRx;       ///< all data sent, start of response wait [us] (for trace)
+  uint32_t            transfer;     ///< line time of exchange [us] (see rto.h)
+  uint32_t            device;       ///< max. processing time of device [us], e.g. flash programming
+  rto_t               rto;          ///< measured response latency (for timeouts)
+
+  // current BSL command
+  const char          *cmd;         ///< name of current command (for trace), NULL=none
+  uint64_t            timeCmd;      ///< start of current command [us] (for trace)
+  uint32_t            addr;         ///< address of current command
+  const uint8_t       *frame;       ///< WRITE frame (N-1, data, checksum)
+  uint16_t            lenFrame;     ///< length of WRITE frame
+  const image_t       *wrImage;     ///< image in upload
+  uint32_t            idx;          ///< index of frame, probe or verify chunk
+  uint8_t             retry;        ///< retry counter for SYNC
+  bsl_sm_cont_t       imgDone;      ///< continuation after image upload
+
+  // link quality and renegotiation (reset, re-SYNC, RAM routines, repeat command)
+  linkmon_t           link;         ///< link quality monitor
+  uint8_t             relink;       ///< renegotiation in progress
+  uint8_t             relinkPhase;  ///< phase to resume after renegotiation
+  uint32_t            relinkIdx;    ///< frame or verify offset to resume
+  uint8_t             numRelink;    ///< number of renegotiations
+
+  // device info
+  uint8_t             family;       ///< STM8S or STM8L
+  uint8_t             versBSL;      ///< BSL version
+  int                 flashsize;    ///< flash size [kB]
+
+  // statistics
+  uint64_t            timeStart;    ///< start of session [us]
+  uint64_t            timeEnd;      ///< end of session [us]
+  io_stats_t          io;           ///< transport counters (polls are counted by event loop)
+  uint32_t            bytesPayload; ///< number of image bytes written and verified
+  uint32_t            numFrames;    ///< number of WRITE frames sent
+  uint64_t            phaseStart[SM_PHASE_DONE+1];  ///< start of each phase [us], 0=not reached
+  uint64_t            phaseEnd[SM_PHASE_DONE+1];    ///< end of each phase [us], 0=skipped or aborted
+  hist_t              ackRtt[ACK_NUM_STAGES];       ///< send-to-ACK round-trip times [us] (see bsl_ackRtt())
+  progress_t          *progress;    ///< progress counters for dashboard (NULL=none, set after init)
+
+};
+
+
+/// init session for an opened port (handle is set to non-blocking)
+void        bsl_sm_init(bsl_sm_t *sm, HANDLE fd, const char *name, const bsl_sm_cfg_t *cfg);
+
+/// start session (send first SYNC)
+void        bsl_sm_start(bsl_sm_t *sm);
+
+/// get poll() events the session waits for
+short       bsl_sm_events(const bsl_sm_t *sm);
+
+/// handle poll() events of session
+void        bsl_sm_io(bsl_sm_t *sm, short revents);
+
+/// handle timeout of current exchange, if expired
+void        bsl_sm_timeout(bsl_sm_t *sm, uint64_t now);
+
+/// get name of phase
+const char  *bsl_sm_phaseName(uint8_t phase);
+
+#endif // _BSL_SM_H_
+
+// end of file
@@ -0,0 +1,396 @@
+/**
+  \file dumpstub.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief implementation of RAM stub for fast memory dump
+
+  implementation of the host side of the memory dump stub. The ROM bootloader
+  requires 3 handshakes for each READ of max. 256B. The stub instead streams
+  the complete range, so only line time remains. Chunks are received directly
+  into the dump buffer. A corrupted chunk is marked and requested again
+  after the stream, i.e. the dump is not restarted.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "dumpstub.h"
+#include "bootloader.h"
+#include "updater.h"
+#include "serial_comm.h"
+#include "trace.h"
+#include "rto.h"
+#include "misc.h"
+#include "globals.h"
+
+
+/// number of repeat passes for corrupted chunks
+#define DUMP_RETRY            3
+
+/// processing time of stub per byte [us] (16MHz, bitwise CRC)
+#define DUMP_BYTE_US          10
+
+
+/**
+  STM8 machine code of stub, linked to DUMP_STUB_ADDR. Uses the UART which
+  is enabled by the ROM bootloader (UART1 or UART2), polled without interrupts.
+  The variables follow the code and are uploaded together with it
+*/
+static const uint8_t s_stub[] = {
+  0x9B,                                // 0210  sim
+  0x35, 0x00, 0x50, 0xC6,              // 0211  mov  CLK_CKDIVR,#0x00
+  0xAE, 0x52, 0x30,                    // 0215  ldw  x,#UART1
+  0x72, 0x06, 0x52, 0x35, 0x03,        // 0218  btjt UART1_CR2,#3,wait_tc
+  0xAE, 0x52, 0x40,                    // 021D  ldw  x,#UART2
+  // wait_tc:
+  0xF6,                                // 0220  ld   a,(x)
+  0xA5, 0x40,                          // 0221  bcp  a,#0x40
+  0x27, 0xFB,                          // 0223  jreq wait_tc
+  0xC6, 0x03, 0x0E,                    // 0225  ld   a,brr2
+  0xE7, 0x03,                          // 0228  ld   (3,x),a
+  0xC6, 0x03, 0x0D,                    // 022A  ld   a,brr1
+  0xE7, 0x02,                          // 022D  ld   (2,x),a
+  // sync:
+  0xCD, 0x02, 0xD0,                    // 022F  call getc
+  0xA1, 0x5A,                          // 0232  cp   a,#0x5A
+  0x26, 0xF9,                          // 0234  jrne sync
+  0x90, 0xAE, 0x03, 0x0F,              // 0236  ldw  y,#req
+  // rx:
+  0xCD, 0x02, 0xD0,                    // 023A  call getc
+  0x90, 0xF7,                          // 023D  ld   (y),a
+  0x90, 0x5C,                          // 023F  incw y
+  0x90, 0xA3, 0x03, 0x15,              // 0241  cpw  y,#req+6
+  0x26, 0xF3,                          // 0245  jrne rx
+  0xC6, 0x03, 0x0F,                    // 0247  ld   a,req+0
+  0xC8, 0x03, 0x10,                    // 024A  xor  a,req+1
+  0xC8, 0x03, 0x11,                    // 024D  xor  a,req+2
+  0xC8, 0x03, 0x12,                    // 0250  xor  a,req+3
+  0xC8, 0x03, 0x13,                    // 0253  xor  a,req+4
+  0xC1, 0x03, 0x14,                    // 0256  cp   a,req+5
+  0x26, 0xD4,                          // 0259  jrne sync
+  0xC6, 0x03, 0x13,                    // 025B  ld   a,req+4
+  0xCA, 0x03, 0x12,                    // 025E  or   a,req+3
+  0x26, 0x03,                          // 0261  jrne chunk
+  0xCC, 0x80, 0x00,                    // 0263  jp   0x8000
+  // chunk:
+  0x35, 0xFF, 0x03, 0x15,              // 0266  mov  crc+0,#0xFF
+  0x35, 0xFF, 0x03, 0x16,              // 026A  mov  crc+1,#0xFF
+  0xC6, 0x03, 0x0F,                    // 026E  ld   a,req+0
+  0xCD, 0x02, 0xE2,                    // 0271  call crc_upd
+  0xC6, 0x03, 0x10,                    // 0274  ld   a,req+1
+  0xCD, 0x02, 0xE2,                    // 0277  call crc_upd
+  0xC6, 0x03, 0x11,                    // 027A  ld   a,req+2
+  0xCD, 0x02, 0xE2,                    // 027D  call crc_upd
+  0x72, 0x5F, 0x03, 0x17,              // 0280  clr  num
+  // byte:
+  0x92, 0xBC, 0x03, 0x0F,              // 0284  ldf  a,[req.e]
+  0xCD, 0x02, 0xD8,                    // 0288  call putc
+  0xCD, 0x02, 0xE2,                    // 028B  call crc_upd
+  0x72, 0x5C, 0x03, 0x11,              // 028E  inc  req+2
+  0x26, 0x0A,                          // 0292  jrne addr_ok
+  0x72, 0x5C, 0x03, 0x10,              // 0294  inc  req+1
+  0x26, 0x04,                          // 0298  jrne addr_ok
+  0x72, 0x5C, 0x03, 0x0F,              // 029A  inc  req+0
+  // addr_ok:
+  0xC6, 0x03, 0x13,                    // 029E  ld   a,req+4
+  0x26, 0x04,                          // 02A1  jrne len_lo
+  0x72, 0x5A, 0x03, 0x12,              // 02A3  dec  req+3
+  // len_lo:
+  0x72, 0x5A, 0x03, 0x13,              // 02A7  dec  req+4
+  0xC6, 0x03, 0x13,                    // 02AB  ld   a,req+4
+  0xCA, 0x03, 0x12,                    // 02AE  or   a,req+3
+  0x27, 0x0B,                          // 02B1  jreq last
+  0x72, 0x5A, 0x03, 0x17,              // 02B3  dec  num
+  0x26, 0xCB,                          // 02B7  jrne byte
+  0xCD, 0x02, 0xC4,                    // 02B9  call send_crc
+  0x20, 0xA8,                          // 02BC  jra  chunk
+  // last:
+  0xCD, 0x02, 0xC4,                    // 02BE  call send_crc
+  0xCC, 0x02, 0x2F,                    // 02C1  jp   sync
+  // send_crc:
+  0xC6, 0x03, 0x15,                    // 02C4  ld   a,crc+0
+  0xCD, 0x02, 0xD8,                    // 02C7  call putc
+  0xC6, 0x03, 0x16,                    // 02CA  ld   a,crc+1
+  0xCC, 0x02, 0xD8,                    // 02CD  jp   putc
+  // getc:
+  0xF6,                                // 02D0  ld   a,(x)
+  0xA5, 0x20,                          // 02D1  bcp  a,#0x20
+  0x27, 0xFB,                          // 02D3  jreq getc
+  0xE6, 0x01,                          // 02D5  ld   a,(1,x)
+  0x81,                                // 02D7  ret
+  // putc:
+  0x88,                                // 02D8  push a
+  // putc_w:
+  0xF6,                                // 02D9  ld   a,(x)
+  0xA5, 0x80,                          // 02DA  bcp  a,#0x80
+  0x27, 0xFB,                          // 02DC  jreq putc_w
+  0x84,                                // 02DE  pop  a
+  0xE7, 0x01,                          // 02DF  ld   (1,x),a
+  0x81,                                // 02E1  ret
+  // crc_upd:
+  0xC8, 0x03, 0x15,                    // 02E2  xor  a,crc+0
+  0xC7, 0x03, 0x15,                    // 02E5  ld   crc+0,a
+  0x35, 0x08, 0x03, 0x18,              // 02E8  mov  bit,#8
+  // crc_bit:
+  0x72, 0x58, 0x03, 0x16,              // 02EC  sll  crc+1
+  0x72, 0x59, 0x03, 0x15,              // 02F0  rlc  crc+0
+  0x24, 0x10,                          // 02F4  jrnc crc_next
+  0xC6, 0x03, 0x15,                    // 02F6  ld   a,crc+0
+  0xA8, 0x10,                          // 02F9  xor  a,#0x10
+  0xC7, 0x03, 0x15,                    // 02FB  ld   crc+0,a
+  0xC6, 0x03, 0x16,                    // 02FE  ld   a,crc+1
+  0xA8, 0x21,                          // 0301  xor  a,#0x21
+  0xC7, 0x03, 0x16,                    // 0303  ld   crc+1,a
+  // crc_next:
+  0x72, 0x5A, 0x03, 0x18,              // 0306  dec  bit
+  0x26, 0xE0,                          // 030A  jrne crc_bit
+  0x81,                                // 030C  ret
+};
+
+// variables of stub (offset to end of code)
+#define DUMP_VAR_BRR1         0         // BRR1 for dump baudrate (set by host)
+#define DUMP_VAR_BRR2         1         // BRR2 for dump baudrate (set by host)
+#define DUMP_VAR_SIZE         12        // BRR1/2, request[6], CRC[2], counters[2]
+
+
+// port state
+static uint32_t   s_baudrate = 0;         // baudrate of stub [Baud]
+
+
+
+/**
+  \fn uint8_t dump_start(HANDLE ptrPort, uint32_t baudrate)
+
+  \brief upload stub, start it and switch to baudrate
+
+  \param[in] ptrPort    handle to communication port (BSL synchronized, STM8S)
+  \param[in] baudrate   baudrate for dump [Baud]
+
+  \return communication status (0=ok)
+*/
+uint8_t dump_start(HANDLE ptrPort, uint32_t baudrate) {
+
+  char      buf[sizeof(s_stub) + DUMP_VAR_SIZE];
+  uint32_t  div;
+
+  // UART divider must be in 16..0xFFFF and baudrate error within 2%
+  div = (uint32_t) ((DUMP_FCPU + baudrate/2) / baudrate);
+  if ((div < 16) || (div > 0xFFFF) || (labs((long) (DUMP_FCPU / div) - (long) baudrate) * 50 > (long) baudrate)) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'dump_start()': baudrate %d not supported, exit!\n\n", (int) baudrate);
+    Exit(1, g_pauseOnExit);
+  }
+
+  // upload stub with baudrate divider
+  memcpy(buf, s_stub, sizeof(s_stub));
+  memset(buf + sizeof(s_stub), 0, DUMP_VAR_SIZE);
+  buf[sizeof(s_stub) + DUMP_VAR_BRR1] = (char) (div >> 4);
+  buf[sizeof(s_stub) + DUMP_VAR_BRR2] = (char) (((div >> 8) & 0xF0) | (div & 0x0F));
+  if (g_verbose)
+    printf("  Uploading dump stub ... ");
+  fflush(stdout);
+  bsl_memWrite(ptrPort, DUMP_STUB_ADDR, sizeof(buf), buf, 0);
+  if (g_verbose)
+    printf("ok\n");
+
+  // leave ROM bootloader. The stub waits for end of ACK before changing baudrate
+  bsl_jumpTo(ptrPort, DUMP_STUB_ADDR);
+  set_baudrate(ptrPort, baudrate);
+  s_baudrate = baudrate;
+  SLEEP(5);
+  flush_port(ptrPort);
+
+  return(0);
+
+} // dump_start
+
+
+
+/**
+  \fn static uint32_t dump_stream(HANDLE ptrPort, uint32_t addrStart, uint32_t numBytes, char *buf, uint8_t *bad)
+
+  \brief request memory range and receive stream of chunks
+
+  \param[in]  ptrPort     handle to communication port
+  \param[in]  addrStart   starting address to read from
+  \param[in]  numBytes    number of bytes (1..DUMP_STREAM_MAX)
+  \param[out] buf         buffer to store data to
+  \param[out] bad         corrupted chunks (1 per chunk)
+
+  \return number of corrupted chunks
+*/
+static uint32_t dump_stream(HANDLE ptrPort, uint32_t addrStart, uint32_t numBytes, char *buf, uint8_t *bad) {
+
+  uint8_t   Tx[7], Rx[DUMP_CHUNK+2], addr[3];
+  uint32_t  idx, len, numBad = 0;
+  uint16_t  crc;
+  char      tmp[1000];
+
+  // send request
+  Tx[0] = DUMP_SOF;
+  Tx[1] = (uint8_t) (addrStart >> 16);
+  Tx[2] = (uint8_t) (addrStart >> 8);
+  Tx[3] = (uint8_t) addrStart;
+  Tx[4] = (uint8_t) (numBytes >> 8);
+  Tx[5] = (uint8_t) numBytes;
+  Tx[6] = Tx[1] ^ Tx[2] ^ Tx[3] ^ Tx[4] ^ Tx[5];
+  set_timeout(ptrPort, (rto_transfer(s_baudrate, 0, sizeof(Tx), DUMP_CHUNK+2) + DUMP_CHUNK*DUMP_BYTE_US) / 1000 + 100);
+  if (send_port(ptrPort, sizeof(Tx), (char*) Tx) != sizeof(Tx)) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'dump_stream()': sending request failed, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+
+  // receive chunks. CRC includes chunk address to detect corrupted requests
+  for (idx=0; idx<numBytes; idx+=len) {
+    len = numBytes - idx;
+    if (len > DUMP_CHUNK)
+      len = DUMP_CHUNK;
+    addr[0] = (uint8_t) ((addrStart + idx) >> 16);
+    addr[1] = (uint8_t) ((addrStart + idx) >> 8);
+    addr[2] = (uint8_t) (addrStart + idx);
+
+    // timeout -> stream lost, mark remaining chunks and wait until stub is idle
+    if (receive_port(ptrPort, len+2, (char*) Rx) != len+2) {
+      for (; idx<numBytes; idx+=DUMP_CHUNK) {
+        bad[idx/DUMP_CHUNK] = 1;
+        numBad++;
+      }
+      while (receive_port(ptrPort, sizeof(tmp), tmp) > 0);
+      break;
+    }
+
+    // check CRC and copy data
+    crc = upd_crc16(upd_crc16(0xFFFF, addr, 3), Rx, len);
+    if ((Rx[len] != (uint8_t) (crc >> 8)) || (Rx[len+1] != (uint8_t) crc)) {
+      bad[idx/DUMP_CHUNK] = 1;
+      numBad++;
+    }
+    else {
+      memcpy(buf+idx, Rx, len);
+      bad[idx/DUMP_CHUNK] = 0;
+    }
+
+  } // loop over chunks
+
+  return(numBad);
+
+} // dump_stream
+
+
+
+/**
+  \fn uint8_t dump_memRead(HANDLE ptrPort, uint32_t addrStart, uint32_t numBytes, char *buf, uint8_t verbose)
+
+  \brief read memory range via stub
+
+  \param[in]  ptrPort     handle to communication port
+  \param[in]  addrStart   starting address to read from
+  \param[in]  numBytes    number of bytes to read
+  \param[out] buf         buffer to store data to
+  \param[in]  verbose     print messages
+
+  \return communication status (0=ok)
+*/
+uint8_t dump_memRead(HANDLE ptrPort, uint32_t addrStart, uint32_t numBytes, char *buf, uint8_t verbose) {
+
+  uint8_t   *bad;
+  uint32_t  idx, len, numChunks, numBad = 0, numRepeat = 0;
+  uint8_t   pass;
+
+  // print message
+  if (verbose) {
+    if (numBytes > 1024)
+      printf("  dump  %1.1fkB starting from 0x%04x with %gkBaud ", (float) numBytes/1024.0, (int) addrStart, (float) s_baudrate/1000.0);
+    else
+      printf("  dump  %dB starting from 0x%04x with %gkBaud ", numBytes, (int) addrStart, (float) s_baudrate/1000.0);
+    fflush(stdout);
+  }
+
+  numChunks = (numBytes + DUMP_CHUNK - 1) / DUMP_CHUNK;
+  bad = (uint8_t*) calloc(numChunks+1, 1);
+  if (!bad) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'dump_memRead()': cannot allocate chunk list, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+
+  // stream complete range
+  trace_begin(TRACE_TID(ptrPort), "command", "DUMP");
+  for (idx=0; idx<numBytes; idx+=len) {
+    len = numBytes - idx;
+    if (len > DUMP_STREAM_MAX)
+      len = DUMP_STREAM_MAX;
+    numBad += dump_stream(ptrPort, addrStart+idx, len, buf+idx, bad+idx/DUMP_CHUNK);
+  }
+  trace_end(TRACE_TID(ptrPort), "command", "DUMP");
+
+  // request corrupted chunks again
+  for (pass=0; (pass<DUMP_RETRY) && (numBad>0); pass++) {
+    trace_begin(TRACE_TID(ptrPort), "command", "DUMP repeat");
+    numBad = 0;
+    for (idx=0; idx<numChunks; idx++) {
+      if (!bad[idx])
+        continue;
+      len = numBytes - idx*DUMP_CHUNK;
+      if (len > DUMP_CHUNK)
+        len = DUMP_CHUNK;
+      numBad += dump_stream(ptrPort, addrStart+idx*DUMP_CHUNK, len, buf+idx*DUMP_CHUNK, bad+idx);
+      numRepeat++;
+    }
+    trace_end(TRACE_TID(ptrPort), "command", "DUMP repeat");
+  }
+  free(bad);
+  if (numBad > 0) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'dump_memRead()': %d chunks corrupted after %d retries, exit!\n\n", (int) numBad, DUMP_RETRY);
+    Exit(1, g_pauseOnExit);
+  }
+
+  // print message
+  if (verbose) {
+    if (numRepeat > 0)
+      printf("(%d chunks repeated) ", (int) numRepeat);
+    printf("... ok\n");
+    fflush(stdout);
+  }
+
+  return(0);
+
+} // dump_memRead
+
+
+
+/**
+  \fn uint8_t dump_jumpTo(HANDLE ptrPort)
+
+  \brief leave stub and jump to reset vector. There is no response
+
+  \param[in] ptrPort    handle to communication port
+
+  \return communication status (0=ok)
+*/
+uint8_t dump_jumpTo(HANDLE ptrPort) {
+
+  uint8_t   Tx[7] = {DUMP_SOF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+  printf("  jump to address 0x%04x ... ", (int) PFLASH_START);
+  fflush(stdout);
+  if (send_port(ptrPort, sizeof(Tx), (char*) Tx) != sizeof(Tx)) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'dump_jumpTo()': sending request failed, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+  printf("ok\n");
+  fflush(stdout);
+
+  return(0);
+
+} // dump_jumpTo
+
+// end of file
@@ -0,0 +1,58 @@
+/**
+  \file dumpstub.h
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief declaration of RAM stub for fast memory dump
+
+  declaration of routines for reading memory via a small RAM routine instead
+  of the ROM bootloader READ command. The stub is uploaded with the BSL WRITE
+  command and started with GO. It then streams requested memory ranges
+  continuously at a higher baudrate, with a CRC16 after each chunk. Chunks
+  with a CRC error are requested again. Only STM8S in duplex UART mode is
+  supported. Request (host -> STM8):
+    DUMP_SOF, address (24b), number of bytes (16b, 0=leave stub), XOR checksum
+  Response (STM8 -> host), for each chunk of up to DUMP_CHUNK bytes:
+    data, CRC16-CCITT (MSB first, init 0xFFFF) over chunk address (24b) and data
+*/
+
+// for including file only once
+#ifndef _DUMPSTUB_H_
+#define _DUMPSTUB_H_
+
+
+// include files
+#include <stdint.h>
+#include "serial_comm.h"
+
+
+/// RAM address of stub (above RAM routines, below stack)
+#define DUMP_STUB_ADDR        0x0210
+
+/// CPU clock of stub [Hz] (HSI without divider)
+#define DUMP_FCPU             16000000L
+
+/// start of request frame
+#define DUMP_SOF              0x5A
+
+/// number of bytes per CRC protected chunk
+#define DUMP_CHUNK            256
+
+/// max. number of bytes per request
+#define DUMP_STREAM_MAX       0x8000
+
+
+/// upload stub via ROM bootloader, start it and switch to given baudrate
+uint8_t     dump_start(HANDLE ptrPort, uint32_t baudrate);
+
+/// read memory range via stub. Corrupted chunks are requested again
+uint8_t     dump_memRead(HANDLE ptrPort, uint32_t addrStart, uint32_t numBytes, char *buf, uint8_t verbose);
+
+/// leave stub and jump to reset vector
+uint8_t     dump_jumpTo(HANDLE ptrPort);
+
+#endif // _DUMPSTUB_H_
+
+// end of file
@@ -0,0 +1,449 @@
+/**
+  \file gang.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief implementation of gang programming with job scheduler
+
+  implementation of routines for programming boards on several fixtures in
+  parallel. Each fixture (=port) is a worker of the scheduler, which pulls
+  jobs and runs the BSL session state machine (see bsl_sm.h). Fixtures are
+  served by up to GANG_MAX_THREADS threads; with more fixtures a thread drives
+  the sessions of several fixtures via poll() (see reactor_step()).
+  Fast fixtures take over jobs of slow ones, so mixed adapters and devices
+  don't leave fixtures idle.
+
+  Job file format: one line per firmware with optional number of boards
+  (default 1). Empty lines and lines starting with '#' are ignored, e.g.
+    fw_STM8L.s19    20
+    fw_STM8S.hex    50
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "gang.h"
+#include "sched.h"
+#include "image.h"
+#include "reactor.h"
+#include "progress.h"
+#include "telemetry.h"
+#include "metrics.h"
+#include "serialno.h"
+#include "misc.h"
+#include "globals.h"
+
+// OS specific: Posix
+#if defined(__APPLE__) || defined(__unix__)
+  #include <pthread.h>
+  #include <poll.h>
+  #include <errno.h>
+  #include <unistd.h>
+#endif
+
+
+// max. number of attempts per job (a failed board is replaced by the next one)
+#define GANG_MAX_ATTEMPTS   3
+
+// max. number of threads. More fixtures are distributed round-robin
+#define GANG_MAX_THREADS    64
+
+// max. wait for I/O [ms] while a fixture of the thread is idle (then check for new jobs)
+#define GANG_IDLE_POLL      10
+
+
+/// state of fixture worker
+typedef struct {
+  uint32_t            idx;          // index of worker
+  HANDLE              fd;           // port of fixture
+  const char          *name;        // name of port
+  bsl_sm_cfg_t        cfg;          // session settings (image set per job)
+  uint8_t             resetSTM8;    // reset before each job (see main())
+  uint32_t            baudrate;     // baudrate (restored after SW reset)
+  progress_t          *progress;    // dashboard slot (NULL=print result per job)
+  hist_t              ackRtt[ACK_NUM_STAGES];   // ACK round-trip times of all jobs
+  io_stats_t          io;           // transport counters of all jobs
+  linkmon_t           link;         // link quality of last job (baudrate is kept for next board)
+  uint32_t            bytesPayload; // image bytes written and verified in all jobs
+  serialno_block_t    serials;      // reserved serial numbers (if cfg.serialAddr != 0)
+  sched_job_t         *job;         // job in execution (NULL=idle)
+  image_t             *patched;     // image with serial number of job (NULL=none)
+  bsl_sm_t            sm;           // BSL session of job
+} gang_worker_t;
+
+
+/// thread serving one or more fixtures
+typedef struct {
+  gang_worker_t       **worker;     // fixtures of thread
+  uint32_t            num;          // number of fixtures
+} gang_thread_t;
+
+
+
+#if defined(__APPLE__) || defined(__unix__)
+
+/**
+  \fn static void reset_board(gang_worker_t *w)
+
+  \brief reset STM8 on fixture via DTR line or UART command (see main())
+
+  the port is non-blocking (see bsl_sm_init()), therefore wait until the
+  command is accepted. A 1-wire echo is discarded by the flush
+*/
+static void reset_board(gang_worker_t *w) {
+
+  struct pollfd   pfd;
+  int             i;
+
+  // HW reset via DTR line
+  if (w->resetSTM8 == 1) {
+    pulse_DTR(w->fd, 10);
+    SLEEP(5);                               // allow BSL to initialize
+  }
+
+  // SW reset via command 'Re5eT!' at 115.2kBaud
+  else if (w->resetSTM8 == 2) {
+    set_baudrate(w->fd, 115200);
+    pfd.fd     = w->fd;
+    pfd.events = POLLOUT;
+    for (i=0; i<6; i++) {
+      while ((write(w->fd, "Re5eT!"+i, 1) != 1) && ((errno == EAGAIN) || (errno == EINTR)))
+        poll(&pfd, 1, 10);
+      SLEEP(10);
+    }
+    set_baudrate(w->fd, w->baudrate);
+    flush_port(w->fd);
+  }
+
+} // reset_board
+
+
+
+/**
+  \fn static void gang_start(gang_worker_t *w, sched_job_t *job)
+
+  \brief reset board on fixture and start BSL session for job
+
+  \param[in] w      fixture
+  \param[in] job    job from scheduler
+
+  the reset blocks the thread for some ms, also for other fixtures of the thread
+*/
+static void gang_start(gang_worker_t *w, sched_job_t *job) {
+
+  const image_t   *image;
+  uint64_t        serial = 0;
+
+  // prepare board. Serial number is taken from the worker's block
+  image = (const image_t*) job->data;
+  w->job     = job;
+  w->patched = NULL;
+  if (w->cfg.serialAddr) {
+    serial     = serialno_next(&(w->serials));
+    w->patched = serialno_patch(image, w->cfg.serialAddr, serial);
+  }
+  w->cfg.image = w->patched ? w->patched : image;
+  reset_board(w);
+
+  // start BSL session
+  bsl_sm_init(&(w->sm), w->fd, w->name, &(w->cfg));
+  if (w->patched)
+    w->sm.serialNo = (int64_t) serial;
+  w->sm.queueLatency = (int64_t) (job->timeStart - job->timeSubmit);
+  linkmon_resume(&(w->sm.link), &(w->link));
+  w->sm.progress = w->progress;
+  bsl_sm_start(&(w->sm));
+
+} // gang_start
+
+
+
+/**
+  \fn static void gang_finish(gang_worker_t *w)
+
+  \brief report finished job of fixture and print result
+
+  \param[in] w      fixture with finished session
+*/
+static void gang_finish(gang_worker_t *w) {
+
+  sched_job_t     *job = w->job;
+  bsl_sm_t        *sm = &(w->sm);
+  const image_t   *image = (const image_t*) job->data;
+  uint8_t         success, retry;
+  int             i;
+
+  // report job and accumulate statistics of fixture
+  success = (sm->status == SM_STATUS_OK);
+  retry = sched_done(w->idx, job, success);
+  telemetry_write(sm, job->id);
+  metrics_write(sm);
+  for (i=0; i<ACK_NUM_STAGES; i++)
+    hist_merge(&(w->ackRtt[i]), &(sm->ackRtt[i]));
+  add_port_stats(&(w->io), &(sm->io));
+  w->link = sm->link;
+  w->bytesPayload += sm->bytesPayload;
+  image_release(w->patched);
+  w->patched = NULL;
+  w->job     = NULL;
+
+  // print result (single call to avoid interleaving), unless shown in dashboard
+  if (w->progress)
+    return;
+  if ((success) && (sm->link.baud != sm->link.baudMax))
+    printf("  %s: job %d '%s' ok (%1.2fs at %d Baud)\n", w->name, (int) job->id, image->name, (float) (sm->timeEnd - sm->timeStart) / 1000000.0, (int) sm->link.baud);
+  else if (success)
+    printf("  %s: job %d '%s' ok (%1.2fs)\n", w->name, (int) job->id, image->name, (float) (sm->timeEnd - sm->timeStart) / 1000000.0);
+  else {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "  %s: job %d '%s' failed in phase '%s': %s%s\n", w->name, (int) job->id, image->name,
+      bsl_sm_phaseName(sm->phase), sm->error, retry ? " -> retry" : "");
+    setConsoleColor(PRM_COLOR_DEFAULT);
+  }
+  fflush(stdout);
+
+} // gang_finish
+
+
+
+/**
+  \fn static void *gang_thread(void *arg)
+
+  \brief thread serving one or more fixtures
+
+  \param[in] arg    fixtures of thread (gang_thread_t)
+
+  idle fixtures pull jobs from the scheduler without blocking, while the
+  sessions of busy fixtures are driven via reactor_step(). Only if all
+  fixtures of the thread are idle, it waits for the next job. Returns when
+  all jobs are done
+*/
+static void *gang_thread(void *arg) {
+
+  gang_thread_t   *t = (gang_thread_t*) arg;
+  gang_worker_t   *w;
+  sched_job_t     *job;
+  bsl_sm_t        **active;
+  uint32_t        i, numActive;
+
+  active = (bsl_sm_t**) malloc(t->num * sizeof(bsl_sm_t*));
+  if (!active) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'gang_thread()': cannot allocate memory buffers, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+
+  while (1) {
+
+    // start jobs on idle fixtures and collect running sessions
+    numActive = 0;
+    for (i=0; i<t->num; i++) {
+      w = t->worker[i];
+      if ((!w->job) && ((job = sched_tryGet(w->idx)) != NULL))
+        gang_start(w, job);
+      if (w->job)
+        active[numActive++] = &(w->sm);
+    }
+
+    // all fixtures idle -> wait for next job, or stop when all jobs are done
+    if (numActive == 0) {
+      w = t->worker[0];
+      if ((job = sched_get(w->idx)) == NULL)
+        break;
+      gang_start(w, job);
+      active[numActive++] = &(w->sm);
+    }
+
+    // run sessions. While a fixture is idle, return in time to check for new jobs
+    reactor_step(active, numActive, (numActive < t->num) ? GANG_IDLE_POLL : -1, 0);
+    for (i=0; i<t->num; i++) {
+      w = t->worker[i];
+      if ((w->job) && (w->sm.status != SM_STATUS_RUNNING))
+        gang_finish(w);
+    }
+
+  } // loop over jobs
+
+  free(active);
+  return(NULL);
+
+} // gang_thread
+
+#endif // __APPLE__ || __unix__
+
+
+
+/**
+  \fn uint32_t gang_run(HANDLE *ports, char **names, uint32_t numPorts, const char *jobFile, const bsl_sm_cfg_t *cfg, uint8_t resetSTM8, uint32_t baudrate, uint8_t dashboard)
+
+  \brief run jobs from job file on all ports
+
+  \param[in] ports       handles of opened ports (one per fixture)
+  \param[in] names       names of ports (for output)
+  \param[in] numPorts    number of ports
+  \param[in] jobFile     name of job file (see above)
+  \param[in] cfg         session settings. The image is taken from the jobs
+  \param[in] resetSTM8   reset before each job: 0=none, 1=DTR, 2=UART command
+  \param[in] baudrate    communication baudrate
+  \param[in] dashboard   show live dashboard instead of a line per job
+
+  \return number of finally failed jobs
+
+  load all firmware files of the job file, submit one job per board and
+  execute them with one worker per port, served by max. GANG_MAX_THREADS
+  threads. Print statistics incl. queue latency and throughput per fixture
+  when done
+*/
+uint32_t gang_run(HANDLE *ports, char **names, uint32_t numPorts, const char *jobFile, const bsl_sm_cfg_t *cfg, uint8_t resetSTM8, uint32_t baudrate, uint8_t dashboard) {
+
+#if defined(__APPLE__) || defined(__unix__)
+
+  FILE            *fp;
+  char            line[1100], file[1000];
+  image_t         *images[100];
+  uint32_t        numImages = 0, numJobs = 0, numThreads, count, i, j, k;
+  sched_job_t     *jobs = NULL;
+  gang_worker_t   *workers, **fixtures;
+  gang_thread_t   *pool;
+  pthread_t       *threads;
+  sched_stats_t   stats;
+  hist_t          ackRtt[ACK_NUM_STAGES];
+  io_stats_t      io;
+  uint32_t        bytesPayload;
+  int             num;
+
+  // read job file and load firmware
+  if (!(fp = fopen(jobFile, "r"))) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'gang_run()': cannot open job file '%s', exit!\n\n", jobFile);
+    Exit(1, g_pauseOnExit);
+  }
+  while (fgets(line, sizeof(line), fp)) {
+    num = sscanf(line, "%999s %u", file, &count);
+    if ((num < 1) || (file[0] == '#'))
+      continue;
+    if (num < 2)
+      count = 1;
+    if (numImages >= sizeof(images)/sizeof(images[0])) {
+      setConsoleColor(PRM_COLOR_RED);
+      fprintf(stderr, "\n\nerror in 'gang_run()': too many firmware files in '%s', exit!\n\n", jobFile);
+      Exit(1, g_pauseOnExit);
+    }
+    images[numImages] = image_load(file, g_verbose);
+    jobs = (sched_job_t*) realloc(jobs, (numJobs + count + 1) * sizeof(sched_job_t));
+    if (!jobs) {
+      setConsoleColor(PRM_COLOR_RED);
+      fprintf(stderr, "\n\nerror in 'gang_run()': cannot allocate memory buffers, exit!\n\n");
+      Exit(1, g_pauseOnExit);
+    }
+
+    // one job per board. Cost is number of bytes to write and read back
+    for (k=0; k<count; k++) {
+      memset(&(jobs[numJobs]), 0, sizeof(sched_job_t));
+      jobs[numJobs].id   = numJobs + 1;
+      jobs[numJobs].data = images[numImages];
+      jobs[numJobs].cost = image_dataBytes(images[numImages]) * (cfg->verifyUpload ? 2 : 1) + 1;
+      numJobs++;
+    }
+    numImages++;
+  }
+  fclose(fp);
+  printf("  %d jobs for %d firmware files on %d fixtures\n", (int) numJobs, (int) numImages, (int) numPorts);
+  fflush(stdout);
+
+  // init scheduler
+  sched_init(numPorts, GANG_MAX_ATTEMPTS);
+
+  // start dashboard and one worker per fixture. Fixtures are distributed round-robin to the threads
+  if (dashboard)
+    progress_start(100);
+  numThreads = (numPorts < GANG_MAX_THREADS) ? numPorts : GANG_MAX_THREADS;
+  workers  = (gang_worker_t*) calloc(numPorts, sizeof(gang_worker_t));
+  fixtures = (gang_worker_t**) calloc(numPorts, sizeof(gang_worker_t*));
+  pool     = (gang_thread_t*) calloc(numThreads, sizeof(gang_thread_t));
+  threads  = (pthread_t*) calloc(numThreads, sizeof(pthread_t));
+  if ((!workers) || (!fixtures) || (!pool) || (!threads)) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'gang_run()': cannot allocate memory buffers, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+  for (i=0; i<numPorts; i++) {
+    workers[i].idx       = i;
+    workers[i].fd        = ports[i];
+    workers[i].name      = names[i];
+    workers[i].cfg       = *cfg;
+    linkmon_init(&(workers[i].link), cfg->baudrate);
+    workers[i].resetSTM8 = resetSTM8;
+    workers[i].baudrate  = baudrate;
+    workers[i].progress  = dashboard ? progress_register(names[i]) : NULL;
+  }
+  for (i=0, k=0; i<numThreads; i++) {
+    pool[i].worker = &(fixtures[k]);
+    for (j=i; j<numPorts; j+=numThreads)
+      pool[i].worker[pool[i].num++] = &(workers[j]);
+    k += pool[i].num;
+    if (pthread_create(&(threads[i]), NULL, gang_thread, &(pool[i])) != 0) {
+      setConsoleColor(PRM_COLOR_RED);
+      fprintf(stderr, "\n\nerror in 'gang_run()': cannot start thread, exit!\n\n");
+      Exit(1, g_pauseOnExit);
+    }
+  }
+
+  // feed jobs with few jobs queued per fixture, so that placement uses current throughput estimates
+  for (i=0; i<numJobs; i++) {
+    sched_wait(2*numPorts);
+    sched_submit(&(jobs[i]));
+  }
+  sched_close();
+
+  // wait until all jobs are done
+  for (i=0; i<numThreads; i++)
+    pthread_join(threads[i], NULL);
+  if (dashboard)
+    progress_stop();
+
+  // print statistics
+  printf("\n");
+  sched_printStats();
+  sched_getStats(&stats);
+  memset(ackRtt, 0, sizeof(ackRtt));
+  for (i=0; i<numPorts; i++)
+    for (k=0; k<ACK_NUM_STAGES; k++)
+      hist_merge(&(ackRtt[k]), &(workers[i].ackRtt[k]));
+  bsl_printAckRtt(ackRtt);
+  memset(&io, 0, sizeof(io));
+  bytesPayload = 0;
+  for (i=0; i<numPorts; i++) {
+    add_port_stats(&io, &(workers[i].io));
+    bytesPayload += workers[i].bytesPayload;
+  }
+  print_port_stats(&io, bytesPayload, workers[0].cfg.UARTmode);
+
+  // clean up
+  sched_free();
+  for (i=0; i<numImages; i++)
+    image_release(images[i]);
+  free(jobs);
+  free(workers);
+  free(fixtures);
+  free(pool);
+  free(threads);
+
+  return(stats.numFailed);
+
+#else
+
+  setConsoleColor(PRM_COLOR_RED);
+  fprintf(stderr, "\n\nerror in 'gang_run()': not supported on this OS, exit!\n\n");
+  Exit(1, g_pauseOnExit);
+  return(0);
+
+#endif // __APPLE__ || __unix__
+
+} // gang_run
+
+// end of file
@@ -0,0 +1,31 @@
+/**
+  \file gang.h
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief declaration of gang programming with job scheduler
+
+  declaration of routines for programming boards on several fixtures in
+  parallel. Jobs are read from a job file and distributed to the fixtures
+  by the work-stealing scheduler (see sched.h)
+*/
+
+// for including file only once
+#ifndef _GANG_H_
+#define _GANG_H_
+
+
+// include files
+#include <stdint.h>
+#include "serial_comm.h"
+#include "bsl_sm.h"
+
+
+/// run jobs from job file on all ports (one worker per port, served by max. 64 threads). Returns number of failed jobs
+uint32_t    gang_run(HANDLE *ports, char **names, uint32_t numPorts, const char *jobFile, const bsl_sm_cfg_t *cfg, uint8_t resetSTM8, uint32_t baudrate, uint8_t dashboard);
+
+#endif // _GANG_H_
+
+// end of file
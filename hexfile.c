@@ -74,10 +74,12 @@ char *get_line(char **buf, char *line) {
    \param[out] buf        memory buffer containing file content (0-terminated)
    \param[in]  bufsize    max size of memory buffer
    
+   \return number of bytes read (excl. terminating 0)
+   
    read hexfile from file to memory buffer. Don't interpret (is done
    in separate routine)
 */
-void load_hexfile(const char *filename, char *buf, uint32_t bufsize) {
+uint32_t load_hexfile(const char *filename, char *buf, uint32_t bufsize) {
 
   FILE      *fp;
   uint32_t  len;
@@ -90,6 +92,8 @@ void load_hexfile(const char *filename, char *buf, uint32_t bufsize) {
   fseek(fp, 0, SEEK_END);
   len = ftell(fp);
   fseek(fp, 0, SEEK_SET);
+  if (len >= bufsize)
+    Error("File too large (%d bytes)", (int) len);
 
   // read file to buffer
   fread(buf, len, 1, fp);
@@ -98,7 +102,7 @@ void load_hexfile(const char *filename, char *buf, uint32_t bufsize) {
   fclose(fp);
 
   // attach 0 to buffer to detect EOF
-  buf[len++] = 0;
+  buf[len] = 0;
   
   // print message
   if (g_verbose) {
@@ -110,6 +114,8 @@ void load_hexfile(const char *filename, char *buf, uint32_t bufsize) {
       printf("ok, no data read\n");
     fflush(stdout);
   }
+  
+  return(len);
 
 } // load_hexfile
 
@@ -551,6 +557,102 @@ void convert_hex(char *buf, uint32_t *addrStart, uint32_t *numBytes, char *image
 
   
 
+/**
+   \fn void convert_elf(char *buf, uint32_t lenBuf, uint32_t *addrStart, uint32_t *numBytes, char *image, uint32_t lenImage)
+   
+   \brief convert ELF file in memory buffer to memory image
+   
+   \param[in]  buf        memory buffer containing ELF file
+   \param[in]  lenBuf     size of ELF file in bytes
+   \param[out] addrStart  start address of image (=lowest loaded address)
+   \param[out] numBytes   number of bytes in image
+   \param[out] image      RAM image of ELF file
+   \param[in]  lenImage   size of image buffer in bytes
+   
+   convert memory buffer containing a 32-bit ELF executable (e.g. from Cosmic, IAR or
+   SDCC with --out-fmt-elf) to memory buffer. All PT_LOAD segments with file content
+   are stored at their physical (=load) address. Byte order is taken from the ELF header.
+   For description of ELF file format see https://en.wikipedia.org/wiki/Executable_and_Linkable_Format
+*/
+void convert_elf(char *buf, uint32_t lenBuf, uint32_t *addrStart, uint32_t *numBytes, char *image, uint32_t lenImage) {
+  
+  const uint8_t   *p = (const uint8_t*) buf;
+  uint8_t         bigEndian;
+  uint32_t        phoff, phentsize, phnum, type, offset, paddr, filesz;
+  uint32_t        addrMin, addrMax, i, j, run;
+  
+  // read 16b and 32b values with ELF byte order
+  #define ELF_U16(o)  (bigEndian ? ((p[o]<<8) | p[(o)+1]) : (p[o] | (p[(o)+1]<<8)))
+  #define ELF_U32(o)  (bigEndian ? (((uint32_t)p[o]<<24) | ((uint32_t)p[(o)+1]<<16) | ((uint32_t)p[(o)+2]<<8) | p[(o)+3]) : \
+                                   (p[o] | ((uint32_t)p[(o)+1]<<8) | ((uint32_t)p[(o)+2]<<16) | ((uint32_t)p[(o)+3]<<24)))
+  
+  // check ELF header (magic, 32-bit class, executable)
+  if ((lenBuf < 52) || (p[0] != 0x7F) || (p[1] != 'E') || (p[2] != 'L') || (p[3] != 'F'))
+    Error("ELF file has no valid header");
+  if (p[4] != 1)
+    Error("ELF file is not 32-bit (class %d)", p[4]);
+  bigEndian = (p[5] == 2);
+  phoff     = ELF_U32(28);
+  phentsize = ELF_U16(42);
+  phnum     = ELF_U16(44);
+  if ((phnum == 0) || (phentsize < 32) || ((uint64_t) phoff + (uint64_t) phnum*phentsize > lenBuf))
+    Error("ELF file has no valid program header table");
+  
+  // 2 runs: 1st run check segments and extract min/max addresses, 2nd run store data to image
+  addrMin = 0xFFFFFFFF;
+  addrMax = 0x00000000;
+  for (run=0; run<2; run++) {
+    for (i=0; i<phnum; i++) {
+      
+      // only consider loadable segments with content (skip e.g. .bss)
+      type   = ELF_U32(phoff + i*phentsize);
+      offset = ELF_U32(phoff + i*phentsize + 4);
+      paddr  = ELF_U32(phoff + i*phentsize + 12);
+      filesz = ELF_U32(phoff + i*phentsize + 16);
+      if ((type != 1) || (filesz == 0))
+        continue;
+      
+      // 1st run: check syntax and store min/max address
+      if (run == 0) {
+        if ((uint64_t) offset + filesz > lenBuf)
+          Error("ELF segment %d exceeds file size", (int) i);
+        if ((uint64_t) paddr + filesz - 1 > 0xFFFFFFFF)
+          Error("ELF segment %d exceeds 32-bit address range", (int) i);
+        if (paddr < addrMin)
+          addrMin = paddr;
+        if (paddr+filesz-1 > addrMax)
+          addrMax = paddr+filesz-1;
+      }
+      
+      // 2nd run: copy segment to image
+      else {
+        for (j=0; j<filesz; j++)
+          image[paddr-addrMin+j] = buf[offset+j];
+      }
+      
+    } // loop over segments
+    
+    // after 1st run clear image (gaps are empty)
+    if (run == 0) {
+      *addrStart = addrMin;
+      if ((addrMin != 0xFFFFFFFF) || (addrMax != 0x00000000))
+        *numBytes  = addrMax-addrMin+1;
+      else
+        *numBytes  = 0;
+      if ((uint64_t) addrMax - addrMin + 1 > lenImage)
+        Error("ELF segments span 0x%x-0x%x, exceeds buffer size (%d bytes)", (unsigned) addrMin, (unsigned) addrMax, (int) lenImage);
+      memset(image, 0, *numBytes);
+    }
+    
+  } // loop over runs
+  
+  #undef ELF_U16
+  #undef ELF_U32
+  
+} // convert_elf
+
+  
+
 /**
    \fn void export_s19(char *outfile, char *buf, uint32_t addrStart, uint32_t numBytes)
    
@@ -21,7 +21,7 @@
 char *get_line(char **buf, char *line);
 
 // read hexfile into memory buffer
-void load_hexfile(const char *filename, char *buf, uint32_t bufsize);
+uint32_t load_hexfile(const char *filename, char *buf, uint32_t bufsize);
 
 // read binary file to memory image
 void load_binfile(const char *filename, char *buf, uint32_t *addrStart, uint32_t *numBytes, uint32_t bufsize);
@@ -32,6 +32,9 @@ void convert_s19(char *buf, uint32_t *addrStart, uint32_t *numBytes, char *image
 // convert intel hex format in memory buffer to memory image
 void convert_hex(char *buf, uint32_t *addrStart, uint32_t *numBytes, char *image);
 
+// convert ELF file in memory buffer to memory image
+void convert_elf(char *buf, uint32_t lenBuf, uint32_t *addrStart, uint32_t *numBytes, char *image, uint32_t lenImage);
+
 
 // export RAM image to file in Motorola s19 format
 void export_s19(char *outfile, char *buf, uint32_t addrStart, uint32_t numBytes);
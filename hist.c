@@ -0,0 +1,152 @@
+/**
+  \file hist.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief implementation of latency histograms
+
+  implementation of HDR-style histograms with log-linear buckets
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "hist.h"
+
+
+// number of linear sub-buckets per power of 2
+#define HIST_SUB          (1 << HIST_SUB_BITS)
+
+
+
+/**
+  \fn static uint32_t hist_index(uint32_t value)
+
+  \brief get bucket index of value
+*/
+static uint32_t hist_index(uint32_t value) {
+
+  uint32_t  shift;
+
+  // small values are exact
+  if (value < 2*HIST_SUB)
+    return(value);
+
+  // bucket within power of 2
+  shift = (31 - __builtin_clz(value)) - HIST_SUB_BITS;
+  return(((shift + 1) << HIST_SUB_BITS) + (value >> shift) - HIST_SUB);
+
+} // hist_index
+
+
+
+/**
+  \fn static uint32_t hist_upper(uint32_t idx)
+
+  \brief get largest value of bucket
+*/
+static uint32_t hist_upper(uint32_t idx) {
+
+  uint32_t  shift;
+
+  if (idx < 2*HIST_SUB)
+    return(idx);
+  shift = (idx >> HIST_SUB_BITS) - 1;
+  return((uint32_t) ((((uint64_t) (idx & (HIST_SUB-1)) + HIST_SUB + 1) << shift) - 1));
+
+} // hist_upper
+
+
+
+/**
+  \fn void hist_reset(hist_t *hist)
+
+  \brief clear histogram
+*/
+void hist_reset(hist_t *hist) {
+
+  memset(hist, 0, sizeof(hist_t));
+
+} // hist_reset
+
+
+
+/**
+  \fn void hist_add(hist_t *hist, uint64_t value)
+
+  \brief add value to histogram
+
+  \param[in] hist     histogram
+  \param[in] value    value to add, e.g. latency in us
+*/
+void hist_add(hist_t *hist, uint64_t value) {
+
+  uint32_t  val = (value > UINT32_MAX) ? UINT32_MAX : (uint32_t) value;
+
+  hist->count[hist_index(val)]++;
+  hist->num++;
+  if (val > hist->max)
+    hist->max = val;
+
+} // hist_add
+
+
+
+/**
+  \fn void hist_merge(hist_t *dst, const hist_t *src)
+
+  \brief add all values of src to dst
+*/
+void hist_merge(hist_t *dst, const hist_t *src) {
+
+  uint32_t  i;
+
+  for (i=0; i<HIST_NUM_BUCKETS; i++)
+    dst->count[i] += src->count[i];
+  dst->num += src->num;
+  if (src->max > dst->max)
+    dst->max = src->max;
+
+} // hist_merge
+
+
+
+/**
+  \fn uint32_t hist_percentile(const hist_t *hist, float percentile)
+
+  \brief get value at percentile
+
+  \param[in] hist         histogram
+  \param[in] percentile   percentile [0..100], e.g. 50 for median
+
+  \return upper bound of bucket containing the percentile (max. max value), or 0 if empty
+*/
+uint32_t hist_percentile(const hist_t *hist, float percentile) {
+
+  uint64_t  target, sum = 0;
+  uint32_t  i, val;
+
+  if (hist->num == 0)
+    return(0);
+
+  // number of values at or below percentile (at least 1)
+  target = (uint64_t) ((percentile / 100.0) * hist->num + 0.999);
+  if (target < 1)
+    target = 1;
+
+  for (i=0; i<HIST_NUM_BUCKETS; i++) {
+    sum += hist->count[i];
+    if (sum >= target) {
+      val = hist_upper(i);
+      return((val < hist->max) ? val : hist->max);
+    }
+  }
+  return(hist->max);
+
+} // hist_percentile
+
+// end of file
@@ -0,0 +1,54 @@
+/**
+  \file hist.h
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief declaration of latency histograms
+
+  declaration of HDR-style histograms with log-linear buckets: values below
+  32 are stored exactly, above each power of 2 is split into 16 buckets
+  (max. error 6.25%). Recording is a few integer operations without memory
+  allocation, so it can be used in the protocol hot path.
+*/
+
+// for including file only once
+#ifndef _HIST_H_
+#define _HIST_H_
+
+
+// include files
+#include <stdint.h>
+
+
+/// number of linear sub-buckets per power of 2 (as bits)
+#define HIST_SUB_BITS     4
+
+/// number of buckets for values up to 2^32-1
+#define HIST_NUM_BUCKETS  ((32 - HIST_SUB_BITS + 1) << HIST_SUB_BITS)
+
+
+/// histogram of values, e.g. latency in us
+typedef struct {
+  uint32_t        count[HIST_NUM_BUCKETS];  ///< number of values per bucket
+  uint32_t        num;                      ///< total number of values
+  uint32_t        max;                      ///< max. value
+} hist_t;
+
+
+/// clear histogram
+void        hist_reset(hist_t *hist);
+
+/// add value (clipped to 2^32-1)
+void        hist_add(hist_t *hist, uint64_t value);
+
+/// add all values of another histogram
+void        hist_merge(hist_t *dst, const hist_t *src);
+
+/// get value at percentile [0..100] (upper bound of bucket). Returns 0 if empty
+uint32_t    hist_percentile(const hist_t *hist, float percentile);
+
+#endif // _HIST_H_
+
+// end of file
@@ -0,0 +1,763 @@
+/**
+  \file image.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief implementation of prepared memory image routines
+
+  implementation of routines for loading a firmware file (s19, hex, ELF or binary)
+  into a decoded, validated and pre-framed memory image. Preparing an image once
+  moves the parsing and framing cost off the programming line. The current image
+  is shared between threads via a reference counted pointer, which is swapped
+  atomically by image_publish(). Merged images consist of several address
+  ranges, only these are framed and verified.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include "image.h"
+#include "hexfile.h"
+#include "misc.h"
+#include "globals.h"
+
+
+// max. size of file and image buffers
+#define  BUFSIZE  10000000
+
+
+// current image and lock for swapping it
+static image_t    *s_current = NULL;
+static char       s_lock = 0;
+
+// WRITE frame size for new images (see image_setFrameSize())
+static uint16_t   s_frameSize = IMAGE_FRAMESIZE;
+
+// lock/unlock access to current image pointer (only held for pointer swap -> spinlock)
+#define IMAGE_LOCK    while (__atomic_test_and_set(&s_lock, __ATOMIC_ACQUIRE))
+#define IMAGE_UNLOCK  __atomic_clear(&s_lock, __ATOMIC_RELEASE)
+
+
+
+/**
+  \fn static void image_frame(image_t *image)
+
+  \brief calculate identifier and pre-build BSL WRITE frames of image
+
+  \param[in,out] image   image with valid data, addrStart and numBytes
+
+  calculate CRC32 of image and pre-build the BSL WRITE frames for all non-empty
+  blocks of image->frameSize (default 128B). Empty (=all zero) blocks are
+  skipped like in bsl_memWrite(). Frames don't extend beyond an address range
+  of a merged image
+*/
+static void image_frame(image_t *image) {
+
+  uint32_t          addr, idx, len, end, i;
+  uint32_t          size = image->frameSize;
+  uint8_t           chk, flagEmpty;
+  image_frame_t     *frame;
+
+  // calculate image identifier
+  image->crc = crc32(0, image->data, image->numBytes);
+
+
+  // count non-empty frames and allocate frame buffer
+  image->numFrames = 0;
+  for (idx=0; (end = image_range(image, &idx)) > 0; ) {
+    for (end+=idx; idx<end; idx+=len) {
+      len = end - idx;
+      if (len > size)
+        len = size;
+      for (i=0; i<len; i++) {
+        if (image->data[idx+i]) {
+          image->numFrames++;
+          break;
+        }
+      }
+    }
+  }
+  image->frames = (image_frame_t*) malloc((image->numFrames+1) * sizeof(image_frame_t));
+  if (!image->frames)
+    Error("cannot allocate memory buffers");
+
+
+  // pre-build WRITE frames (number of bytes-1 + data + XOR checksum)
+  frame = image->frames;
+  for (idx=0; (end = image_range(image, &idx)) > 0; ) {
+    for (end+=idx; idx<end; idx+=len) {
+
+      // if addr too close to end of range reduce framesize
+      addr = image->addrStart + idx;
+      len  = end - idx;
+      if (len > size)
+        len = size;
+
+      // check if block contains data. If not, skip complete block
+      flagEmpty = 1;
+      for (i=0; i<len; i++) {
+        if (image->data[idx+i]) {
+          flagEmpty = 0;
+          break;
+        }
+      }
+      if (flagEmpty)
+        continue;
+
+      // construct frame
+      frame->addr  = addr;
+      frame->lenTx = 0;
+      frame->Tx[frame->lenTx++] = len-1;     // -1 from BSL
+      chk = len-1;
+      for (i=0; i<len; i++) {
+        frame->Tx[frame->lenTx++] = image->data[idx+i];
+        chk ^= image->data[idx+i];
+      }
+      frame->Tx[frame->lenTx++] = chk;
+      frame++;
+
+    } // loop over range
+  } // loop over address ranges
+
+} // image_frame
+
+
+
+/**
+  \fn static uint8_t image_decode(const char *filename, const char *shortname, char *fileBuf, char *data, char *dataFF, uint32_t *addrStart, uint32_t *numBytes, uint8_t verbose)
+
+  \brief load and convert file depending on file extension
+
+  \param[in]  filename   name of file to load (*.s19, *.hex, *.ihx, *.elf, else binary)
+  \param[in]  shortname  name of file without path (for output)
+  \param[in]  fileBuf    buffer for file content [BUFSIZE]
+  \param[out] data       memory content [BUFSIZE], initialized with 0x00 by caller
+  \param[out] dataFF     optional 2nd conversion [BUFSIZE] initialized with 0xFF by caller, or NULL.
+                          Bytes contained in the file have the same value in data and dataFF
+  \param[out] addrStart  first address of image
+  \param[out] numBytes   size of image [B]
+  \param[in]  verbose    print output to console?
+
+  \return 1 for binary file, else 0
+*/
+static uint8_t image_decode(const char *filename, const char *shortname, char *fileBuf, char *data, char *dataFF, uint32_t *addrStart, uint32_t *numBytes, uint8_t verbose) {
+
+  const char  *dot;
+  uint32_t    lenFile;
+
+  dot = strrchr(filename, '.');
+  if (dot && !strcmp(dot, ".s19")) {
+    if (verbose)
+      printf("  load Motorola S-record file '%s' ... ", shortname);
+    load_hexfile(filename, fileBuf, BUFSIZE);
+    convert_s19(fileBuf, addrStart, numBytes, data);
+    if (dataFF)
+      convert_s19(fileBuf, addrStart, numBytes, dataFF);
+  }
+  else if (dot && (!strcmp(dot, ".hex") || !strcmp(dot, ".ihx"))) {
+    if (verbose)
+      printf("  load Intel hex file '%s' ... ", shortname);
+    load_hexfile(filename, fileBuf, BUFSIZE);
+    convert_hex(fileBuf, addrStart, numBytes, data);
+    if (dataFF)
+      convert_hex(fileBuf, addrStart, numBytes, dataFF);
+  }
+  else if (dot && !strcmp(dot, ".elf")) {
+    if (verbose)
+      printf("  load ELF file '%s' ... ", shortname);
+    lenFile = load_hexfile(filename, fileBuf, BUFSIZE);
+    convert_elf(fileBuf, lenFile, addrStart, numBytes, data, BUFSIZE);
+    if (dataFF)
+      convert_elf(fileBuf, lenFile, addrStart, numBytes, dataFF, BUFSIZE);
+  }
+  else {
+    if (verbose)
+      printf("  load binary file '%s' ... ", shortname);
+    load_binfile(filename, data, addrStart, numBytes, BUFSIZE);
+    if (dataFF)
+      memcpy(dataFF, data, *numBytes);
+    return(1);
+  }
+
+  return(0);
+
+} // image_decode
+
+
+
+/**
+  \fn image_t *image_load(const char *filename, uint8_t verbose)
+
+  \brief load file and convert to prepared image
+
+  \param[in] filename   name of file to load (*.s19, *.hex, *.ihx, *.elf, else binary)
+  \param[in] verbose    print output to console?
+
+  \return prepared image with reference count 1, or NULL on error (see below)
+
+  load and decode firmware file depending on file extension, and pre-build the
+  BSL WRITE frames for all non-empty 128B blocks. Empty (=all zero) blocks are
+  skipped like in bsl_memWrite().
+  On error the application terminates, unless the calling thread registered a
+  recovery point via setExitHandler(). In that case all buffers are released
+  and NULL is returned, e.g. to skip a corrupt file in watch mode.
+*/
+image_t *image_load(const char *filename, uint8_t verbose) {
+
+  char              * volatile fileBuf = NULL;    // buffer for file content
+  image_t           * volatile image = NULL;      // resulting image
+  const char        *shortname;
+  jmp_buf           env, *prev;
+  struct stat       st;
+
+
+  // if caller wants to recover from errors, catch them here to release buffers
+  prev = setExitHandler(NULL);
+  if (prev != NULL) {
+    if (setjmp(env)) {
+      setExitHandler(prev);
+      free(fileBuf);
+      if (image) {
+        free(image->data);
+        free(image->frames);
+        free(image);
+      }
+      return(NULL);
+    }
+    setExitHandler(&env);
+  }
+
+  // allocate buffers (image is shrunk to actual size later)
+  image   = (image_t*) calloc(1, sizeof(image_t));
+  fileBuf = (char*) malloc(BUFSIZE);
+  if ((!image) || (!fileBuf))
+    Error("cannot allocate memory buffers");
+  image->data = (char*) calloc(BUFSIZE, 1);
+  if (!image->data)
+    Error("cannot allocate memory buffers");
+  strncpy(image->name, filename, sizeof(image->name)-1);
+  if (stat(filename, &st) == 0)
+    image->mtime = st.st_mtime;
+
+  // strip path for output
+  shortname = strrchr(filename, '/');
+  if (!shortname)
+    shortname = filename;
+  else
+    shortname++;
+
+  // convert to memory image, depending on file type
+  image_decode(filename, shortname, fileBuf, image->data, NULL, &(image->addrStart), &(image->numBytes), verbose);
+  free(fileBuf);
+  fileBuf = NULL;
+
+  // validate image (STM8 address space is 24bit)
+  if (image->numBytes > BUFSIZE)
+    Error("image in '%s' exceeds buffer size", shortname);
+  if ((image->numBytes > 0) && (image->addrStart + image->numBytes - 1 > 0xFFFFFF))
+    Error("image in '%s' exceeds 24bit address range", shortname);
+
+  // shrink image buffer to actual size
+  image->data = (char*) realloc(image->data, image->numBytes + 1);
+
+  // calculate identifier and pre-build frames
+  image->frameSize = s_frameSize;
+  image_frame(image);
+
+  // restore caller's recovery point
+  if (prev != NULL)
+    setExitHandler(prev);
+
+  // print message
+  if (verbose) {
+    printf("  prepared %d frames (CRC32 0x%08x)\n", (int) image->numFrames, image->crc);
+    fflush(stdout);
+  }
+
+  // return prepared image
+  image->refCount = 1;
+  return(image);
+
+} // image_load
+
+
+
+/**
+  \fn image_t *image_merge(uint8_t numFiles, char *filenames[], uint8_t verbose)
+
+  \brief load several files and merge them into one prepared image
+
+  \param[in] numFiles    number of files (1..IMAGE_MERGE_MAX)
+  \param[in] filenames   names of files to load. For binary files an optional suffix '@addr' (hex) overrides the start address
+  \param[in] verbose     print output to console?
+
+  \return prepared image with reference count 1
+
+  load all files and merge them into one image, which is uploaded in a single
+  session. Each file becomes an address range (segment) of the image, bytes
+  between the files are neither written nor verified. Overlapping files are
+  allowed if the common bytes are identical, otherwise the conflicting addresses
+  are listed and the flasher exits before connecting to the target. Bytes are
+  considered as defined if the file contains them (s19 and hex records, complete
+  binary, ELF segments incl. gaps). Files are decoded one after the other into a
+  shared buffer, and only their address range and defined bytes are kept, which
+  limits memory e.g. on a Raspberry Pi Zero. A single file without suffix is
+  loaded via image_load()
+*/
+image_t *image_merge(uint8_t numFiles, char *filenames[], uint8_t verbose) {
+
+  char              *fileBuf, *data, *dataFF, *bytes[IMAGE_MERGE_MAX], *end;
+  char              path[1000];
+  const char        *shortname, *at;
+  uint32_t          addrStart[IMAGE_MERGE_MAX], numBytes[IMAGE_MERGE_MAX], addr, addrMin, addrMax, idx, j;
+  uint32_t          numConflicts = 0;
+  uint8_t           *owner, *defined[IMAGE_MERGE_MAX], i, k, isBinary;
+  image_segment_t   tmp;
+  image_t           *image;
+  struct stat       st;
+
+  // check number of files
+  if ((numFiles < 1) || (numFiles > IMAGE_MERGE_MAX))
+    Error("can only merge 1..%d files", (int) IMAGE_MERGE_MAX);
+
+  // single file without address override -> same as image_load()
+  if ((numFiles == 1) && (!strchr(filenames[0], '@')))
+    return(image_load(filenames[0], verbose));
+
+  // allocate buffers. Decode buffers are shared by all files: data with 0x00 and dataFF with 0xFF background
+  image   = (image_t*) calloc(1, sizeof(image_t));
+  fileBuf = (char*) malloc(BUFSIZE);
+  data    = (char*) calloc(BUFSIZE, 1);
+  dataFF  = (char*) malloc(BUFSIZE);
+  if ((!image) || (!fileBuf) || (!data) || (!dataFF))
+    Error("cannot allocate memory buffers");
+  memset(dataFF, 0xFF, BUFSIZE);
+
+
+  // load all files and keep their address range
+  addrMin = 0xFFFFFFFF;
+  addrMax = 0x00000000;
+  for (i=0; i<numFiles; i++) {
+
+    // split optional address override 'name@addr'
+    strncpy(path, filenames[i], sizeof(path)-1);
+    path[sizeof(path)-1] = '\0';
+    addr = 0xFFFFFFFF;
+    at = strrchr(path, '@');
+    if (at) {
+      addr = strtoul(at+1, &end, 16);
+      if ((at[1] == '\0') || (*end != '\0'))
+        Error("invalid address in '%s'", filenames[i]);
+      path[at-path] = '\0';
+    }
+
+    // strip path for output
+    shortname = strrchr(path, '/');
+    if (!shortname)
+      shortname = path;
+    else
+      shortname++;
+
+    // decode file twice with different background -> defined bytes are identical in both buffers
+    isBinary = image_decode(path, shortname, fileBuf, data, dataFF, &(addrStart[i]), &(numBytes[i]), verbose);
+    if (addr != 0xFFFFFFFF) {
+      if (!isBinary)
+        Error("address override only supported for binary files ('%s')", filenames[i]);
+      addrStart[i] = addr;
+    }
+
+    // validate image (STM8 address space is 24bit)
+    if (numBytes[i] > BUFSIZE)
+      Error("image in '%s' exceeds buffer size", shortname);
+    if ((numBytes[i] > 0) && (addrStart[i] + numBytes[i] - 1 > 0xFFFFFF))
+      Error("image in '%s' exceeds 24bit address range", shortname);
+
+    // keep content and bitmap of defined bytes, and restore background of decode buffers for next file
+    bytes[i]   = (char*) malloc(numBytes[i] + 1);
+    defined[i] = (uint8_t*) calloc(numBytes[i] / 8 + 1, 1);
+    if ((!bytes[i]) || (!defined[i]))
+      Error("cannot allocate memory buffers");
+    memcpy(bytes[i], data, numBytes[i]);
+    for (j=0; j<numBytes[i]; j++)
+      if (data[j] == dataFF[j])
+        defined[i][j >> 3] |= (uint8_t) (1 << (j & 7));
+    memset(data, 0x00, numBytes[i]);
+    memset(dataFF, 0xFF, numBytes[i]);
+
+    // update total range, name and time stamp
+    if (numBytes[i] > 0) {
+      if (addrStart[i] < addrMin)
+        addrMin = addrStart[i];
+      if (addrStart[i] + numBytes[i] > addrMax)
+        addrMax = addrStart[i] + numBytes[i];
+    }
+    if (i > 0)
+      strncat(image->name, "+", sizeof(image->name) - strlen(image->name) - 1);
+    strncat(image->name, filenames[i], sizeof(image->name) - strlen(image->name) - 1);
+    if ((stat(path, &st) == 0) && (st.st_mtime > image->mtime))
+      image->mtime = st.st_mtime;
+
+  } // loop over files
+  free(fileBuf);
+  free(data);
+  free(dataFF);
+  if (addrMin > addrMax)
+    addrMin = addrMax = 0;
+
+
+  // merge files into common buffer and check overlaps. owner = 1 + index of file which defined a byte
+  image->addrStart = addrMin;
+  image->numBytes  = addrMax - addrMin;
+  image->data = (char*) calloc(image->numBytes + 1, 1);
+  owner = (uint8_t*) calloc(image->numBytes + 1, 1);
+  if ((!image->data) || (!owner))
+    Error("cannot allocate memory buffers");
+  for (i=0; i<numFiles; i++) {
+    for (j=0; j<numBytes[i]; j++) {
+      if (!(defined[i][j >> 3] & (1 << (j & 7))))
+        continue;
+      idx = addrStart[i] - addrMin + j;
+      if ((owner[idx]) && (image->data[idx] != bytes[i][j])) {
+        if (numConflicts < 10) {
+          setConsoleColor(PRM_COLOR_RED);
+          fprintf(stderr, "  conflict at 0x%04x: '%s'=0x%02x, '%s'=0x%02x\n", (int) (addrMin + idx),
+            filenames[owner[idx]-1], (int) (image->data[idx] & 0xFF), filenames[i], (int) (bytes[i][j] & 0xFF));
+          setConsoleColor(PRM_COLOR_DEFAULT);
+        }
+        numConflicts++;
+        continue;
+      }
+      image->data[idx] = bytes[i][j];
+      owner[idx] = i+1;
+    }
+    free(bytes[i]);
+    free(defined[i]);
+  }
+  free(owner);
+  if (numConflicts > 0)
+    Error("%d conflicting bytes in overlapping files", (int) numConflicts);
+
+
+  // address ranges of files, sorted by address and joined if overlapping or adjacent
+  image->segments = (image_segment_t*) malloc(numFiles * sizeof(image_segment_t));
+  if (!image->segments)
+    Error("cannot allocate memory buffers");
+  for (i=0; i<numFiles; i++) {
+    if (numBytes[i] == 0)
+      continue;
+    tmp.addrStart = addrStart[i];
+    tmp.numBytes  = numBytes[i];
+    for (k=image->numSegments; (k > 0) && (image->segments[k-1].addrStart > tmp.addrStart); k--)
+      image->segments[k] = image->segments[k-1];
+    image->segments[k] = tmp;
+    image->numSegments++;
+  }
+  for (k=1; k<image->numSegments; ) {
+    if (image->segments[k].addrStart <= image->segments[k-1].addrStart + image->segments[k-1].numBytes) {
+      addr = image->segments[k].addrStart + image->segments[k].numBytes;
+      if (addr > image->segments[k-1].addrStart + image->segments[k-1].numBytes)
+        image->segments[k-1].numBytes = addr - image->segments[k-1].addrStart;
+      memmove(&(image->segments[k]), &(image->segments[k+1]), (image->numSegments-k-1) * sizeof(image_segment_t));
+      image->numSegments--;
+    }
+    else
+      k++;
+  }
+
+  // calculate identifier and pre-build frames
+  image->frameSize = s_frameSize;
+  image_frame(image);
+
+  // print message
+  if (verbose) {
+    printf("  merged %d files into %d ranges (%dB), prepared %d frames (CRC32 0x%08x)\n", (int) numFiles,
+      (int) image->numSegments, (int) image_dataBytes(image), (int) image->numFrames, image->crc);
+    fflush(stdout);
+  }
+
+  // return prepared image
+  image->refCount = 1;
+  return(image);
+
+} // image_merge
+
+
+
+/**
+  \fn uint32_t image_range(const image_t *image, uint32_t *idx)
+
+  \brief get next address range of image
+
+  \param[in]     image    prepared image
+  \param[in,out] idx      offset in image->data. Is moved to start of next range if between ranges
+
+  \return number of bytes from idx to end of range (0=no more data)
+
+  iterate over the address ranges of a (merged) image, e.g.
+    for (idx=0; (len=image_range(image, &idx))>0; idx+=len) { ... }
+  An image without segments is a single range
+*/
+uint32_t image_range(const image_t *image, uint32_t *idx) {
+
+  uint32_t  start, end;
+  uint16_t  i;
+
+  // single range
+  if (image->numSegments == 0)
+    return((*idx < image->numBytes) ? (image->numBytes - *idx) : 0);
+
+  // find segment containing or following idx
+  for (i=0; i<image->numSegments; i++) {
+    start = image->segments[i].addrStart - image->addrStart;
+    end   = start + image->segments[i].numBytes;
+    if (*idx < end) {
+      if (*idx < start)
+        *idx = start;
+      return(end - *idx);
+    }
+  }
+  return(0);
+
+} // image_range
+
+
+
+/**
+  \fn uint32_t image_dataBytes(const image_t *image)
+
+  \brief number of bytes in all address ranges of image
+
+  \param[in] image    prepared image
+
+  \return number of bytes which are written and verified
+*/
+uint32_t image_dataBytes(const image_t *image) {
+
+  uint32_t  num = 0;
+  uint16_t  i;
+
+  if (image->numSegments == 0)
+    return(image->numBytes);
+  for (i=0; i<image->numSegments; i++)
+    num += image->segments[i].numBytes;
+  return(num);
+
+} // image_dataBytes
+
+
+
+/**
+  \fn image_t *image_create(const char *name, uint32_t addrStart, uint32_t numBytes, const char *data)
+
+  \brief create prepared image from memory content
+
+  \param[in] name        name of image (for output)
+  \param[in] addrStart   first address of image
+  \param[in] numBytes    size of image [B]
+  \param[in] data        memory content [numBytes]
+
+  \return prepared image with reference count 1
+
+  create prepared image from already decoded data, e.g. the RAM routines
+  compiled into the flasher. The data is copied
+*/
+image_t *image_create(const char *name, uint32_t addrStart, uint32_t numBytes, const char *data) {
+
+  image_t   *image;
+
+  // allocate buffers
+  image = (image_t*) calloc(1, sizeof(image_t));
+  if (!image)
+    Error("cannot allocate memory buffers");
+  image->data = (char*) malloc(numBytes + 1);
+  if (!image->data)
+    Error("cannot allocate memory buffers");
+
+  // copy content and prepare frames
+  strncpy(image->name, name, sizeof(image->name)-1);
+  image->addrStart = addrStart;
+  image->numBytes  = numBytes;
+  memcpy(image->data, data, numBytes);
+  image->frameSize = s_frameSize;
+  image_frame(image);
+
+  image->refCount = 1;
+  return(image);
+
+} // image_create
+
+
+
+/**
+  \fn image_t *image_patch(const image_t *image, uint32_t addr, uint32_t numBytes, const char *data)
+
+  \brief create copy of image with some bytes replaced
+
+  \param[in] image       prepared image
+  \param[in] addr        first address to replace (must be inside image)
+  \param[in] numBytes    number of bytes to replace
+  \param[in] data        new content [numBytes]
+
+  \return prepared copy with reference count 1
+
+  e.g. for a per-board serial number. The copy is re-framed completely,
+  which is cheap compared to the upload
+*/
+image_t *image_patch(const image_t *image, uint32_t addr, uint32_t numBytes, const char *data) {
+
+  image_t   *copy;
+
+  if ((addr < image->addrStart) || (addr + numBytes > image->addrStart + image->numBytes))
+    Error("patch address 0x%04x outside of image '%s'", (int) addr, image->name);
+  copy = (image_t*) calloc(1, sizeof(image_t));
+  if (!copy)
+    Error("cannot allocate memory buffers");
+  *copy = *image;
+  copy->data = (char*) malloc(image->numBytes + 1);
+  if (!copy->data)
+    Error("cannot allocate memory buffers");
+  memcpy(copy->data, image->data, image->numBytes);
+  memcpy(copy->data + (addr - image->addrStart), data, numBytes);
+  if (image->numSegments > 0) {
+    copy->segments = (image_segment_t*) malloc(image->numSegments * sizeof(image_segment_t));
+    if (!copy->segments)
+      Error("cannot allocate memory buffers");
+    memcpy(copy->segments, image->segments, image->numSegments * sizeof(image_segment_t));
+  }
+  image_frame(copy);
+
+  copy->refCount = 1;
+  return(copy);
+
+} // image_patch
+
+
+
+/**
+  \fn void image_setFrameSize(uint16_t frameSize)
+
+  \brief set WRITE frame size for images prepared later
+
+  \param[in] frameSize   max. number of data bytes per WRITE frame (clipped to 1..IMAGE_FRAMESIZE)
+
+  smaller frames reduce the data lost on a bad link, see the port profiles in tune.c
+*/
+void image_setFrameSize(uint16_t frameSize) {
+
+  if (frameSize < 1)
+    frameSize = 1;
+  if (frameSize > IMAGE_FRAMESIZE)
+    frameSize = IMAGE_FRAMESIZE;
+  s_frameSize = frameSize;
+
+} // image_setFrameSize
+
+
+
+/**
+  \fn void image_reframe(image_t *image, uint16_t frameSize)
+
+  \brief re-build WRITE frames of image with another frame size
+
+  \param[in,out] image     prepared image, which is currently not in use
+  \param[in]     frameSize max. number of data bytes per WRITE frame (clipped to 1..IMAGE_FRAMESIZE)
+*/
+void image_reframe(image_t *image, uint16_t frameSize) {
+
+  if (frameSize < 1)
+    frameSize = 1;
+  if (frameSize > IMAGE_FRAMESIZE)
+    frameSize = IMAGE_FRAMESIZE;
+  if (frameSize == image->frameSize)
+    return;
+  free(image->frames);
+  image->frameSize = frameSize;
+  image_frame(image);
+
+} // image_reframe
+
+
+
+/**
+  \fn void image_release(image_t *image)
+
+  \brief release image
+
+  \param[in] image    image to release (may be NULL)
+
+  decrease reference count of image and free memory if no longer used
+*/
+void image_release(image_t *image) {
+
+  if (!image)
+    return;
+
+  // free image after last user released it
+  if (__atomic_sub_fetch(&(image->refCount), 1, __ATOMIC_ACQ_REL) == 0) {
+    free(image->data);
+    free(image->segments);
+    free(image->frames);
+    free(image);
+  }
+
+} // image_release
+
+
+
+/**
+  \fn void image_publish(image_t *image)
+
+  \brief atomically replace current image
+
+  \param[in] image    new current image. The caller's reference is passed on
+
+  replace the image returned by image_acquire(). Users of the previous image
+  keep a valid copy until they call image_release()
+*/
+void image_publish(image_t *image) {
+
+  image_t   *old;
+
+  // swap pointer
+  IMAGE_LOCK;
+  old = s_current;
+  s_current = image;
+  IMAGE_UNLOCK;
+
+  // release reference held by image module
+  image_release(old);
+
+} // image_publish
+
+
+
+/**
+  \fn image_t *image_acquire(void)
+
+  \brief get current image
+
+  \return current image with increased reference count, or NULL if none published
+
+  get current image for use in a session. The image stays valid until the caller
+  releases it via image_release(), even if a new image is published meanwhile
+*/
+image_t *image_acquire(void) {
+
+  image_t   *image;
+
+  IMAGE_LOCK;
+  image = s_current;
+  if (image)
+    __atomic_add_fetch(&(image->refCount), 1, __ATOMIC_ACQ_REL);
+  IMAGE_UNLOCK;
+
+  return(image);
+
+} // image_acquire
+
+// end of file
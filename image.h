@@ -0,0 +1,100 @@
+/**
+  \file image.h
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief declaration of prepared memory image routines
+
+  declaration of routines for loading a firmware file (s19, hex, ELF or binary)
+  into a decoded, validated and pre-framed memory image, and for sharing the
+  current image between threads (e.g. watcher and station loop). Several files
+  can be merged into one image with separate address ranges (segments).
+*/
+
+// for including file only once
+#ifndef _IMAGE_H_
+#define _IMAGE_H_
+
+
+// include files
+#include <stdint.h>
+#include <time.h>
+
+
+/// max. number of data bytes in BSL WRITE frame
+#define IMAGE_FRAMESIZE   128
+
+/// max. number of files merged into one image
+#define IMAGE_MERGE_MAX   8
+
+
+/// pre-built BSL WRITE frame (N-1, data, XOR checksum), ready to send
+typedef struct {
+  uint32_t  addr;                           ///< target address of frame
+  uint16_t  lenTx;                          ///< number of bytes in Tx (N+2)
+  char      Tx[IMAGE_FRAMESIZE+2];          ///< frame content
+} image_frame_t;
+
+
+/// address range of merged image, which is written and verified
+typedef struct {
+  uint32_t  addrStart;                      ///< first address of segment
+  uint32_t  numBytes;                       ///< size of segment [B]
+} image_segment_t;
+
+
+/// decoded and pre-framed memory image
+typedef struct {
+  char            name[1000];               ///< name of source file
+  time_t          mtime;                    ///< modification time of source file
+  uint32_t        addrStart;                ///< first address of image
+  uint32_t        numBytes;                 ///< size of image [B]
+  char            *data;                    ///< memory content [numBytes]
+  uint16_t        numSegments;              ///< number of address ranges (0=complete image, see image_range())
+  image_segment_t *segments;                ///< address ranges of merged image, sorted [numSegments]
+  uint32_t        crc;                      ///< CRC32 over image content
+  uint16_t        frameSize;                ///< max. number of data bytes per WRITE frame
+  uint32_t        numFrames;                ///< number of non-empty WRITE frames
+  image_frame_t   *frames;                  ///< pre-built WRITE frames [numFrames]
+  int             refCount;                 ///< number of users (see image_acquire())
+} image_t;
+
+
+/// load file and convert to prepared image. Returns NULL on error if recoverable (see setExitHandler())
+image_t   *image_load(const char *filename, uint8_t verbose);
+
+/// load and merge files (name[@addr] overrides address of binaries). Exits on conflicting overlaps
+image_t   *image_merge(uint8_t numFiles, char *filenames[], uint8_t verbose);
+
+/// get next address range of image at or after offset idx (updated). Returns number of bytes (0=done)
+uint32_t  image_range(const image_t *image, uint32_t *idx);
+
+/// number of bytes in all address ranges of image
+uint32_t  image_dataBytes(const image_t *image);
+
+/// create prepared image from decoded memory content (data is copied)
+image_t   *image_create(const char *name, uint32_t addrStart, uint32_t numBytes, const char *data);
+
+/// create copy of image with some bytes replaced, e.g. a serial number. Returns image with reference count 1
+image_t   *image_patch(const image_t *image, uint32_t addr, uint32_t numBytes, const char *data);
+
+/// set max. number of data bytes per WRITE frame for images prepared later (1..IMAGE_FRAMESIZE)
+void      image_setFrameSize(uint16_t frameSize);
+
+/// re-build WRITE frames of image with another frame size (image must not be in use)
+void      image_reframe(image_t *image, uint16_t frameSize);
+
+/// release image, free if no longer used
+void      image_release(image_t *image);
+
+/// atomically replace current image. Reference is passed to image module
+void      image_publish(image_t *image);
+
+/// get current image with increased reference count (or NULL). Call image_release() when done
+image_t   *image_acquire(void);
+
+#endif // _IMAGE_H_
+
+// end of file
@@ -0,0 +1,192 @@
+/**
+  \file linkmon.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief implementation of link quality monitor
+
+  implementation of a sliding window error tracker, which proposes baudrate
+  steps along the standard rates
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "linkmon.h"
+
+
+// standard baudrates for stepping down or up
+static const uint32_t s_baud[] = { 4800, 9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600 };
+#define NUM_BAUD  (sizeof(s_baud)/sizeof(s_baud[0]))
+
+
+
+/**
+  \fn static uint32_t baud_lower(uint32_t baud)
+
+  \brief next lower standard baudrate, or 0 if none
+*/
+static uint32_t baud_lower(uint32_t baud) {
+
+  int   i;
+
+  for (i=NUM_BAUD-1; i>=0; i--)
+    if (s_baud[i] < baud)
+      return(s_baud[i]);
+  return(0);
+
+} // baud_lower
+
+
+
+/**
+  \fn static uint32_t baud_higher(uint32_t baud, uint32_t baudMax)
+
+  \brief next higher standard baudrate, max. baudMax
+*/
+static uint32_t baud_higher(uint32_t baud, uint32_t baudMax) {
+
+  uint32_t  i;
+
+  for (i=0; i<NUM_BAUD; i++)
+    if ((s_baud[i] > baud) && (s_baud[i] < baudMax))
+      return(s_baud[i]);
+  return(baudMax);
+
+} // baud_higher
+
+
+
+/**
+  \fn void linkmon_init(linkmon_t *lm, uint32_t baud)
+
+  \brief init monitor
+
+  \param[out] lm      link monitor
+  \param[in]  baud    configured baudrate (start value and upper limit)
+*/
+void linkmon_init(linkmon_t *lm, uint32_t baud) {
+
+  memset(lm, 0, sizeof(linkmon_t));
+  lm->baud    = baud;
+  lm->baudMax = baud;
+  lm->cleanUp = LINK_CLEAN_UP;
+
+} // linkmon_init
+
+
+
+/**
+  \fn void linkmon_resume(linkmon_t *lm, const linkmon_t *prev)
+
+  \brief start new session with adaptation state of previous session
+
+  \param[out] lm      link monitor of new session
+  \param[in]  prev    link monitor of previous session on same port
+
+  keep baudrate and error-free run of the previous board on the same fixture,
+  but clear the statistics
+*/
+void linkmon_resume(linkmon_t *lm, const linkmon_t *prev) {
+
+  linkmon_init(lm, prev->baudMax);
+  lm->baud     = prev->baud;
+  lm->history  = prev->history;
+  lm->clean    = prev->clean;
+  lm->cleanUp  = prev->cleanUp;
+  lm->probing  = prev->probing;
+
+} // linkmon_resume
+
+
+
+/**
+  \fn uint8_t linkmon_errors(const linkmon_t *lm)
+
+  \brief number of errors in sliding window
+*/
+uint8_t linkmon_errors(const linkmon_t *lm) {
+
+  uint32_t  mask = (LINK_WINDOW >= 32) ? 0xFFFFFFFF : ((1UL << LINK_WINDOW) - 1);
+
+  return((uint8_t) __builtin_popcount(lm->history & mask));
+
+} // linkmon_errors
+
+
+
+/**
+  \fn uint8_t linkmon_event(linkmon_t *lm, uint8_t event)
+
+  \brief track result of BSL command
+
+  \param[in] lm       link monitor
+  \param[in] event    result of command (LINK_EVENT_*)
+
+  \return proposed action (LINK_*). Call linkmon_apply() if the action is performed
+*/
+uint8_t linkmon_event(linkmon_t *lm, uint8_t event) {
+
+  lm->numCmd++;
+
+  // successful command. Step up after long error-free run
+  if (event == LINK_EVENT_OK) {
+    lm->history <<= 1;
+    lm->clean++;
+    if ((lm->probing) && (lm->clean >= LINK_WINDOW))
+      lm->probing = 0;                        // higher baudrate confirmed
+    if ((lm->clean >= lm->cleanUp) && (lm->baud < lm->baudMax))
+      return(LINK_UP);
+    return(LINK_KEEP);
+  }
+
+  // failed command. Step down if window contains too many errors
+  lm->history = (lm->history << 1) | 1;
+  lm->clean   = 0;
+  if (event == LINK_EVENT_TIMEOUT)
+    lm->numTimeout++;
+  else if (event == LINK_EVENT_NACK)
+    lm->numNack++;
+  else
+    lm->numCorrupt++;
+  if ((linkmon_errors(lm) >= LINK_MAX_ERRORS) && (baud_lower(lm->baud) > 0))
+    return(LINK_DOWN);
+  return(LINK_RETRY);
+
+} // linkmon_event
+
+
+
+/**
+  \fn void linkmon_apply(linkmon_t *lm, uint8_t action)
+
+  \brief apply proposed action
+
+  \param[in] lm       link monitor
+  \param[in] action   action returned by linkmon_event()
+*/
+void linkmon_apply(linkmon_t *lm, uint8_t action) {
+
+  if (action == LINK_DOWN) {
+    if (lm->probing)                          // step up failed -> wait longer for next try
+      lm->cleanUp *= 2;
+    lm->probing = 0;
+    lm->baud    = baud_lower(lm->baud);
+    lm->history = 0;
+    lm->numDown++;
+  }
+  else if (action == LINK_UP) {
+    lm->probing = 1;
+    lm->baud    = baud_higher(lm->baud, lm->baudMax);
+    lm->history = 0;
+    lm->clean   = 0;
+    lm->numUp++;
+  }
+
+} // linkmon_apply
+
+// end of file
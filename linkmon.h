@@ -0,0 +1,92 @@
+/**
+  \file linkmon.h
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief declaration of link quality monitor
+
+  declaration of a link quality monitor for BSL sessions. The result of each
+  BSL command (ok, timeout, NACK, corrupted response) is tracked in a sliding
+  window. If too many commands in the window failed, the monitor proposes a
+  lower baudrate. After a long error-free run it proposes the next higher
+  baudrate up to the configured one. A failed step up doubles the required
+  error-free run, so a marginal link doesn't oscillate. The monitor has no
+  I/O, the session performs the renegotiation (see bsl_sm.c).
+*/
+
+// for including file only once
+#ifndef _LINKMON_H_
+#define _LINKMON_H_
+
+
+// include files
+#include <stdint.h>
+
+
+/// number of commands in sliding window
+#define LINK_WINDOW         32
+
+/// failed commands in window for stepping down the baudrate
+#define LINK_MAX_ERRORS     2
+
+/// initial number of error-free commands before stepping up the baudrate
+#define LINK_CLEAN_UP       256
+
+/// max. number of renegotiations per session
+#define LINK_MAX_RELINK     8
+
+// result of a BSL command
+#define LINK_EVENT_OK       0       ///< ACK received
+#define LINK_EVENT_TIMEOUT  1       ///< no response
+#define LINK_EVENT_NACK     2       ///< NACK received
+#define LINK_EVENT_CORRUPT  3       ///< neither ACK nor NACK (parity or framing error on line)
+
+// proposed action
+#define LINK_KEEP           0       ///< continue with current baudrate
+#define LINK_RETRY          1       ///< isolated error: renegotiate with current baudrate
+#define LINK_DOWN           2       ///< bad link: renegotiate with lower baudrate
+#define LINK_UP             3       ///< clean link: renegotiate with higher baudrate
+
+
+/// state of link quality monitor
+typedef struct {
+
+  // adaptation state
+  uint32_t    baud;               ///< current baudrate
+  uint32_t    baudMax;            ///< configured baudrate (upper limit)
+  uint32_t    history;            ///< results in sliding window (bit=1: error)
+  uint32_t    clean;              ///< error-free commands since last error or change
+  uint32_t    cleanUp;            ///< error-free commands required for stepping up
+  uint8_t     probing;            ///< baudrate was stepped up and is not yet confirmed
+
+  // statistics
+  uint32_t    numCmd;             ///< number of tracked commands
+  uint32_t    numTimeout;         ///< number of timeouts
+  uint32_t    numNack;            ///< number of NACKs
+  uint32_t    numCorrupt;         ///< number of corrupted responses
+  uint32_t    numDown;            ///< number of steps down
+  uint32_t    numUp;              ///< number of steps up
+
+} linkmon_t;
+
+
+/// init monitor for configured baudrate
+void        linkmon_init(linkmon_t *lm, uint32_t baud);
+
+/// start new session, keep adaptation state of previous session on same port
+void        linkmon_resume(linkmon_t *lm, const linkmon_t *prev);
+
+/// track result of BSL command (LINK_EVENT_*). Returns proposed action (LINK_*)
+uint8_t     linkmon_event(linkmon_t *lm, uint8_t event);
+
+/// apply proposed action: change baudrate and clear window
+void        linkmon_apply(linkmon_t *lm, uint8_t action);
+
+/// number of errors in sliding window
+uint8_t     linkmon_errors(const linkmon_t *lm);
+
+#endif // _LINKMON_H_
+
+// end of file
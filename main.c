@@ -53,28 +53,107 @@
 #include "serial_comm.h"
 #include "bootloader.h"
 #include "hexfile.h"
+#include "image.h"
+#include "routines.h"
+#include "bsl_sm.h"
+#include "reactor.h"
+#include "gang.h"
+#include "progress.h"
+#include "telemetry.h"
+#include "metrics.h"
+#include "serialno.h"
+#include "trace.h"
+#include "watch.h"
+#include "tune.h"
+#include "adapter.h"
+#include "updater.h"
+#include "dumpstub.h"
+#include "archive.h"
+#include "pipeline.h"
 #include "version.h"
 
 
-// device dependent flash w/e routines
-#include "E_W_ROUTINEs_8K_verL_1.0.h"
-#include "E_W_ROUTINEs_32K_ver_1.0.h"
-#include "E_W_ROUTINEs_32K_ver_1.2.h"
-#include "E_W_ROUTINEs_32K_ver_1.3.h"
-#include "E_W_ROUTINEs_32K_ver_1.4.h"
-//#include "E_W_ROUTINEs_32K_verL_1.0.h"  // empty
-#include "E_W_ROUTINEs_128K_ver_2.0.h"
-#include "E_W_ROUTINEs_128K_ver_2.1.h"
-#include "E_W_ROUTINEs_128K_ver_2.2.h"
-#include "E_W_ROUTINEs_128K_ver_2.4.h"
-#include "E_W_ROUTINEs_256K_ver_1.0.h"
-
 // buffer sizes
 #define  STRLEN   1000
+#define  PORTLEN  20000         // comma separated list of many ports
 #define  BUFSIZE  10000000
 
 
 
+/**
+   \fn static void board_phase(bsl_sm_t *board, HANDLE ptrPort, uint8_t phase, uint8_t begin)
+   
+   \brief mark begin or end of phase in timeline and in record of board (single port)
+   
+   \param board     record of board (see telemetry_write())
+   \param ptrPort   handle to communication port
+   \param phase     phase (SM_PHASE_*)
+   \param begin     1=begin of phase, 0=end of phase
+*/
+static void board_phase(bsl_sm_t *board, HANDLE ptrPort, uint8_t phase, uint8_t begin) {
+
+  if (begin) {
+    trace_begin(TRACE_TID(ptrPort), "phase", bsl_sm_phaseName(phase));
+    board->phase = phase;
+    board->phaseStart[phase] = time_us();
+  }
+  else {
+    trace_end(TRACE_TID(ptrPort), "phase", bsl_sm_phaseName(phase));
+    board->phaseEnd[phase] = time_us();
+  }
+
+} // board_phase
+
+
+
+/**
+   \fn static void board_finish(bsl_sm_t *board, uint8_t status, hist_t *ackRtt, uint32_t bytesPayload)
+   
+   \brief complete record of board (single port) and write it to telemetry and metrics output
+   
+   \param board         record of board. At start of board, io and bytesPayload contain the counters of all boards so far
+   \param status        result of board (SM_STATUS_OK or SM_STATUS_FAILED)
+   \param ackRtt        ACK round-trip times of all boards, ACK_NUM_STAGES entries. Updated with this board
+   \param bytesPayload  image bytes written, verified and read in all boards
+*/
+static void board_finish(bsl_sm_t *board, uint8_t status, hist_t *ackRtt, uint32_t bytesPayload) {
+
+  io_stats_t  io;
+  int         i;
+
+  board->status  = status;
+  board->timeEnd = time_us();
+  if (status == SM_STATUS_FAILED)
+    snprintf(board->error, sizeof(board->error), "aborted in phase '%s'", bsl_sm_phaseName(board->phase));
+  else
+    board->phase = SM_PHASE_DONE;
+
+  // ACK round-trip times of this board
+  for (i=0; i<ACK_NUM_STAGES; i++) {
+    board->ackRtt[i] = bsl_ackRtt()[i];
+    hist_merge(&(ackRtt[i]), &(board->ackRtt[i]));
+  }
+  bsl_resetAckRtt();
+
+  // transport counters of this board
+  get_port_stats(&io);
+  board->io.numWrite   = io.numWrite   - board->io.numWrite;
+  board->io.numRead    = io.numRead    - board->io.numRead;
+  board->io.numPoll    = io.numPoll    - board->io.numPoll;
+  board->io.numAgain   = io.numAgain   - board->io.numAgain;
+  board->io.numTimeout = io.numTimeout - board->io.numTimeout;
+  board->io.bytesTx    = io.bytesTx    - board->io.bytesTx;
+  board->io.bytesRx    = io.bytesRx    - board->io.bytesRx;
+  board->io.bytesEcho  = io.bytesEcho  - board->io.bytesEcho;
+  board->bytesPayload  = bytesPayload  - board->bytesPayload;
+
+  telemetry_write(board, 0);
+  metrics_write(board);
+
+} // board_finish
+
+
+
 /**
    \fn int main(int argc, char *argv[])
    
@@ -90,17 +169,28 @@
 int main(int argc, char ** argv) {
  
   char      *appname;             // name of application without path
-  char      portname[STRLEN];     // name of communication port
+  char      portname[PORTLEN];    // name of communication port(s)
   int       baudrate;             // communication baudrate [Baud]
+  uint8_t   baudSet;              // baudrate was given on commandline (overrides profile)
+  uint8_t   tune;                 // benchmark link parameters and store port profile
+  tune_profile_t profile;         // stored link parameters of port
+  const adapter_profile_t *adapter; // defaults of USB adapter of port
   uint8_t   resetSTM8;            // 0=no reset; 1=HW reset via DTR (RS232/USB) or GPIO18 (Raspi); 2=SW reset by sending 0x55+0xAA
   uint8_t   enableBSL;            // don't enable ROM bootloader after upload (caution!)
   uint8_t   flashErase;           // erase P-flash and D-flash prior to upload
   uint8_t   jumpFlash;            // jump to flash after upload
   uint8_t   verifyUpload;         // verify memory after upload
   uint8_t   pauseOnLaunch;        // prompt for <return> prior to upload
+  uint32_t  updBaud;              // baudrate for resident updater (0=ROM bootloader only)
+  uint8_t   useUpdater;           // resident updater is used for current board
+  upd_info_t updInfo;             // properties of resident updater
+  uint32_t  dumpBaud;             // baudrate for memory dump via RAM stub (0=ROM bootloader READ)
+  uint8_t   useDump;              // dump stub is running on current board
+  uint8_t   pipeline;             // speculative pipelining of BSL frames (see pipeline.h)
+  uint32_t  numSpeculative, numDesync; // pipelining statistics of current board
   HANDLE    ptrPort;              // handle to communication port
-  char      *ptr=NULL;            // pointer to memory
   int       i, j;                 // generic variables  
+  uint32_t  idx, len;             // address range of merged image
   char      buf[1000];            // misc buffer
   //char      Tx[100], Rx[100];     // debug: buffer for tests
   
@@ -108,19 +198,49 @@ int main(int argc, char ** argv) {
   int       flashsize;            // size of flash (kB) for w/e routines
   uint8_t   versBSL;              // BSL version for w/e routines
   uint8_t   family;               // device family, currently STM8S and STM8L
+  const image_t *ramRoutines;     // flash w/e routines for upload to RAM
   
   // for upload to flash
-  char      fileIn[STRLEN];       // name of file to upload to STM8
-  char      *fileBufIn;           // buffer for hexfiles
-  char      *imageIn;             // memory buffer for upload hexfile
-  uint32_t  imageInStart;         // starting address of imageIn
-  uint32_t  imageInBytes;         // number of bytes in imageIn
+  char      *fileIn[IMAGE_MERGE_MAX]; // names of files to upload to STM8 (merged into one image)
+  uint8_t   numFileIn;            // number of files to upload
+  char      dirWatch[STRLEN];     // directory to watch for firmware (station mode)
+  char      fileSerial[STRLEN];   // counter file for per-board serial numbers
+  uint32_t  serialAddr;           // address of serial number in image (0=none)
+  uint64_t  serial;               // first allocated serial number
+  image_t   * volatile imageIn = NULL;  // prepared image to upload
+  jmp_buf   envStation;           // recovery point for failed boards in station mode
+  volatile uint32_t numBoards;    // number of boards in station mode
+  volatile uint32_t numFailed;    // number of failed boards in station mode
+
+  // for multiple ports
+  bsl_sm_t      *sessions;        // state machines of BSL sessions
+  bsl_sm_cfg_t  cfgSessions;      // settings for all sessions
+  bsl_sm_cfg_t  *cfgPorts;        // settings per port (with port profile)
+  uint32_t      numPorts;         // number of ports
+  HANDLE        *ports;           // handles of ports
+  char          **names;          // names of ports
+  char          *tok;             // port name in list
+  char          fileJobs[STRLEN]; // job file for gang programming
+  uint8_t       dashboard;        // show live dashboard instead of result lines
+  char          fileJSON[STRLEN]; // telemetry output (JSON record per session)
+  char          fileMetrics[STRLEN];  // Prometheus textfile (counters per port)
+  char          fileTrace[STRLEN];// timeline trace output (Chrome trace-event format)
+  hist_t        ackRtt[ACK_NUM_STAGES]; // ACK round-trip times of all sessions
+  io_stats_t    ioStats;          // transport counters of all sessions
+  volatile uint32_t bytesPayload; // image bytes written, verified and read
+
+  // record of board for telemetry (single port). Static, as it is used after a failed board (longjmp)
+  static bsl_sm_t     board;
+  static bsl_sm_cfg_t cfgBoard;
+  uint8_t       record;           // write record or metrics per board
   
   // for download from flash
   char      fileOut[STRLEN];      // name of file to download from STM8
   char      *imageOut;            // memory buffer for download hexfile
   uint32_t  imageOutStart;        // starting address of imageOut
   uint32_t  imageOutBytes;        // number of bytes in imageOut
+  char      dirArchive[STRLEN];   // deduplicated archive for dumps (instead of outfile)
+  archive_t *archive;             // open dump archive
 
   
   // initialize global variables
@@ -131,25 +251,47 @@ int main(int argc, char ** argv) {
   // initialize default arguments
   portname[0] = '\0';           // no default port name
   baudrate   = 230400;          // default baudrate
+  baudSet    = 0;               // baudrate from port profile, else default
+  tune       = 0;               // use stored port profile
+  updBaud    = 0;               // don't use resident updater
+  useUpdater = 0;
+  dumpBaud   = 0;               // read memory with ROM bootloader
+  useDump    = 0;
+  pipeline   = PIPE_OFF;        // strict lock-step
   resetSTM8  = 0;               // don't automatically reset STM8
   flashErase = 0;               // erase P-flash and D-flash prior to upload
   jumpFlash  = 1;               // jump to flash after uploade
   pauseOnLaunch = 1;            // prompt for return prior to upload
   enableBSL  = 1;               // enable bootloader after upload
   verifyUpload = 1;             // verify memory content after upload
-  fileIn[0] = '\0';             // no default file to upload to flash
+  numFileIn = 0;                // no default file to upload to flash
+  dirWatch[0] = '\0';           // no station mode
+  fileSerial[0] = '\0';         // no serial numbers
+  serialAddr = 0;
+  fileJobs[0] = '\0';           // no gang programming
+  dashboard  = 0;               // print result per board
+  fileJSON[0] = '\0';           // no telemetry
+  fileMetrics[0] = '\0';        // no metrics
+  bytesPayload = 0;             // no data transferred yet
+  fileTrace[0] = '\0';          // no timeline trace
   fileOut[0] = '\0';            // no default file to download from flash
+  dirArchive[0] = '\0';         // save dump to outfile
+  archive = NULL;
   
   // required for strncpy()
-  portname[STRLEN-1] = '\0';
-  fileIn[STRLEN-1]   = '\0';
+  portname[PORTLEN-1] = '\0';
+  dirWatch[STRLEN-1] = '\0';
+  fileSerial[STRLEN-1] = '\0';
+  fileJobs[STRLEN-1] = '\0';
+  fileJSON[STRLEN-1] = '\0';
+  fileMetrics[STRLEN-1] = '\0';
+  fileTrace[STRLEN-1] = '\0';
   fileOut[STRLEN-1]  = '\0';
+  dirArchive[STRLEN-1] = '\0';
     
   // allocate buffers (can't be static for large buffers)
-  imageIn   = (char*) malloc(BUFSIZE);
   imageOut  = (char*) malloc(BUFSIZE);
-  fileBufIn = (char*) malloc(BUFSIZE);
-  if ((!imageIn) || (!imageOut) || (!fileBufIn)) {
+  if (!imageOut) {
     setConsoleColor(PRM_COLOR_RED);
     fprintf(stderr, "\n\nerror: cannot allocate memory buffers, exit!\n\n");
     Exit(1, 1);
@@ -170,13 +312,15 @@ int main(int argc, char ** argv) {
     // name of communication port
     if (!strcmp(argv[i], "-p")) {
       if (i<argc-1)
-        strncpy(portname, argv[++i], STRLEN-1);
+        strncpy(portname, argv[++i], PORTLEN-1);
     }
 
     // communication baudrate
     else if (!strcmp(argv[i], "-b")) {
-      if (i<argc-1)
+      if (i<argc-1) {
         sscanf(argv[++i],"%d",&baudrate);
+        baudSet = 1;
+      }
     }
     
     // UART mode: 0=duplex, 1=1-wire reply, 2=2-wire reply (default: duplex)\n");
@@ -200,10 +344,95 @@ int main(int argc, char ** argv) {
       flashErase = 1;
     }
 
-    // name of file to upload
+    // name of file to upload. Repeated files are merged into one image
     else if (!strcmp(argv[i], "-w")) {
+      if (numFileIn >= IMAGE_MERGE_MAX) {
+        setConsoleColor(PRM_COLOR_RED);
+        fprintf(stderr, "\n\nerror: max. %d files with option -w, exit!\n\n", (int) IMAGE_MERGE_MAX);
+        Exit(1, g_pauseOnExit);
+      }
+      if (i<argc-1)
+        fileIn[numFileIn++] = argv[++i];
+    }
+
+    // watch directory for new firmware and flash boards in a loop (station mode)
+    else if (!strcmp(argv[i], "-W")) {
+      if (i<argc-1)
+        strncpy(dirWatch, argv[++i], STRLEN-1);
+    }
+
+    // gang programming: distribute jobs from file to all ports
+    else if (!strcmp(argv[i], "-J")) {
+      if (i<argc-1)
+        strncpy(fileJobs, argv[++i], STRLEN-1);
+    }
+
+    // live dashboard for multiple ports or job file
+    else if (!strcmp(argv[i], "-D")) {
+      dashboard = 1;
+    }
+
+    // JSON telemetry for multiple ports or job file ("-"=stdout)
+    else if (!strcmp(argv[i], "--json")) {
+      if (i<argc-1)
+        strncpy(fileJSON, argv[++i], STRLEN-1);
+    }
+
+    // Prometheus textfile with counters per port for multiple ports or job file
+    else if (!strcmp(argv[i], "--metrics")) {
+      if (i<argc-1)
+        strncpy(fileMetrics, argv[++i], STRLEN-1);
+    }
+
+    // record timeline of protocol activity
+    else if (!strcmp(argv[i], "--timeline")) {
+      if (i<argc-1)
+        strncpy(fileTrace, argv[++i], STRLEN-1);
+    }
+
+    // patch serial number from counter file into image (4B big-endian at address in hex)
+    else if (!strcmp(argv[i], "--serial")) {
+      if (i<argc-1)
+        strncpy(fileSerial, argv[++i], STRLEN-1);
+      if (i<argc-1) {
+        sscanf(argv[++i],"%x",&j);
+        serialAddr = j;
+      }
+    }
+
+    // benchmark link parameters and store as port profile
+    else if (!strcmp(argv[i], "--tune")) {
+      tune = 1;
+    }
+
+    // prefer resident updater of BSL_activate, if installed
+    else if (!strcmp(argv[i], "--updater")) {
+      if (i<argc-1) {
+        sscanf(argv[++i],"%d",&j);
+        updBaud = j;
+      }
+    }
+
+    // store dumps in deduplicated archive
+    else if (!strcmp(argv[i], "--archive")) {
       if (i<argc-1)
-        strncpy(fileIn, argv[++i], STRLEN-1);
+        strncpy(dirArchive, argv[++i], STRLEN-1);
+    }
+
+    // read memory via RAM stub with given baudrate
+    else if (!strcmp(argv[i], "--dump")) {
+      if (i<argc-1) {
+        sscanf(argv[++i],"%d",&j);
+        dumpBaud = j;
+      }
+    }
+
+    // send next BSL command before ACK of previous data phase
+    else if (!strcmp(argv[i], "--pipeline")) {
+      if (i<argc-1) {
+        sscanf(argv[++i],"%d",&j);
+        pipeline = j;
+      }
     }
 
     // don't enable ROM bootloader after upload (caution!)
@@ -260,9 +489,9 @@ int main(int argc, char ** argv) {
         appname = argv[0];
       printf("\n");
 
-      printf("usage: %s [-h] [-p port] [-b rate] [-u mode] [-R ch] [-e] [-w infile] [-x] [-v] [-r start stop outfile] [-j] [-Q] [-q] [-V]\n", appname);
+      printf("usage: %s [-h] [-p port] [-b rate] [-u mode] [-R ch] [-e] [-w infile[@addr]] [-W dir] [-J jobfile] [-D] [--json file] [--metrics file] [--timeline file] [--serial file addr] [--tune] [--updater rate] [--pipeline mode] [--dump rate] [--archive dir] [-x] [-v] [-r start stop outfile] [-j] [-Q] [-q] [-V]\n", appname);
       printf("  -h                     print this help\n");
-      printf("  -p port                name of communication port (default: list available ports)\n");
+      printf("  -p port                name of communication port, or comma separated list for flashing in parallel (default: list available ports)\n");
       printf("  -b rate                communication baudrate in Baud (default: 230400)\n");
       printf("  -u mode                UART mode: 0=duplex, 1=1-wire reply, 2=2-wire reply (default: duplex)\n");
       #ifdef __ARMEL__
@@ -271,10 +500,23 @@ int main(int argc, char ** argv) {
         printf("  -R ch                  reset STM8: 1=DTR line (RS232), 2=send 'Re5eT!' @ 115.2kBaud (default: no reset)\n");
       #endif
       printf("  -e                     erase P-flash and D-flash prior to upload (default: skip)\n");
-      printf("  -w infile              upload s19 or intel-hex file to flash (default: skip)\n");
+      printf("  -w infile              upload s19, intel-hex, ELF or binary file to flash (default: skip)\n");
+      printf("                         repeat to merge up to %d files into one upload, 'file.bin@addr' sets address of binary\n", (int) IMAGE_MERGE_MAX);
+      printf("  -W dir                 station mode: watch dir for new firmware and flash boards in a loop (default: skip)\n");
+      printf("  -J jobfile             gang programming: distribute jobs (firmware + number of boards) to all ports (default: skip)\n");
+      printf("    -D                   show live dashboard for multiple ports or job file (default: line per board)\n");
+      printf("  --json file            append JSON record per board, '-'=stdout (default: skip)\n");
+      printf("  --metrics file         update Prometheus textfile with counters per port after each board (default: skip)\n");
+      printf("  --timeline file        save timeline of BSL protocol activity in Chrome trace format (default: skip)\n");
+      printf("  --serial file addr     write serial number from counter file to addr (in hex) of each board (default: skip)\n");
+      printf("  --tune                 benchmark link parameters with infile and store as port profile (default: use stored profile)\n");
+      printf("  --updater rate         use resident updater of BSL_activate with rate in Baud, if installed (single port, -u 0) (default: ROM bootloader)\n");
       printf("    -x                   don't enable ROM bootloader after upload (default: enable)\n");
       printf("    -v                   don't verify code in flash after upload (default: verify)\n");
+      printf("  --pipeline mode        send next command before ACK of data (single port, -u 0): 1=validated BSL versions, 2=also probe unknown (default: 0=off)\n");
       printf("  -r start stop outfile  read memory range (in hex) to s19 file or table (default: skip)\n");
+      printf("    --dump rate          read via RAM stub streaming with rate in Baud (single port, -u 0, STM8S) (default: ROM bootloader)\n");
+      printf("    --archive dir        store dump in deduplicated archive, named like outfile (see tools/dump_archive) (default: file)\n");
       printf("  -j                     don't jump to flash before exit (default: jump to flash)\n");
       printf("  -Q                     don't prompt for <return> prior to bootloader entry (default: prompt)\n");
       printf("  -q                     prompt for <return> prior to exit (default: no prompt)\n");
@@ -307,37 +549,277 @@ int main(int argc, char ** argv) {
   } // if no comm port name
 
 
+  // start recording timeline (written on exit)
+  if (strlen(fileTrace) > 0)
+    trace_open(fileTrace);
+
+
+  // open counter file for serial numbers
+  if ((strlen(fileSerial) > 0) && (serialAddr != 0))
+    serialno_open(fileSerial);
+  else
+    serialAddr = 0;
+
+  // open dump archive. The last stored dump is reference for skipping unchanged blocks
+  if ((strlen(dirArchive) > 0) && (strlen(fileOut) > 0))
+    archive = archive_open(dirArchive);
+
+  // WRITE frames are pre-built once for all ports -> use smallest frame size of port profiles
+  if (!tune)
+    image_setFrameSize(tune_frameSize(portname));
+
+  // limit baudrate to slowest USB adapter (gang workers share the baudrate)
+  if (adapter_baudrate(portname, baudrate) < (uint32_t) baudrate) {
+    baudrate = adapter_baudrate(portname, baudrate);
+    printf("  limit baudrate to %d Baud (USB adapter)\n", baudrate);
+  }
+
   // If specified import hexfile - do it early here to be able to report file read errors before others
-  if (strlen(fileIn) > 0) {
-    const char *shortname = strrchr(fileIn, '/');
-    if (!shortname)
-      shortname = fileIn;
-
-    // convert to memory image, depending on file type
-    const char *dot = strrchr (fileIn, '.');
-    if (dot && !strcmp(dot, ".s19")) {
-      if (g_verbose)
-        printf("  load Motorola S-record file '%s' ... ", shortname);
-      load_hexfile(fileIn, fileBufIn, BUFSIZE);
-      convert_s19(fileBufIn, &imageInStart, &imageInBytes, imageIn);
+  if (strlen(dirWatch) > 0) {
+    printf("  watch directory '%s' for firmware\n", dirWatch);
+    watch_start(dirWatch, 1);
+  }
+  else if (numFileIn > 0)
+    image_publish(image_merge(numFileIn, fileIn, g_verbose));
+
+
+  // settings for BSL sessions (multiple ports, job file or tuning)
+  cfgSessions.image        = NULL;
+  cfgSessions.flashErase   = flashErase;
+  cfgSessions.verifyUpload = verifyUpload;
+  cfgSessions.enableBSL    = enableBSL;
+  cfgSessions.jumpFlash    = jumpFlash;
+  cfgSessions.UARTmode     = g_UARTmode;
+  cfgSessions.baudrate     = baudrate;
+  cfgSessions.linkAdapt    = (resetSTM8 == 1);    // renegotiation requires reset via DTR
+  cfgSessions.readSize     = 256;
+  cfgSessions.echoBlock    = 0;
+  cfgSessions.serialAddr   = serialAddr;
+
+
+  ////////
+  // tune link parameters of each port and store as port profile
+  ////////
+  if (tune) {
+
+    // check for unsupported options
+    if ((strlen(dirWatch) > 0) || (strlen(fileJobs) > 0) || (strlen(fileOut) > 0) || (serialAddr != 0)) {
+      setConsoleColor(PRM_COLOR_RED);
+      fprintf(stderr, "\n\nerror: options -W, -J, -r and --serial not supported with --tune, exit!\n\n");
+      Exit(1, g_pauseOnExit);
     }
-    else if (dot && (!strcmp(dot, ".hex") || !strcmp(dot, ".ihx"))) {
-      if (g_verbose)
-        printf("  load Intel hex file '%s' ... ", shortname);
-      load_hexfile(fileIn, fileBufIn, BUFSIZE);
-      convert_hex(fileBufIn, &imageInStart, &imageInBytes, imageIn);
+    imageIn = image_acquire();
+    cfgSessions.image = imageIn;
+
+    // manually put STM8s into bootloader mode
+    if (pauseOnLaunch) {
+      printf("  activate STM8 bootloaders and press <return>");
+      fflush(stdout);
+      fflush(stdin);
+      getchar();
+    }
+
+    // tune ports one after the other
+    numFailed = 0;
+    for (tok=strtok(portname, ","); tok; tok=strtok(NULL, ",")) {
+      if (g_UARTmode == 0)
+        ptrPort = init_port(tok, baudrate, 1000, 8, 2, 1, 0, 0);   // use even parity
+      else
+        ptrPort = init_port(tok, baudrate, 1000, 8, 0, 1, 0, 0);   // use no parity
+      flush_port(ptrPort);
+      if (!tune_run(ptrPort, tok, &cfgSessions, resetSTM8, &profile)) {
+        setConsoleColor(PRM_COLOR_RED);
+        fprintf(stderr, "  %s: no working setting found\n", tok);
+        setConsoleColor(PRM_COLOR_DEFAULT);
+        numFailed++;
+      }
+      close_port(&ptrPort);
+    }
+    image_release(imageIn);
+    printf("done with program\n");
+    Exit((numFailed > 0), g_pauseOnExit);
+
+  } // tune
+
+
+  ////////
+  // multiple ports (comma separated) or job file: flash boards concurrently
+  ////////
+  if (strchr(portname, ',') || (strlen(fileJobs) > 0)) {
+
+    // check for unsupported options
+    if ((strlen(dirWatch) > 0) || (strlen(fileOut) > 0)) {
+      setConsoleColor(PRM_COLOR_RED);
+      fprintf(stderr, "\n\nerror: options -W and -r not supported for multiple ports or job file, exit!\n\n");
+      Exit(1, g_pauseOnExit);
+    }
+
+    // allocate buffers for all ports
+    numPorts = 1;
+    for (i=0; portname[i]; i++)
+      numPorts += (portname[i] == ',');
+    sessions = (bsl_sm_t*) malloc(numPorts * sizeof(bsl_sm_t));
+    cfgPorts = (bsl_sm_cfg_t*) malloc(numPorts * sizeof(bsl_sm_cfg_t));
+    ports    = (HANDLE*) malloc(numPorts * sizeof(HANDLE));
+    names    = (char**) malloc(numPorts * sizeof(char*));
+    if ((!sessions) || (!cfgPorts) || (!ports) || (!names)) {
+      setConsoleColor(PRM_COLOR_RED);
+      fprintf(stderr, "\n\nerror: cannot allocate memory buffers, exit!\n\n");
+      Exit(1, g_pauseOnExit);
     }
+    imageIn = image_acquire();
+    cfgSessions.image = imageIn;
+
+    // open all ports. Without job file apply port profiles (gang workers share the baudrate)
+    numPorts = 0;
+    for (tok=strtok(portname, ","); tok; tok=strtok(NULL, ",")) {
+      names[numPorts] = tok;
+      cfgPorts[numPorts] = cfgSessions;
+      if ((strlen(fileJobs) == 0) && (adapter = adapter_find(tok))) {
+        cfgPorts[numPorts].readSize  = adapter->readSize;
+        cfgPorts[numPorts].echoBlock = adapter->echoBlock;
+      }
+      if ((strlen(fileJobs) == 0) && (tune_apply(tok, &profile))) {
+        if (!baudSet)
+          cfgPorts[numPorts].baudrate = profile.baudrate;
+        cfgPorts[numPorts].readSize  = profile.readSize;
+        cfgPorts[numPorts].echoBlock = profile.echoBlock;
+      }
+      if (g_verbose) {
+        printf("  open port '%s' with %gkBaud ... ", names[numPorts], (float) cfgPorts[numPorts].baudrate / 1000.0);
+        fflush(stdout);
+      }
+      if (g_UARTmode == 0)
+        ports[numPorts] = init_port(names[numPorts], cfgPorts[numPorts].baudrate, 1000, 8, 2, 1, 0, 0);   // use even parity
+      else
+        ports[numPorts] = init_port(names[numPorts], cfgPorts[numPorts].baudrate, 1000, 8, 0, 1, 0, 0);   // use no parity
+      if (strlen(fileJobs) == 0)
+        set_port_latency(names[numPorts], profile.latency);     // tuned latency replaces adapter default
+      flush_port(ports[numPorts]);
+      if (g_verbose) {
+        printf("ok\n");
+        fflush(stdout);
+      }
+      numPorts++;
+    }
+
+    // manually put STM8s into bootloader mode
+    if (pauseOnLaunch) {
+      printf("  activate STM8 bootloaders and press <return>");
+      fflush(stdout);
+      fflush(stdin);
+      getchar();
+    }
+
+    // gang programming: workers pull jobs from scheduler and reset boards themselves
+    if (strlen(fileJobs) > 0) {
+      if (strlen(fileJSON) > 0)
+        telemetry_open(fileJSON);
+      if (strlen(fileMetrics) > 0)
+        metrics_open(fileMetrics);
+      numFailed = gang_run(ports, names, numPorts, fileJobs, &cfgSessions, resetSTM8, baudrate, dashboard);
+      printf("  %d jobs failed\n", (int) numFailed);
+    }
+
+    // same image on all ports
     else {
-      if (g_verbose)
-        printf("  load binary file '%s' ... ", shortname);
-      load_binfile(fileIn, imageIn, &imageInStart, &imageInBytes, BUFSIZE);
+
+      // reset all STM8s via DTR line or command (GPIO reset not possible for multiple boards)
+      if ((resetSTM8 == 1) || (resetSTM8 == 2)) {
+        printf("  reset %d boards ... ", (int) numPorts);
+        fflush(stdout);
+        for (i=0; i<numPorts; i++) {
+          if (resetSTM8 == 1)
+            pulse_DTR(ports[i], 10);
+          else {
+            set_baudrate(ports[i], 115200);   // expect STM8 SW to receive at 115.2kBaud
+            for (j=0; j<6; j++) {
+              send_port(ports[i], 1, (char*) "Re5eT!"+j);
+              SLEEP(10);
+            }
+            set_baudrate(ports[i], cfgPorts[i].baudrate);
+          }
+        }
+        printf("ok\n");
+        SLEEP(5);                       // allow BSL to initialize
+      }
+
+      // flash all boards in a single thread
+      printf("  flash %d boards ...\n", (int) numPorts);
+      fflush(stdout);
+      if ((serialAddr) && (imageIn))
+        serial = serialno_reserve(numPorts);      // one serial number per board
+      for (i=0; i<numPorts; i++) {
+        if ((serialAddr) && (imageIn))
+          cfgPorts[i].image = serialno_patch(imageIn, serialAddr, serial+i);
+        bsl_sm_init(&(sessions[i]), ports[i], names[i], &(cfgPorts[i]));
+        if (cfgPorts[i].image != imageIn)
+          sessions[i].serialNo = (int64_t) (serial+i);
+        if (dashboard)
+          sessions[i].progress = progress_register(names[i]);
+      }
+      if (dashboard) {
+        progress_start(100);
+        numFailed = reactor_run(sessions, numPorts, 0);
+        progress_stop();
+        for (i=0; i<numPorts; i++) {
+          if (sessions[i].status == SM_STATUS_FAILED) {
+            setConsoleColor(PRM_COLOR_RED);
+            fprintf(stderr, "  %s: failed in phase '%s': %s\n", sessions[i].name, bsl_sm_phaseName(sessions[i].phase), sessions[i].error);
+            setConsoleColor(PRM_COLOR_DEFAULT);
+          }
+        }
+      }
+      else
+        numFailed = reactor_run(sessions, numPorts, 1);
+      if (strlen(fileJSON) > 0) {
+        telemetry_open(fileJSON);
+        for (i=0; i<numPorts; i++)
+          telemetry_write(&(sessions[i]), 0);
+      }
+      if (strlen(fileMetrics) > 0) {
+        metrics_open(fileMetrics);
+        for (i=0; i<numPorts; i++)
+          metrics_write(&(sessions[i]));
+      }
+      printf("  %d boards processed, %d failed\n", (int) numPorts, (int) numFailed);
+      memset(ackRtt, 0, sizeof(ackRtt));
+      for (i=0; i<numPorts; i++)
+        for (j=0; j<ACK_NUM_STAGES; j++)
+          hist_merge(&(ackRtt[j]), &(sessions[i].ackRtt[j]));
+      bsl_printAckRtt(ackRtt);
+      memset(&ioStats, 0, sizeof(ioStats));
+      for (i=0; i<numPorts; i++) {
+        add_port_stats(&ioStats, &(sessions[i].io));
+        bytesPayload += sessions[i].bytesPayload;
+      }
+      print_port_stats(&ioStats, bytesPayload, g_UARTmode);
     }
-  }
+
+    // clean up and exit
+    telemetry_close();
+    metrics_close();
+    for (i=0; i<numPorts; i++) {
+      close_port(&(ports[i]));
+      if (cfgPorts[i].image != imageIn)
+        image_release((image_t*) cfgPorts[i].image);
+    }
+    free(sessions);
+    free(cfgPorts);
+    free(ports);
+    free(names);
+    image_release(imageIn);
+    printf("done with program\n");
+    Exit((numFailed > 0), g_pauseOnExit);
+
+  } // multiple ports
 
 
   ////////
   // open port with given properties
   ////////
+  if ((tune_apply(portname, &profile)) && (!baudSet))
+    baudrate = profile.baudrate;
   if (g_verbose) {
     printf("  open port '%s' with %gkBaud ... ", portname, (float) baudrate / 1000.0);
     fflush(stdout);
@@ -346,6 +828,7 @@ int main(int argc, char ** argv) {
     ptrPort = init_port(portname, baudrate, 1000, 8, 2, 1, 0, 0);   // use even parity
   else
     ptrPort = init_port(portname, baudrate, 1000, 8, 0, 1, 0, 0);   // use no parity
+  set_port_latency(portname, profile.latency);                      // tuned latency replaces adapter default
   if (g_verbose) {
     printf("ok\n");
     fflush(stdout);
@@ -353,6 +836,7 @@ int main(int argc, char ** argv) {
   
   // flush receive buffer
   flush_port(ptrPort);
+  trace_threadName(TRACE_TID(ptrPort), portname);
 
  
   // debug: communication test (echo+1 test-SW on STM8)
@@ -370,258 +854,370 @@ int main(int argc, char ** argv) {
   
 
   ////////
-  // reset STM8
+  // flash board(s). In station mode loop over boards until terminated
   ////////
+  numBoards = 0;
+  numFailed = 0;
+  record = (strlen(fileJSON) > 0) || (strlen(fileMetrics) > 0);
+  if (strlen(fileJSON) > 0)
+    telemetry_open(fileJSON);
+  if (strlen(fileMetrics) > 0)
+    metrics_open(fileMetrics);
+  memset(ackRtt, 0, sizeof(ackRtt));
+  do {
 
-  // manually put STM8 into bootloader mode
-  if (pauseOnLaunch) {
-    printf("  activate STM8 bootloader and press <return>");
-    fflush(stdout);
-    fflush(stdin);
-    getchar();
-  }
+    // with record per board, a failed single board is recorded before terminating
+    if ((strlen(dirWatch) == 0) && (record)) {
+      if (setjmp(envStation) != 0) {
+        setExitHandler(NULL);
+        board_finish(&board, SM_STATUS_FAILED, ackRtt, bytesPayload);
+        telemetry_close();
+        metrics_close();
+        Exit(1, g_pauseOnExit);
+      }
+      setExitHandler(&envStation);
+    }
 
-  // HW reset STM8 using DTR line (USB/RS232)
-  if (resetSTM8 == 1) {
-    printf("  reset via DTR ... ");
-    pulse_DTR(ptrPort, 10);
-    printf("ok\n");
-    SLEEP(5);                       // allow BSL to initialize
-  }
-  
-  // SW reset STM8 via command 'Re5eT!' at 115.2kBaud (requires respective STM8 SW)
-  else if (resetSTM8 == 2) {
-    set_baudrate(ptrPort, 115200);    // expect STM8 SW to receive at 115.2kBaud
-    printf("  reset via UART command ... ");
-    sprintf(buf, "Re5eT!");           // reset command (same as in STM8 SW!)
-    for (i=0; i<6; i++) {
-      send_port(ptrPort, 1, buf+i);   // send reset command bytewise to account for slow handling
-      SLEEP(10);
+    // in station mode, a failed board returns here and the next board is processed
+    if (strlen(dirWatch) > 0) {
+      if (setjmp(envStation) != 0) {
+        board_finish(&board, SM_STATUS_FAILED, ackRtt, bytesPayload);
+        image_release(imageIn);
+        numFailed++;
+        setConsoleColor(PRM_COLOR_RED);
+        fprintf(stderr, "  board failed (%d of %d failed), continue with next board\n", (int) numFailed, (int) numBoards);
+        setConsoleColor(PRM_COLOR_DEFAULT);
+        set_baudrate(ptrPort, baudrate);    // updater or dump stub may have changed baudrate
+        flush_port(ptrPort);
+      }
+      setExitHandler(&envStation);
+      
+      // wait until first firmware is available
+      while (!(imageIn = image_acquire()))
+        SLEEP(500);
+      image_release(imageIn);
+      imageIn = NULL;
+      numBoards++;
+      printf("\n  board %d\n", (int) numBoards);
     }
-    printf("ok\n");
-    set_baudrate(ptrPort, baudrate);  // restore specified baudrate
-  }
-  
-  // HW reset STM8 using GPIO18 pin (only Raspberry Pi!)
-  #ifdef __ARMEL__
-    else if (resetSTM8 == 3) {
-      printf("  reset via GPIO18 ... ");
-      pulse_GPIO(18, 10);
+
+    ////////
+    // reset STM8
+    ////////
+
+    // manually put STM8 into bootloader mode (always in station mode)
+    if (pauseOnLaunch || (strlen(dirWatch) > 0)) {
+      printf("  activate STM8 bootloader and press <return>");
+      fflush(stdout);
+      fflush(stdin);
+      if ((getchar() == EOF) && (strlen(dirWatch) > 0))
+        break;
+    }
+
+    // use latest prepared firmware
+    imageIn = image_acquire();
+    if ((imageIn) && (strlen(dirWatch) > 0))
+      printf("  firmware '%s' (CRC32 0x%08x)\n", imageIn->name, imageIn->crc);
+
+    // start record of board. Counters are converted to this board by board_finish()
+    memset(&board, 0, sizeof(board));
+    memset(&cfgBoard, 0, sizeof(cfgBoard));
+    strncpy(board.name, portname, sizeof(board.name)-1);
+    board.cfg          = &cfgBoard;
+    board.serialNo     = -1;
+    board.queueLatency = -1;
+    board.timeStart    = time_us();
+    board.bytesPayload = bytesPayload;
+    board.link.baud    = baudrate;
+    board.link.baudMax = baudrate;
+    get_port_stats(&(board.io));
+    cfgBoard.UARTmode  = g_UARTmode;
+    cfgBoard.baudrate  = baudrate;
+
+    // use copy with serial number of this board
+    if ((imageIn) && (serialAddr)) {
+      image_t *patched;
+      serial  = serialno_reserve(1);
+      patched = serialno_patch(imageIn, serialAddr, serial);
+      image_release(imageIn);
+      imageIn = patched;
+      board.serialNo = (int64_t) serial;
+      printf("  serial number %llu\n", (unsigned long long) serial);
+    }
+    cfgBoard.image = imageIn;
+
+    // HW reset STM8 using DTR line (USB/RS232)
+    if (resetSTM8 == 1) {
+      printf("  reset via DTR ... ");
+      pulse_DTR(ptrPort, 10);
       printf("ok\n");
       SLEEP(5);                       // allow BSL to initialize
     }
-  #endif // __ARMEL__
+  
+    // SW reset STM8 via command 'Re5eT!' at 115.2kBaud (requires respective STM8 SW)
+    else if (resetSTM8 == 2) {
+      set_baudrate(ptrPort, 115200);    // expect STM8 SW to receive at 115.2kBaud
+      printf("  reset via UART command ... ");
+      sprintf(buf, "Re5eT!");           // reset command (same as in STM8 SW!)
+      for (i=0; i<6; i++) {
+        send_port(ptrPort, 1, buf+i);   // send reset command bytewise to account for slow handling
+        SLEEP(10);
+      }
+      printf("ok\n");
+      set_baudrate(ptrPort, baudrate);  // restore specified baudrate
+    }
+  
+    // HW reset STM8 using GPIO18 pin (only Raspberry Pi!)
+    #ifdef __ARMEL__
+      else if (resetSTM8 == 3) {
+        printf("  reset via GPIO18 ... ");
+        pulse_GPIO(18, 10);
+        printf("ok\n");
+        SLEEP(5);                       // allow BSL to initialize
+      }
+    #endif // __ARMEL__
   
   
 
-  ////////
-  // communicate with STM8 bootloader
-  ////////
+    ////////
+    // communicate with STM8 bootloader
+    ////////
 
-  // synchronize baudrate
-  bsl_sync(ptrPort);
+    // synchronize baudrate
+    board_phase(&board, ptrPort, SM_PHASE_SYNC, 1);
+    bsl_sync(ptrPort);
+    board_phase(&board, ptrPort, SM_PHASE_SYNC, 0);
   
 
-  // get bootloader info for selecting RAM w/e routines for flash
-  bsl_getInfo(ptrPort, &flashsize, &versBSL, &family);
+    // get bootloader info for selecting RAM w/e routines for flash
+    board_phase(&board, ptrPort, SM_PHASE_IDENTIFY, 1);
+    bsl_getInfo(ptrPort, &flashsize, &versBSL, &family);
+    board.flashsize = flashsize;
+    board.versBSL   = versBSL;
+    board.family    = family;
+    board_phase(&board, ptrPort, SM_PHASE_IDENTIFY, 0);
 
+    // speculative pipelining only for BSL versions known to tolerate it
+    bsl_setPipeline((pipeline != PIPE_OFF) && (g_UARTmode == 0) && (pipe_allowed(family, versBSL, pipeline)));
 
-  // for STM8S and 8kB STM8L upload RAM routines, else skip
-  if ((family == STM8S) || (flashsize==8)) {
 
-    // select device dependent flash routines for upload
-    if ((flashsize==8) && (versBSL==0x10)) {
-      #ifdef DEBUG
-        printf("header STM8_Routines_E_W_ROUTINEs_8K_verL_1_0_s19 \n");
-      #endif
-      ptr = (char*) STM8_Routines_E_W_ROUTINEs_8K_verL_1_0_s19;
-      ptr[STM8_Routines_E_W_ROUTINEs_8K_verL_1_0_s19_len]=0;
-    }
-    else if ((flashsize==32) && (versBSL==0x10)) {
-      #ifdef DEBUG
-        printf("header STM8_Routines_E_W_ROUTINEs_32K_ver_1_0_s19 \n");
-      #endif
-      ptr = (char*) STM8_Routines_E_W_ROUTINEs_32K_ver_1_0_s19;
-      ptr[STM8_Routines_E_W_ROUTINEs_32K_ver_1_0_s19_len]=0;
-    }
-    else if ((flashsize==32) && (versBSL==0x12)) {
-      #ifdef DEBUG
-        printf("header STM8_Routines_E_W_ROUTINEs_32K_ver_1_2_s19 \n");
-      #endif
-      ptr = (char*) STM8_Routines_E_W_ROUTINEs_32K_ver_1_2_s19;
-      ptr[STM8_Routines_E_W_ROUTINEs_32K_ver_1_2_s19_len]=0;
-    }
-    else if ((flashsize==32) && (versBSL==0x13)) {
-      #ifdef DEBUG
-        printf("header STM8_Routines_E_W_ROUTINEs_32K_ver_1_3_s19 \n");
-      #endif
-      ptr = (char*) STM8_Routines_E_W_ROUTINEs_32K_ver_1_3_s19;
-      ptr[STM8_Routines_E_W_ROUTINEs_32K_ver_1_3_s19_len]=0;
-    }
-    else if ((flashsize==32) && (versBSL==0x14)) {
-      #ifdef DEBUG
-        printf("header STM8_Routines_E_W_ROUTINEs_32K_ver_1_4_s19 \n");
-      #endif
-      ptr = (char*) STM8_Routines_E_W_ROUTINEs_32K_ver_1_4_s19;
-      ptr[STM8_Routines_E_W_ROUTINEs_32K_ver_1_4_s19_len]=0;
-    }
-    else if ((flashsize==128) && (versBSL==0x20)) {
-      #ifdef DEBUG
-        printf("header STM8_Routines_E_W_ROUTINEs_128K_ver_2_0_s19 \n");
-      #endif
-      ptr = (char*) STM8_Routines_E_W_ROUTINEs_128K_ver_2_0_s19;
-      ptr[STM8_Routines_E_W_ROUTINEs_128K_ver_2_0_s19_len]=0;
-    }
-/*
-    else if ((flashsize==128) && (versBSL==0x20)) {
-      #ifdef DEBUG
-        printf("header STM8_Routines_E_W_ROUTINEs_32K_verL_1_0_s19 \n");
-      #endif
-      ptr = (char*) STM8_Routines_E_W_ROUTINEs_32K_verL_1_0_s19;
-      ptr[STM8_Routines_E_W_ROUTINEs_32K_verL_1_0_s19_len]=0;
-    }
-*/
-    else if ((flashsize==128) && (versBSL==0x21)) {
-      #ifdef DEBUG
-        printf("header STM8_Routines_E_W_ROUTINEs_128K_ver_2_1_s19 \n");
-      #endif
-      ptr = (char*) STM8_Routines_E_W_ROUTINEs_128K_ver_2_1_s19;
-      ptr[STM8_Routines_E_W_ROUTINEs_128K_ver_2_1_s19_len]=0;
-    }
-    else if ((flashsize==128) && (versBSL==0x22)) {
-      #ifdef DEBUG
-        printf("header STM8_Routines_E_W_ROUTINEs_128K_ver_2_2_s19 \n");
-      #endif
-      ptr = (char*) STM8_Routines_E_W_ROUTINEs_128K_ver_2_2_s19;
-      ptr[STM8_Routines_E_W_ROUTINEs_128K_ver_2_2_s19_len]=0;
-    }
-    else if ((flashsize==128) && (versBSL==0x24)) {
-      #ifdef DEBUG
-        printf("header STM8_Routines_E_W_ROUTINEs_128K_ver_2_4_s19 \n");
-      #endif
-      ptr = (char*) STM8_Routines_E_W_ROUTINEs_128K_ver_2_4_s19;
-      ptr[STM8_Routines_E_W_ROUTINEs_128K_ver_2_4_s19_len]=0;
-    }
-    else if ((flashsize==256) && (versBSL==0x10)) {
-      #ifdef DEBUG
-        printf("header STM8_Routines_E_W_ROUTINEs_256K_ver_1_0_s19 \n");
-      #endif
-      ptr = (char*) STM8_Routines_E_W_ROUTINEs_256K_ver_1_0_s19;
-      ptr[STM8_Routines_E_W_ROUTINEs_256K_ver_1_0_s19_len]=0;
-    }
-    else {
-      setConsoleColor(PRM_COLOR_RED);
-      fprintf(stderr, "\n\nerror: unsupported device, exit!\n\n");
-      Exit(1, g_pauseOnExit);
+    // prefer resident updater, if installed and image is in its writable range
+    useUpdater = 0;
+    useDump    = 0;
+    if ((updBaud > 0) && (g_UARTmode == 0) && (upd_detect(ptrPort, flashsize, family, &updInfo))) {
+      if (upd_writable(&updInfo, imageIn)) {
+        trace_begin(TRACE_TID(ptrPort), "phase", "updater");
+        upd_start(ptrPort, &updInfo, updBaud);
+        trace_end(TRACE_TID(ptrPort), "phase", "updater");
+        useUpdater = 1;
+      }
+      else
+        printf("  image not in application area of updater (0x%04x-0x%04x), use ROM bootloader\n", (int) updInfo.appStart, (int) (updInfo.flashEnd-1));
     }
 
-    // upload respective RAM routines to STM8
-    {
-      char      ramImage[8192];
-      uint32_t  ramImageStart;
-      uint32_t  numRamBytes;
 
-      convert_s19(ptr, &ramImageStart, &numRamBytes, ramImage);
+    // for STM8S and 8kB STM8L upload RAM routines, else skip
+    if ((!useUpdater) && (routines_required(flashsize, family))) {
+
+      // select device dependent flash routines for upload
+      ramRoutines = routines_get(flashsize, versBSL);
+      if (!ramRoutines) {
+        setConsoleColor(PRM_COLOR_RED);
+        fprintf(stderr, "\n\nerror: unsupported device, exit!\n\n");
+        Exit(1, g_pauseOnExit);
+      }
 
+      // upload respective RAM routines to STM8
       if (g_verbose)
         printf("  Uploading RAM routines ... ");
-      bsl_memWrite(ptrPort, ramImageStart, numRamBytes, ramImage, 0);
+      board_phase(&board, ptrPort, SM_PHASE_ROUTINES, 1);
+      bsl_imageWrite(ptrPort, ramRoutines, 0);
+      board_phase(&board, ptrPort, SM_PHASE_ROUTINES, 0);
       if (g_verbose)
         printf("ok\n");
-    }
   
-  } // if STM8S or low-density STM8L -> upload RAM code
+    } // if STM8S or low-density STM8L -> upload RAM code
 
 
 
-  // if flash mass erase
-  if (flashErase) 
-    bsl_flashMassErase(ptrPort);
+    // if flash mass erase
+    if (flashErase) {
+      board_phase(&board, ptrPort, SM_PHASE_ERASE, 1);
+      if (useUpdater)
+        upd_erase(ptrPort, &updInfo);
+      else
+        bsl_flashMassErase(ptrPort);
+      board_phase(&board, ptrPort, SM_PHASE_ERASE, 0);
+    }
     
         
         
-  // if upload file to flash
-  if (strlen(fileIn)>0) {
+    // if upload file to flash
+    if (imageIn) {
   
-    // upload memory image to STM8
-    bsl_memWrite(ptrPort, imageInStart, imageInBytes, imageIn, 1);
+      // upload pre-framed memory image to STM8
+      board_phase(&board, ptrPort, SM_PHASE_WRITE, 1);
+      if (useUpdater)
+        upd_imageWrite(ptrPort, &updInfo, imageIn, 1);
+      else
+        bsl_imageWrite(ptrPort, imageIn, 1);
+      board_phase(&board, ptrPort, SM_PHASE_WRITE, 0);
+      bytesPayload += image_dataBytes(imageIn);
 
 
-    // optionally verify upload
-    if (verifyUpload==1) {
-      bsl_memRead(ptrPort, imageInStart, imageInBytes, imageOut, 1);
-      printf("  verify memory ... ");
-      for (i=0; i<imageInBytes; i++) {
-        if (imageIn[i] != imageOut[i]) {
-          printf("failed at address 0x%04x (0x%02x vs 0x%02x), exit!\n", (uint32_t) (imageInStart+i), (uint8_t) (imageIn[i]), (uint8_t) (imageOut[i]));
-          Exit(1, g_pauseOnExit);
-        }        
+      // optionally verify upload. The updater only returns the CRC of the range
+      if ((verifyUpload==1) && (useUpdater)) {
+        board_phase(&board, ptrPort, SM_PHASE_VERIFY, 1);
+        upd_verify(ptrPort, imageIn);
+        board_phase(&board, ptrPort, SM_PHASE_VERIFY, 0);
+      }
+      else if (verifyUpload==1) {
+        board_phase(&board, ptrPort, SM_PHASE_VERIFY, 1);
+        for (idx=0; (len=image_range(imageIn, &idx)) > 0; idx+=len)
+          bsl_memRead(ptrPort, imageIn->addrStart+idx, len, imageOut+idx, 1);
+        board_phase(&board, ptrPort, SM_PHASE_VERIFY, 0);
+        bytesPayload += image_dataBytes(imageIn);
+        printf("  verify memory ... ");
+        for (idx=0; (len=image_range(imageIn, &idx)) > 0; idx+=len) {
+          for (i=(int) idx; i<(int) (idx+len); i++) {
+            if (imageIn->data[i] != imageOut[i]) {
+              printf("failed at address 0x%04x (0x%02x vs 0x%02x), exit!\n", (uint32_t) (imageIn->addrStart+i), (uint8_t) (imageIn->data[i]), (uint8_t) (imageOut[i]));
+              Exit(1, g_pauseOnExit);
+            }
+          }
+        }
+        printf("ok\n");
       }
-      printf("ok\n");
-    }
     
     
-    // enable ROM bootloader after upload (option bytes always on same address)
-    if (enableBSL==1) {
-      if (g_verbose)
-        printf("  activate bootloader ... ");
-      bsl_memWrite(ptrPort, 0x487E, 2, (char*)"\x55\xAA", 0);
-      if (g_verbose)
-        printf("ok\n");
-    }
+      // enable ROM bootloader after upload (option bytes always on same address). BSL_activate keeps it enabled
+      if ((enableBSL==1) && (!useUpdater)) {
+        if (g_verbose)
+          printf("  activate bootloader ... ");
+        board_phase(&board, ptrPort, SM_PHASE_ACTIVATE, 1);
+        bsl_memWrite(ptrPort, 0x487E, 2, (char*)"\x55\xAA", 0);
+        board_phase(&board, ptrPort, SM_PHASE_ACTIVATE, 0);
+        if (g_verbose)
+          printf("ok\n");
+      }
   
-  } // if file upload to flash
+    } // if file upload to flash
   
   
   
-  ////////////////////
-  // read memory and dump to file
-  ////////////////////
-  if (strlen(fileOut)>0) {
+    ////////////////////
+    // read memory and dump to file
+    ////////////////////
+    if (strlen(fileOut)>0) {
 
-    const char *shortname = strrchr(fileOut, '/');
-    if (!shortname)
-      shortname = fileOut;
+      const char *shortname = strrchr(fileOut, '/');
+      if (!shortname)
+        shortname = fileOut;
 
-    // read memory
-    bsl_memRead(ptrPort, imageOutStart, imageOutBytes, imageOut, 1);
-  
-    // save to file, depending on file type
-    const char *dot = strrchr (fileOut, '.');
-    if (dot && !strcmp(dot, ".s19")) {
-      if (g_verbose)
-        printf("  save as Motorola S-record file '%s' ... ", shortname);
+      // read memory. The dump stub replaces the ROM bootloader until reset
+      if (useUpdater)
+        upd_memRead(ptrPort, imageOutStart, imageOutBytes, imageOut);
+      else if ((dumpBaud > 0) && (g_UARTmode == 0) && (family == STM8S)) {
+        trace_begin(TRACE_TID(ptrPort), "phase", "dump stub");
+        dump_start(ptrPort, dumpBaud);
+        trace_end(TRACE_TID(ptrPort), "phase", "dump stub");
+        useDump = 1;
+        trace_begin(TRACE_TID(ptrPort), "phase", "dump");
+        dump_memRead(ptrPort, imageOutStart, imageOutBytes, imageOut, 1);
+        trace_end(TRACE_TID(ptrPort), "phase", "dump");
+      }
       else
-        printf("  save to '%s' ... ", shortname);
-      export_s19(fileOut, imageOut, imageOutStart, imageOutBytes);
-      printf("ok\n");
+        bsl_memRead(ptrPort, imageOutStart, imageOutBytes, imageOut, 1);
+      bytesPayload += imageOutBytes;
+  
+      // save to archive or file, depending on file type
+      const char *dot = strrchr (fileOut, '.');
+      if (archive) {
+        char      name[ARCHIVE_PATHLEN];
+        uint32_t  numNew;
+        strncpy(name, (shortname[0] == '/') ? shortname+1 : shortname, ARCHIVE_PATHLEN-1);
+        name[ARCHIVE_PATHLEN-1] = '\0';
+        if (strrchr(name, '.'))
+          *strrchr(name, '.') = '\0';
+        numNew = archive_write(archive, name, imageOut, imageOutStart, imageOutBytes);
+        printf("  store as '%s' in archive ... ok (%d new blocks)\n", name, (int) numNew);
+      }
+      else if (dot && !strcmp(dot, ".s19")) {
+        if (g_verbose)
+          printf("  save as Motorola S-record file '%s' ... ", shortname);
+        else
+          printf("  save to '%s' ... ", shortname);
+        export_s19(fileOut, imageOut, imageOutStart, imageOutBytes);
+        printf("ok\n");
+      }
+      else if (dot && !strcmp(dot, ".txt")) {
+        if (g_verbose)
+          printf("  save as plain file to '%s' ... ", shortname);
+        else
+          printf("  save to '%s' ... ", shortname);
+        export_txt(fileOut, imageOut, imageOutStart, imageOutBytes);
+        printf("ok\n");
+      }
+      else {
+        setConsoleColor(PRM_COLOR_RED);
+        fprintf(stderr, "\n\nerror: unsupported export type '%s', exit!\n\n", dot);
+        Exit(1, g_pauseOnExit);
+      }
     }
-    else if (dot && !strcmp(dot, ".txt")) {
-      if (g_verbose)
-        printf("  save as plain file to '%s' ... ", shortname);
+  
+  
+
+    // jump to flash start address after done (reset vector always on same address)
+    if (jumpFlash) {
+      board_phase(&board, ptrPort, SM_PHASE_JUMP, 1);
+      if (useUpdater)
+        upd_jumpTo(ptrPort, PFLASH_START);
+      else if (useDump)
+        dump_jumpTo(ptrPort);
       else
-        printf("  save to '%s' ... ", shortname);
-      export_txt(fileOut, imageOut, imageOutStart, imageOutBytes);
-      printf("ok\n");
+        bsl_jumpTo(ptrPort, PFLASH_START);
+      board_phase(&board, ptrPort, SM_PHASE_JUMP, 0);
     }
-    else {
-      setConsoleColor(PRM_COLOR_RED);
-      fprintf(stderr, "\n\nerror: unsupported export type '%s', exit!\n\n", dot);
-      Exit(1, g_pauseOnExit);
+
+    // restore baudrate of ROM bootloader for next board
+    if ((useUpdater) || (useDump))
+      set_baudrate(ptrPort, baudrate);
+
+    // pipelining statistics. A probe session counts towards validation, a desync always blacklists the BSL version
+    bsl_pipelineStats(&numSpeculative, &numDesync);
+    if ((numSpeculative > 0) || (numDesync > 0)) {
+      printf("  pipelined %d commands, %d desync\n", (int) numSpeculative, (int) numDesync);
+      if ((pipeline == PIPE_PROBE) || (numDesync > 0))
+        pipe_record(family, versBSL, numDesync);
     }
-  }
-  
-  
+    bsl_setPipeline(0);
+
+    // done with this board
+    board_finish(&board, SM_STATUS_OK, ackRtt, bytesPayload);
+    image_release(imageIn);
 
-  // jump to flash start address after done (reset vector always on same address)
-  if (jumpFlash)
-    bsl_jumpTo(ptrPort, PFLASH_START);
+  } while (strlen(dirWatch) > 0); // loop over boards
+
+  // statistics of ACK round-trip times (all boards)
+  bsl_printAckRtt(ackRtt);
+  get_port_stats(&ioStats);
+  print_port_stats(&ioStats, bytesPayload, g_UARTmode);
+  
+  // station mode: stop watcher and print summary
+  if (strlen(dirWatch) > 0) {
+    setExitHandler(NULL);
+    watch_stop();
+    printf("\n  %d boards processed, %d failed\n", (int) (numBoards-1), (int) numFailed);
+  }
 
 
   ////////
   // clean up and exit
   ////////
   close_port(&ptrPort);
+  archive_close(archive);
+  telemetry_close();
+  metrics_close();
   printf("done with program\n");
   Exit(0, g_pauseOnExit);
   
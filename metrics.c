@@ -0,0 +1,294 @@
+/**
+  \file metrics.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief implementation of Prometheus textfile metrics
+
+  implementation of per-port counters, which are accumulated over all
+  sessions of a run (boards, gang jobs) and written in the Prometheus text
+  exposition format. The file is written to a temporary file in the same
+  directory and renamed, which is atomic on Posix. Example:
+    stm8flash_sessions_total{port="/dev/ttyUSB0"} 12
+    stm8flash_sessions_failed_total{port="/dev/ttyUSB0",phase="sync"} 1
+    stm8flash_phase_seconds_total{port="/dev/ttyUSB0",phase="write"} 7.82
+    stm8flash_ack_rtt_p99_seconds{port="/dev/ttyUSB0",stage="data"} 0.0163
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "metrics.h"
+#include "bootloader.h"
+#include "misc.h"
+#include "globals.h"
+
+// OS specific: Posix
+#if defined(__APPLE__) || defined(__unix__)
+  #include <pthread.h>
+#endif
+
+
+/// counters and gauges of a port
+typedef struct {
+  char        name[64];                       ///< name of port
+  char        label[130];                     ///< name of port, escaped as label value
+  uint32_t    numSessions;                    ///< number of finished sessions
+  uint32_t    numOk;                          ///< number of successful sessions
+  uint32_t    numFailed[SM_PHASE_DONE+1];     ///< number of failed sessions per phase
+  uint64_t    bytesWritten;                   ///< image bytes written
+  uint64_t    phaseUs[SM_PHASE_DONE+1];       ///< cumulative time per phase [us]
+  uint32_t    numRetry;                       ///< SYNC retries
+  uint32_t    numRelink;                      ///< link renegotiations
+  uint32_t    ackP99[ACK_NUM_STAGES];         ///< p99 ACK round-trip of last session [us]
+  uint32_t    throughput;                     ///< throughput of last successful session [B/s]
+  time_t      timeLast;                       ///< end of last session
+} port_metrics_t;
+
+
+// names of ACK stages (label values)
+static const char       *s_stageName[ACK_NUM_STAGES] = { "command", "address", "data" };
+
+// metrics file and counters of all ports
+static char             s_file[1000] = "";
+static port_metrics_t   *s_port = NULL;
+static uint32_t         s_numPorts = 0;
+
+// serialize updates of concurrent workers
+#if defined(__APPLE__) || defined(__unix__)
+  static pthread_mutex_t  s_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+
+
+/**
+  \fn void metrics_open(const char *filename)
+
+  \brief set metrics file
+
+  \param[in] filename   name of metrics file. Should end with .prom for node-exporter
+*/
+void metrics_open(const char *filename) {
+
+  strncpy(s_file, filename, sizeof(s_file)-1);
+
+} // metrics_open
+
+
+
+/**
+  \fn static void metrics_label(char *out, const char *in)
+
+  \brief escape label value as required by Prometheus text format
+
+  \param[out] out   escaped label value. Must hold 2*strlen(in)+1 chars
+  \param[in]  in    label value, e.g. port name
+*/
+static void metrics_label(char *out, const char *in) {
+
+  for (; *in; in++) {
+    if ((*in == '"') || (*in == '\\'))
+      *(out++) = '\\', *(out++) = *in;
+    else if (*in == '\n')
+      *(out++) = '\\', *(out++) = 'n';
+    else
+      *(out++) = *in;
+  }
+  *out = '\0';
+
+} // metrics_label
+
+
+
+/**
+  \fn static port_metrics_t *metrics_port(const char *name)
+
+  \brief get counters of port, add new port if required
+*/
+static port_metrics_t *metrics_port(const char *name) {
+
+  uint32_t  i;
+
+  for (i=0; i<s_numPorts; i++)
+    if (!strcmp(s_port[i].name, name))
+      return(&(s_port[i]));
+  s_port = (port_metrics_t*) realloc(s_port, (s_numPorts+1) * sizeof(port_metrics_t));
+  if (!s_port) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'metrics_port()': cannot allocate memory buffers, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+  memset(&(s_port[s_numPorts]), 0, sizeof(port_metrics_t));
+  strncpy(s_port[s_numPorts].name, name, sizeof(s_port[s_numPorts].name)-1);
+  metrics_label(s_port[s_numPorts].label, s_port[s_numPorts].name);
+  return(&(s_port[s_numPorts++]));
+
+} // metrics_port
+
+
+
+/**
+  \fn static void metrics_header(FILE *fp, const char *name, const char *type, const char *help)
+
+  \brief write HELP and TYPE lines of a metric
+*/
+static void metrics_header(FILE *fp, const char *name, const char *type, const char *help) {
+
+  fprintf(fp, "# HELP stm8flash_%s %s\n", name, help);
+  fprintf(fp, "# TYPE stm8flash_%s %s\n", name, type);
+
+} // metrics_header
+
+
+
+/**
+  \fn static void metrics_dump(void)
+
+  \brief write all metrics to temporary file and replace metrics file
+*/
+static void metrics_dump(void) {
+
+  char      tmp[1010];
+  FILE      *fp;
+  uint32_t  i;
+  uint8_t   phase, stage;
+
+  snprintf(tmp, sizeof(tmp), "%s.tmp", s_file);
+  if (!(fp = fopen(tmp, "w"))) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'metrics_dump()': cannot create '%s', exit!\n\n", tmp);
+    Exit(1, g_pauseOnExit);
+  }
+
+  // counters per port
+  metrics_header(fp, "sessions_total", "counter", "Number of finished BSL sessions.");
+  for (i=0; i<s_numPorts; i++)
+    fprintf(fp, "stm8flash_sessions_total{port=\"%s\"} %u\n", s_port[i].label, s_port[i].numSessions);
+  metrics_header(fp, "sessions_ok_total", "counter", "Number of successful BSL sessions.");
+  for (i=0; i<s_numPorts; i++)
+    fprintf(fp, "stm8flash_sessions_ok_total{port=\"%s\"} %u\n", s_port[i].label, s_port[i].numOk);
+  metrics_header(fp, "sessions_failed_total", "counter", "Number of failed BSL sessions by failed phase.");
+  for (i=0; i<s_numPorts; i++)
+    for (phase=SM_PHASE_SYNC; phase<SM_PHASE_DONE; phase++)
+      fprintf(fp, "stm8flash_sessions_failed_total{port=\"%s\",phase=\"%s\"} %u\n", s_port[i].label,
+        bsl_sm_phaseName(phase), s_port[i].numFailed[phase]);
+  metrics_header(fp, "bytes_written_total", "counter", "Number of image bytes written to flash.");
+  for (i=0; i<s_numPorts; i++)
+    fprintf(fp, "stm8flash_bytes_written_total{port=\"%s\"} %llu\n", s_port[i].label, (unsigned long long) s_port[i].bytesWritten);
+  metrics_header(fp, "phase_seconds_total", "counter", "Cumulative duration of BSL session phases.");
+  for (i=0; i<s_numPorts; i++)
+    for (phase=SM_PHASE_SYNC; phase<SM_PHASE_DONE; phase++)
+      fprintf(fp, "stm8flash_phase_seconds_total{port=\"%s\",phase=\"%s\"} %1.6f\n", s_port[i].label,
+        bsl_sm_phaseName(phase), (double) s_port[i].phaseUs[phase] / 1000000.0);
+  metrics_header(fp, "sync_retries_total", "counter", "Number of SYNC retries.");
+  for (i=0; i<s_numPorts; i++)
+    fprintf(fp, "stm8flash_sync_retries_total{port=\"%s\"} %u\n", s_port[i].label, s_port[i].numRetry);
+  metrics_header(fp, "relinks_total", "counter", "Number of link renegotiations.");
+  for (i=0; i<s_numPorts; i++)
+    fprintf(fp, "stm8flash_relinks_total{port=\"%s\"} %u\n", s_port[i].label, s_port[i].numRelink);
+
+  // gauges of last session
+  metrics_header(fp, "ack_rtt_p99_seconds", "gauge", "99th percentile of send-to-ACK round-trip in last session.");
+  for (i=0; i<s_numPorts; i++)
+    for (stage=0; stage<ACK_NUM_STAGES; stage++)
+      fprintf(fp, "stm8flash_ack_rtt_p99_seconds{port=\"%s\",stage=\"%s\"} %1.6f\n", s_port[i].label,
+        s_stageName[stage], (double) s_port[i].ackP99[stage] / 1000000.0);
+  metrics_header(fp, "throughput_bytes_per_second", "gauge", "Image throughput of last successful session.");
+  for (i=0; i<s_numPorts; i++)
+    fprintf(fp, "stm8flash_throughput_bytes_per_second{port=\"%s\"} %u\n", s_port[i].label, s_port[i].throughput);
+  metrics_header(fp, "last_session_timestamp_seconds", "gauge", "End of last session as Unix time.");
+  for (i=0; i<s_numPorts; i++)
+    fprintf(fp, "stm8flash_last_session_timestamp_seconds{port=\"%s\"} %lld\n", s_port[i].label, (long long) s_port[i].timeLast);
+
+  // replace file atomically
+  if (fclose(fp) || rename(tmp, s_file)) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'metrics_dump()': cannot write '%s', exit!\n\n", s_file);
+    Exit(1, g_pauseOnExit);
+  }
+
+} // metrics_dump
+
+
+
+/**
+  \fn void metrics_write(const bsl_sm_t *sm)
+
+  \brief add finished session to counters and rewrite metrics file
+
+  \param[in] sm     finished session
+
+  Does nothing if no metrics file is set
+*/
+void metrics_write(const bsl_sm_t *sm) {
+
+  port_metrics_t  *port;
+  uint8_t         phase, stage;
+  uint64_t        end, duration;
+
+  if (s_file[0] == '\0')
+    return;
+
+#if defined(__APPLE__) || defined(__unix__)
+  pthread_mutex_lock(&s_lock);
+#endif
+
+  // session result. A failed session ends within its current phase
+  port = metrics_port(sm->name);
+  port->numSessions++;
+  if (sm->status == SM_STATUS_OK)
+    port->numOk++;
+  else
+    port->numFailed[sm->phase]++;
+  port->numRetry  += sm->retry;
+  port->numRelink += sm->numRelink;
+  if (sm->phaseEnd[SM_PHASE_WRITE] != 0)
+    port->bytesWritten += image_dataBytes(sm->cfg->image);
+
+  // time per phase
+  for (phase=SM_PHASE_SYNC; phase<SM_PHASE_DONE; phase++) {
+    end = sm->phaseEnd[phase];
+    if ((end == 0) && (phase == sm->phase) && (sm->status == SM_STATUS_FAILED))
+      end = sm->timeEnd;
+    if ((sm->phaseStart[phase] != 0) && (end != 0))
+      port->phaseUs[phase] += end - sm->phaseStart[phase];
+  }
+
+  // gauges of last session
+  for (stage=0; stage<ACK_NUM_STAGES; stage++)
+    port->ackP99[stage] = hist_percentile(&(sm->ackRtt[stage]), 99.0);
+  duration = sm->timeEnd - sm->timeStart;
+  if ((sm->status == SM_STATUS_OK) && (duration > 0))
+    port->throughput = (uint32_t) ((uint64_t) image_dataBytes(sm->cfg->image) * 1000000 / duration);
+  port->timeLast = time(NULL);
+
+  metrics_dump();
+
+#if defined(__APPLE__) || defined(__unix__)
+  pthread_mutex_unlock(&s_lock);
+#endif
+
+} // metrics_write
+
+
+
+/**
+  \fn void metrics_close(void)
+
+  \brief release metrics (file is kept)
+*/
+void metrics_close(void) {
+
+  free(s_port);
+  s_port = NULL;
+  s_numPorts = 0;
+  s_file[0] = '\0';
+
+} // metrics_close
+
+// end of file
@@ -0,0 +1,37 @@
+/**
+  \file metrics.h
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief declaration of Prometheus textfile metrics
+
+  declaration of routines for maintaining counters and gauges per port and
+  writing them in the Prometheus text format, e.g. for the textfile collector
+  of node-exporter. The file is replaced atomically after each session, so
+  the collector never reads a partial file.
+*/
+
+// for including file only once
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+
+// include files
+#include <stdint.h>
+#include "bsl_sm.h"
+
+
+/// set metrics file (*.prom). Counters start at zero
+void        metrics_open(const char *filename);
+
+/// add finished session to counters of its port and rewrite metrics file. Thread safe
+void        metrics_write(const bsl_sm_t *sm);
+
+/// release metrics
+void        metrics_close(void);
+
+#endif // _METRICS_H_
+
+// end of file
@@ -21,6 +21,7 @@
 #include <string.h>
 #include <stdint.h>
 #include <stdarg.h>
+#include <setjmp.h>
 
 // color codes 
 #define PRM_COLOR_DEFAULT       0
@@ -48,6 +49,15 @@ void Error(const char *format, ...);
 /// terminate program after cleaning up
 void        Exit(uint8_t code, uint8_t pause);
 
+/// redirect Exit() on error to a recovery point of the calling thread (NULL=terminate)
+jmp_buf     *setExitHandler(jmp_buf *env);
+
+/// calculate CRC32 (IEEE 802.3) over buffer
+uint32_t    crc32(uint32_t crc, const void *buf, uint32_t len);
+
+/// get time from monotonic clock [us]
+uint64_t    time_us(void);
+
 /// strip path from application name
 void        stripPath(char *in, char *out);
 
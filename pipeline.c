@@ -0,0 +1,176 @@
+/**
+  \file pipeline.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief implementation of whitelist for speculative BSL pipelining
+
+  implementation of the per-BSL-version whitelist for pipelining (see
+  pipeline.h). A version is validated after PIPE_MIN_SESSIONS probe sessions
+  without desync. A single desync blacklists the version, as a lost command
+  costs a resync which is more than pipelining saves in a session.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "pipeline.h"
+#include "bootloader.h"
+#include "misc.h"
+#include "globals.h"
+
+
+/// BSL versions validated on hardware (family, version). None yet, add after probe runs on real boards
+static const struct { uint8_t family; uint8_t vers; } s_validated[] = {
+  { 0, 0 }      // end of list
+};
+
+
+
+/**
+  \fn static void pipe_file(char *file, uint32_t size)
+
+  \brief name of whitelist file in home directory
+*/
+static void pipe_file(char *file, uint32_t size) {
+
+  const char  *home = getenv("HOME");
+
+  if (!home)
+    home = getenv("USERPROFILE");
+  snprintf(file, size, "%s/.STM8_serial_flasher_pipeline", home ? home : ".");
+
+} // pipe_file
+
+
+
+/**
+  \fn static uint8_t pipe_load(uint8_t family, uint8_t vers, uint32_t *numSessions, uint32_t *numDesync)
+
+  \brief get probe results of BSL version from whitelist file
+
+  \return 1 if found, else 0
+*/
+static uint8_t pipe_load(uint8_t family, uint8_t vers, uint32_t *numSessions, uint32_t *numDesync) {
+
+  char      file[1000], line[200], name[20];
+  unsigned  v, sessions, desync;
+  uint8_t   found = 0;
+  FILE      *fp;
+
+  *numSessions = 0;
+  *numDesync   = 0;
+  pipe_file(file, sizeof(file));
+  if (!(fp = fopen(file, "r")))
+    return(0);
+  while ((!found) && fgets(line, sizeof(line), fp)) {
+    if ((line[0] == '#') || (sscanf(line, "%19s %x %u %u", name, &v, &sessions, &desync) != 4))
+      continue;
+    if ((strcmp(name, (family == STM8L) ? "STM8L" : "STM8S")) || (v != vers))
+      continue;
+    *numSessions = sessions;
+    *numDesync   = desync;
+    found = 1;
+  }
+  fclose(fp);
+
+  return(found);
+
+} // pipe_load
+
+
+
+/**
+  \fn uint8_t pipe_allowed(uint8_t family, uint8_t vers, uint8_t mode)
+
+  \brief check whether pipelining is allowed for BSL version. Prints decision
+
+  \param[in] family     device family (STM8S or STM8L)
+  \param[in] vers       BSL version (see bsl_getInfo())
+  \param[in] mode       pipelining mode (PIPE_OFF, PIPE_WHITELIST or PIPE_PROBE)
+
+  \return 1 if the next command may be sent before the ACK of the data phase
+*/
+uint8_t pipe_allowed(uint8_t family, uint8_t vers, uint8_t mode) {
+
+  uint32_t  numSessions, numDesync;
+  uint8_t   i, allowed = 0;
+
+  if (mode == PIPE_OFF)
+    return(0);
+
+  // built-in whitelist
+  for (i=0; s_validated[i].family != 0; i++)
+    if ((s_validated[i].family == family) && (s_validated[i].vers == vers))
+      allowed = 1;
+
+  // probe results: a desync always disables, validated after PIPE_MIN_SESSIONS
+  pipe_load(family, vers, &numSessions, &numDesync);
+  if (numDesync > 0)
+    allowed = 0;
+  else if (numSessions >= PIPE_MIN_SESSIONS)
+    allowed = 1;
+  else if ((mode == PIPE_PROBE) && (!allowed)) {
+    printf("  pipelining BSL v%x.%x ... probe (%d of %d sessions)\n", (vers & 0xF0) >> 4, vers & 0x0F, (int) numSessions + 1, PIPE_MIN_SESSIONS);
+    return(1);
+  }
+  printf("  pipelining BSL v%x.%x ... %s\n", (vers & 0xF0) >> 4, vers & 0x0F, allowed ? "on" : ((numDesync > 0) ? "off (desync in probe)" : "off (not validated)"));
+
+  return(allowed);
+
+} // pipe_allowed
+
+
+
+/**
+  \fn void pipe_record(uint8_t family, uint8_t vers, uint32_t numDesync)
+
+  \brief record result of probe session for BSL version
+
+  \param[in] family     device family (STM8S or STM8L)
+  \param[in] vers       BSL version (see bsl_getInfo())
+  \param[in] numDesync  number of desyncs in session (0=pipelining was tolerated)
+*/
+void pipe_record(uint8_t family, uint8_t vers, uint32_t numDesync) {
+
+  char      file[1000], tmp[1010], line[200], name[20];
+  unsigned  v;
+  uint32_t  numSessions, numDesyncOld;
+  FILE      *fpIn, *fpOut;
+
+  // copy other versions to temporary file
+  pipe_load(family, vers, &numSessions, &numDesyncOld);
+  pipe_file(file, sizeof(file));
+  snprintf(tmp, sizeof(tmp), "%s.tmp", file);
+  if (!(fpOut = fopen(tmp, "w"))) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'pipe_record()': cannot create '%s', exit!\n\n", tmp);
+    Exit(1, g_pauseOnExit);
+  }
+  fprintf(fpOut, "# family version sessions desyncs\n");
+  if ((fpIn = fopen(file, "r"))) {
+    while (fgets(line, sizeof(line), fpIn)) {
+      if ((line[0] == '#') || (sscanf(line, "%19s %x", name, &v) != 2))
+        continue;
+      if ((!strcmp(name, (family == STM8L) ? "STM8L" : "STM8S")) && (v == vers))
+        continue;
+      fputs(line, fpOut);
+    }
+    fclose(fpIn);
+  }
+
+  // append updated result and replace file
+  fprintf(fpOut, "%s 0x%02x %d %d\n", (family == STM8L) ? "STM8L" : "STM8S", (int) vers, (int) numSessions + 1, (int) (numDesyncOld + numDesync));
+  if (fclose(fpOut) || rename(tmp, file)) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'pipe_record()': cannot write '%s', exit!\n\n", file);
+    Exit(1, g_pauseOnExit);
+  }
+
+} // pipe_record
+
+// end of file
@@ -0,0 +1,47 @@
+/**
+  \file pipeline.h
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief declaration of whitelist for speculative BSL pipelining
+
+  declaration of routines for deciding whether the next WRITE or READ
+  command may be sent before the ACK of the previous data phase has arrived
+  (see bsl_setPipeline()). The ROM bootloader polls its UART, so bytes
+  received while it programs flash or sends data may be lost, depending on
+  the BSL version. Pipelining is therefore only used for BSL versions which
+  are validated, either built-in (tested on hardware) or by probe sessions
+  without desync, which are recorded in ~/.STM8_serial_flasher_pipeline:
+    # family version sessions desyncs
+    STM8S 0x22 5 0
+*/
+
+// for including file only once
+#ifndef _PIPELINE_H_
+#define _PIPELINE_H_
+
+
+// include files
+#include <stdint.h>
+
+
+/// pipelining modes (option --pipeline)
+#define PIPE_OFF            0         ///< strict lock-step (default)
+#define PIPE_WHITELIST      1         ///< pipeline validated BSL versions only
+#define PIPE_PROBE          2         ///< also probe unknown BSL versions and record result
+
+/// min. number of probe sessions without desync for validating a BSL version
+#define PIPE_MIN_SESSIONS   3
+
+
+/// check whether pipelining is allowed for BSL version. Prints decision
+uint8_t     pipe_allowed(uint8_t family, uint8_t vers, uint8_t mode);
+
+/// record result of probe session for BSL version
+void        pipe_record(uint8_t family, uint8_t vers, uint32_t numDesync);
+
+#endif // _PIPELINE_H_
+
+// end of file
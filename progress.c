@@ -0,0 +1,303 @@
+/**
+  \file progress.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief implementation of progress counters and terminal dashboard
+
+  implementation of lock-free progress counters and a terminal dashboard.
+  Each slot has a single writer (the session of the port), so plain atomic
+  loads and stores are sufficient. The renderer thread composes the complete
+  dashboard in a buffer and writes it with a single call, using ANSI escape
+  sequences to redraw it in place. A slow terminal only delays the renderer.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "progress.h"
+#include "bsl_sm.h"
+#include "misc.h"
+#include "globals.h"
+
+// OS specific: Posix
+#if defined(__APPLE__) || defined(__unix__)
+  #include <pthread.h>
+  #include <unistd.h>
+#endif
+
+
+// single writer per field -> relaxed atomics
+#define STORE(field, val)   __atomic_store_n(&(field), (val), __ATOMIC_RELAXED)
+#define LOAD(field)         __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+
+// progress slots
+static progress_t     s_slot[PROGRESS_MAX_SLOTS];
+static uint32_t       s_numSlots = 0;
+
+// renderer thread
+#if defined(__APPLE__) || defined(__unix__)
+  static pthread_t    s_thread;
+#endif
+static volatile int   s_stop = 0;
+static uint8_t        s_running = 0;
+static uint32_t       s_period;
+static uint32_t       s_numLines = 0;         // number of lines drawn in last frame
+
+
+
+/**
+  \fn progress_t *progress_register(const char *name)
+
+  \brief get progress slot for port
+
+  \param[in] name   name of port (for output)
+
+  \return progress slot, or NULL if all slots are used. All functions accept NULL
+*/
+progress_t *progress_register(const char *name) {
+
+  uint32_t      idx;
+  progress_t    *p;
+
+  idx = __atomic_fetch_add(&s_numSlots, 1, __ATOMIC_ACQ_REL);
+  if (idx >= PROGRESS_MAX_SLOTS)
+    return(NULL);
+  p = &(s_slot[idx]);
+  strncpy(p->name, name, sizeof(p->name)-1);
+  return(p);
+
+} // progress_register
+
+
+
+/**
+  \fn void progress_begin(progress_t *p, uint32_t bytesTotal)
+
+  \brief start new session
+
+  \param[in] p            progress slot (or NULL)
+  \param[in] bytesTotal   number of bytes to write and verify
+*/
+void progress_begin(progress_t *p, uint32_t bytesTotal) {
+
+  if (!p)
+    return;
+  STORE(p->bytesDone, 0);
+  STORE(p->bytesTotal, bytesTotal);
+  STORE(p->phase, SM_PHASE_IDLE);
+  STORE(p->status, SM_STATUS_RUNNING);
+  STORE(p->timeEnd, 0);
+  STORE(p->timeStart, time_us());
+
+} // progress_begin
+
+
+
+/**
+  \fn void progress_phase(progress_t *p, uint8_t phase)
+
+  \brief set phase of session
+*/
+void progress_phase(progress_t *p, uint8_t phase) {
+
+  if (p)
+    STORE(p->phase, phase);
+
+} // progress_phase
+
+
+
+/**
+  \fn void progress_add(progress_t *p, uint32_t bytes)
+
+  \brief add transferred bytes
+*/
+void progress_add(progress_t *p, uint32_t bytes) {
+
+  if (p)
+    STORE(p->bytesDone, LOAD(p->bytesDone) + bytes);
+
+} // progress_add
+
+
+
+/**
+  \fn void progress_retry(progress_t *p)
+
+  \brief count retry
+*/
+void progress_retry(progress_t *p) {
+
+  if (p)
+    STORE(p->retries, LOAD(p->retries) + 1);
+
+} // progress_retry
+
+
+
+/**
+  \fn void progress_end(progress_t *p, uint8_t status)
+
+  \brief end session
+
+  \param[in] p        progress slot (or NULL)
+  \param[in] status   SM_STATUS_OK or SM_STATUS_FAILED
+*/
+void progress_end(progress_t *p, uint8_t status) {
+
+  if (!p)
+    return;
+  STORE(p->timeEnd, time_us());
+  if (status == SM_STATUS_OK)
+    STORE(p->numOk, LOAD(p->numOk) + 1);
+  else
+    STORE(p->numFailed, LOAD(p->numFailed) + 1);
+  STORE(p->status, status);
+
+} // progress_end
+
+
+
+/**
+  \fn static void progress_draw(void)
+
+  \brief draw dashboard (redraw in place after first call)
+*/
+static void progress_draw(void) {
+
+  static char   buf[(PROGRESS_MAX_SLOTS+2)*120];
+  uint32_t      i, num, len = 0, done, total;
+  uint64_t      start, end;
+  float         duration, rate, eta;
+  const char    *phase;
+  progress_t    *p;
+
+  num = LOAD(s_numSlots);
+  if (num > PROGRESS_MAX_SLOTS)
+    num = PROGRESS_MAX_SLOTS;
+
+  // move cursor to start of previous frame
+  if (s_numLines > 0)
+    len += sprintf(buf+len, "\033[%dA", (int) s_numLines);
+
+  // header
+  len += sprintf(buf+len, "\033[2K  %-24s %-13s %5s %9s %7s %7s %9s\n", "port", "phase", "%", "kB/s", "retries", "ETA", "ok/fail");
+
+  // one line per port
+  for (i=0; i<num; i++) {
+    p     = &(s_slot[i]);
+    start = LOAD(p->timeStart);
+    end   = LOAD(p->timeEnd);
+    done  = LOAD(p->bytesDone);
+    total = LOAD(p->bytesTotal);
+
+    // calculate rate and ETA of current session
+    duration = (start == 0) ? 0.0 : (float) (((end != 0) ? end : time_us()) - start) / 1000000.0;
+    rate = (duration > 0.0) ? (float) done / duration : 0.0;
+    eta  = ((rate > 0.0) && (total > done) && (end == 0)) ? (float) (total - done) / rate : 0.0;
+
+    // phase or result
+    if (start == 0)
+      phase = "waiting";
+    else if (LOAD(p->status) == SM_STATUS_FAILED)
+      phase = "FAILED";
+    else
+      phase = bsl_sm_phaseName(LOAD(p->phase));
+
+    len += sprintf(buf+len, "\033[2K  %-24.24s %-13s %4d%% %9.1f %7d %6.1fs %4d/%-4d\n", p->name, phase,
+      (total > 0) ? (int) ((uint64_t) done * 100 / total) : 0, rate / 1024.0, (int) LOAD(p->retries), eta,
+      (int) LOAD(p->numOk), (int) LOAD(p->numFailed));
+  }
+  s_numLines = num + 1;
+
+  // output complete frame at once
+  fwrite(buf, 1, len, stdout);
+  fflush(stdout);
+
+} // progress_draw
+
+
+
+#if defined(__APPLE__) || defined(__unix__)
+
+/**
+  \fn static void *progress_thread(void *arg)
+
+  \brief renderer thread: redraw dashboard periodically
+*/
+static void *progress_thread(void *arg) {
+
+  while (!s_stop) {
+    progress_draw();
+    SLEEP(s_period);
+  }
+  return(NULL);
+
+} // progress_thread
+
+#endif // __APPLE__ || __unix__
+
+
+
+/**
+  \fn void progress_start(uint32_t period)
+
+  \brief start renderer thread
+
+  \param[in] period   refresh period [ms]
+
+  start background thread, which redraws the dashboard of all registered
+  slots at a fixed rate. Other console output must be avoided until
+  progress_stop() is called
+*/
+void progress_start(uint32_t period) {
+
+  s_period   = period;
+  s_stop     = 0;
+  s_numLines = 0;
+
+#if defined(__APPLE__) || defined(__unix__)
+  if (pthread_create(&s_thread, NULL, progress_thread, NULL) != 0) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'progress_start()': cannot start thread, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+  s_running = 1;
+#endif // __APPLE__ || __unix__
+
+} // progress_start
+
+
+
+/**
+  \fn void progress_stop(void)
+
+  \brief stop renderer thread
+
+  stop renderer thread, draw final state and release all slots
+*/
+void progress_stop(void) {
+
+#if defined(__APPLE__) || defined(__unix__)
+  if (s_running) {
+    s_stop = 1;
+    pthread_join(s_thread, NULL);
+    s_running = 0;
+  }
+#endif // __APPLE__ || __unix__
+
+  // final state and reset slots
+  progress_draw();
+  memset(s_slot, 0, sizeof(s_slot));
+  s_numSlots = 0;
+  s_numLines = 0;
+
+} // progress_stop
+
+// end of file
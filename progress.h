@@ -0,0 +1,69 @@
+/**
+  \file progress.h
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief declaration of progress counters and terminal dashboard
+
+  declaration of lock-free progress counters for concurrent sessions, and of
+  a renderer thread drawing them as terminal dashboard at a fixed refresh rate.
+  Sessions only update their own counters and never wait for the terminal.
+*/
+
+// for including file only once
+#ifndef _PROGRESS_H_
+#define _PROGRESS_H_
+
+
+// include files
+#include <stdint.h>
+
+
+/// max. number of progress slots (ports)
+#define PROGRESS_MAX_SLOTS    256
+
+
+/// progress counters of one port. Written by the owning session only, read by renderer
+typedef struct {
+  char              name[64];       ///< name of port
+  uint8_t           phase;          ///< current phase (see bsl_sm.h)
+  uint8_t           status;         ///< status of current or last session (see bsl_sm.h)
+  uint32_t          bytesDone;      ///< bytes written and verified in current session
+  uint32_t          bytesTotal;     ///< bytes to write and verify in current session
+  uint32_t          retries;        ///< number of retries (all sessions)
+  uint32_t          numOk;          ///< number of successful sessions
+  uint32_t          numFailed;      ///< number of failed sessions
+  uint64_t          timeStart;      ///< start of current session [us]
+  uint64_t          timeEnd;        ///< end of current session [us], 0=running
+} progress_t;
+
+
+/// get progress slot for port. Returns NULL if no slot is free
+progress_t  *progress_register(const char *name);
+
+/// start new session with given number of bytes to transfer
+void        progress_begin(progress_t *p, uint32_t bytesTotal);
+
+/// set phase of session
+void        progress_phase(progress_t *p, uint8_t phase);
+
+/// add transferred bytes
+void        progress_add(progress_t *p, uint32_t bytes);
+
+/// count retry
+void        progress_retry(progress_t *p);
+
+/// end session with status
+void        progress_end(progress_t *p, uint8_t status);
+
+/// start renderer thread with refresh period [ms]
+void        progress_start(uint32_t period);
+
+/// draw final state, stop renderer thread and release slots
+void        progress_stop(void);
+
+#endif // _PROGRESS_H_
+
+// end of file
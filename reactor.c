@@ -0,0 +1,250 @@
+/**
+  \file reactor.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief implementation of event loop for BSL sessions
+
+  implementation of a single threaded event loop for BSL session state machines.
+  All ports are multiplexed via poll(). When a port is ready, or the deadline of
+  a session has passed, the session is resumed. The poll timeout is derived from
+  the earliest deadline, so idle sessions don't cost CPU time.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "reactor.h"
+#include "misc.h"
+#include "globals.h"
+
+// OS specific: Posix
+#if defined(__APPLE__) || defined(__unix__)
+  #include <poll.h>
+  #include <errno.h>
+#endif
+
+
+
+/**
+  \fn static void print_result(const bsl_sm_t *sm)
+
+  \brief print result of finished session
+*/
+static void print_result(const bsl_sm_t *sm) {
+
+  float   duration = (float) (sm->timeEnd - sm->timeStart) / 1000000.0;
+
+  if ((sm->status == SM_STATUS_OK) && (sm->link.numDown + sm->link.numUp + sm->numRelink > 0))
+    printf("  %s: ok (%d frames in %1.2fs, %d relinks, %d Baud)\n", sm->name, (int) sm->numFrames, duration,
+      (int) (sm->numRelink + sm->link.numUp), (int) sm->link.baud);
+  else if (sm->status == SM_STATUS_OK)
+    printf("  %s: ok (%d frames in %1.2fs)\n", sm->name, (int) sm->numFrames, duration);
+  else {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "  %s: failed in phase '%s': %s\n", sm->name, bsl_sm_phaseName(sm->phase), sm->error);
+    setConsoleColor(PRM_COLOR_DEFAULT);
+  }
+  fflush(stdout);
+
+} // print_result
+
+
+
+#if defined(__APPLE__) || defined(__unix__)
+
+/**
+  \fn static uint32_t reactor_poll(bsl_sm_t **sm, uint32_t numSessions, struct pollfd *pfd, uint32_t *map, int maxWait, uint8_t verbose)
+
+  \brief handle expired deadlines, wait for I/O and resume sessions once
+
+  \param[in] sm           started sessions
+  \param[in] numSessions  number of sessions
+  \param[in] pfd          buffer for poll descriptors (numSessions)
+  \param[in] map          buffer for index of session per descriptor (numSessions)
+  \param[in] maxWait      max. wait time [ms] (<0=until next event or deadline)
+  \param[in] verbose      print result of each session when finished
+
+  \return number of sessions running before the wait (0=all finished)
+*/
+static uint32_t reactor_poll(bsl_sm_t **sm, uint32_t numSessions, struct pollfd *pfd, uint32_t *map, int maxWait, uint8_t verbose) {
+
+  uint32_t        i, numActive;
+  uint64_t        now, next;
+  int             timeout;
+
+  // handle expired deadlines and collect active sessions
+  now  = time_us();
+  next = UINT64_MAX;
+  numActive = 0;
+  for (i=0; i<numSessions; i++) {
+    if (sm[i]->status != SM_STATUS_RUNNING)
+      continue;
+    bsl_sm_timeout(sm[i], now);
+    if (sm[i]->status != SM_STATUS_RUNNING) {
+      if (verbose)
+        print_result(sm[i]);
+      continue;
+    }
+    pfd[numActive].fd      = sm[i]->fd;
+    pfd[numActive].events  = bsl_sm_events(sm[i]);
+    pfd[numActive].revents = 0;
+    map[numActive++] = i;
+    if ((sm[i]->deadline != 0) && (sm[i]->deadline < next))
+      next = sm[i]->deadline;
+  }
+  if (numActive == 0)
+    return(0);
+
+  // wait for I/O or earliest deadline (round up to avoid busy loop)
+  if (next == UINT64_MAX)
+    timeout = -1;
+  else if (next <= now)
+    timeout = 0;
+  else
+    timeout = (int) ((next - now + 999) / 1000);
+  if ((maxWait >= 0) && ((timeout < 0) || (timeout > maxWait)))
+    timeout = maxWait;
+  if ((poll(pfd, numActive, timeout) < 0) && (errno != EINTR)) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'reactor_poll()': poll failed, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+  for (i=0; i<numActive; i++)
+    sm[map[i]]->io.numPoll++;
+
+  // resume sessions with I/O events
+  for (i=0; i<numActive; i++) {
+    if (pfd[i].revents == 0)
+      continue;
+    bsl_sm_io(sm[map[i]], pfd[i].revents);
+    if ((sm[map[i]]->status != SM_STATUS_RUNNING) && (verbose))
+      print_result(sm[map[i]]);
+  }
+
+  return(numActive);
+
+} // reactor_poll
+
+#endif // __APPLE__ || __unix__
+
+
+
+/**
+  \fn uint32_t reactor_run(bsl_sm_t *sm, uint32_t numSessions, uint8_t verbose)
+
+  \brief run sessions until all are finished
+
+  \param[in] sm           array of initialized sessions (see bsl_sm_init())
+  \param[in] numSessions  number of sessions
+  \param[in] verbose      print result of each session when finished
+
+  \return number of failed sessions
+
+  start all sessions and multiplex them in the calling thread until each one
+  either completed or failed. A failed session doesn't affect the others
+*/
+uint32_t reactor_run(bsl_sm_t *sm, uint32_t numSessions, uint8_t verbose) {
+
+#if defined(__APPLE__) || defined(__unix__)
+
+  struct pollfd   *pfd;           // poll descriptors of active sessions
+  uint32_t        *map;           // index of session for poll descriptor
+  bsl_sm_t        **list;         // sessions
+  uint32_t        i, numFailed = 0;
+
+  // allocate buffers
+  pfd  = (struct pollfd*) malloc(numSessions * sizeof(struct pollfd) + 1);
+  map  = (uint32_t*) malloc(numSessions * sizeof(uint32_t) + 1);
+  list = (bsl_sm_t**) malloc(numSessions * sizeof(bsl_sm_t*) + 1);
+  if ((!pfd) || (!map) || (!list)) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'reactor_run()': cannot allocate memory buffers, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+
+  // start all sessions
+  for (i=0; i<numSessions; i++) {
+    list[i] = &(sm[i]);
+    bsl_sm_start(&(sm[i]));
+    if ((sm[i].status != SM_STATUS_RUNNING) && (verbose))
+      print_result(&(sm[i]));
+  }
+
+  // loop until all sessions finished
+  while (reactor_poll(list, numSessions, pfd, map, -1, verbose) > 0);
+
+  // release buffers and count failed sessions
+  free(pfd);
+  free(map);
+  free(list);
+  for (i=0; i<numSessions; i++)
+    numFailed += (sm[i].status == SM_STATUS_FAILED);
+
+  return(numFailed);
+
+#else
+
+  setConsoleColor(PRM_COLOR_RED);
+  fprintf(stderr, "\n\nerror in 'reactor_run()': not supported on this OS, exit!\n\n");
+  Exit(1, g_pauseOnExit);
+  return(numSessions);
+
+#endif // __APPLE__ || __unix__
+
+} // reactor_run
+
+
+
+/**
+  \fn uint32_t reactor_step(bsl_sm_t **sm, uint32_t numSessions, int maxWait, uint8_t verbose)
+
+  \brief run started sessions for one I/O wait
+
+  \param[in] sm           sessions started via bsl_sm_start(). Finished ones are skipped
+  \param[in] numSessions  number of sessions
+  \param[in] maxWait      max. wait time [ms] (<0=until next event or deadline)
+  \param[in] verbose      print result of each session when finished
+
+  \return number of sessions running before the wait (0=all finished)
+
+  for callers which add sessions while others are running, e.g. a gang thread
+  serving several fixtures. maxWait limits the time until the caller regains
+  control, e.g. to start jobs on idle fixtures
+*/
+uint32_t reactor_step(bsl_sm_t **sm, uint32_t numSessions, int maxWait, uint8_t verbose) {
+
+#if defined(__APPLE__) || defined(__unix__)
+
+  struct pollfd   *pfd;
+  uint32_t        *map, numActive;
+
+  pfd = (struct pollfd*) malloc(numSessions * sizeof(struct pollfd) + 1);
+  map = (uint32_t*) malloc(numSessions * sizeof(uint32_t) + 1);
+  if ((!pfd) || (!map)) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'reactor_step()': cannot allocate memory buffers, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+  numActive = reactor_poll(sm, numSessions, pfd, map, maxWait, verbose);
+  free(pfd);
+  free(map);
+
+  return(numActive);
+
+#else
+
+  setConsoleColor(PRM_COLOR_RED);
+  fprintf(stderr, "\n\nerror in 'reactor_step()': not supported on this OS, exit!\n\n");
+  Exit(1, g_pauseOnExit);
+  return(0);
+
+#endif // __APPLE__ || __unix__
+
+} // reactor_step
+
+// end of file
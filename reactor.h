@@ -0,0 +1,32 @@
+/**
+  \file reactor.h
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief declaration of event loop for BSL sessions
+
+  declaration of a single threaded event loop, which drives many BSL session
+  state machines (see bsl_sm.h) concurrently via poll()
+*/
+
+// for including file only once
+#ifndef _REACTOR_H_
+#define _REACTOR_H_
+
+
+// include files
+#include <stdint.h>
+#include "bsl_sm.h"
+
+
+/// run sessions until all are finished. Returns number of failed sessions
+uint32_t    reactor_run(bsl_sm_t *sm, uint32_t numSessions, uint8_t verbose);
+
+/// run started sessions for one I/O wait of max. maxWait ms (<0=no limit). Returns number of sessions running before
+uint32_t    reactor_step(bsl_sm_t **sm, uint32_t numSessions, int maxWait, uint8_t verbose);
+
+#endif // _REACTOR_H_
+
+// end of file
@@ -0,0 +1,150 @@
+/**
+  \file routines.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief implementation of RAM flash write/erase routines
+
+  implementation of routines for selecting the device dependent flash write/erase
+  (E_W) routines from STM. The s19 files are compiled into the flasher (see
+  STM8_Routines) and are converted to a prepared image once at first use. The
+  images are shared between all sessions and threads.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "routines.h"
+#include "bootloader.h"
+#include "hexfile.h"
+#include "misc.h"
+#include "globals.h"
+
+
+// device dependent flash w/e routines
+#include "E_W_ROUTINEs_8K_verL_1.0.h"
+#include "E_W_ROUTINEs_32K_ver_1.0.h"
+#include "E_W_ROUTINEs_32K_ver_1.2.h"
+#include "E_W_ROUTINEs_32K_ver_1.3.h"
+#include "E_W_ROUTINEs_32K_ver_1.4.h"
+//#include "E_W_ROUTINEs_32K_verL_1.0.h"  // empty
+#include "E_W_ROUTINEs_128K_ver_2.0.h"
+#include "E_W_ROUTINEs_128K_ver_2.1.h"
+#include "E_W_ROUTINEs_128K_ver_2.2.h"
+#include "E_W_ROUTINEs_128K_ver_2.4.h"
+#include "E_W_ROUTINEs_256K_ver_1.0.h"
+
+
+/// table entry of available RAM routines
+typedef struct {
+  int             flashsize;      // flash size [kB]
+  uint8_t         versBSL;        // BSL version
+  const char      *name;          // name of s19 file
+  unsigned char   *s19;           // content of s19 file (not terminated)
+  unsigned int    *len;           // length of s19 file
+  image_t         *image;         // prepared image (created at first use)
+} routine_t;
+
+
+// available RAM routines
+static routine_t  s_routines[] = {
+  {   8, 0x10, "E_W_ROUTINEs_8K_verL_1.0",  STM8_Routines_E_W_ROUTINEs_8K_verL_1_0_s19,  &STM8_Routines_E_W_ROUTINEs_8K_verL_1_0_s19_len,  NULL },
+  {  32, 0x10, "E_W_ROUTINEs_32K_ver_1.0",  STM8_Routines_E_W_ROUTINEs_32K_ver_1_0_s19,  &STM8_Routines_E_W_ROUTINEs_32K_ver_1_0_s19_len,  NULL },
+  {  32, 0x12, "E_W_ROUTINEs_32K_ver_1.2",  STM8_Routines_E_W_ROUTINEs_32K_ver_1_2_s19,  &STM8_Routines_E_W_ROUTINEs_32K_ver_1_2_s19_len,  NULL },
+  {  32, 0x13, "E_W_ROUTINEs_32K_ver_1.3",  STM8_Routines_E_W_ROUTINEs_32K_ver_1_3_s19,  &STM8_Routines_E_W_ROUTINEs_32K_ver_1_3_s19_len,  NULL },
+  {  32, 0x14, "E_W_ROUTINEs_32K_ver_1.4",  STM8_Routines_E_W_ROUTINEs_32K_ver_1_4_s19,  &STM8_Routines_E_W_ROUTINEs_32K_ver_1_4_s19_len,  NULL },
+  { 128, 0x20, "E_W_ROUTINEs_128K_ver_2.0", STM8_Routines_E_W_ROUTINEs_128K_ver_2_0_s19, &STM8_Routines_E_W_ROUTINEs_128K_ver_2_0_s19_len, NULL },
+  { 128, 0x21, "E_W_ROUTINEs_128K_ver_2.1", STM8_Routines_E_W_ROUTINEs_128K_ver_2_1_s19, &STM8_Routines_E_W_ROUTINEs_128K_ver_2_1_s19_len, NULL },
+  { 128, 0x22, "E_W_ROUTINEs_128K_ver_2.2", STM8_Routines_E_W_ROUTINEs_128K_ver_2_2_s19, &STM8_Routines_E_W_ROUTINEs_128K_ver_2_2_s19_len, NULL },
+  { 128, 0x24, "E_W_ROUTINEs_128K_ver_2.4", STM8_Routines_E_W_ROUTINEs_128K_ver_2_4_s19, &STM8_Routines_E_W_ROUTINEs_128K_ver_2_4_s19_len, NULL },
+  { 256, 0x10, "E_W_ROUTINEs_256K_ver_1.0", STM8_Routines_E_W_ROUTINEs_256K_ver_1_0_s19, &STM8_Routines_E_W_ROUTINEs_256K_ver_1_0_s19_len, NULL },
+  {   0, 0x00, NULL, NULL, NULL, NULL }
+};
+
+
+
+/**
+  \fn uint8_t routines_required(int flashsize, uint8_t family)
+
+  \brief check if device requires RAM routines for flash write/erase
+
+  \param[in] flashsize   size of flash [kB]
+  \param[in] family      STM8 family (STM8S=1, STM8L=2)
+
+  \return 1 if RAM routines have to be uploaded, else 0
+*/
+uint8_t routines_required(int flashsize, uint8_t family) {
+
+  return((family == STM8S) || (flashsize == 8));
+
+} // routines_required
+
+
+
+/**
+  \fn const image_t *routines_get(int flashsize, uint8_t versBSL)
+
+  \brief get prepared image of RAM routines
+
+  \param[in] flashsize   size of flash [kB]
+  \param[in] versBSL     BSL version
+
+  \return prepared image of RAM routines, or NULL if device is not supported
+
+  select device dependent RAM routines and convert them to a prepared image
+  at first use. The image is kept until program termination and must not be
+  released by the caller. Safe to call from multiple threads
+*/
+const image_t *routines_get(int flashsize, uint8_t versBSL) {
+
+  routine_t   *r;
+  char        *s19, *ramImage;
+  uint32_t    ramImageStart, numRamBytes;
+  image_t     *image, *expected;
+
+  // find matching routines
+  for (r=s_routines; r->s19; r++) {
+    if ((r->flashsize == flashsize) && (r->versBSL == versBSL))
+      break;
+  }
+  if (!r->s19)
+    return(NULL);
+  #ifdef DEBUG
+    printf("header STM8_Routines_%s_s19 \n", r->name);
+  #endif
+
+  // already prepared
+  image = __atomic_load_n(&(r->image), __ATOMIC_ACQUIRE);
+  if (image)
+    return(image);
+
+  // s19 data is not terminated -> copy to string buffer
+  s19      = (char*) malloc(*(r->len) + 1);
+  ramImage = (char*) malloc(8192);
+  if ((!s19) || (!ramImage))
+    Error("cannot allocate memory buffers");
+  memcpy(s19, r->s19, *(r->len));
+  s19[*(r->len)] = '\0';
+
+  // convert to prepared image
+  convert_s19(s19, &ramImageStart, &numRamBytes, ramImage);
+  image = image_create(r->name, ramImageStart, numRamBytes, ramImage);
+  free(s19);
+  free(ramImage);
+
+  // store image. If another thread was faster, use its image
+  expected = NULL;
+  if (!__atomic_compare_exchange_n(&(r->image), &expected, image, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    image_release(image);
+    image = expected;
+  }
+
+  return(image);
+
+} // routines_get
+
+// end of file
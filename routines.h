@@ -0,0 +1,32 @@
+/**
+  \file routines.h
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief declaration of RAM flash write/erase routines
+
+  declaration of routines for selecting the device dependent flash write/erase
+  (E_W) routines, which have to be uploaded to RAM for STM8S and 8kB STM8L devices
+*/
+
+// for including file only once
+#ifndef _ROUTINES_H_
+#define _ROUTINES_H_
+
+
+// include files
+#include <stdint.h>
+#include "image.h"
+
+
+/// check if device requires RAM routines for flash write/erase
+uint8_t         routines_required(int flashsize, uint8_t family);
+
+/// get prepared image of RAM routines for device (NULL if unsupported). Image is owned by module
+const image_t   *routines_get(int flashsize, uint8_t versBSL);
+
+#endif // _ROUTINES_H_
+
+// end of file
@@ -0,0 +1,178 @@
+/**
+  \file rto.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief implementation of adaptive response timeouts
+
+  implementation of a TCP-like retransmission timeout estimator (RFC 6298):
+  the latency of single byte ACKs, i.e. response time minus line time, is
+  smoothed, and the timeout is
+    2*(line time + device time) + smoothed latency + 4*deviation
+  but at least RTO_MIN_US. Device times are the max. values of the STM8
+  datasheets (6ms per programmed byte/word/block, 3.33ms per erased block).
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "rto.h"
+
+
+// STM8 flash timing [us] (datasheet, max. values)
+#define RTO_PROG_US         6000        // standard programming time (incl. erase) of byte, word or block
+#define RTO_ERASE_US        3330        // erase time of a block
+
+// STM8 memory layout
+#define RTO_BLOCK           128         // flash block size (64B for low density, covered by margin)
+#define RTO_NVM_START       0x4000      // start of data EEPROM. Below is RAM and registers
+
+
+
+/**
+  \fn void rto_init(rto_t *rto)
+
+  \brief init latency estimate
+
+  \param[out] rto     latency estimate of port
+*/
+void rto_init(rto_t *rto) {
+
+  rto->srtt   = RTO_INIT_US;
+  rto->rttvar = RTO_INIT_US/2;
+  rto->num    = 0;
+
+} // rto_init
+
+
+
+/**
+  \fn void rto_sample(rto_t *rto, uint32_t response, uint32_t transfer)
+
+  \brief add measured response time
+
+  \param[in,out] rto        latency estimate of port
+  \param[in]     response   time from start of sending to end of response [us]
+  \param[in]     transfer   line time of exchange [us] (see rto_transfer())
+
+  only exchanges without device processing (e.g. flash programming) may be
+  sampled, otherwise the latency is overestimated
+*/
+void rto_sample(rto_t *rto, uint32_t response, uint32_t transfer) {
+
+  uint32_t  latency, delta;
+
+  latency = (response > transfer) ? (response - transfer) : 0;
+  if (rto->num++ == 0) {
+    rto->srtt   = latency;
+    rto->rttvar = latency/2;
+    return;
+  }
+  delta = (latency > rto->srtt) ? (latency - rto->srtt) : (rto->srtt - latency);
+  rto->rttvar = (3*rto->rttvar + delta) / 4;
+  rto->srtt   = (7*rto->srtt + latency) / 8;
+
+} // rto_sample
+
+
+
+/**
+  \fn uint32_t rto_timeout(const rto_t *rto, uint32_t transfer, uint32_t device)
+
+  \brief get response timeout of an exchange
+
+  \param[in] rto        latency estimate of port
+  \param[in] transfer   line time of exchange [us] (see rto_transfer())
+  \param[in] device     max. processing time of device [us], e.g. rto_program()
+
+  \return timeout [us]
+*/
+uint32_t rto_timeout(const rto_t *rto, uint32_t transfer, uint32_t device) {
+
+  uint64_t  timeout;
+
+  timeout = 2 * ((uint64_t) transfer + device) + rto->srtt + 4 * (uint64_t) rto->rttvar;
+  if (timeout < RTO_MIN_US)
+    timeout = RTO_MIN_US;
+  if (timeout > UINT32_MAX)
+    timeout = UINT32_MAX;
+  return((uint32_t) timeout);
+
+} // rto_timeout
+
+
+
+/**
+  \fn uint32_t rto_transfer(uint32_t baudrate, uint8_t UARTmode, uint16_t lenTx, uint16_t lenRx)
+
+  \brief get time on the line
+
+  \param[in] baudrate   baudrate [Baud]
+  \param[in] UARTmode   0=duplex (8E1), 1=1-wire echo (8N1), 2=reply mode (8N1)
+  \param[in] lenTx      number of sent bytes
+  \param[in] lenRx      number of received bytes
+
+  \return line time [us]
+
+  in reply mode each byte is echoed by the receiver, which doubles the line
+  time. The 1-wire echo is received while sending and costs no extra time
+*/
+uint32_t rto_transfer(uint32_t baudrate, uint8_t UARTmode, uint16_t lenTx, uint16_t lenRx) {
+
+  uint64_t  bits;
+
+  if (baudrate == 0)
+    return(0);
+  bits = ((uint64_t) lenTx + lenRx) * ((UARTmode == 0) ? 11 : 10);   // start, 8 data, (parity), stop
+  if (UARTmode == 2)
+    bits *= 2;
+  return((uint32_t) (bits * 1000000 / baudrate));
+
+} // rto_transfer
+
+
+
+/**
+  \fn uint32_t rto_program(uint32_t addr, uint16_t numBytes)
+
+  \brief get max. time for programming a WRITE frame
+
+  \param[in] addr       start address of frame
+  \param[in] numBytes   number of data bytes
+
+  \return programming time [us]
+
+  aligned full blocks are programmed at once, else byte by byte. Writes to
+  RAM (e.g. RAM routines) take no time
+*/
+uint32_t rto_program(uint32_t addr, uint16_t numBytes) {
+
+  if (addr < RTO_NVM_START)
+    return(0);
+  if (((addr % RTO_BLOCK) == 0) && (numBytes == RTO_BLOCK))
+    return(RTO_PROG_US);
+  return((uint32_t) numBytes * RTO_PROG_US);
+
+} // rto_program
+
+
+
+/**
+  \fn uint32_t rto_erase(uint32_t sizeKB)
+
+  \brief get max. time for erasing memory
+
+  \param[in] sizeKB    size of erased memory [kB], e.g. sector (1kB) or flash + RTO_EEPROM_KB for mass erase
+
+  \return erase time [us]
+*/
+uint32_t rto_erase(uint32_t sizeKB) {
+
+  return(sizeKB * (1024 / RTO_BLOCK) * RTO_ERASE_US);
+
+} // rto_erase
+
+// end of file
@@ -0,0 +1,64 @@
+/**
+  \file rto.h
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief declaration of adaptive response timeouts
+
+  declaration of routines for computing the response timeout of an exchange
+  from the number of bytes on the line, the baudrate and UART mode, the
+  processing time of the device (flash program/erase) and the measured
+  response latency of the port, plus a safety margin. A lost frame is then
+  detected after a time proportional to the work instead of a fixed second.
+*/
+
+// for including file only once
+#ifndef _RTO_H_
+#define _RTO_H_
+
+
+// include files
+#include <stdint.h>
+
+
+/// min. response timeout [us]. A session has no retransmit, so this must cover scheduling stalls of loaded hosts, e.g. Raspberry Pi Zero
+#define RTO_MIN_US          200000
+
+/// initial response latency [us] before first measurement (FTDI default latency timer 16ms)
+#define RTO_INIT_US         20000
+
+/// max. size of STM8 data EEPROM [kB] (erased together with flash by mass erase)
+#define RTO_EEPROM_KB       2
+
+
+/// measured response latency of a port
+typedef struct {
+  uint32_t    srtt;         ///< smoothed latency [us] (response time minus line time)
+  uint32_t    rttvar;       ///< mean deviation of latency [us]
+  uint32_t    num;          ///< number of samples
+} rto_t;
+
+
+/// init latency estimate
+void        rto_init(rto_t *rto);
+
+/// add measured response time of an exchange without device processing
+void        rto_sample(rto_t *rto, uint32_t response, uint32_t transfer);
+
+/// get response timeout of an exchange [us]
+uint32_t    rto_timeout(const rto_t *rto, uint32_t transfer, uint32_t device);
+
+/// get time on the line for sent and received bytes [us]
+uint32_t    rto_transfer(uint32_t baudrate, uint8_t UARTmode, uint16_t lenTx, uint16_t lenRx);
+
+/// get max. time for programming a WRITE frame [us]
+uint32_t    rto_program(uint32_t addr, uint16_t numBytes);
+
+/// get max. time for erasing flash or data EEPROM [us]
+uint32_t    rto_erase(uint32_t sizeKB);
+
+#endif // _RTO_H_
+
+// end of file
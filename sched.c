@@ -0,0 +1,552 @@
+/**
+  \file sched.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief implementation of work-stealing job scheduler
+
+  implementation of a job scheduler with one double ended queue per worker.
+  A worker takes jobs from the front of its own queue. If it is empty, it steals
+  from the back of the queue with the highest pending cost. Each queue has its
+  own lock, so workers only contend when stealing.
+  The throughput of each worker is estimated as moving average (EWMA) over
+  finished jobs and used for placing new jobs.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "sched.h"
+#include "misc.h"
+#include "globals.h"
+
+// OS specific: Posix
+#if defined(__APPLE__) || defined(__unix__)
+  #include <pthread.h>
+#endif
+
+
+// weight of new sample in throughput estimate
+#define SCHED_EWMA_WEIGHT   0.3
+
+
+#if defined(__APPLE__) || defined(__unix__)
+
+/// job queue of a worker
+typedef struct {
+  pthread_mutex_t       lock;         // protects queue
+  sched_job_t           **job;        // ring buffer of jobs
+  uint32_t              size;         // capacity of ring buffer
+  uint32_t              head;         // index of first job
+  uint32_t              num;          // number of jobs in queue
+  uint64_t              cost;         // sum of cost in queue
+  uint64_t              running;      // cost of job in execution
+  sched_worker_stats_t  stats;        // statistics
+} worker_t;
+
+
+// state of scheduler
+static worker_t         *s_worker = NULL;
+static uint32_t         s_numWorkers = 0;
+static uint8_t          s_maxAttempts;
+static pthread_mutex_t  s_lock = PTHREAD_MUTEX_INITIALIZER;   // protects counters below
+static pthread_cond_t   s_cond = PTHREAD_COND_INITIALIZER;    // signals new jobs or end
+static uint32_t         s_numQueued;        // jobs in all queues
+static uint32_t         s_numRunning;       // jobs in execution
+static uint8_t          s_closed;           // no more jobs will be submitted
+static sched_stats_t    s_stats;            // global statistics (per worker in s_worker)
+
+
+
+/**
+  \fn static void queue_push(worker_t *w, sched_job_t *job)
+
+  \brief append job to back of worker queue (caller holds w->lock)
+*/
+static void queue_push(worker_t *w, sched_job_t *job) {
+
+  sched_job_t   **buf;
+  uint32_t      i, size;
+
+  // grow ring buffer if full
+  if (w->num == w->size) {
+    size = (w->size == 0) ? 16 : 2*w->size;
+    buf  = (sched_job_t**) malloc(size * sizeof(sched_job_t*));
+    if (!buf)
+      Error("cannot allocate memory buffers");
+    for (i=0; i<w->num; i++)
+      buf[i] = w->job[(w->head + i) % w->size];
+    free(w->job);
+    w->job  = buf;
+    w->size = size;
+    w->head = 0;
+  }
+
+  // append job
+  w->job[(w->head + w->num) % w->size] = job;
+  w->num++;
+  w->cost += job->cost;
+
+} // queue_push
+
+
+
+/**
+  \fn static sched_job_t *queue_pop(worker_t *w, uint8_t back)
+
+  \brief remove job from front (own worker) or back (thief) of queue (caller holds w->lock)
+*/
+static sched_job_t *queue_pop(worker_t *w, uint8_t back) {
+
+  sched_job_t   *job;
+
+  if (w->num == 0)
+    return(NULL);
+  if (back)
+    job = w->job[(w->head + w->num - 1) % w->size];
+  else {
+    job = w->job[w->head];
+    w->head = (w->head + 1) % w->size;
+  }
+  w->num--;
+  w->cost -= job->cost;
+  return(job);
+
+} // queue_pop
+
+
+
+/**
+  \fn static float expected_rate(uint32_t idx)
+
+  \brief throughput estimate of worker. Unknown workers get the average of the known ones (caller holds s_lock)
+*/
+static float expected_rate(uint32_t idx) {
+
+  uint32_t  i, num = 0;
+  float     sum = 0.0;
+
+  if (s_worker[idx].stats.rate > 0.0)
+    return(s_worker[idx].stats.rate);
+  for (i=0; i<s_numWorkers; i++) {
+    if (s_worker[i].stats.rate > 0.0) {
+      sum += s_worker[i].stats.rate;
+      num++;
+    }
+  }
+  return((num > 0) ? sum / num : 1.0);
+
+} // expected_rate
+
+
+
+/**
+  \fn void sched_init(uint32_t numWorkers, uint8_t maxAttempts)
+
+  \brief init scheduler
+
+  \param[in] numWorkers    number of workers, e.g. one per fixture
+  \param[in] maxAttempts   number of attempts for a job before it is counted as failed
+*/
+void sched_init(uint32_t numWorkers, uint8_t maxAttempts) {
+
+  uint32_t  i;
+
+  if (numWorkers == 0) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'sched_init()': no workers, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+  s_worker = (worker_t*) calloc(numWorkers, sizeof(worker_t));
+  if (!s_worker) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'sched_init()': cannot allocate memory buffers, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+
+  memset(&s_stats, 0, sizeof(s_stats));
+  for (i=0; i<numWorkers; i++)
+    pthread_mutex_init(&(s_worker[i].lock), NULL);
+  s_numWorkers  = numWorkers;
+  s_maxAttempts = (maxAttempts > 0) ? maxAttempts : 1;
+  s_numQueued   = 0;
+  s_numRunning  = 0;
+  s_closed      = 0;
+  s_stats.numWorkers = numWorkers;
+
+} // sched_init
+
+
+
+/**
+  \fn void sched_free(void)
+
+  \brief release scheduler. All workers must have returned
+*/
+void sched_free(void) {
+
+  uint32_t  i;
+
+  for (i=0; i<s_numWorkers; i++) {
+    pthread_mutex_destroy(&(s_worker[i].lock));
+    free(s_worker[i].job);
+  }
+  free(s_worker);
+  s_worker = NULL;
+  s_numWorkers = 0;
+
+} // sched_free
+
+
+
+/**
+  \fn void sched_submit(sched_job_t *job)
+
+  \brief submit job
+
+  \param[in] job    job to submit. Must stay valid until finished
+
+  place job on the worker with the earliest expected completion time, i.e.
+  (pending cost + job cost) / throughput. Idle workers may steal it later
+*/
+void sched_submit(sched_job_t *job) {
+
+  uint32_t  i, best = 0;
+  uint64_t  cost;
+  float     t, tBest = 0.0;
+
+  // find worker with earliest expected completion. Running cost and rate are protected by s_lock, queue by worker lock
+  pthread_mutex_lock(&s_lock);
+  for (i=0; i<s_numWorkers; i++) {
+    pthread_mutex_lock(&(s_worker[i].lock));
+    cost = s_worker[i].cost;
+    pthread_mutex_unlock(&(s_worker[i].lock));
+    t = (float) (cost + s_worker[i].running + job->cost) / expected_rate(i);
+    if ((i == 0) || (t < tBest)) {
+      tBest = t;
+      best  = i;
+    }
+  }
+  pthread_mutex_unlock(&s_lock);
+
+  // append to queue of worker
+  job->timeSubmit = time_us();
+  pthread_mutex_lock(&(s_worker[best].lock));
+  queue_push(&(s_worker[best]), job);
+  pthread_mutex_unlock(&(s_worker[best].lock));
+
+  // wake up idle workers
+  pthread_mutex_lock(&s_lock);
+  s_numQueued++;
+  s_stats.numSubmitted++;
+  pthread_cond_broadcast(&s_cond);
+  pthread_mutex_unlock(&s_lock);
+
+} // sched_submit
+
+
+
+/**
+  \fn void sched_wait(uint32_t maxQueued)
+
+  \brief wait until less than maxQueued jobs are queued
+
+  \param[in] maxQueued   max. number of queued jobs
+
+  used by the producer to submit jobs on demand. Jobs are then placed based on
+  current throughput estimates instead of the initial ones
+*/
+void sched_wait(uint32_t maxQueued) {
+
+  pthread_mutex_lock(&s_lock);
+  while (s_numQueued >= maxQueued)
+    pthread_cond_wait(&s_cond, &s_lock);
+  pthread_mutex_unlock(&s_lock);
+
+} // sched_wait
+
+
+
+/**
+  \fn void sched_close(void)
+
+  \brief no more jobs will be submitted
+
+  after all queued and running jobs are done, sched_get() returns NULL
+*/
+void sched_close(void) {
+
+  pthread_mutex_lock(&s_lock);
+  s_closed = 1;
+  pthread_cond_broadcast(&s_cond);
+  pthread_mutex_unlock(&s_lock);
+
+} // sched_close
+
+
+
+/**
+  \fn sched_job_t *sched_tryGet(uint32_t worker)
+
+  \brief get next job for worker if one is available
+
+  \param[in] worker   index of worker
+
+  \return next job, or NULL if no job is queued
+
+  take job from own queue. If empty, steal from the back of the queue with the
+  highest pending cost. Used by threads serving several workers, which must
+  not block while other workers of the thread are busy
+*/
+sched_job_t *sched_tryGet(uint32_t worker) {
+
+  worker_t      *w = &(s_worker[worker]), *victim;
+  sched_job_t   *job;
+  uint32_t      i;
+  uint64_t      latency, cost, costVictim;
+  uint8_t       stolen = 0;
+
+  // nothing queued -> skip scanning the queues of all workers (called often by threads with idle fixtures)
+  pthread_mutex_lock(&s_lock);
+  i = s_numQueued;
+  pthread_mutex_unlock(&s_lock);
+  if (i == 0)
+    return(NULL);
+
+  // own queue first
+  pthread_mutex_lock(&(w->lock));
+  job = queue_pop(w, 0);
+  pthread_mutex_unlock(&(w->lock));
+
+  // else steal from most loaded worker. Its queue may change until locked again, then queue_pop() returns NULL
+  if (!job) {
+    victim = NULL;
+    costVictim = 0;
+    for (i=0; i<s_numWorkers; i++) {
+      if (i == worker)
+        continue;
+      pthread_mutex_lock(&(s_worker[i].lock));
+      cost = (s_worker[i].num > 0) ? s_worker[i].cost : 0;
+      if ((s_worker[i].num > 0) && ((!victim) || (cost > costVictim))) {
+        victim     = &(s_worker[i]);
+        costVictim = cost;
+      }
+      pthread_mutex_unlock(&(s_worker[i].lock));
+    }
+    if (victim) {
+      pthread_mutex_lock(&(victim->lock));
+      job = queue_pop(victim, 1);
+      pthread_mutex_unlock(&(victim->lock));
+      stolen = (job != NULL);
+    }
+  }
+  if (!job)
+    return(NULL);
+
+  // got job -> update statistics
+  pthread_mutex_lock(&s_lock);
+  job->timeStart = time_us();
+  latency = job->timeStart - job->timeSubmit;
+  s_stats.latencySum += latency;
+  s_stats.latencyNum++;
+  if (latency > s_stats.latencyMax)
+    s_stats.latencyMax = latency;
+  s_numQueued--;
+  s_numRunning++;
+  w->running = job->cost;
+  w->stats.numStolen += stolen;
+  pthread_cond_broadcast(&s_cond);
+  pthread_mutex_unlock(&s_lock);
+
+  return(job);
+
+} // sched_tryGet
+
+
+
+/**
+  \fn sched_job_t *sched_get(uint32_t worker)
+
+  \brief get next job for worker
+
+  \param[in] worker   index of worker
+
+  \return next job, or NULL if scheduler is closed and all jobs are done
+
+  take job via sched_tryGet(). If no job is available, wait for new jobs
+*/
+sched_job_t *sched_get(uint32_t worker) {
+
+  sched_job_t   *job;
+
+  while (1) {
+
+    if ((job = sched_tryGet(worker)) != NULL)
+      return(job);
+
+    // all done
+    pthread_mutex_lock(&s_lock);
+    if (s_closed && (s_numQueued == 0) && (s_numRunning == 0)) {
+      pthread_cond_broadcast(&s_cond);
+      pthread_mutex_unlock(&s_lock);
+      return(NULL);
+    }
+
+    // wait for new jobs, unless jobs were queued meanwhile
+    if (s_numQueued == 0)
+      pthread_cond_wait(&s_cond, &s_lock);
+    pthread_mutex_unlock(&s_lock);
+
+  } // loop until job found or done
+
+} // sched_get
+
+
+
+/**
+  \fn uint8_t sched_done(uint32_t worker, sched_job_t *job, uint8_t success)
+
+  \brief report job as done
+
+  \param[in] worker    index of worker
+  \param[in] job       finished job
+  \param[in] success   1 if job succeeded, else 0
+
+  \return 1 if failed job was re-submitted, else 0
+
+  update throughput estimate of worker. A failed job is re-submitted until
+  the max. number of attempts is reached
+*/
+uint8_t sched_done(uint32_t worker, sched_job_t *job, uint8_t success) {
+
+  worker_t  *w = &(s_worker[worker]);
+  float     duration, rate;
+  uint8_t   retry = 0;
+
+  // update throughput estimate (also failed jobs tell about speed, but may end early)
+  duration = (float) (time_us() - job->timeStart) / 1000000.0;
+  job->attempts++;
+  pthread_mutex_lock(&s_lock);
+  w->stats.numJobs++;
+  if (success && (duration > 0.0)) {
+    rate = (float) job->cost / duration;
+    if (w->stats.rate <= 0.0)
+      w->stats.rate = rate;
+    else
+      w->stats.rate = SCHED_EWMA_WEIGHT * rate + (1.0 - SCHED_EWMA_WEIGHT) * w->stats.rate;
+  }
+  if (success)
+    s_stats.numDone++;
+  else {
+    w->stats.numFailed++;
+    if (job->attempts < s_maxAttempts)
+      retry = 1;
+    else
+      s_stats.numFailed++;
+  }
+  pthread_mutex_unlock(&s_lock);
+
+  // re-submit failed job before it stops counting as running (avoids premature end)
+  if (retry)
+    sched_submit(job);
+
+  // job no longer running
+  pthread_mutex_lock(&s_lock);
+  w->running = 0;
+  s_numRunning--;
+  pthread_cond_broadcast(&s_cond);
+  pthread_mutex_unlock(&s_lock);
+
+  return(retry);
+
+} // sched_done
+
+
+
+/**
+  \fn void sched_getStats(sched_stats_t *stats)
+
+  \brief get copy of statistics
+
+  \param[out] stats   statistics incl. queue latency (see sched_getWorkerStats() for workers)
+*/
+void sched_getStats(sched_stats_t *stats) {
+
+  pthread_mutex_lock(&s_lock);
+  memcpy(stats, &s_stats, sizeof(sched_stats_t));
+  pthread_mutex_unlock(&s_lock);
+
+} // sched_getStats
+
+
+
+/**
+  \fn void sched_getWorkerStats(uint32_t worker, sched_worker_stats_t *stats)
+
+  \brief get copy of statistics of a worker
+
+  \param[in]  worker   index of worker
+  \param[out] stats    statistics incl. throughput and queue
+*/
+void sched_getWorkerStats(uint32_t worker, sched_worker_stats_t *stats) {
+
+  pthread_mutex_lock(&s_lock);
+  *stats = s_worker[worker].stats;
+  pthread_mutex_lock(&(s_worker[worker].lock));
+  stats->queued     = s_worker[worker].num;
+  stats->queuedCost = s_worker[worker].cost;
+  pthread_mutex_unlock(&(s_worker[worker].lock));
+  pthread_mutex_unlock(&s_lock);
+
+} // sched_getWorkerStats
+
+#else // __APPLE__ || __unix__
+
+void sched_init(uint32_t numWorkers, uint8_t maxAttempts) {
+  setConsoleColor(PRM_COLOR_RED);
+  fprintf(stderr, "\n\nerror in 'sched_init()': not supported on this OS, exit!\n\n");
+  Exit(1, g_pauseOnExit);
+}
+void sched_free(void) { }
+void sched_submit(sched_job_t *job) { }
+void sched_wait(uint32_t maxQueued) { }
+void sched_close(void) { }
+sched_job_t *sched_get(uint32_t worker) { return(NULL); }
+sched_job_t *sched_tryGet(uint32_t worker) { return(NULL); }
+uint8_t sched_done(uint32_t worker, sched_job_t *job, uint8_t success) { return(0); }
+void sched_getStats(sched_stats_t *stats) { memset(stats, 0, sizeof(sched_stats_t)); }
+void sched_getWorkerStats(uint32_t worker, sched_worker_stats_t *stats) { memset(stats, 0, sizeof(sched_worker_stats_t)); }
+
+#endif // __APPLE__ || __unix__
+
+
+
+/**
+  \fn void sched_printStats(void)
+
+  \brief print statistics of scheduler and workers
+*/
+void sched_printStats(void) {
+
+  sched_stats_t         stats;
+  sched_worker_stats_t  worker;
+  uint32_t              i;
+
+  sched_getStats(&stats);
+  printf("  jobs: %d ok, %d failed, %d submitted\n", (int) stats.numDone, (int) stats.numFailed, (int) stats.numSubmitted);
+  if (stats.latencyNum > 0)
+    printf("  queue latency: avg %1.1fms, max %1.1fms\n", (float) stats.latencySum / stats.latencyNum / 1000.0, (float) stats.latencyMax / 1000.0);
+  for (i=0; i<stats.numWorkers; i++) {
+    sched_getWorkerStats(i, &worker);
+    printf("  worker %d: %d jobs (%d stolen, %d failed), %1.2fkB/s\n", (int) i, (int) worker.numJobs,
+      (int) worker.numStolen, (int) worker.numFailed, worker.rate / 1024.0);
+  }
+  fflush(stdout);
+
+} // sched_printStats
+
+// end of file
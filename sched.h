@@ -0,0 +1,95 @@
+/**
+  \file sched.h
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief declaration of work-stealing job scheduler
+
+  declaration of a job scheduler for fixtures with different speed. Each worker
+  (=fixture) has its own job queue. New jobs are placed on the worker with the
+  earliest expected completion, based on a throughput estimate per worker.
+  An idle worker steals jobs from the most loaded worker. The number of workers
+  is not limited, and a thread may serve several workers (see sched_tryGet())
+*/
+
+// for including file only once
+#ifndef _SCHED_H_
+#define _SCHED_H_
+
+
+// include files
+#include <stdint.h>
+
+
+/// job for scheduler
+typedef struct {
+  uint32_t        id;             ///< job number (for output)
+  uint32_t        cost;           ///< expected work, e.g. number of bytes to program
+  void            *data;          ///< job data, not used by scheduler
+  uint8_t         attempts;       ///< number of attempts so far
+  uint64_t        timeSubmit;     ///< time of (re-)submission [us]
+  uint64_t        timeStart;      ///< start of execution [us]
+} sched_job_t;
+
+
+/// statistics of a worker
+typedef struct {
+  uint32_t        numJobs;        ///< number of executed jobs
+  uint32_t        numFailed;      ///< number of failed jobs
+  uint32_t        numStolen;      ///< number of jobs stolen from other workers
+  uint32_t        queued;         ///< number of jobs in queue
+  uint64_t        queuedCost;     ///< sum of cost of jobs in queue
+  float           rate;           ///< estimated throughput [cost/s] (EWMA, 0=unknown)
+} sched_worker_stats_t;
+
+
+/// statistics of scheduler
+typedef struct {
+  uint32_t              numWorkers;         ///< number of workers
+  uint32_t              numSubmitted;       ///< number of submitted jobs (incl. retries)
+  uint32_t              numDone;            ///< number of successful jobs
+  uint32_t              numFailed;          ///< number of finally failed jobs
+  uint64_t              latencySum;         ///< sum of queue latency (submit to start) [us]
+  uint64_t              latencyMax;         ///< max. queue latency [us]
+  uint32_t              latencyNum;         ///< number of latency samples
+} sched_stats_t;
+
+
+/// init scheduler for a number of workers. Failed jobs are retried up to maxAttempts times
+void          sched_init(uint32_t numWorkers, uint8_t maxAttempts);
+
+/// release scheduler
+void          sched_free(void);
+
+/// submit job. It is placed on the worker with the earliest expected completion
+void          sched_submit(sched_job_t *job);
+
+/// wait until less than maxQueued jobs are queued (for feeding jobs on demand)
+void          sched_wait(uint32_t maxQueued);
+
+/// no more jobs will be submitted. Idle workers return from sched_get()
+void          sched_close(void);
+
+/// get next job for worker (blocking). Returns NULL when all jobs are done
+sched_job_t   *sched_get(uint32_t worker);
+
+/// get next job for worker if one is available (non-blocking). Returns NULL otherwise
+sched_job_t   *sched_tryGet(uint32_t worker);
+
+/// report job as done. Updates throughput of worker. Returns 1 if failed job was re-submitted
+uint8_t       sched_done(uint32_t worker, sched_job_t *job, uint8_t success);
+
+/// get copy of statistics
+void          sched_getStats(sched_stats_t *stats);
+
+/// get copy of statistics of a worker
+void          sched_getWorkerStats(uint32_t worker, sched_worker_stats_t *stats);
+
+/// print statistics
+void          sched_printStats(void);
+
+#endif // _SCHED_H_
+
+// end of file
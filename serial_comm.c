@@ -15,10 +15,37 @@
 
 // include files
 #include "serial_comm.h"
+#include "adapter.h"
+#include "trace.h"
 #include "misc.h"
 #include "globals.h"
 
 
+// transport counters of send_port() and receive_port()
+static io_stats_t   s_stats;
+
+
+
+/**
+  \fn static void trace_io(HANDLE fpCom, const char *name, uint64_t timeStart, uint32_t numBytes)
+
+  \brief add transfer to timeline trace (see trace.h)
+
+  \param[in] fpCom       handle to comm port
+  \param[in] name        "send" or "receive"
+  \param[in] timeStart   start of transfer [us]
+  \param[in] numBytes    number of bytes transferred
+  
+  after sending, the sent bytes are in flight until the response was received
+*/
+static void trace_io(HANDLE fpCom, const char *name, uint64_t timeStart, uint32_t numBytes) {
+
+  trace_complete(TRACE_TID(fpCom), "io", name, timeStart, time_us(), (int32_t) numBytes);
+  trace_counter(TRACE_TID(fpCom), "bytes in flight", (name[0] == 's') ? (int32_t) numBytes : 0);
+
+} // trace_io
+
+
 /**
   \fn void list_ports(void)
    
@@ -138,6 +165,8 @@ void list_ports(void) {
   
   open comm port for communication, set properties (baudrate, timeout,...). 
   Note: baudrate must be supported by COM port driver. 
+  For known USB adapters (see adapter.h) the baudrate is limited to the highest
+  reliable baudrate and the latency timer is set.
 */
 HANDLE init_port(const char *port, uint32_t baudrate, uint32_t timeout, uint8_t numBits, uint8_t parity, uint8_t numStop, uint8_t RTS, uint8_t DTR) {
 
@@ -240,9 +269,20 @@ HANDLE init_port(const char *port, uint32_t baudrate, uint32_t timeout, uint8_t
 /////////
 #if defined(__APPLE__) || defined(__unix__) 
 
-  HANDLE          fpCom;
-  struct termios  toptions;
-  int             status;
+  HANDLE                    fpCom;
+  struct termios            toptions;
+  int                       status;
+  const adapter_profile_t   *adapter;
+
+  // apply defaults of known USB adapter
+  if ((adapter = adapter_find(port))) {
+    if (baudrate > adapter->maxBaud) {
+      printf("  limit baudrate of '%s' to %d Baud (%s)\n", port, (int) adapter->maxBaud, adapter->name);
+      baudrate = adapter->maxBaud;
+    }
+    if (adapter->latency > 0)
+      set_port_latency(port, adapter->latency);
+  }
 
   // open port
   fpCom = open(port, O_RDWR | O_NOCTTY | O_NDELAY | O_NONBLOCK);
@@ -290,6 +330,15 @@ HANDLE init_port(const char *port, uint32_t baudrate, uint32_t timeout, uint8_t
 #endif
 #ifdef B230400
     case 230400: brate=B230400; break;
+#endif
+#ifdef B460800
+    case 460800: brate=B460800; break;
+#endif
+#ifdef B921600
+    case 921600: brate=B921600; break;
+#endif
+#ifdef B1000000
+    case 1000000: brate=B1000000; break;
 #endif
     default: 
       setConsoleColor(PRM_COLOR_RED);
@@ -350,7 +399,7 @@ HANDLE init_port(const char *port, uint32_t baudrate, uint32_t timeout, uint8_t
     status |= TIOCM_DTR;
   else
     status &= ~TIOCM_DTR;
-  if (ioctl(fpCom, TIOCMSET, &status)) {
+  if (ioctl(fpCom, TIOCMSET, &status) && (errno != ENOTTY) && (errno != EINVAL)) {   // pseudo terminals have no modem lines
     setConsoleColor(PRM_COLOR_RED);
     fprintf(stderr, "\n\nerror in 'init_port(%s)': cannot set RTS status, exit!\n\n", port);
     Exit(1, g_pauseOnExit);
@@ -421,31 +470,273 @@ void close_port(HANDLE *fpCom) {
 
 
 
+#if defined(__APPLE__) || defined(__unix__)
 /**
-  \fn void pulse_DTR(HANDLE *fpCom, uint32_t duration)
+  \fn static uint8_t sysfs_path(const char *port, const char *file, char *path, uint32_t size)
    
-  \brief generate low pulse on DTR in [ms] to reset STM8
+  \brief find file in sysfs directory of USB adapter
+   
+  \param[in]  port     name of port, e.g. /dev/ttyUSB0 or a symlink to it
+  \param[in]  file     name of attribute file, e.g. "serial"
+  \param[out] path     path of attribute file
+  \param[in]  size     size of path buffer
+
+  \return 1 if found, else 0
+
+  search the device directory of the tty and its parents (interface, USB
+  device) for the attribute. Only available on Linux, elsewhere sysfs is
+  missing and 0 is returned.
+*/
+static uint8_t sysfs_path(const char *port, const char *file, char *path, uint32_t size) {
+
+  char      dev[PATH_MAX], dir[PATH_MAX+50], *p;
+  uint8_t   level;
+  FILE      *fp;
+
+  // resolve symlinks, e.g. /dev/serial/by-id/...
+  if (!realpath(port, dev))
+    return(0);
+  p = strrchr(dev, '/');
+  snprintf(dir, sizeof(dir), "/sys/class/tty/%s/device", p ? p+1 : dev);
+  if (!realpath(dir, dev))
+    return(0);
+
+  // walk up from tty device to USB device
+  for (level=0; level<4; level++) {
+    snprintf(path, size, "%s/%s", dev, file);
+    if ((fp = fopen(path, "r"))) {
+      fclose(fp);
+      return(1);
+    }
+    if (!(p = strrchr(dev, '/')) || (p == dev))
+      return(0);
+    *p = '\0';
+  }
+  return(0);
+
+} // sysfs_path
+#endif // __APPLE__ || __unix__
+
+
+
+/**
+  \fn uint8_t get_port_serial(const char *port, char *serial, uint32_t size)
+   
+  \brief get serial number of USB adapter
+   
+  \param[in]  port     name of port
+  \param[out] serial   serial number (iSerial string descriptor)
+  \param[in]  size     size of serial buffer
+
+  \return 1 if available, else 0 (e.g. no USB adapter or not supported by OS)
+*/
+uint8_t get_port_serial(const char *port, char *serial, uint32_t size) {
+
+/////////
+// Win32
+/////////
+#if defined(WIN32)
+
+  // not supported (would require SetupAPI)
+  return(0);
+
+#endif // WIN32
+
+
+/////////
+// Posix
+/////////
+#if defined(__APPLE__) || defined(__unix__) 
+
+  char      path[PATH_MAX+100];
+  FILE      *fp;
+  uint8_t   result = 0;
+
+  if (!sysfs_path(port, "serial", path, sizeof(path)))
+    return(0);
+  if ((fp = fopen(path, "r"))) {
+    if (fgets(serial, size, fp)) {
+      serial[strcspn(serial, "\r\n")] = '\0';
+      result = (serial[0] != '\0');
+    }
+    fclose(fp);
+  }
+  return(result);
+
+#endif // __APPLE__ || __unix__
+
+} // get_port_serial
+
+
+
+/**
+  \fn uint8_t get_port_usbid(const char *port, uint16_t *vid, uint16_t *pid)
+   
+  \brief get USB vendor and product ID of adapter
+   
+  \param[in]  port     name of port
+  \param[out] vid      USB vendor ID
+  \param[out] pid      USB product ID
+
+  \return 1 if available, else 0 (e.g. no USB adapter or not supported by OS)
+*/
+uint8_t get_port_usbid(const char *port, uint16_t *vid, uint16_t *pid) {
+
+/////////
+// Win32
+/////////
+#if defined(WIN32)
+
+  // not supported (would require SetupAPI)
+  return(0);
+
+#endif // WIN32
+
+
+/////////
+// Posix
+/////////
+#if defined(__APPLE__) || defined(__unix__) 
+
+  char      path[PATH_MAX+100];
+  FILE      *fp;
+  unsigned  id[2];
+  uint8_t   i;
+
+  for (i=0; i<2; i++) {
+    if (!sysfs_path(port, (i == 0) ? "idVendor" : "idProduct", path, sizeof(path)))
+      return(0);
+    if (!(fp = fopen(path, "r")))
+      return(0);
+    if (fscanf(fp, "%x", &(id[i])) != 1)
+      id[i] = 0;
+    fclose(fp);
+  }
+  *vid = (uint16_t) id[0];
+  *pid = (uint16_t) id[1];
+  return(1);
+
+#endif // __APPLE__ || __unix__
+
+} // get_port_usbid
+
+
+
+/**
+  \fn uint8_t get_port_latency(const char *port)
+   
+  \brief get latency timer of USB adapter
+   
+  \param[in]  port     name of port
+
+  \return latency timer [ms], or 0 if not available (only FTDI adapters on Linux)
+*/
+uint8_t get_port_latency(const char *port) {
+
+/////////
+// Win32
+/////////
+#if defined(WIN32)
+
+  // not supported (set in device manager)
+  return(0);
+
+#endif // WIN32
+
+
+/////////
+// Posix
+/////////
+#if defined(__APPLE__) || defined(__unix__) 
+
+  char      path[PATH_MAX+100];
+  FILE      *fp;
+  int       latency = 0;
+
+  if (!sysfs_path(port, "latency_timer", path, sizeof(path)))
+    return(0);
+  if ((fp = fopen(path, "r"))) {
+    if (fscanf(fp, "%d", &latency) != 1)
+      latency = 0;
+    fclose(fp);
+  }
+  return((uint8_t) latency);
+
+#endif // __APPLE__ || __unix__
+
+} // get_port_latency
+
+
+
+/**
+  \fn uint8_t set_port_latency(const char *port, uint8_t latency)
+   
+  \brief set latency timer of USB adapter
+   
+  \param[in]  port     name of port
+  \param[in]  latency  latency timer [ms] (1..255)
+
+  \return 1 on success, 0 if not available or no write permission
+
+  The latency timer of FTDI adapters delays short responses like an ACK by
+  up to 16ms (default), which dominates the duration of a BSL command.
+*/
+uint8_t set_port_latency(const char *port, uint8_t latency) {
+
+/////////
+// Win32
+/////////
+#if defined(WIN32)
+
+  // not supported (set in device manager)
+  return(0);
+
+#endif // WIN32
+
+
+/////////
+// Posix
+/////////
+#if defined(__APPLE__) || defined(__unix__) 
+
+  char      path[PATH_MAX+100];
+  FILE      *fp;
+  uint8_t   result;
+
+  if ((latency == 0) || (!sysfs_path(port, "latency_timer", path, sizeof(path))))
+    return(0);
+  if (!(fp = fopen(path, "w")))
+    return(0);
+  result = (fprintf(fp, "%d", (int) latency) > 0);
+  if (fclose(fp))
+    result = 0;
+  return(result);
+
+#endif // __APPLE__ || __unix__
+
+} // set_port_latency
+
+
+
+/**
+  \fn void set_DTR(HANDLE fpCom, uint8_t state)
+   
+  \brief set DTR line to reset STM8
    
   \param[in] fpCom      port handle
-  \param[in] duration   duration of DTR low pulse in ms
+  \param[in] state      1=set DTR (STM8 in reset), 0=clear DTR
 
-  generate low pulse on DTR in [ms] to reset STM8.
+  set or clear DTR line. Pseudo terminals have no modem lines, so the
+  request is ignored there.
 */
-void pulse_DTR(HANDLE fpCom, uint32_t duration) {
+void set_DTR(HANDLE fpCom, uint8_t state) {
   
 /////////
-// Win32 (see https://msdn.microsoft.com/en-us/library/windows/desktop/aa363254(v=vs.85).aspx)
+// Win32
 /////////
 #if defined(WIN32)
 
-  // set DTR
-  EscapeCommFunction(fpCom, SETDTR);
-  
-  // wait specified duration
-  SLEEP(duration);
-  
-  // clear DTR
-  EscapeCommFunction(fpCom, CLRDTR);
+  EscapeCommFunction(fpCom, state ? SETDTR : CLRDTR);
 
 #endif // WIN32
 
@@ -458,27 +749,42 @@ void pulse_DTR(HANDLE fpCom, uint32_t duration) {
   int status;
   
   ioctl(fpCom, TIOCMGET, &status);
-
-  // set DTR
-  status |= TIOCM_DTR;
-  if (ioctl(fpCom, TIOCMSET, &status)) {
+  if (state)
+    status |= TIOCM_DTR;
+  else
+    status &= ~TIOCM_DTR;
+  if (ioctl(fpCom, TIOCMSET, &status) && (errno != ENOTTY) && (errno != EINVAL)) {
     setConsoleColor(PRM_COLOR_RED);
-    fprintf(stderr, "\n\nerror in 'pulse_DTR()': cannot set DTS status, exit!\n\n");
+    fprintf(stderr, "\n\nerror in 'set_DTR()': cannot set DTR status, exit!\n\n");
     Exit(1, g_pauseOnExit);
   }
 
+#endif // __APPLE__ || __unix__
+
+} // set_DTR
+
+
+
+/**
+  \fn void pulse_DTR(HANDLE *fpCom, uint32_t duration)
+   
+  \brief generate low pulse on DTR in [ms] to reset STM8
+   
+  \param[in] fpCom      port handle
+  \param[in] duration   duration of DTR low pulse in ms
+
+  generate low pulse on DTR in [ms] to reset STM8.
+*/
+void pulse_DTR(HANDLE fpCom, uint32_t duration) {
+  
+  // set DTR
+  set_DTR(fpCom, 1);
+  
   // wait specified duration
   SLEEP(duration);
-	
+  
   // clear DTR
-  status &= ~TIOCM_DTR;
-  if (ioctl(fpCom, TIOCMSET, &status)) {
-    setConsoleColor(PRM_COLOR_RED);
-    fprintf(stderr, "\n\nerror in 'pulse_DTR()': cannot reset DTS status, exit!\n\n");
-    Exit(1, g_pauseOnExit);
-  }
-
-#endif // __APPLE__ || __unix__
+  set_DTR(fpCom, 0);
 
 } // pulse_DTR
 
@@ -631,6 +937,15 @@ void get_port_attribute(HANDLE fpCom, uint32_t *baudrate, uint32_t *timeout, uin
 #endif
 #ifdef B230400
     case B230400:  *baudrate = 230400;  break;
+#endif
+#ifdef B460800
+    case B460800:  *baudrate = 460800;  break;
+#endif
+#ifdef B921600
+    case B921600:  *baudrate = 921600;  break;
+#endif
+#ifdef B1000000
+    case B1000000: *baudrate = 1000000; break;
 #endif
     default: *baudrate = UINT32_MAX;
   } // switch (brate)
@@ -810,6 +1125,15 @@ void set_port_attribute(HANDLE fpCom, uint32_t baudrate, uint32_t timeout, uint8
 #endif
 #ifdef B230400
     case 230400: brate=B230400; break;
+#endif
+#ifdef B460800
+    case 460800: brate=B460800; break;
+#endif
+#ifdef B921600
+    case 921600: brate=B921600; break;
+#endif
+#ifdef B1000000
+    case 1000000: brate=B1000000; break;
 #endif
     default: 
       setConsoleColor(PRM_COLOR_RED);
@@ -862,7 +1186,7 @@ void set_port_attribute(HANDLE fpCom, uint32_t baudrate, uint32_t timeout, uint8
     status |= TIOCM_DTR;
   else
     status &= ~TIOCM_DTR;
-  if (ioctl(fpCom, TIOCMSET, &status)) {
+  if (ioctl(fpCom, TIOCMSET, &status) && (errno != ENOTTY) && (errno != EINVAL)) {   // pseudo terminals have no modem lines
     setConsoleColor(PRM_COLOR_RED);
     fprintf(stderr, "\n\nerror in 'set_port_attribute()': cannot set RTS status, exit!\n\n");
     Exit(1, g_pauseOnExit);
@@ -958,6 +1282,15 @@ void set_baudrate(HANDLE fpCom, uint32_t baudrate) {
 #endif
 #ifdef B230400
     case 230400: brate=B230400; break;
+#endif
+#ifdef B460800
+    case 460800: brate=B460800; break;
+#endif
+#ifdef B921600
+    case 921600: brate=B921600; break;
+#endif
+#ifdef B1000000
+    case 1000000: brate=B1000000; break;
 #endif
     default: 
       setConsoleColor(PRM_COLOR_RED);
@@ -1071,6 +1404,7 @@ uint32_t send_port(HANDLE fpCom, uint32_t lenTx, char *Tx) {
   // for reading back LIN echo 
   char      Rx[1000];
   uint32_t  lenRx;
+  uint64_t  timeStart = time_us();    // for timeline trace
   
   
 /////////
@@ -1083,6 +1417,7 @@ uint32_t send_port(HANDLE fpCom, uint32_t lenTx, char *Tx) {
   // send data & return number of sent bytes
   PurgeComm(fpCom, PURGE_RXABORT | PURGE_RXCLEAR | PURGE_TXABORT | PURGE_TXCLEAR);
   WriteFile(fpCom, Tx, lenTx, &numChars, NULL);
+  s_stats.numWrite++;
 
 #endif // WIN32
 
@@ -1096,13 +1431,19 @@ uint32_t send_port(HANDLE fpCom, uint32_t lenTx, char *Tx) {
   
   // send data & return number of sent bytes
   numChars = write(fpCom, Tx, lenTx);
+  s_stats.numWrite++;
+  if (numChars == (uint32_t) -1)
+    numChars = 0;
 
 #endif // __APPLE__ || __unix__
 
+  s_stats.bytesTx += numChars;
+  trace_io(fpCom, "send", timeStart, numChars);
 
   // for 1-wire interface, read back LIN echo and ignore
   if (g_UARTmode == 1) {
     lenRx = receive_port(fpCom, numChars, Rx);
+    s_stats.bytesEcho += lenRx;
     if (lenRx != numChars) {
       setConsoleColor(PRM_COLOR_RED);
       fprintf(stderr, "\n\nerror in 'send_port()': read 1-wire echo failed, exit!\n\n");
@@ -1135,6 +1476,8 @@ uint32_t send_port(HANDLE fpCom, uint32_t lenTx, char *Tx) {
 */
 uint32_t receive_port(HANDLE fpCom, uint32_t lenRx, char *Rx) {
 
+  uint64_t  timeStart = time_us();    // for timeline trace
+
   
 /////////
 // Win32
@@ -1151,8 +1494,10 @@ uint32_t receive_port(HANDLE fpCom, uint32_t lenRx, char *Rx) {
     numChars = 0;
     for (i=0; i<lenRx; i++) {
       ReadFile(fpCom, Rx+i, 1, &numTmp, NULL);
+      s_stats.numRead++;
       if (numTmp == 1) {
         numChars++;
+        s_stats.bytesEcho++;
         send_port(fpCom, 1, Rx+i);
       }
       else
@@ -1165,9 +1510,14 @@ uint32_t receive_port(HANDLE fpCom, uint32_t lenRx, char *Rx) {
   // UART duplex mode or 1-wire interface -> receive all bytes in single block -> fast
   else {
     ReadFile(fpCom, Rx, lenRx, &numChars, NULL);
+    s_stats.numRead++;
   }
+  s_stats.bytesRx += numChars;
+  if (numChars < lenRx)
+    s_stats.numTimeout++;
   
   // return number of bytes received
+  trace_io(fpCom, "receive", timeStart, numChars);
   return((uint32_t) numChars);
 
 #endif // WIN32
@@ -1205,19 +1555,27 @@ uint32_t receive_port(HANDLE fpCom, uint32_t lenRx, char *Rx) {
     // wait for data to come in using select
     FD_ZERO(&fdr);
     FD_SET(fpCom, &fdr);
+    s_stats.numPoll++;
     if (select(fpCom + 1, &fdr, NULL, NULL, &tv) != 1) {
+      s_stats.numTimeout++;
+      trace_io(fpCom, "receive", timeStart, received);
       return(received);
     }
 
     // read a response, we know there's data waiting
     got = read(fpCom, dest, remaining);
+    s_stats.numRead++;
     
     // handle errors. retry on EAGAIN, fail on anything else, ignore if no bytes read
     if (got == -1) {
-      if (errno == EAGAIN)
+      if (errno == EAGAIN) {
+        s_stats.numAgain++;
         continue;
-      else
+      }
+      else {
+        trace_io(fpCom, "receive", timeStart, received);
         return(received);
+      }
     } 
     else if (got > 0) {
       
@@ -1225,18 +1583,21 @@ uint32_t receive_port(HANDLE fpCom, uint32_t lenRx, char *Rx) {
       if (g_UARTmode==2) {
         //fprintf(stderr,"sent echo %dB 0x%02x\n", (int) lenRx, Rx[0]);
         send_port(fpCom, 1, dest);
+        s_stats.bytesEcho++;
       }
       
       // figure out how many bytes are left and increment dest pointer through buffer
       dest += got;
       remaining -= got;
       received += got;
+      s_stats.bytesRx += got;
       
     } // received bytes
 
   } // while (remaining != 0)
 
   // return number of received bytes
+  trace_io(fpCom, "receive", timeStart, received);
   return(received);
   
 #endif // __APPLE__ || __unix__
@@ -1280,4 +1641,111 @@ void flush_port(HANDLE fpCom) {
 
 } // flush_port
 
+
+/**
+  \fn void get_port_stats(io_stats_t *stats)
+   
+  \brief get transport counters
+  
+  \param[out] stats   counters of send_port() and receive_port() since start
+*/
+void get_port_stats(io_stats_t *stats) {
+
+  *stats = s_stats;
+
+} // get_port_stats
+
+
+
+/**
+  \fn void add_port_stats(io_stats_t *dst, const io_stats_t *src)
+   
+  \brief add transport counters of src to dst
+*/
+void add_port_stats(io_stats_t *dst, const io_stats_t *src) {
+
+  dst->numWrite   += src->numWrite;
+  dst->numRead    += src->numRead;
+  dst->numPoll    += src->numPoll;
+  dst->numAgain   += src->numAgain;
+  dst->numTimeout += src->numTimeout;
+  dst->bytesTx    += src->bytesTx;
+  dst->bytesRx    += src->bytesRx;
+  dst->bytesEcho  += src->bytesEcho;
+
+} // add_port_stats
+
+
+
+/**
+  \fn float port_syscalls_per_kB(const io_stats_t *stats, uint32_t payload)
+   
+  \brief get number of read, write and select/poll calls per kB payload
+  
+  \param[in] stats     transport counters
+  \param[in] payload   number of payload bytes (e.g. written + verified image bytes)
+
+  \return syscalls per kB, or 0 if no payload
+*/
+float port_syscalls_per_kB(const io_stats_t *stats, uint32_t payload) {
+
+  if (payload == 0)
+    return(0.0);
+  return((float) (stats->numWrite + stats->numRead + stats->numPoll) * 1024.0 / (float) payload);
+
+} // port_syscalls_per_kB
+
+
+
+/**
+  \fn float port_line_efficiency(const io_stats_t *stats, uint32_t payload, uint8_t UARTmode)
+   
+  \brief get line efficiency
+  
+  \param[in] stats     transport counters
+  \param[in] payload   number of payload bytes
+  \param[in] UARTmode  UART mode: 0=duplex (8E1), 1=1-wire (8N1), 2=reply mode (8N1)
+
+  \return payload bits divided by all bits on the line [0..1]
+  
+  each byte on the line has 1 start, 8 data, an optional parity and 1 stop bit.
+  In 1-wire mode the received echo is no additional line traffic
+*/
+float port_line_efficiency(const io_stats_t *stats, uint32_t payload, uint8_t UARTmode) {
+
+  uint64_t  numBytes, numBits;
+
+  numBytes = (uint64_t) stats->bytesTx + stats->bytesRx;
+  if (UARTmode == 1)
+    numBytes -= stats->bytesEcho;
+  numBits = numBytes * ((UARTmode == 0) ? 11 : 10);
+  if (numBits == 0)
+    return(0.0);
+  return((float) payload * 8.0 / (float) numBits);
+
+} // port_line_efficiency
+
+
+
+/**
+  \fn void print_port_stats(const io_stats_t *stats, uint32_t payload, uint8_t UARTmode)
+   
+  \brief print transport counters and derived metrics
+  
+  \param[in] stats     transport counters
+  \param[in] payload   number of payload bytes
+  \param[in] UARTmode  UART mode (see port_line_efficiency())
+*/
+void print_port_stats(const io_stats_t *stats, uint32_t payload, uint8_t UARTmode) {
+
+  printf("  transport: %d writes, %d reads, %d polls, %d EAGAIN, %d timeouts, %dB tx, %dB rx, %dB echo\n",
+    (int) stats->numWrite, (int) stats->numRead, (int) stats->numPoll, (int) stats->numAgain, (int) stats->numTimeout,
+    (int) stats->bytesTx, (int) stats->bytesRx, (int) stats->bytesEcho);
+  if (payload > 0)
+    printf("  transport: %dB payload, %1.1f syscalls/kB, line efficiency %1.1f%%\n", (int) payload,
+      port_syscalls_per_kB(stats, payload), port_line_efficiency(stats, payload, UARTmode) * 100.0);
+  fflush(stdout);
+
+} // print_port_stats
+
 // end of file
@@ -40,12 +40,26 @@
   #include <string.h>
   #include <sys/ioctl.h>
   #include <unistd.h>
+  #include <limits.h>     // PATH_MAX
 
 #else
   #error OS not supported
 #endif
 
 
+/// transport counters of a port or session
+typedef struct {
+  uint32_t    numWrite;     ///< number of write calls
+  uint32_t    numRead;      ///< number of read calls
+  uint32_t    numPoll;      ///< number of select/poll calls
+  uint32_t    numAgain;     ///< number of calls returning EAGAIN
+  uint32_t    numTimeout;   ///< number of response timeouts
+  uint32_t    bytesTx;      ///< number of bytes sent
+  uint32_t    bytesRx;      ///< number of bytes received
+  uint32_t    bytesEcho;    ///< echo bytes: discarded 1-wire echo (UART mode 1) or sent replies (UART mode 2)
+} io_stats_t;
+
+
 /// list all available comm ports
 void        list_ports(void);
 
@@ -55,6 +69,21 @@ HANDLE      init_port(const char *port, uint32_t baudrate, uint32_t timeout, uin
 /// close comm port
 void        close_port(HANDLE *fpCom);
 
+/// get serial number of USB adapter. Returns 0 if not available
+uint8_t     get_port_serial(const char *port, char *serial, uint32_t size);
+
+/// get USB vendor and product ID of adapter. Returns 0 if not available
+uint8_t     get_port_usbid(const char *port, uint16_t *vid, uint16_t *pid);
+
+/// get latency timer of USB adapter [ms]. Returns 0 if not available
+uint8_t     get_port_latency(const char *port);
+
+/// set latency timer of USB adapter [ms]. Returns 0 if not available
+uint8_t     set_port_latency(const char *port, uint8_t latency);
+
+/// set DTR line (1=active, i.e. STM8 in reset)
+void        set_DTR(HANDLE fpCom, uint8_t state);
+
 /// generate low pulse on DTR in [ms] to reset STM8
 void        pulse_DTR(HANDLE fpCom, uint32_t duration);
 
@@ -82,6 +111,21 @@ uint32_t    receive_port(HANDLE fpCom, uint32_t lenRx, char *Rx);
 /// flush port buffers
 void        flush_port(HANDLE fpCom);
 
+/// get transport counters of send_port() and receive_port() (all ports)
+void        get_port_stats(io_stats_t *stats);
+
+/// add transport counters of src to dst
+void        add_port_stats(io_stats_t *dst, const io_stats_t *src);
+
+/// get number of read, write and select calls per kB payload
+float       port_syscalls_per_kB(const io_stats_t *stats, uint32_t payload);
+
+/// get payload bits divided by all bits on the line (incl. start, parity and stop bits)
+float       port_line_efficiency(const io_stats_t *stats, uint32_t payload, uint8_t UARTmode);
+
+/// print transport counters and derived metrics
+void        print_port_stats(const io_stats_t *stats, uint32_t payload, uint8_t UARTmode);
+
 #endif // _SERIAL_COMM_H_
 
 // end of file
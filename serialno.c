@@ -0,0 +1,219 @@
+/**
+  \file serialno.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief implementation of serial number allocator
+
+  implementation of a counter file, which is memory mapped and guarded by
+  flock(), so concurrent flasher processes never get the same number. The
+  counter is synced to disk before the lock is released, i.e. a number is
+  never handed out twice, even after a crash. Numbers of a reserved block,
+  which are not used before the process terminates, are lost (gaps).
+  File layout (binary, native byte order):
+    char      magic[8]    "STM8SNO"
+    uint64_t  next        next free serial number
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "serialno.h"
+#include "image.h"
+#include "misc.h"
+#include "globals.h"
+
+// OS specific: Posix
+#if defined(__APPLE__) || defined(__unix__)
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <pthread.h>
+  #include <sys/file.h>
+  #include <sys/stat.h>
+  #include <sys/mman.h>
+#endif
+
+
+/// content of counter file
+typedef struct {
+  char        magic[8];     ///< file identifier
+  uint64_t    next;         ///< next free serial number
+} serialno_file_t;
+
+// file identifier
+#define SERIALNO_MAGIC      "STM8SNO"
+
+
+#if defined(__APPLE__) || defined(__unix__)
+
+// counter file and its mapping
+static int                s_fd = -1;
+static serialno_file_t    *s_map = NULL;
+
+// serialize threads of this process (flock() is per open file description)
+static pthread_mutex_t    s_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#endif // __APPLE__ || __unix__
+
+
+
+/**
+  \fn void serialno_open(const char *filename)
+
+  \brief open counter file
+
+  \param[in] filename   name of counter file. If missing it is created with first serial number 1
+*/
+void serialno_open(const char *filename) {
+
+#if defined(__APPLE__) || defined(__unix__)
+
+  struct stat       st;
+  serialno_file_t   init;
+
+  // open or create file. Initialize under lock, another process may do the same
+  if ((s_fd = open(filename, O_RDWR | O_CREAT, 0644)) < 0)
+    Error("cannot open serial number file '%s'", filename);
+  flock(s_fd, LOCK_EX);
+  if (fstat(s_fd, &st) != 0)
+    Error("cannot access serial number file '%s'", filename);
+  if (st.st_size == 0) {
+    memset(&init, 0, sizeof(init));
+    strcpy(init.magic, SERIALNO_MAGIC);
+    init.next = 1;
+    if ((write(s_fd, &init, sizeof(init)) != sizeof(init)) || (fsync(s_fd) != 0))
+      Error("cannot initialize serial number file '%s'", filename);
+    st.st_size = sizeof(init);
+  }
+  flock(s_fd, LOCK_UN);
+
+  // map counter. Accessing a mapping beyond end of file raises SIGBUS
+  if (st.st_size < (off_t) sizeof(serialno_file_t))
+    Error("'%s' is no serial number file", filename);
+  s_map = (serialno_file_t*) mmap(NULL, sizeof(serialno_file_t), PROT_READ | PROT_WRITE, MAP_SHARED, s_fd, 0);
+  if ((s_map == MAP_FAILED) || (strcmp(s_map->magic, SERIALNO_MAGIC))) {
+    s_map = NULL;
+    Error("'%s' is no serial number file", filename);
+  }
+
+#else
+
+  Error("serial number allocation not supported on this OS");
+
+#endif // __APPLE__ || __unix__
+
+} // serialno_open
+
+
+
+/**
+  \fn uint64_t serialno_reserve(uint32_t num)
+
+  \brief reserve consecutive serial numbers
+
+  \param[in] num    number of serial numbers to reserve
+
+  \return first reserved serial number
+*/
+uint64_t serialno_reserve(uint32_t num) {
+
+#if defined(__APPLE__) || defined(__unix__)
+
+  uint64_t    first;
+
+  if (!s_map)
+    Error("serial number file not opened");
+  pthread_mutex_lock(&s_lock);
+  flock(s_fd, LOCK_EX);
+  first = s_map->next;
+  s_map->next = first + num;
+  msync(s_map, sizeof(serialno_file_t), MS_SYNC);
+  flock(s_fd, LOCK_UN);
+  pthread_mutex_unlock(&s_lock);
+  return(first);
+
+#else
+
+  return(0);
+
+#endif // __APPLE__ || __unix__
+
+} // serialno_reserve
+
+
+
+/**
+  \fn uint64_t serialno_next(serialno_block_t *block)
+
+  \brief get next serial number of a worker
+
+  \param[in,out] block   numbers reserved by the worker (init with zeros)
+
+  \return serial number
+*/
+uint64_t serialno_next(serialno_block_t *block) {
+
+  if (block->next >= block->end) {
+    block->next = serialno_reserve(SERIALNO_BLOCK);
+    block->end  = block->next + SERIALNO_BLOCK;
+  }
+  return(block->next++);
+
+} // serialno_next
+
+
+
+/**
+  \fn image_t *serialno_patch(const image_t *image, uint32_t addr, uint64_t serial)
+
+  \brief create copy of image with serial number
+
+  \param[in] image     prepared image
+  \param[in] addr      address of serial number in image
+  \param[in] serial    serial number
+
+  \return prepared copy with reference count 1
+
+  the serial number is stored as SERIALNO_BYTES big-endian value (native STM8 byte order).
+  Larger serial numbers would be truncated and are rejected
+*/
+image_t *serialno_patch(const image_t *image, uint32_t addr, uint64_t serial) {
+
+  char      buf[SERIALNO_BYTES];
+  uint8_t   i;
+
+  if ((SERIALNO_BYTES < 8) && (serial >> (8*SERIALNO_BYTES)))
+    Error("serial number %llu exceeds %d bytes", (unsigned long long) serial, SERIALNO_BYTES);
+  for (i=0; i<SERIALNO_BYTES; i++)
+    buf[i] = (char) (serial >> (8*(SERIALNO_BYTES-1-i)));
+  return(image_patch(image, addr, SERIALNO_BYTES, buf));
+
+} // serialno_patch
+
+
+
+/**
+  \fn void serialno_close(void)
+
+  \brief close counter file
+*/
+void serialno_close(void) {
+
+#if defined(__APPLE__) || defined(__unix__)
+
+  if (s_map)
+    munmap(s_map, sizeof(serialno_file_t));
+  if (s_fd >= 0)
+    close(s_fd);
+  s_map = NULL;
+  s_fd  = -1;
+
+#endif // __APPLE__ || __unix__
+
+} // serialno_close
+
+// end of file
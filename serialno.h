@@ -0,0 +1,56 @@
+/**
+  \file serialno.h
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief declaration of serial number allocator
+
+  declaration of routines for allocating unique per-board serial numbers from
+  a counter file, which is shared by all flasher processes on a host. Workers
+  reserve blocks of numbers, so the file lock is taken only once per block.
+*/
+
+// for including file only once
+#ifndef _SERIALNO_H_
+#define _SERIALNO_H_
+
+
+// include files
+#include <stdint.h>
+#include "image.h"
+
+
+/// number of serial numbers reserved at once by a worker
+#define SERIALNO_BLOCK      16
+
+/// size of serial number in image [B] (big-endian)
+#define SERIALNO_BYTES      4
+
+
+/// serial numbers reserved by a worker
+typedef struct {
+  uint64_t    next;         ///< next serial number to use
+  uint64_t    end;          ///< end of reserved block (exclusive)
+} serialno_block_t;
+
+
+/// open counter file, create it if missing (first serial number 1)
+void        serialno_open(const char *filename);
+
+/// reserve consecutive serial numbers. Returns the first one. Thread and process safe
+uint64_t    serialno_reserve(uint32_t num);
+
+/// get next serial number from block, reserve a new block if used up
+uint64_t    serialno_next(serialno_block_t *block);
+
+/// create copy of image with serial number at given address
+image_t     *serialno_patch(const image_t *image, uint32_t addr, uint64_t serial);
+
+/// close counter file
+void        serialno_close(void);
+
+#endif // _SERIALNO_H_
+
+// end of file
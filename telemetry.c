@@ -0,0 +1,219 @@
+/**
+  \file telemetry.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief implementation of JSON telemetry output
+
+  implementation of routines for writing one JSON record per BSL session.
+  Phase timestamps are relative to the session start in us, the record time
+  is the wall clock time when the session finished. Example (wrapped):
+    {"time":1792310400,"port":"/dev/ttyUSB0","job":0,"queue_us":null,"serial":1042,"status":"ok","error":"",
+     "device":{"family":"STM8S","flash_kB":128,"bsl":"2.2"},
+     "image":{"name":"fw.s19","crc32":"0x1234abcd","bytes":8000},
+     "phases":[{"name":"sync","start_us":0,"end_us":1200},...],
+     "ack_rtt_us":{"command":{"num":68,"p50":120,"p99":180,"max":190},...},
+     "io":{"writes":311,"reads":436,"polls":477,"eagain":0,"timeouts":0,"echo":0,"payload":16000,...},
+     "link":{"baud":230400,"commands":134,"timeouts":0,"nacks":0,"corrupt":0,"relinks":0,"down":0,"up":0},
+     "bytes_tx":9280,"bytes_rx":8319,"frames":63,"sync_retries":0,
+     "duration_us":652000,"throughput_Bps":12270}
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "telemetry.h"
+#include "bootloader.h"
+#include "misc.h"
+#include "globals.h"
+
+// OS specific: Posix
+#if defined(__APPLE__) || defined(__unix__)
+  #include <pthread.h>
+#endif
+
+
+// names of ACK stages
+static const char       *s_stageName[ACK_NUM_STAGES] = { "command", "address", "data" };
+
+// output stream
+static FILE             *s_fp = NULL;
+
+// serialize records of concurrent workers
+#if defined(__APPLE__) || defined(__unix__)
+  static pthread_mutex_t  s_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+
+
+/**
+  \fn static int json_string(char *out, int size, const char *in)
+
+  \brief copy string with JSON escapes
+
+  \param[out] out    output buffer
+  \param[in]  size   size of output buffer
+  \param[in]  in     string to escape
+
+  \return number of characters written (excl. terminating zero)
+*/
+static int json_string(char *out, int size, const char *in) {
+
+  int   len = 0;
+
+  for (; (*in) && (len < size-7); in++) {
+    if ((*in == '"') || (*in == '\\'))
+      len += sprintf(out+len, "\\%c", *in);
+    else if ((uint8_t) *in < 0x20)
+      len += sprintf(out+len, "\\u%04x", (uint8_t) *in);
+    else
+      out[len++] = *in;
+  }
+  out[len] = '\0';
+  return(len);
+
+} // json_string
+
+
+
+/**
+  \fn void telemetry_open(const char *filename)
+
+  \brief open telemetry output
+
+  \param[in] filename   name of output file (appended), or "-" for stdout
+*/
+void telemetry_open(const char *filename) {
+
+  if (!strcmp(filename, "-"))
+    s_fp = stdout;
+  else if (!(s_fp = fopen(filename, "a"))) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'telemetry_open()': cannot open file '%s', exit!\n\n", filename);
+    Exit(1, g_pauseOnExit);
+  }
+
+} // telemetry_open
+
+
+
+/**
+  \fn void telemetry_write(const bsl_sm_t *sm, uint32_t job)
+
+  \brief write record of finished session
+
+  \param[in] sm     finished session
+  \param[in] job    job number (for gang programming), 0=none
+
+  compose the JSON record and write it as single line. Does nothing if
+  telemetry output is not opened
+*/
+void telemetry_write(const bsl_sm_t *sm, uint32_t job) {
+
+  char            buf[4096], str[1100];
+  int             len = 0, num = 0;
+  uint8_t         phase, stage;
+  uint64_t        start, end, duration;
+  const image_t   *image = sm->cfg->image;
+
+  if (!s_fp)
+    return;
+
+  // session info and device identity
+  duration = sm->timeEnd - sm->timeStart;
+  json_string(str, sizeof(str), sm->name);
+  len += sprintf(buf+len, "{\"time\":%lld,\"port\":\"%s\",\"job\":%d", (long long) time(NULL), str, (int) job);
+  if (sm->queueLatency >= 0)
+    len += sprintf(buf+len, ",\"queue_us\":%lld", (long long) sm->queueLatency);
+  else
+    len += sprintf(buf+len, ",\"queue_us\":null");
+  if (sm->serialNo >= 0)
+    len += sprintf(buf+len, ",\"serial\":%lld", (long long) sm->serialNo);
+  else
+    len += sprintf(buf+len, ",\"serial\":null");
+  json_string(str, sizeof(str), sm->error);
+  len += sprintf(buf+len, ",\"status\":\"%s\",\"error\":\"%s\"", (sm->status == SM_STATUS_OK) ? "ok" : "failed", str);
+  len += sprintf(buf+len, ",\"device\":{\"family\":\"%s\",\"flash_kB\":%d,\"bsl\":\"%x.%x\"}",
+    (sm->family == STM8S) ? "STM8S" : ((sm->family == STM8L) ? "STM8L" : "unknown"), sm->flashsize,
+    (sm->versBSL >> 4) & 0x0F, sm->versBSL & 0x0F);
+
+  // image identity
+  if (image) {
+    json_string(str, sizeof(str), image->name);
+    len += sprintf(buf+len, ",\"image\":{\"name\":\"%s\",\"crc32\":\"0x%08x\",\"bytes\":%d}", str, image->crc, (int) image_dataBytes(image));
+  }
+  else
+    len += sprintf(buf+len, ",\"image\":null");
+
+  // executed phases. A failed session ends within its current phase
+  len += sprintf(buf+len, ",\"phases\":[");
+  for (phase=SM_PHASE_SYNC; phase<SM_PHASE_DONE; phase++) {
+    start = sm->phaseStart[phase];
+    end   = sm->phaseEnd[phase];
+    if ((end == 0) && (phase == sm->phase) && (sm->status == SM_STATUS_FAILED))
+      end = sm->timeEnd;
+    if ((start == 0) || (end == 0))               // not reached or skipped
+      continue;
+    len += sprintf(buf+len, "%s{\"name\":\"%s\",\"start_us\":%lld,\"end_us\":%lld}", (num++ > 0) ? "," : "",
+      bsl_sm_phaseName(phase), (long long) (start - sm->timeStart), (long long) (end - sm->timeStart));
+  }
+  len += sprintf(buf+len, "]");
+
+  // send-to-ACK round-trip times per ACK stage
+  len += sprintf(buf+len, ",\"ack_rtt_us\":{");
+  for (stage=0; stage<ACK_NUM_STAGES; stage++) {
+    len += sprintf(buf+len, "%s\"%s\":{\"num\":%d,\"p50\":%d,\"p99\":%d,\"max\":%d}", (stage > 0) ? "," : "",
+      s_stageName[stage], (int) sm->ackRtt[stage].num, (int) hist_percentile(&(sm->ackRtt[stage]), 50.0),
+      (int) hist_percentile(&(sm->ackRtt[stage]), 99.0), (int) sm->ackRtt[stage].max);
+  }
+  len += sprintf(buf+len, "}");
+
+  // syscall and byte accounting of transport
+  len += sprintf(buf+len, ",\"io\":{\"writes\":%d,\"reads\":%d,\"polls\":%d,\"eagain\":%d,\"timeouts\":%d,\"echo\":%d,\"payload\":%d,\"syscalls_per_kB\":%1.1f,\"line_efficiency\":%1.3f}",
+    (int) sm->io.numWrite, (int) sm->io.numRead, (int) sm->io.numPoll, (int) sm->io.numAgain, (int) sm->io.numTimeout,
+    (int) sm->io.bytesEcho, (int) sm->bytesPayload, port_syscalls_per_kB(&(sm->io), sm->bytesPayload),
+    port_line_efficiency(&(sm->io), sm->bytesPayload, sm->cfg->UARTmode));
+
+  // link quality and renegotiation
+  len += sprintf(buf+len, ",\"link\":{\"baud\":%d,\"commands\":%d,\"timeouts\":%d,\"nacks\":%d,\"corrupt\":%d,\"relinks\":%d,\"down\":%d,\"up\":%d}",
+    (int) sm->link.baud, (int) sm->link.numCmd, (int) sm->link.numTimeout, (int) sm->link.numNack, (int) sm->link.numCorrupt,
+    (int) sm->numRelink, (int) sm->link.numDown, (int) sm->link.numUp);
+
+  // wire statistics and throughput of image data
+  len += sprintf(buf+len, ",\"bytes_tx\":%d,\"bytes_rx\":%d,\"frames\":%d,\"sync_retries\":%d,\"duration_us\":%lld,\"throughput_Bps\":%d}\n",
+    (int) sm->io.bytesTx, (int) sm->io.bytesRx, (int) sm->numFrames, (int) sm->retry, (long long) duration,
+    ((image) && (duration > 0)) ? (int) ((uint64_t) image_dataBytes(image) * 1000000 / duration) : 0);
+
+  // write record as single line
+#if defined(__APPLE__) || defined(__unix__)
+  pthread_mutex_lock(&s_lock);
+#endif
+  fwrite(buf, 1, len, s_fp);
+  fflush(s_fp);
+#if defined(__APPLE__) || defined(__unix__)
+  pthread_mutex_unlock(&s_lock);
+#endif
+
+} // telemetry_write
+
+
+
+/**
+  \fn void telemetry_close(void)
+
+  \brief close telemetry output
+*/
+void telemetry_close(void) {
+
+  if ((s_fp) && (s_fp != stdout))
+    fclose(s_fp);
+  s_fp = NULL;
+
+} // telemetry_close
+
+// end of file
@@ -0,0 +1,37 @@
+/**
+  \file telemetry.h
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief declaration of JSON telemetry output
+
+  declaration of routines for writing one JSON record per BSL session (JSON
+  Lines format) for processing by production databases. Each record contains
+  device identity, image CRC, per-phase timestamps, wire statistics and
+  throughput of the session.
+*/
+
+// for including file only once
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+
+// include files
+#include <stdint.h>
+#include "bsl_sm.h"
+
+
+/// open telemetry output. Name "-" writes to stdout
+void        telemetry_open(const char *filename);
+
+/// write record of finished session. Job number 0 = no job. Thread safe
+void        telemetry_write(const bsl_sm_t *sm, uint32_t job);
+
+/// close telemetry output
+void        telemetry_close(void);
+
+#endif // _TELEMETRY_H_
+
+// end of file
@@ -0,0 +1,491 @@
+/**
+  \file bench.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief end-to-end benchmark of STM8_serial_flasher against bsl_sim
+
+  runs the flasher binary against the pty-based BSL simulator for a matrix of
+  device sizes, image shapes, baudrates, UART modes and operations, and saves
+  wall time, throughput, CPU time, peak RSS and syscalls per kB of each run to
+  a JSON file. The matrix follows test_matrix.ods (duplex and 2-wire reply up
+  to 230.4kBaud, 1-wire reply up to 115.2kBaud). Each case is repeated to allow
+  a statistical comparison with a baseline. With -M the simulator uses a timing
+  model fitted to hardware traces (see tools/timing_fit.c).
+
+  usage: bench [-f flasher] [-s sim] [-o file] [-n num] [-q] [-T] [-M file,device,adapter]
+*/
+
+// include files
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+
+
+// max. number of repetitions per case
+#define BENCH_MAX_RUNS    20
+
+// start address of P-flash
+#define FLASH_START       0x8000
+
+// operations
+#define OP_CONNECT        0       // sync, identify and upload RAM routines
+#define OP_WRITE          1       // upload image without verify
+#define OP_VERIFY         2       // upload image and read back for verify
+#define OP_DUMP           3       // read complete P-flash to file
+#define OP_ERASE          4       // mass erase
+#define OP_NUM            5
+
+// image shapes
+#define IMG_DENSE         0       // complete P-flash
+#define IMG_SPARSE        1       // 64B at start of each 1kB sector
+#define IMG_DELTA         2       // two small patches
+#define IMG_NUM           3
+
+
+/// result of a benchmark case
+typedef struct {
+  uint16_t    flashKB;                    // P-flash size of simulated device [kB]
+  uint8_t     shape;                      // image shape (only write and verify)
+  uint32_t    baud;                       // baudrate
+  uint8_t     mode;                       // UART mode
+  uint8_t     op;                         // operation
+  uint32_t    numBytes;                   // payload of operation
+  uint8_t     numRuns;                    // number of successful runs
+  double      wall[BENCH_MAX_RUNS];       // wall time [s]
+  double      cpu[BENCH_MAX_RUNS];        // CPU time (user+system) [s]
+  double      rss[BENCH_MAX_RUNS];        // peak RSS [kB]
+  double      sysPerKB[BENCH_MAX_RUNS];   // syscalls per kB payload (see print_port_stats())
+} bench_case_t;
+
+
+// names for output
+static const char *s_opName[OP_NUM]     = { "connect", "write", "verify", "dump", "erase" };
+static const char *s_shapeName[IMG_NUM] = { "dense", "sparse", "delta" };
+
+// settings
+static const char *s_flasher = "./STM8_serial_flasher";
+static const char *s_sim     = "tools/bsl_sim";
+static uint8_t    s_timing   = 1;
+static const char *s_model   = NULL;
+static char       s_dir[100];
+
+
+
+/**
+  \fn static double time_s(void)
+
+  \brief monotonic time in [s]
+*/
+static double time_s(void) {
+
+  struct timespec   ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return((double) ts.tv_sec + (double) ts.tv_nsec / 1e9);
+
+} // time_s
+
+
+
+/**
+  \fn static uint32_t write_image(const char *file, uint16_t flashKB, uint8_t shape)
+
+  \brief create s19 file with pseudo-random content
+
+  \param[in] file       name of s19 file
+  \param[in] flashKB    P-flash size [kB]
+  \param[in] shape      image shape (IMG_*)
+
+  \return number of data bytes in image
+*/
+static uint32_t write_image(const char *file, uint16_t flashKB, uint8_t shape) {
+
+  FILE      *fp;
+  uint32_t  size = (uint32_t) flashKB * 1024, seed = 0x12345678, numBytes = 0;
+  uint32_t  addr, len, i, k;
+  uint8_t   data[32], chk;
+
+  if (!(fp = fopen(file, "w"))) {
+    fprintf(stderr, "bench: cannot create '%s'\n", file);
+    exit(1);
+  }
+  for (addr=0; addr<size; addr+=sizeof(data)) {
+
+    // select records depending on shape
+    if ((shape == IMG_SPARSE) && ((addr % 1024) >= 64))
+      continue;
+    if ((shape == IMG_DELTA) && (addr >= 128) && ((addr < size/2) || (addr >= size/2 + 128)))
+      continue;
+
+    // S2 record (24-bit address) with pseudo-random data
+    len = sizeof(data);
+    chk = (uint8_t) (len + 4);
+    fprintf(fp, "S2%02X%06X", (unsigned) (len + 4), (unsigned) (FLASH_START + addr));
+    for (k=0; k<3; k++)
+      chk += (uint8_t) ((FLASH_START + addr) >> (8*k));
+    for (i=0; i<len; i++) {
+      seed = seed * 1103515245 + 12345;
+      data[i] = (uint8_t) (seed >> 16);
+      chk += data[i];
+      fprintf(fp, "%02X", data[i]);
+    }
+    fprintf(fp, "%02X\n", (uint8_t) ~chk);
+    numBytes += len;
+  }
+  fprintf(fp, "S9030000FC\n");
+  fclose(fp);
+
+  return(numBytes);
+
+} // write_image
+
+
+
+/**
+  \fn static pid_t start_sim(const bench_case_t *c, const char *link)
+
+  \brief start simulator on pseudo terminal and wait until it is ready
+*/
+static pid_t start_sim(const bench_case_t *c, const char *link) {
+
+  char    kB[10], mode[10], baud[20], line[200];
+  int     fd[2];
+  pid_t   pid;
+  FILE    *fp;
+
+  sprintf(kB, "%d", (int) c->flashKB);
+  sprintf(mode, "%d", (int) c->mode);
+  sprintf(baud, "%d", (int) c->baud);
+  if (pipe(fd)) {
+    perror("bench: pipe");
+    exit(1);
+  }
+  pid = fork();
+  if (pid == 0) {
+    dup2(fd[1], STDOUT_FILENO);
+    dup2(open("/dev/null", O_WRONLY), STDERR_FILENO);
+    close(fd[0]);
+    close(fd[1]);
+    if (!s_timing)
+      execl(s_sim, s_sim, "-s", kB, "-u", mode, "-b", baud, "-l", link, "-T", NULL);
+    else if (s_model)
+      execl(s_sim, s_sim, "-s", kB, "-u", mode, "-b", baud, "-l", link, "-M", s_model, NULL);
+    else
+      execl(s_sim, s_sim, "-s", kB, "-u", mode, "-b", baud, "-l", link, NULL);
+    perror("bench: cannot start simulator");
+    _exit(1);
+  }
+
+  // simulator prints name of pty when ready
+  close(fd[1]);
+  fp = fdopen(fd[0], "r");
+  if ((pid < 0) || (!fgets(line, sizeof(line), fp))) {
+    fprintf(stderr, "bench: simulator '%s' failed\n", s_sim);
+    exit(1);
+  }
+  fclose(fp);
+
+  return(pid);
+
+} // start_sim
+
+
+
+/**
+  \fn static uint8_t run_case(bench_case_t *c)
+
+  \brief run flasher once for benchmark case and store result
+
+  \return 1 on success, else 0
+*/
+static uint8_t run_case(bench_case_t *c) {
+
+  char            port[200], image[200], dump[200], log[200], baud[20], mode[10], stop[20], line[300];
+  const char      *argv[20];
+  int             argc = 0, status, fd;
+  pid_t           sim, pid;
+  struct rusage   ru;
+  double          start, wall;
+  uint32_t        payload;
+  float           sysPerKB = 0.0;
+  FILE            *fp;
+
+  // start simulated device
+  sprintf(port,  "%s/port", s_dir);
+  sprintf(image, "%s/%dK_%s.s19", s_dir, (int) c->flashKB, s_shapeName[c->shape]);
+  sprintf(dump,  "%s/dump.s19", s_dir);
+  sprintf(log,   "%s/flasher.log", s_dir);
+  sprintf(baud,  "%d", (int) c->baud);
+  sprintf(mode,  "%d", (int) c->mode);
+  sprintf(stop,  "%x", (unsigned) (FLASH_START + c->flashKB * 1024 - 1));
+  sim = start_sim(c, port);
+
+  // commandline of flasher
+  argv[argc++] = s_flasher;
+  argv[argc++] = "-p";  argv[argc++] = port;
+  argv[argc++] = "-b";  argv[argc++] = baud;
+  argv[argc++] = "-u";  argv[argc++] = mode;
+  argv[argc++] = "-Q";  argv[argc++] = "-j";  argv[argc++] = "-x";
+  if (c->op == OP_WRITE) {
+    argv[argc++] = "-w";  argv[argc++] = image;  argv[argc++] = "-v";
+  }
+  else if (c->op == OP_VERIFY) {
+    argv[argc++] = "-w";  argv[argc++] = image;
+  }
+  else if (c->op == OP_DUMP) {
+    argv[argc++] = "-r";  argv[argc++] = "8000";  argv[argc++] = stop;  argv[argc++] = dump;
+  }
+  else if (c->op == OP_ERASE)
+    argv[argc++] = "-e";
+  argv[argc] = NULL;
+
+  // run flasher and measure resources
+  start = time_s();
+  pid = fork();
+  if (pid == 0) {
+    fd = open(log, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    dup2(fd, STDOUT_FILENO);
+    dup2(fd, STDERR_FILENO);
+    execv(s_flasher, (char * const *) argv);
+    _exit(127);
+  }
+  if ((pid < 0) || (wait4(pid, &status, 0, &ru) != pid))
+    status = -1;
+  wall = time_s() - start;
+
+  // stop simulator
+  kill(sim, SIGTERM);
+  waitpid(sim, NULL, 0);
+
+  // check result and get syscalls per kB from transport statistics
+  if ((status != 0) || (!(fp = fopen(log, "r")))) {
+    fprintf(stderr, "\nbench: flasher failed, see '%s'\n", log);
+    return(0);
+  }
+  while (fgets(line, sizeof(line), fp))
+    if (sscanf(line, " transport: %uB payload, %f syscalls/kB", &payload, &sysPerKB) == 2)
+      break;
+  fclose(fp);
+
+  // store result
+  c->wall[c->numRuns]     = wall;
+  c->cpu[c->numRuns]      = (double) (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) + (double) (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+  #if defined(__APPLE__)
+    c->rss[c->numRuns]    = (double) ru.ru_maxrss / 1024.0;   // bytes on macOS
+  #else
+    c->rss[c->numRuns]    = (double) ru.ru_maxrss;            // kB on Linux
+  #endif
+  c->sysPerKB[c->numRuns] = sysPerKB;
+  c->numRuns++;
+
+  return(1);
+
+} // run_case
+
+
+
+/**
+  \fn static double mean(const double *val, uint8_t num)
+
+  \brief mean value of array
+*/
+static double mean(const double *val, uint8_t num) {
+
+  double    sum = 0.0;
+  uint8_t   i;
+
+  for (i=0; i<num; i++)
+    sum += val[i];
+  return((num > 0) ? sum / num : 0.0);
+
+} // mean
+
+
+
+/**
+  \fn static void print_array(FILE *fp, const char *name, const double *val, uint8_t num)
+
+  \brief print JSON array of samples
+*/
+static void print_array(FILE *fp, const char *name, const double *val, uint8_t num) {
+
+  uint8_t   i;
+
+  fprintf(fp, ",\"%s\":[", name);
+  for (i=0; i<num; i++)
+    fprintf(fp, "%s%.6g", (i > 0) ? "," : "", val[i]);
+  fprintf(fp, "]");
+
+} // print_array
+
+
+
+/**
+  \fn int main(int argc, char *argv[])
+
+  \brief main routine of benchmark
+*/
+int main(int argc, char *argv[]) {
+
+  // test matrix (see test_matrix.ods)
+  static const uint16_t sizeFull[]  = { 8, 32, 128, 256 };
+  static const uint16_t sizeQuick[] = { 8, 32 };
+  static const struct { uint32_t baud; uint8_t mode; } link[] = {
+    { 115200, 0 }, { 230400, 0 }, { 115200, 1 }, { 115200, 2 }, { 230400, 2 }
+  };
+
+  const char      *fileOut = "bench.json";
+  const uint16_t  *size = sizeFull;
+  uint8_t         numSize = 4, numRuns = 3, quick = 0;
+  uint8_t         s, l, op, shape, numShapes, run;
+  uint32_t        imgBytes[IMG_NUM];
+  bench_case_t    *cases, *c;
+  uint32_t        numCases = 0, numFailed = 0, i;
+  int             arg;
+  char            file[200];
+  double          tp[BENCH_MAX_RUNS];
+  FILE            *fp;
+  time_t          now;
+
+  // parse commandline
+  for (arg=1; arg<argc; arg++) {
+    if (!strcmp(argv[arg], "-f") && (arg<argc-1))
+      s_flasher = argv[++arg];
+    else if (!strcmp(argv[arg], "-s") && (arg<argc-1))
+      s_sim = argv[++arg];
+    else if (!strcmp(argv[arg], "-o") && (arg<argc-1))
+      fileOut = argv[++arg];
+    else if (!strcmp(argv[arg], "-n") && (arg<argc-1))
+      numRuns = atoi(argv[++arg]);
+    else if (!strcmp(argv[arg], "-q"))
+      quick = 1;
+    else if (!strcmp(argv[arg], "-T"))
+      s_timing = 0;
+    else if (!strcmp(argv[arg], "-M") && (arg<argc-1))
+      s_model = argv[++arg];
+    else {
+      printf("usage: %s [-f flasher] [-s sim] [-o file] [-n num] [-q] [-T] [-M file,device,adapter]\n", argv[0]);
+      printf("  -f flasher   flasher binary (default: ./STM8_serial_flasher)\n");
+      printf("  -s sim       BSL simulator (default: tools/bsl_sim)\n");
+      printf("  -o file      JSON output file (default: bench.json)\n");
+      printf("  -n num       runs per case, 1..%d (default: 3)\n", BENCH_MAX_RUNS);
+      printf("  -q           quick matrix: 8kB and 32kB devices, 230.4kBaud duplex only\n");
+      printf("  -T           don't emulate line and processing time (host overhead only)\n");
+      printf("  -M f,d,a     simulate device d and adapter a of timing model file f (see bsl_sim)\n");
+      return(1);
+    }
+  }
+  if ((numRuns < 1) || (numRuns > BENCH_MAX_RUNS))
+    numRuns = 3;
+  if (quick) {
+    size    = sizeQuick;
+    numSize = 2;
+  }
+
+  // working directory for pty link, images and logs
+  strcpy(s_dir, "/tmp/stm8_bench_XXXXXX");
+  if (!mkdtemp(s_dir)) {
+    perror("bench: cannot create working directory");
+    return(1);
+  }
+  cases = (bench_case_t*) calloc(numSize * 5 * (OP_NUM + 2*(IMG_NUM-1)), sizeof(bench_case_t));
+  if (!cases) {
+    fprintf(stderr, "bench: cannot allocate memory\n");
+    return(1);
+  }
+
+  // loop over test matrix
+  for (s=0; s<numSize; s++) {
+    for (shape=0; shape<IMG_NUM; shape++) {
+      sprintf(file, "%s/%dK_%s.s19", s_dir, (int) size[s], s_shapeName[shape]);
+      imgBytes[shape] = write_image(file, size[s], shape);
+    }
+    for (l=0; l<5; l++) {
+      if ((quick) && ((link[l].baud != 230400) || (link[l].mode != 0)))
+        continue;
+      for (op=0; op<OP_NUM; op++) {
+        numShapes = ((op == OP_WRITE) || (op == OP_VERIFY)) ? IMG_NUM : 1;
+        for (shape=0; shape<numShapes; shape++) {
+
+          // set up case
+          c = &(cases[numCases++]);
+          c->flashKB = size[s];
+          c->shape   = shape;
+          c->baud    = link[l].baud;
+          c->mode    = link[l].mode;
+          c->op      = op;
+          if ((op == OP_WRITE) || (op == OP_VERIFY))
+            c->numBytes = imgBytes[shape];
+          else if (op == OP_DUMP)
+            c->numBytes = (uint32_t) size[s] * 1024;
+          printf("  %3dkB %-7s %6d mode %d %-7s ", (int) c->flashKB, (numShapes > 1) ? s_shapeName[shape] : "-",
+            (int) c->baud, (int) c->mode, s_opName[op]);
+          fflush(stdout);
+
+          // run repeatedly
+          for (run=0; run<numRuns; run++)
+            run_case(c);
+          numFailed += (c->numRuns < numRuns);
+          if (c->numRuns > 0)
+            printf("%7.2fs  %5.1f%% CPU  %6.0fkB RSS\n", mean(c->wall, c->numRuns),
+              100.0 * mean(c->cpu, c->numRuns) / mean(c->wall, c->numRuns), mean(c->rss, c->numRuns));
+          else
+            printf("failed\n");
+
+        } // loop over shapes
+      } // loop over operations
+    } // loop over baudrate and mode
+  } // loop over device sizes
+
+  // save results
+  if (!(fp = fopen(fileOut, "w"))) {
+    fprintf(stderr, "bench: cannot create '%s'\n", fileOut);
+    return(1);
+  }
+  now = time(NULL);
+  fprintf(fp, "{\"date\":%lld,\"timing\":%d,\"runs\":%d,\"cases\":[\n", (long long) now, (int) s_timing, (int) numRuns);
+  for (i=0; i<numCases; i++) {
+    c = &(cases[i]);
+    for (run=0; run<c->numRuns; run++)
+      tp[run] = (c->wall[run] > 0) ? (double) c->numBytes / c->wall[run] : 0.0;
+    fprintf(fp, "%s{\"name\":\"%dK/%s/%d/u%d/%s\",\"flash_kB\":%d,\"image\":\"%s\",\"baud\":%d,\"mode\":%d,\"op\":\"%s\",\"bytes\":%d",
+      (i > 0) ? ",\n" : "", (int) c->flashKB, ((c->op == OP_WRITE) || (c->op == OP_VERIFY)) ? s_shapeName[c->shape] : "-",
+      (int) c->baud, (int) c->mode, s_opName[c->op], (int) c->flashKB,
+      ((c->op == OP_WRITE) || (c->op == OP_VERIFY)) ? s_shapeName[c->shape] : "-", (int) c->baud, (int) c->mode,
+      s_opName[c->op], (int) c->numBytes);
+    print_array(fp, "wall_s", c->wall, c->numRuns);
+    print_array(fp, "throughput_Bps", tp, c->numRuns);
+    print_array(fp, "cpu_s", c->cpu, c->numRuns);
+    print_array(fp, "rss_kB", c->rss, c->numRuns);
+    print_array(fp, "syscalls_per_kB", c->sysPerKB, c->numRuns);
+    fprintf(fp, "}");
+  }
+  fprintf(fp, "\n]}\n");
+  fclose(fp);
+  printf("\n  %d cases, %d failed, results saved to '%s'\n", (int) numCases, (int) numFailed, fileOut);
+
+  // clean up
+  sprintf(file, "rm -rf %s", s_dir);
+  if (system(file)) {}
+  free(cases);
+
+  return(numFailed > 0);
+
+} // main
+
+// end of file
@@ -0,0 +1,271 @@
+/**
+  \file bench_compare.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief compare benchmark results with a baseline
+
+  loads two JSON files written by tools/bench and compares throughput, connect
+  time, CPU time, peak RSS and syscalls per kB of all cases present in both. A
+  change is flagged as regression if it exceeds the threshold and is
+  statistically significant (Welch's t-test, 95% two-sided). With a single run
+  per case only the threshold is checked. Returns exit code 1 if any regression was found.
+
+  usage: bench_compare [-t percent] baseline.json current.json
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+
+// max. number of cases and runs per case (see bench.c)
+#define MAX_CASES     1000
+#define MAX_RUNS      20
+
+// compared metrics
+#define M_THROUGHPUT  0       // throughput [B/s], higher is better
+#define M_CONNECT     1       // wall time of connect operation [s], lower is better
+#define M_CPU         2       // CPU time of flasher [s], lower is better
+#define M_RSS         3       // peak RSS [kB], lower is better
+#define M_SYSCALLS    4       // syscalls per kB payload, lower is better
+#define M_NUM         5
+
+
+/// samples of a metric
+typedef struct {
+  double    val[MAX_RUNS];
+  uint8_t   num;
+} samples_t;
+
+
+/// benchmark case
+typedef struct {
+  char        name[100];
+  samples_t   metric[M_NUM];
+} case_t;
+
+
+// metric names and JSON keys
+static const char *s_name[M_NUM] = { "throughput B/s", "connect s", "CPU s", "peak RSS kB", "syscalls/kB" };
+static const char *s_key[M_NUM]  = { "throughput_Bps", "wall_s", "cpu_s", "rss_kB", "syscalls_per_kB" };
+
+// two-sided 95% t-distribution critical values for 1..30 degrees of freedom
+static const double s_tCrit[30] = {
+  12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+  2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+  2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+
+
+/**
+  \fn static void parse_array(const char *line, const char *key, samples_t *s)
+
+  \brief get samples of JSON array "key":[v1,v2,...] in line. Missing key = no samples
+*/
+static void parse_array(const char *line, const char *key, samples_t *s) {
+
+  char    pattern[100];
+  char    *p, *end;
+
+  s->num = 0;
+  sprintf(pattern, "\"%s\":[", key);
+  if (!(p = strstr(line, pattern)))
+    return;
+  p += strlen(pattern);
+  while ((*p != ']') && (*p != '\0') && (s->num < MAX_RUNS)) {
+    s->val[s->num] = strtod(p, &end);
+    if (end == p)
+      break;
+    s->num++;
+    p = end;
+    if (*p == ',')
+      p++;
+  }
+
+} // parse_array
+
+
+
+/**
+  \fn static uint32_t load_results(const char *file, case_t *cases)
+
+  \brief load benchmark cases from JSON file (one case per line, see bench.c)
+
+  \return number of cases
+*/
+static uint32_t load_results(const char *file, case_t *cases) {
+
+  FILE      *fp;
+  char      line[10000], *p, *q;
+  uint32_t  num = 0;
+  uint8_t   m;
+  case_t    *c;
+
+  if (!(fp = fopen(file, "r"))) {
+    fprintf(stderr, "bench_compare: cannot open '%s'\n", file);
+    exit(2);
+  }
+  while (fgets(line, sizeof(line), fp) && (num < MAX_CASES)) {
+    if (!(p = strstr(line, "\"name\":\"")))
+      continue;
+    p += 8;
+    if (!(q = strchr(p, '"')))
+      continue;
+    c = &(cases[num++]);
+    memset(c, 0, sizeof(case_t));
+    strncpy(c->name, p, ((size_t) (q-p) < sizeof(c->name)) ? (size_t) (q-p) : sizeof(c->name)-1);
+    for (m=0; m<M_NUM; m++)
+      parse_array(line, s_key[m], &(c->metric[m]));
+
+    // connect time only for connect operation, throughput and syscalls only with payload
+    if (!strstr(line, "\"op\":\"connect\""))
+      c->metric[M_CONNECT].num = 0;
+    if (strstr(line, "\"bytes\":0,")) {
+      c->metric[M_THROUGHPUT].num = 0;
+      c->metric[M_SYSCALLS].num = 0;
+    }
+  }
+  fclose(fp);
+
+  return(num);
+
+} // load_results
+
+
+
+/**
+  \fn static void stats(const samples_t *s, double *mean, double *var)
+
+  \brief mean and sample variance
+*/
+static void stats(const samples_t *s, double *mean, double *var) {
+
+  double    sum = 0.0, sq = 0.0;
+  uint8_t   i;
+
+  for (i=0; i<s->num; i++)
+    sum += s->val[i];
+  *mean = sum / s->num;
+  for (i=0; i<s->num; i++)
+    sq += (s->val[i] - *mean) * (s->val[i] - *mean);
+  *var = (s->num > 1) ? sq / (s->num - 1) : 0.0;
+
+} // stats
+
+
+
+/**
+  \fn static uint8_t significant(const samples_t *a, const samples_t *b)
+
+  \brief check if means differ significantly (Welch's t-test, 95% two-sided)
+
+  \return 1 if significant or not testable (single run), else 0
+*/
+static uint8_t significant(const samples_t *a, const samples_t *b) {
+
+  double    meanA, varA, meanB, varB, seA, seB, t, df;
+
+  if ((a->num < 2) || (b->num < 2))
+    return(1);
+  stats(a, &meanA, &varA);
+  stats(b, &meanB, &varB);
+  seA = varA / a->num;
+  seB = varB / b->num;
+
+  // no scatter, e.g. deterministic syscall count
+  if (seA + seB == 0.0)
+    return(meanA != meanB);
+
+  // Welch-Satterthwaite degrees of freedom
+  t  = fabs(meanA - meanB) / sqrt(seA + seB);
+  df = (seA + seB) * (seA + seB) / (seA*seA / (a->num - 1) + seB*seB / (b->num - 1));
+  if (df < 1.0)
+    df = 1.0;
+  return(t > ((df <= 30.0) ? s_tCrit[(int) df - 1] : 1.960));
+
+} // significant
+
+
+
+/**
+  \fn int main(int argc, char *argv[])
+
+  \brief main routine of benchmark comparison
+*/
+int main(int argc, char *argv[]) {
+
+  static case_t   base[MAX_CASES], curr[MAX_CASES];
+  uint32_t        numBase, numCurr, numCompared = 0, numRegress = 0, numImprove = 0, numMissing = 0;
+  uint32_t        i, k;
+  double          threshold = 5.0, meanA, meanB, var, change;
+  const char      *fileBase = NULL, *fileCurr = NULL;
+  uint8_t         m, worse;
+  int             arg;
+
+  // parse commandline
+  for (arg=1; arg<argc; arg++) {
+    if (!strcmp(argv[arg], "-t") && (arg<argc-1))
+      threshold = atof(argv[++arg]);
+    else if ((!fileBase) && (argv[arg][0] != '-'))
+      fileBase = argv[arg];
+    else if ((!fileCurr) && (argv[arg][0] != '-'))
+      fileCurr = argv[arg];
+    else
+      fileBase = NULL;
+  }
+  if ((!fileBase) || (!fileCurr)) {
+    printf("usage: %s [-t percent] baseline.json current.json\n", argv[0]);
+    printf("  -t percent   min. change of mean to report (default: 5)\n");
+    return(2);
+  }
+  numBase = load_results(fileBase, base);
+  numCurr = load_results(fileCurr, curr);
+
+  // compare all cases of baseline
+  printf("  %-32s %-13s %12s %12s %8s\n", "case", "metric", "baseline", "current", "change");
+  for (i=0; i<numBase; i++) {
+    for (k=0; (k<numCurr) && (strcmp(base[i].name, curr[k].name)); k++);
+    if (k == numCurr) {
+      numMissing++;
+      continue;
+    }
+    for (m=0; m<M_NUM; m++) {
+      const samples_t *a = &(base[i].metric[m]), *b = &(curr[k].metric[m]);
+      if ((a->num == 0) || (b->num == 0))
+        continue;
+      numCompared++;
+      stats(a, &meanA, &var);
+      stats(b, &meanB, &var);
+      if (meanA == 0.0)
+        continue;
+
+      // relative change in direction of a regression
+      change = 100.0 * (meanB - meanA) / meanA;
+      worse  = (m == M_THROUGHPUT) ? (change < 0.0) : (change > 0.0);
+      if ((fabs(change) < threshold) || (!significant(a, b)))
+        continue;
+      numRegress += worse;
+      numImprove += !worse;
+      printf("  %-32s %-13s %12.6g %12.6g %+7.1f%%  %s\n", base[i].name, s_name[m], meanA, meanB, change,
+        worse ? "REGRESSION" : "improved");
+    }
+  }
+
+  // print summary
+  printf("\n  %d metrics compared, %d regressions, %d improvements (threshold %g%%)\n", (int) numCompared,
+    (int) numRegress, (int) numImprove, threshold);
+  if (numMissing > 0)
+    printf("  warning: %d baseline cases missing in '%s'\n", (int) numMissing, fileCurr);
+
+  return(numRegress > 0);
+
+} // main
+
+// end of file
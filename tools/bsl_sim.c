@@ -0,0 +1,542 @@
+/**
+  \file bsl_sim.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief STM8 bootloader simulator on a pseudo terminal
+
+  stand-in for an STM8 in bootloader mode. Creates a pseudo terminal, which
+  can be used by STM8_serial_flasher like a serial port, and answers with the
+  target model in bsl_target.c. Line time is emulated for the given baudrate,
+  incl. the echo of the 1-wire (-u 1) and reply (-u 2) UART modes. If the
+  host sets a baudrate on the port, this is used instead. A flush of the port
+  by the host is treated like a reset of the STM8. For testing link
+  adaptation, responses can be corrupted above a given baudrate (-E). With -U
+  the resident updater of BSL_activate is installed. With -M the device and
+  adapter timing is loaded from a model fitted to hardware traces (see
+  tools/timing_fit.c), incl. the latency and USB frame alignment of the adapter.
+  The adapter delivers responses in parallel to the target, which continues
+  with pending input, like a pipelined command.
+  With -O bytes received while the BSL is busy are lost except the first, like
+  the UART data register of a BSL version which doesn't tolerate pipelining.
+  Terminates on SIGINT/SIGTERM and prints statistics to stderr.
+
+  usage: bsl_sim [-s kB] [-u mode] [-b baud] [-E baud[,percent]] [-U] [-T] [-M file,device,adapter] [-O] [-l link]
+*/
+
+// include files
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <errno.h>
+#include <termios.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include "bsl_target.h"
+
+
+// size of response queue of adapter [B]
+#define SIM_QUEUE         65536
+
+// entry address of simulated resident updater
+#define SIM_UPD_ENTRY   0x8100
+
+// simulator settings and state
+static bsl_target_t   s_target;           // target model
+static uint8_t        s_mode = 0;         // UART mode: 0=duplex, 1=1-wire echo, 2=reply mode
+static uint32_t       s_baud = 230400;    // emulated baudrate
+static uint32_t       s_baudCfg = 230400; // emulated baudrate if not set by host
+static uint32_t       s_errBaud = 0;      // corrupt responses above this baudrate (0=never)
+static uint8_t        s_errPercent = 10;  // probability of corrupted response [%]
+static uint32_t       s_numCorrupt = 0;   // number of corrupted responses
+static uint8_t        s_timing = 1;       // emulate line and processing time
+static target_adapter_t s_adapter = {0, 0}; // latency of USB-serial adapter (default: none)
+static uint8_t        s_overrun = 0;      // emulate UART overrun while BSL is busy
+static int            s_fd = -1;          // master side of pty (for adapter queue)
+static uint8_t        s_queue[SIM_QUEUE]; // bytes in adapter, delivered at due time
+static uint64_t       s_queueDue[SIM_QUEUE]; // due time of bytes in adapter [us]
+static uint32_t       s_queueHead = 0;    // next byte to deliver
+static uint32_t       s_queueTail = 0;    // next free entry
+static uint32_t       s_numLost = 0;      // number of bytes lost by overrun
+static volatile int   s_stop = 0;         // terminate request
+static uint64_t       s_bytesRx = 0;      // bytes received from host
+static uint64_t       s_bytesTx = 0;      // bytes sent to host
+
+
+
+/**
+  \fn static void on_signal(int sig)
+
+  \brief request termination
+*/
+static void on_signal(int sig) {
+
+  s_stop = 1;
+
+} // on_signal
+
+
+
+/**
+  \fn static uint64_t now_us(void)
+
+  \brief monotonic time in [us]
+*/
+static uint64_t now_us(void) {
+
+  struct timespec   ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return((uint64_t) ts.tv_sec * 1000000 + (uint64_t) ts.tv_nsec / 1000);
+
+} // now_us
+
+
+
+/**
+  \fn static void adapter_flush(void)
+
+  \brief deliver bytes of adapter which are due
+*/
+static void adapter_flush(void) {
+
+  uint64_t  now = now_us();
+  uint32_t  num;
+
+  while ((s_queueHead != s_queueTail) && (s_queueDue[s_queueHead % SIM_QUEUE] <= now)) {
+    for (num=1; (s_queueHead + num != s_queueTail) && ((s_queueHead + num) % SIM_QUEUE != 0) &&
+      (s_queueDue[(s_queueHead + num) % SIM_QUEUE] <= now); num++);
+    if (write(s_fd, s_queue + s_queueHead % SIM_QUEUE, num) == (int) num)
+      s_bytesTx += num;
+    s_queueHead += num;
+  }
+
+} // adapter_flush
+
+
+
+/**
+  \fn static int wait_input(struct pollfd *pfd, uint64_t timeout)
+
+  \brief wait for data from host with timeout [us], while adapter delivers due bytes
+*/
+static int wait_input(struct pollfd *pfd, uint64_t timeout) {
+
+  uint64_t  end = now_us() + timeout, now, next;
+  int       res;
+
+  do {
+    adapter_flush();
+    now  = now_us();
+    next = ((s_queueHead != s_queueTail) && (s_queueDue[s_queueHead % SIM_QUEUE] < end)) ? s_queueDue[s_queueHead % SIM_QUEUE] : end;
+    next = (next > now) ? next - now : 0;
+#if defined(__linux__)
+    struct timespec   ts;
+    ts.tv_sec  = next / 1000000;
+    ts.tv_nsec = (next % 1000000) * 1000;
+    res = ppoll(pfd, pfd ? 1 : 0, &ts, NULL);
+#else
+    res = poll(pfd, pfd ? 1 : 0, (int) ((next + 999) / 1000));
+#endif
+    if (res != 0)
+      return(res);
+  } while ((!s_stop) && (now_us() < end));
+  adapter_flush();
+
+  return(0);
+
+} // wait_input
+
+
+
+/**
+  \fn static void wait_us(uint64_t us)
+
+  \brief emulate processing or line time, while adapter delivers due bytes
+*/
+static void wait_us(uint64_t us) {
+
+  uint64_t  end;
+
+  if ((!s_timing) || (us == 0))
+    return;
+  end = now_us() + us;
+  while (now_us() < end)
+    wait_input(NULL, end - now_us());
+
+} // wait_us
+
+
+
+/**
+  \fn static void adapter_send(uint8_t *buf, uint16_t len)
+
+  \brief pass response to USB-serial adapter, which delivers it after its latency at the next frame
+*/
+static void adapter_send(uint8_t *buf, uint16_t len) {
+
+  uint64_t  due;
+  uint16_t  i;
+
+  // no adapter model
+  if ((!s_timing) || ((s_adapter.latency == 0) && (s_adapter.quantum == 0))) {
+    if (write(s_fd, buf, len) == len)
+      s_bytesTx += len;
+    return;
+  }
+
+  // due time: latency, then aligned to next frame
+  due = now_us() + s_adapter.latency;
+  if ((s_adapter.quantum > 0) && (due % s_adapter.quantum))
+    due += s_adapter.quantum - (due % s_adapter.quantum);
+  for (i=0; i<len; i++) {
+    while (s_queueTail - s_queueHead >= SIM_QUEUE)
+      wait_input(NULL, 100);
+    s_queue[s_queueTail % SIM_QUEUE]    = buf[i];
+    s_queueDue[s_queueTail % SIM_QUEUE] = due;
+    s_queueTail++;
+  }
+
+} // adapter_send
+
+
+
+/**
+  \fn static uint64_t line_us(uint32_t numBytes)
+
+  \brief line time for number of bytes (start + 8 data + parity + stop bit)
+*/
+static uint64_t line_us(uint32_t numBytes) {
+
+  uint32_t  bits = (s_mode == 0) ? 11 : 10;
+
+  return((uint64_t) numBytes * bits * 1000000 / s_baud);
+
+} // line_us
+
+
+
+/**
+  \fn static void update_baud(int fdSlave)
+
+  \brief use baudrate set by host on pseudo terminal, else the configured one
+*/
+static void update_baud(int fdSlave) {
+
+  static const struct { speed_t speed; uint32_t baud; } table[] = {
+    {B4800, 4800}, {B9600, 9600}, {B19200, 19200}, {B38400, 38400}, {B57600, 57600},
+    {B115200, 115200}, {B230400, 230400}, {B460800, 460800}, {B921600, 921600},
+#ifdef B1000000
+    {B1000000, 1000000},
+#endif
+  };
+  struct termios    tio;
+  speed_t           speed;
+  uint8_t           i;
+
+  s_baud = s_baudCfg;
+  if (tcgetattr(fdSlave, &tio))
+    return;
+  speed = cfgetospeed(&tio);
+  for (i=0; i<sizeof(table)/sizeof(table[0]); i++)
+    if (table[i].speed == speed)
+      s_baud = table[i].baud;
+
+} // update_baud
+
+
+
+/**
+  \fn static int read_packet(int fd, uint8_t *buf, int size)
+
+  \brief read packet from master in packet mode
+
+  \return number of data bytes, 0 if none, -1 for a flush of the port by the host (=reset)
+*/
+static int read_packet(int fd, uint8_t *buf, int size) {
+
+  uint8_t   pkt[520];
+  int       len;
+
+  len = read(fd, pkt, (size+1 < (int) sizeof(pkt)) ? size+1 : (int) sizeof(pkt));
+  if (len <= 0)
+    return(0);
+  if (pkt[0] != TIOCPKT_DATA)
+    return((pkt[0] & (TIOCPKT_FLUSHREAD | TIOCPKT_FLUSHWRITE)) ? -1 : 0);
+  memcpy(buf, pkt+1, len-1);
+  return(len-1);
+
+} // read_packet
+
+
+
+/**
+  \fn static int read_byte(int fd, uint8_t *byte, int timeout)
+
+  \brief read one byte from host with timeout [ms]. Returns 1 on success
+*/
+static int read_byte(int fd, uint8_t *byte, int timeout) {
+
+  struct pollfd   pfd;
+  int             len;
+
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  while (!s_stop) {
+    if (poll(&pfd, 1, timeout) <= 0)
+      return(0);
+    len = read_packet(fd, byte, 1);
+    if (len == 1)
+      return(1);
+    if (len < 0)
+      return(0);
+  }
+  return(0);
+
+} // read_byte
+
+
+
+/**
+  \fn static int uart_overrun(int fd, uint8_t *buf, int size, int pos, int len)
+
+  \brief emulate UART overrun of ROM BSL before a response
+
+  \return new number of bytes in buf
+
+  the ROM BSL polls its UART, so while it processes a command only the first
+  received byte is kept in the data register. Bytes received meanwhile are
+  the rest of the current packet from pos and pending packets. Called before
+  the response is sent, so a lock-step host has sent nothing yet and only
+  pipelined commands are affected
+*/
+static int uart_overrun(int fd, uint8_t *buf, int size, int pos, int len) {
+
+  struct pollfd   pfd;
+  int             n;
+
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  while ((len < size) && (poll(&pfd, 1, 0) > 0)) {
+    n = read_packet(fd, buf+len, size-len);
+    if (n <= 0)
+      break;
+    s_bytesRx += n;
+    len += n;
+  }
+  if (len > pos+1) {
+    s_numLost += len - pos - 1;
+    len = pos + 1;
+  }
+  return(len);
+
+} // uart_overrun
+
+
+
+/**
+  \fn static void send_bytes(int fd, uint8_t *buf, uint16_t len)
+
+  \brief send response to host incl. line time. In reply mode wait for echo of each byte
+*/
+static void send_bytes(int fd, uint8_t *buf, uint16_t len) {
+
+  uint16_t  i;
+  uint8_t   echo;
+
+  // corrupt first byte (ACK/NACK) of response on a bad link
+  if ((s_errBaud > 0) && (s_baud > s_errBaud) && (len > 0) && ((rand() % 100) < s_errPercent)) {
+    buf[0] ^= 0x10;
+    s_numCorrupt++;
+  }
+
+  // reply mode: send bytewise and wait for host echo
+  if (s_mode == 2) {
+    for (i=0; i<len; i++) {
+      wait_us(line_us(1));
+      adapter_send(buf+i, 1);
+      while (s_queueHead != s_queueTail)
+        wait_input(NULL, 100);
+      if (!read_byte(fd, &echo, 1000))
+        return;
+      wait_us(line_us(1));
+      s_bytesRx++;
+    }
+    return;
+  }
+
+  // duplex or 1-wire mode: send block. Target continues while adapter delivers
+  wait_us(line_us(len));
+  adapter_send(buf, len);
+
+} // send_bytes
+
+
+
+/**
+  \fn int main(int argc, char *argv[])
+
+  \brief main routine of simulator
+*/
+int main(int argc, char *argv[]) {
+
+  int               fdMaster, fdSlave, i;
+  char              *slaveName, *link = NULL, *p, *model = NULL, *device = NULL, *adapter = NULL;
+  uint16_t          flashKB = 128;
+  uint8_t           buf[512];
+  int               len;
+  struct termios    tio;
+  struct pollfd     pfd;
+  int               pkt = 1;
+  uint8_t           updater = 0;
+
+  // parse commandline
+  for (i=1; i<argc; i++) {
+    if (!strcmp(argv[i], "-s") && (i<argc-1))
+      flashKB = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-u") && (i<argc-1))
+      s_mode = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-b") && (i<argc-1))
+      s_baudCfg = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-E") && (i<argc-1)) {
+      s_errBaud = strtoul(argv[++i], &p, 10);
+      if (*p == ',')
+        s_errPercent = atoi(p+1);
+    }
+    else if (!strcmp(argv[i], "-U"))
+      updater = 1;
+    else if (!strcmp(argv[i], "-T"))
+      s_timing = 0;
+    else if (!strcmp(argv[i], "-M") && (i<argc-1)) {
+      model = argv[++i];
+      if ((device = strchr(model, ','))) {
+        *(device++) = '\0';
+        if ((adapter = strchr(device, ',')))
+          *(adapter++) = '\0';
+      }
+    }
+    else if (!strcmp(argv[i], "-O"))
+      s_overrun = 1;
+    else if (!strcmp(argv[i], "-l") && (i<argc-1))
+      link = argv[++i];
+    else {
+      printf("usage: %s [-s kB] [-u mode] [-b baud] [-E baud[,percent]] [-U] [-T] [-M file,device,adapter] [-O] [-l link]\n", argv[0]);
+      printf("  -s kB      flash size: 8 (STM8L), 32, 128 or 256 (STM8S) (default: 128)\n");
+      printf("  -u mode    UART mode: 0=duplex, 1=1-wire, 2=reply mode (default: 0)\n");
+      printf("  -b baud    emulated baudrate if not set by host (default: 230400)\n");
+      printf("  -E b[,p]   corrupt p%% of responses above baudrate b (default p: 10)\n");
+      printf("  -U         install resident updater of BSL_activate (entry 0x%04x)\n", SIM_UPD_ENTRY);
+      printf("  -T         don't emulate line and processing time\n");
+      printf("  -M f,d,a   load device d and adapter a from timing model file f, either may be empty (default: built-in timing)\n");
+      printf("  -O         lose bytes received while busy, except the first (UART overrun) (default: buffer all)\n");
+      printf("  -l link    create symlink to pseudo terminal (default: print name)\n");
+      return(1);
+    }
+  }
+  target_init(&s_target, flashKB);
+  if ((model) && (!target_loadModel(model, device, adapter, &(s_target.timing), &s_adapter))) {
+    fprintf(stderr, "bsl_sim: model '%s' or '%s' not found in '%s'\n", device ? device : "", adapter ? adapter : "", model);
+    return(1);
+  }
+  if (updater)
+    target_installUpdater(&s_target, SIM_UPD_ENTRY);
+
+  // create pseudo terminal. Keep slave open, so host can open and close it
+  fdMaster = posix_openpt(O_RDWR | O_NOCTTY);
+  if ((fdMaster < 0) || grantpt(fdMaster) || unlockpt(fdMaster) || (!(slaveName = ptsname(fdMaster)))) {
+    perror("bsl_sim: cannot create pseudo terminal");
+    return(1);
+  }
+  fdSlave = open(slaveName, O_RDWR | O_NOCTTY);
+  tcgetattr(fdSlave, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(fdSlave, TCSANOW, &tio);
+  ioctl(fdMaster, TIOCPKT, &pkt);
+  update_baud(fdSlave);
+  if (link) {
+    unlink(link);
+    if (symlink(slaveName, link)) {
+      perror("bsl_sim: cannot create link");
+      return(1);
+    }
+  }
+  printf("%s\n", link ? link : slaveName);
+  fflush(stdout);
+
+  // terminate on signal
+  signal(SIGINT,  on_signal);
+  signal(SIGTERM, on_signal);
+
+  // process host data
+  pfd.fd = fdMaster;
+  pfd.events = POLLIN;
+  s_fd = fdMaster;
+  while (!s_stop) {
+    if (wait_input(&pfd, 100000) <= 0)
+      continue;
+    len = read_packet(fdMaster, buf, sizeof(buf));
+
+    // flush by host = reset of STM8: abort pending command, get new baudrate
+    if (len < 0) {
+      s_queueHead = s_queueTail;
+      target_abort(&s_target);
+      update_baud(fdSlave);
+      continue;
+    }
+    if (len == 0)
+      continue;
+    s_bytesRx += len;
+
+    // updater changed baudrate -> host has switched before sending
+    if (s_target.updBaud) {
+      update_baud(fdSlave);
+      s_target.updBaud = 0;
+    }
+
+    // emulate line time of received data
+    wait_us(line_us(len));
+
+    // 1-wire mode: host receives its own data
+    if (s_mode == 1) {
+      if (write(fdMaster, buf, len) == len)
+        s_bytesTx += len;
+    }
+
+    // feed target model and send response
+    for (i=0; i<len; i++) {
+      if (target_input(&s_target, buf[i])) {
+        wait_us(s_target.delay);
+        if (s_overrun)
+          len = uart_overrun(fdMaster, buf, sizeof(buf), i+1, len);
+        send_bytes(fdMaster, s_target.out, s_target.numOut);
+      }
+
+      // dump stub streams requested range
+      while (target_stream(&s_target))
+        send_bytes(fdMaster, s_target.out, s_target.numOut);
+    }
+  }
+
+  // print statistics and clean up
+  fprintf(stderr, "bsl_sim: %d commands, %d NACK, %d corrupted, %d lost, %llu bytes rx, %llu bytes tx\n", (int) s_target.numCmd,
+    (int) s_target.numNack, (int) s_numCorrupt, (int) s_numLost, (unsigned long long) s_bytesRx, (unsigned long long) s_bytesTx);
+  if (link)
+    unlink(link);
+  target_free(&s_target);
+  close(fdSlave);
+  close(fdMaster);
+  return(0);
+
+} // main
+
+// end of file
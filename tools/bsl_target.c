@@ -0,0 +1,764 @@
+/**
+  \file bsl_target.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief implementation of simulated STM8 bootloader target
+
+  implementation of a byte stream model of the STM8 ROM bootloader (BSL).
+  Supported are the commands SYNC, GET, READ, WRITE, ERASE and GO as described
+  in STM application note UM0560. Device identification matches bsl_getInfo(),
+  i.e. memory ranges exist depending on family and flash size. Optionally the
+  resident updater of BSL_activate is modelled (see BSL_activate/updater.h),
+  which is entered by GO to its entry address. The memory dump stub (see
+  dumpstub.h) is entered by GO to TARGET_DUMP_STUB after upload. Timing
+  models fitted from hardware traces (see tools/timing_fit.c) can be loaded
+  instead of the default timing.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "bsl_target.h"
+
+
+// BSL codes (see bootloader.h)
+#define SYNCH   0x7F
+#define ACK     0x79
+#define NACK    0x1F
+#define GET     0x00
+#define READ    0x11
+#define WRITE   0x31
+#define ERASE   0x43
+#define GO      0x21
+
+// updater codes (see BSL_activate/updater.h)
+#define UPD_DESC_ADDR     0x43F8
+#define UPD_PAYLOAD_MAX   (3+128)
+#define UPD_READ_MAX      128
+#define UPD_SOF_HOST      0x5A
+#define UPD_SOF_TARGET    0xA5
+#define UPD_ACK           0x79
+#define UPD_NACK          0x1F
+#define UPD_CRCERR        0x2E
+
+// dump stub codes (see dumpstub.h)
+#define DUMP_FCPU         16000000L
+#define DUMP_SOF          0x5A
+#define DUMP_CHUNK        256
+
+// receive states
+#define ST_CMD      0       // wait for command byte
+#define ST_CMDCHK   1       // wait for command complement
+#define ST_ADDR     2       // wait for 4B address + checksum
+#define ST_READN    3       // wait for READ length + complement
+#define ST_WRITEN   4       // wait for WRITE length
+#define ST_WRITED   5       // wait for WRITE data + checksum
+#define ST_ERASEN   6       // wait for ERASE length (0xFF=mass erase)
+#define ST_ERASED   7       // wait for ERASE sector codes + checksum
+
+
+/**
+  \fn static uint8_t target_exists(bsl_target_t *t, uint32_t addr)
+
+  \brief check if address exists in target memory map
+
+  \param[in] t      target model
+  \param[in] addr   address to check
+
+  \return 1 if address exists, else 0
+*/
+static uint8_t target_exists(bsl_target_t *t, uint32_t addr) {
+
+  uint32_t  ramEnd = (t->flashKB <= 8) ? 0x03FF : ((t->flashKB <= 32) ? 0x07FF : 0x17FF);
+
+  if (addr <= ramEnd)                                                 // RAM
+    return(1);
+  if ((t->family == 1) && (addr >= 0x4000) && (addr <= 0x48FF))       // STM8S EEPROM + option bytes
+    return(1);
+  if ((t->family == 2) && (addr >= 0x1000) && (addr <= 0x13FF))       // STM8L EEPROM
+    return(1);
+  if ((t->family == 2) && (addr >= 0x4800) && (addr <= 0x48FF))       // STM8L option bytes
+    return(1);
+  if ((addr >= 0x5000) && (addr <= 0x57FF))                           // registers
+    return(1);
+  if ((addr >= 0x8000) && (addr < 0x8000 + (uint32_t) t->flashKB*1024))  // P-flash
+    return(1);
+  return(0);
+
+} // target_exists
+
+
+
+/**
+  \fn static void target_poke(bsl_target_t *t, uint32_t addr, uint8_t val)
+
+  \brief write byte to target memory (allocate page on demand)
+*/
+static void target_poke(bsl_target_t *t, uint32_t addr, uint8_t val) {
+
+  uint32_t  pg = addr / TARGET_PAGESIZE;
+
+  if (pg >= TARGET_NUMPAGES)
+    return;
+  if (!t->page[pg]) {
+    if (val == 0)
+      return;
+    t->page[pg] = (uint8_t*) calloc(TARGET_PAGESIZE, 1);
+    if (!t->page[pg])
+      return;
+  }
+  t->page[pg][addr % TARGET_PAGESIZE] = val;
+
+} // target_poke
+
+
+
+/**
+  \fn uint8_t target_peek(bsl_target_t *t, uint32_t addr)
+
+  \brief read byte from target memory
+
+  \param[in] t      target model
+  \param[in] addr   address to read
+
+  \return memory content (0x00 for erased or unused memory)
+*/
+uint8_t target_peek(bsl_target_t *t, uint32_t addr) {
+
+  uint32_t  pg = addr / TARGET_PAGESIZE;
+
+  if ((pg >= TARGET_NUMPAGES) || (!t->page[pg]))
+    return(0x00);
+  return(t->page[pg][addr % TARGET_PAGESIZE]);
+
+} // target_peek
+
+
+
+/**
+  \fn void target_init(bsl_target_t *t, uint16_t flashKB)
+
+  \brief init target model
+
+  \param[in] t          target model
+  \param[in] flashKB    P-flash size in kB (8=STM8L low density, 32, 128, 256=STM8S)
+
+  init target model incl. BSL version matching the RAM routines of the flasher,
+  and default timing derived from the STM8 datasheets
+*/
+void target_init(bsl_target_t *t, uint16_t flashKB) {
+
+  memset(t, 0, sizeof(bsl_target_t));
+  t->flashKB = flashKB;
+  t->state   = ST_CMD;
+
+  // family and BSL version (see E_W routines in flasher)
+  switch (flashKB) {
+    case 8:   t->family = 2; t->version = 0x10; break;
+    case 32:  t->family = 1; t->version = 0x13; break;
+    case 128: t->family = 1; t->version = 0x22; break;
+    default:  t->flashKB = 256; t->family = 1; t->version = 0x10; break;
+  }
+
+  // default timing (fast block programming from RAM, see STM8S datasheet)
+  t->timing.ackCmd      = 20;
+  t->timing.ackAddr     = 20;
+  t->timing.ackData     = 30;
+  t->timing.progBlock   = 3000;
+  t->timing.eraseSector = 3300;
+  t->timing.eraseMass   = 3300 * 8;
+  t->timing.readByte    = 1;
+
+} // target_init
+
+
+
+/**
+  \fn uint8_t target_loadModel(const char *file, const char *device, const char *adapter, target_timing_t *timing, target_adapter_t *link)
+
+  \brief load timing model from model file
+
+  \param[in]     file      name of model file (see tools/timing_fit.c)
+  \param[in]     device    name of device model (NULL or ""=keep timing)
+  \param[in]     adapter   name of adapter model (NULL or ""=keep link)
+  \param[in,out] timing    device timing. Only parameters contained in the model are replaced
+  \param[in,out] link      adapter timing. Only parameters contained in the model are replaced
+
+  \return 1 if all requested models were found, else 0
+
+  model file has one line per model, times in [us], e.g.
+    device STM8S208 ackCmd=25 ackAddr=25 ackData=40 progBlock=3100 eraseMass=26000 readByte=2
+    adapter FT232R latency=15800 quantum=1000
+*/
+uint8_t target_loadModel(const char *file, const char *device, const char *adapter, target_timing_t *timing, target_adapter_t *link) {
+
+  static const struct { const char *key; size_t offset; } keys[] = {
+    {"ackCmd", offsetof(target_timing_t, ackCmd)}, {"ackAddr", offsetof(target_timing_t, ackAddr)},
+    {"ackData", offsetof(target_timing_t, ackData)}, {"progBlock", offsetof(target_timing_t, progBlock)},
+    {"eraseSector", offsetof(target_timing_t, eraseSector)}, {"eraseMass", offsetof(target_timing_t, eraseMass)},
+    {"readByte", offsetof(target_timing_t, readByte)}
+  };
+  char          line[1000], kind[20], name[200], *tok;
+  uint8_t       foundDevice = 0, foundAdapter = 0, isDevice, i;
+  unsigned long val;
+  FILE          *fp;
+
+  if (!(fp = fopen(file, "r")))
+    return(0);
+  while (fgets(line, sizeof(line), fp)) {
+    if ((sscanf(line, "%19s %199s", kind, name) != 2) || (kind[0] == '#'))
+      continue;
+    isDevice = (!strcmp(kind, "device")) && (device) && (!strcmp(name, device));
+    if ((!isDevice) && (!((!strcmp(kind, "adapter")) && (adapter) && (!strcmp(name, adapter)))))
+      continue;
+    foundDevice  |= isDevice;
+    foundAdapter |= !isDevice;
+
+    // parameters key=value after kind and name
+    strtok(line, " \t\r\n");
+    strtok(NULL, " \t\r\n");
+    while ((tok = strtok(NULL, " \t\r\n"))) {
+      if (!strchr(tok, '='))
+        continue;
+      val = strtoul(strchr(tok, '=') + 1, NULL, 10);
+      if (isDevice) {
+        for (i=0; i<sizeof(keys)/sizeof(keys[0]); i++)
+          if (!strncmp(tok, keys[i].key, strlen(keys[i].key)) && (tok[strlen(keys[i].key)] == '='))
+            *((uint32_t*) ((char*) timing + keys[i].offset)) = (uint32_t) val;
+      }
+      else if (!strncmp(tok, "latency=", 8))
+        link->latency = (uint32_t) val;
+      else if (!strncmp(tok, "quantum=", 8))
+        link->quantum = (uint32_t) val;
+    }
+  }
+  fclose(fp);
+
+  return(((!device) || (!device[0]) || foundDevice) && ((!adapter) || (!adapter[0]) || foundAdapter));
+
+} // target_loadModel
+
+
+
+/**
+  \fn void target_installUpdater(bsl_target_t *t, uint16_t entry)
+
+  \brief install resident updater
+
+  \param[in] t        target model
+  \param[in] entry    entry address of updater (for GO)
+
+  write the descriptor of the updater to EEPROM, like BSL_activate does
+*/
+void target_installUpdater(bsl_target_t *t, uint16_t entry) {
+
+  uint8_t   desc[8] = { 'U', 'P', 0x01, (uint8_t) (entry >> 8), (uint8_t) entry, (uint8_t) (TARGET_UPD_APP >> 8), (uint8_t) TARGET_UPD_APP, 0 };
+  uint8_t   i;
+
+  for (i=0; i<7; i++)
+    desc[7] ^= desc[i];
+  for (i=0; i<8; i++)
+    target_poke(t, UPD_DESC_ADDR+i, desc[i]);
+  t->updEntry = entry;
+
+} // target_installUpdater
+
+
+
+/**
+  \fn static uint16_t target_crc16(uint16_t crc, const uint8_t *buf, uint32_t numBytes)
+
+  \brief CRC16-CCITT (polynomial 0x1021) of buffer
+*/
+static uint16_t target_crc16(uint16_t crc, const uint8_t *buf, uint32_t numBytes) {
+
+  uint32_t  i;
+  uint8_t   bit;
+
+  for (i=0; i<numBytes; i++) {
+    crc ^= (uint16_t) buf[i] << 8;
+    for (bit=0; bit<8; bit++)
+      crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+  }
+  return(crc);
+
+} // target_crc16
+
+
+
+/**
+  \fn static void target_respond(bsl_target_t *t, uint8_t status, const uint8_t *payload, uint8_t len)
+
+  \brief build updater response frame in t->out
+*/
+static void target_respond(bsl_target_t *t, uint8_t status, const uint8_t *payload, uint8_t len) {
+
+  uint16_t  crc;
+
+  t->out[0] = UPD_SOF_TARGET;
+  t->out[1] = status;
+  t->out[2] = len;
+  if (len > 0)
+    memcpy(t->out+3, payload, len);
+  crc = target_crc16(0xFFFF, t->out+1, len+2);
+  t->out[3+len] = (uint8_t) (crc >> 8);
+  t->out[4+len] = (uint8_t) crc;
+  t->numOut = len+5;
+  if (status != UPD_ACK)
+    t->numNack++;
+
+} // target_respond
+
+
+
+/**
+  \fn static uint16_t target_updater(bsl_target_t *t, uint8_t byte)
+
+  \brief feed one byte to resident updater model
+
+  \return number of response bytes in t->out
+*/
+static uint16_t target_updater(bsl_target_t *t, uint8_t byte) {
+
+  uint8_t   *p = t->in+3, resp[UPD_READ_MAX];
+  uint32_t  addr, num, i, flashEnd = 0x8000 + (uint32_t) t->flashKB*1024;
+  uint16_t  crc;
+  uint8_t   len;
+
+  // collect frame
+  if ((t->numIn == 0) && (byte != UPD_SOF_HOST))
+    return(0);
+  t->in[t->numIn++] = byte;
+  if ((t->numIn == 3) && (t->in[2] > UPD_PAYLOAD_MAX)) {
+    t->numIn = 0;
+    return(0);
+  }
+  if ((t->numIn < 3) || (t->numIn < 3 + t->in[2] + 2))
+    return(0);
+  len = t->in[2];
+  t->numIn = 0;
+  t->delay = t->timing.ackCmd;
+
+  // check CRC
+  crc = target_crc16(0xFFFF, t->in+1, len+2);
+  if ((p[len] != (uint8_t) (crc >> 8)) || (p[len+1] != (uint8_t) crc)) {
+    target_respond(t, UPD_CRCERR, NULL, 0);
+    return(t->numOut);
+  }
+  t->numCmd++;
+  addr = ((uint32_t) p[0] << 16) | ((uint32_t) p[1] << 8) | p[2];
+
+  switch (t->in[1]) {
+
+    // version, flash size, block size, application start
+    case 'I':
+      resp[0] = 0x01;
+      resp[1] = (uint8_t) (t->flashKB >> 8);
+      resp[2] = (uint8_t) t->flashKB;
+      resp[3] = 128;
+      resp[4] = 0x00;
+      resp[5] = (uint8_t) (TARGET_UPD_APP >> 8);
+      resp[6] = (uint8_t) TARGET_UPD_APP;
+      target_respond(t, UPD_ACK, resp, 7);
+      break;
+
+    // baudrate is applied by frontend
+    case 'B':
+      num = (addr << 8) | p[3];
+      if ((len != 4) || (num < 4800) || (num > 1000000)) {
+        target_respond(t, UPD_NACK, NULL, 0);
+        break;
+      }
+      t->updBaud = num;
+      target_respond(t, UPD_ACK, NULL, 0);
+      break;
+
+    // write to application area or EEPROM
+    case 'W':
+      num = len - 3;
+      if ((len < 4) || (!(((addr >= TARGET_UPD_APP) && (addr + num <= flashEnd)) || ((addr >= 0x4000) && (addr + num <= UPD_DESC_ADDR))))) {
+        target_respond(t, UPD_NACK, NULL, 0);
+        break;
+      }
+      for (i=0; i<num; i++)
+        target_poke(t, addr+i, p[3+i]);
+      t->delay = t->timing.progBlock;
+      target_respond(t, UPD_ACK, NULL, 0);
+      break;
+
+    // read memory
+    case 'R':
+      if ((len != 4) || (p[3] == 0) || (p[3] > UPD_READ_MAX)) {
+        target_respond(t, UPD_NACK, NULL, 0);
+        break;
+      }
+      for (i=0; i<p[3]; i++)
+        resp[i] = target_peek(t, addr+i);
+      t->delay += p[3] * t->timing.readByte;
+      target_respond(t, UPD_ACK, resp, p[3]);
+      break;
+
+    // CRC16 of memory
+    case 'C':
+      num = ((uint32_t) p[3] << 16) | ((uint32_t) p[4] << 8) | p[5];
+      crc = 0xFFFF;
+      for (i=0; i<num; i++) {
+        uint8_t val = target_peek(t, addr+i);
+        crc = target_crc16(crc, &val, 1);
+      }
+      resp[0] = (uint8_t) (crc >> 8);
+      resp[1] = (uint8_t) crc;
+      t->delay += num * t->timing.readByte;
+      target_respond(t, (len == 6) ? UPD_ACK : UPD_NACK, resp, (len == 6) ? 2 : 0);
+      break;
+
+    // erase application area
+    case 'E':
+      for (i=TARGET_UPD_APP/TARGET_PAGESIZE; i<flashEnd/TARGET_PAGESIZE; i++) {
+        free(t->page[i]);
+        t->page[i] = NULL;
+      }
+      t->delay = t->timing.eraseMass;
+      target_respond(t, UPD_ACK, NULL, 0);
+      break;
+
+    // leave updater after response
+    case 'G':
+      t->updActive = 0;
+      target_respond(t, UPD_ACK, NULL, 0);
+      break;
+
+    default:
+      target_respond(t, UPD_NACK, NULL, 0);
+
+  } // switch (command)
+
+  return(t->numOut);
+
+} // target_updater
+
+
+
+/**
+  \fn static uint16_t target_dump(bsl_target_t *t, uint8_t byte)
+
+  \brief feed one byte to memory dump stub model. Data is sent via target_stream()
+
+  \return number of response bytes in t->out (always 0)
+*/
+static uint16_t target_dump(bsl_target_t *t, uint8_t byte) {
+
+  uint8_t   *p = t->in;
+
+  // collect request
+  if ((t->numIn == 0) && (byte != DUMP_SOF))
+    return(0);
+  t->in[t->numIn++] = byte;
+  if (t->numIn < 7)
+    return(0);
+  t->numIn = 0;
+  if (p[6] != (p[1] ^ p[2] ^ p[3] ^ p[4] ^ p[5]))
+    return(0);
+  t->numCmd++;
+
+  // zero length -> jump to reset vector
+  t->dumpAddr   = ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+  t->dumpRemain = ((uint32_t) p[4] << 8) | p[5];
+  if (t->dumpRemain == 0)
+    t->dumpActive = 0;
+
+  return(0);
+
+} // target_dump
+
+
+
+/**
+  \fn uint16_t target_stream(bsl_target_t *t)
+
+  \brief get next chunk streamed by dump stub
+
+  \param[in] t      target model
+
+  \return number of response bytes in t->out (0=stream done)
+*/
+uint16_t target_stream(bsl_target_t *t) {
+
+  uint8_t   val, addr[3];
+  uint16_t  crc, len, i;
+
+  t->numOut = 0;
+  t->delay  = 0;
+  if ((!t->dumpActive) || (t->dumpRemain == 0))
+    return(0);
+
+  // data + CRC16 over chunk address and data
+  len = (t->dumpRemain > DUMP_CHUNK) ? DUMP_CHUNK : (uint16_t) t->dumpRemain;
+  addr[0] = (uint8_t) (t->dumpAddr >> 16);
+  addr[1] = (uint8_t) (t->dumpAddr >> 8);
+  addr[2] = (uint8_t) t->dumpAddr;
+  crc = target_crc16(0xFFFF, addr, 3);
+  for (i=0; i<len; i++) {
+    val = target_peek(t, t->dumpAddr + i);
+    crc = target_crc16(crc, &val, 1);
+    t->out[t->numOut++] = val;
+  }
+  t->out[t->numOut++] = (uint8_t) (crc >> 8);
+  t->out[t->numOut++] = (uint8_t) crc;
+  t->dumpAddr   += len;
+  t->dumpRemain -= len;
+
+  return(t->numOut);
+
+} // target_stream
+
+
+
+/**
+  \fn void target_free(bsl_target_t *t)
+
+  \brief release memory of target model
+*/
+void target_free(bsl_target_t *t) {
+
+  int   i;
+
+  for (i=0; i<TARGET_NUMPAGES; i++) {
+    free(t->page[i]);
+    t->page[i] = NULL;
+  }
+
+} // target_free
+
+
+
+/**
+  \fn void target_abort(bsl_target_t *t)
+
+  \brief abort partially received command
+
+  return to waiting for a command, e.g. after a reset of the STM8. Memory
+  and SYNC state are kept, so a following SYNC is answered with NACK like
+  for an already synchronized BSL, which is accepted by the flasher
+*/
+void target_abort(bsl_target_t *t) {
+
+  t->state  = ST_CMD;
+  t->numIn  = 0;
+  t->numOut = 0;
+  t->dumpRemain = 0;
+
+} // target_abort
+
+
+
+/**
+  \fn uint16_t target_input(bsl_target_t *t, uint8_t byte)
+
+  \brief feed one byte from host to target model
+
+  \param[in] t      target model
+  \param[in] byte   byte received from host
+
+  \return number of response bytes in t->out. Processing time is stored in t->delay
+
+  advance BSL receive state machine by one byte and create response, if any
+*/
+uint16_t target_input(bsl_target_t *t, uint8_t byte) {
+
+  uint32_t  i;
+  uint8_t   chk;
+
+  t->numOut = 0;
+  t->delay  = 0;
+
+  // resident updater replaces BSL
+  if (t->updActive)
+    return(target_updater(t, byte));
+
+  // memory dump stub replaces BSL
+  if (t->dumpActive)
+    return(target_dump(t, byte));
+
+  switch (t->state) {
+
+    // command byte or SYNC
+    case ST_CMD:
+      if ((byte == SYNCH) && (t->numIn == 0)) {
+        t->out[t->numOut++] = t->synced ? NACK : ACK;
+        t->synced = 1;
+        t->delay  = t->timing.ackCmd;
+        break;
+      }
+      t->cmd   = byte;
+      t->state = ST_CMDCHK;
+      break;
+
+    // command complement
+    case ST_CMDCHK:
+      t->state = ST_CMD;
+      t->delay = t->timing.ackCmd;
+      if ((byte != (t->cmd ^ 0xFF)) || (!t->synced) || ((t->cmd != GET) && (t->cmd != READ) && (t->cmd != WRITE) && (t->cmd != ERASE) && (t->cmd != GO))) {
+        t->out[t->numOut++] = NACK;
+        t->numNack++;
+        break;
+      }
+      t->numCmd++;
+      t->out[t->numOut++] = ACK;
+      if (t->cmd == GET) {
+        t->out[t->numOut++] = 5;
+        t->out[t->numOut++] = t->version;
+        t->out[t->numOut++] = GET;
+        t->out[t->numOut++] = READ;
+        t->out[t->numOut++] = GO;
+        t->out[t->numOut++] = WRITE;
+        t->out[t->numOut++] = ERASE;
+        t->out[t->numOut++] = ACK;
+      }
+      else if (t->cmd == ERASE)
+        t->state = ST_ERASEN;
+      else {
+        t->state = ST_ADDR;
+        t->numIn = 0;
+      }
+      break;
+
+    // address + checksum
+    case ST_ADDR:
+      t->in[t->numIn++] = byte;
+      if (t->numIn < 5)
+        break;
+      t->numIn = 0;
+      t->state = ST_CMD;
+      t->delay = t->timing.ackAddr;
+      t->addr  = ((uint32_t) t->in[0] << 24) | ((uint32_t) t->in[1] << 16) | ((uint32_t) t->in[2] << 8) | t->in[3];
+      if ((t->in[4] != (t->in[0] ^ t->in[1] ^ t->in[2] ^ t->in[3])) || (!target_exists(t, t->addr))) {
+        t->out[t->numOut++] = NACK;
+        t->numNack++;
+        break;
+      }
+      t->out[t->numOut++] = ACK;
+      if (t->cmd == READ)
+        t->state = ST_READN;
+      else if (t->cmd == WRITE)
+        t->state = ST_WRITEN;
+      else if ((t->cmd == GO) && (t->updEntry != 0) && (t->addr == t->updEntry))
+        t->updActive = 1;
+      else if ((t->cmd == GO) && (t->addr == TARGET_DUMP_STUB)) {
+        uint8_t   brr1 = target_peek(t, TARGET_DUMP_BRR), brr2 = target_peek(t, TARGET_DUMP_BRR+1);
+        uint32_t  div  = ((uint32_t) (brr2 & 0xF0) << 8) | ((uint32_t) brr1 << 4) | (brr2 & 0x0F);
+        t->dumpActive  = 1;
+        t->dumpRemain  = 0;
+        t->updBaud     = div ? DUMP_FCPU / div : 0;
+      }
+      break;
+
+    // READ: number of bytes + complement
+    case ST_READN:
+      t->in[t->numIn++] = byte;
+      if (t->numIn < 2)
+        break;
+      t->numIn = 0;
+      t->state = ST_CMD;
+      t->delay = t->timing.ackCmd;
+      if (t->in[1] != (t->in[0] ^ 0xFF)) {
+        t->out[t->numOut++] = NACK;
+        t->numNack++;
+        break;
+      }
+      t->out[t->numOut++] = ACK;
+      for (i=0; i<=t->in[0]; i++)
+        t->out[t->numOut++] = target_peek(t, t->addr+i);
+      t->delay += (t->in[0]+1) * t->timing.readByte;
+      break;
+
+    // WRITE: number of bytes-1
+    case ST_WRITEN:
+      t->in[0]  = byte;
+      t->numIn  = 1;
+      t->needIn = byte + 3;         // N-1, data, checksum
+      t->state  = ST_WRITED;
+      break;
+
+    // WRITE: data + checksum
+    case ST_WRITED:
+      t->in[t->numIn++] = byte;
+      if (t->numIn < t->needIn)
+        break;
+      t->state = ST_CMD;
+      chk = 0;
+      for (i=0; i<t->numIn-1; i++)
+        chk ^= t->in[i];
+
+      // check checksum and target area. Flash w/e requires RAM routines (STM8S and 8kB STM8L)
+      if ((chk != t->in[t->numIn-1]) || (t->in[0] > 127) ||
+          ((t->addr >= 0x4000) && (!t->routines) && ((t->family == 1) || (t->flashKB == 8)))) {
+        t->numIn = 0;
+        t->delay = t->timing.ackData;
+        t->out[t->numOut++] = NACK;
+        t->numNack++;
+        break;
+      }
+      for (i=0; i<=t->in[0]; i++)
+        target_poke(t, t->addr+i, t->in[1+i]);
+      t->numIn = 0;
+
+      // writing to RAM w/e routine area provides flash routines
+      if ((t->addr >= 0x00A0) && (t->addr < 0x0400))
+        t->routines = 1;
+      t->delay = (t->addr >= 0x4000) ? t->timing.progBlock : t->timing.ackData;
+      t->out[t->numOut++] = ACK;
+      break;
+
+    // ERASE: number of sectors-1 or 0xFF for mass erase
+    case ST_ERASEN:
+      t->in[0]  = byte;
+      t->numIn  = 1;
+      t->needIn = (byte == 0xFF) ? 2 : byte + 3;
+      t->state  = ST_ERASED;
+      break;
+
+    // ERASE: sector codes + checksum
+    case ST_ERASED:
+      t->in[t->numIn++] = byte;
+      if (t->numIn < t->needIn)
+        break;
+      t->state = ST_CMD;
+      t->numIn = 0;
+      if ((t->family == 1) && (!t->routines)) {
+        t->out[t->numOut++] = NACK;
+        t->numNack++;
+        break;
+      }
+      if (t->in[0] == 0xFF) {
+        for (i=0x8000/TARGET_PAGESIZE; i<TARGET_NUMPAGES; i++) {
+          free(t->page[i]);
+          t->page[i] = NULL;
+        }
+        t->delay = t->timing.eraseMass;
+      }
+      else {
+        for (i=1; i<=t->in[0]+1U; i++) {
+          uint32_t pg = 0x8000/TARGET_PAGESIZE + t->in[i];
+          if (pg < TARGET_NUMPAGES) {
+            free(t->page[pg]);
+            t->page[pg] = NULL;
+          }
+        }
+        t->delay = (t->in[0]+1) * t->timing.eraseSector;
+      }
+      t->out[t->numOut++] = ACK;
+      break;
+
+  } // switch (state)
+
+  return(t->numOut);
+
+} // target_input
+
+// end of file
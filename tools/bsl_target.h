@@ -0,0 +1,128 @@
+/**
+  \file bsl_target.h
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief declaration of simulated STM8 bootloader target
+
+  declaration of a byte stream model of the STM8 ROM bootloader (BSL) incl.
+  memory map, device identification and flash timing. The model has no I/O,
+  it is driven by a frontend (pty simulator or in-process test harness).
+*/
+
+// for including file only once
+#ifndef _BSL_TARGET_H_
+#define _BSL_TARGET_H_
+
+
+// include files
+#include <stdint.h>
+
+
+/// memory page size of target model (flash is allocated on first write)
+#define TARGET_PAGESIZE   1024
+
+/// number of pages covering the STM8 address range 0x000000..0x047FFF
+#define TARGET_NUMPAGES   288
+
+/// first P-flash address writable by the resident updater (see BSL_activate/updater.h)
+#define TARGET_UPD_APP    0xA000
+
+/// RAM address of memory dump stub (see dumpstub.h)
+#define TARGET_DUMP_STUB  0x0210
+
+/// address of UART divider BRR1/BRR2 in dump stub
+#define TARGET_DUMP_BRR   0x030D
+
+
+/// timing model of target in [us]
+typedef struct {
+  uint32_t  ackCmd;           ///< delay from end of command to ACK
+  uint32_t  ackAddr;          ///< delay from end of address to ACK
+  uint32_t  ackData;          ///< delay from end of WRITE data to ACK (RAM)
+  uint32_t  progBlock;        ///< additional flash program time per WRITE frame
+  uint32_t  eraseSector;      ///< erase time per 1kB sector
+  uint32_t  eraseMass;        ///< mass erase time
+  uint32_t  readByte;         ///< additional time per READ byte
+} target_timing_t;
+
+
+/// timing model of USB-serial adapter in [us] (applied by frontend)
+typedef struct {
+  uint32_t  latency;          ///< delay from end of response on the line to delivery to host
+  uint32_t  quantum;          ///< delivery is aligned to multiples of this, e.g. USB frames (0=none)
+} target_adapter_t;
+
+
+/// state of simulated BSL target
+typedef struct {
+
+  // configuration
+  uint16_t          flashKB;            ///< P-flash size [kB]
+  uint8_t           family;             ///< 1=STM8S, 2=STM8L
+  uint8_t           version;            ///< BSL version (e.g. 0x22)
+  target_timing_t   timing;             ///< timing model
+
+  // memory (allocated on demand, NULL=erased or not written)
+  uint8_t           *page[TARGET_NUMPAGES];
+
+  // protocol state
+  uint8_t           state;              ///< receive state
+  uint8_t           cmd;                ///< current command
+  uint8_t           synced;             ///< SYNC already received
+  uint8_t           routines;           ///< flash w/e routines present in RAM
+  uint32_t          addr;               ///< address of current command
+  uint8_t           in[300];            ///< received parameter bytes
+  uint16_t          numIn, needIn;      ///< received / expected parameter bytes
+
+  // resident updater of BSL_activate (entered via GO to updEntry)
+  uint16_t          updEntry;           ///< entry address of updater (0=not installed)
+  uint8_t           updActive;          ///< updater is running instead of BSL
+  uint32_t          updBaud;            ///< baudrate set via updater or dump stub (0=unchanged). Frontend applies and clears it
+
+  // memory dump stub (entered via GO to TARGET_DUMP_STUB)
+  uint8_t           dumpActive;         ///< dump stub is running instead of BSL
+  uint32_t          dumpAddr;           ///< next address to stream
+  uint32_t          dumpRemain;         ///< remaining number of bytes to stream
+
+  // response to last input
+  uint8_t           out[300];           ///< response bytes
+  uint16_t          numOut;             ///< number of response bytes
+  uint32_t          delay;              ///< processing time before response [us]
+
+  // statistics
+  uint32_t          numCmd;             ///< number of executed commands
+  uint32_t          numNack;            ///< number of NACKs sent
+
+} bsl_target_t;
+
+
+/// init target model for given flash size (8, 32, 128 or 256kB)
+void      target_init(bsl_target_t *t, uint16_t flashKB);
+
+/// release memory of target model
+void      target_free(bsl_target_t *t);
+
+/// install resident updater, i.e. write its descriptor to EEPROM
+void      target_installUpdater(bsl_target_t *t, uint16_t entry);
+
+/// abort partially received command, e.g. on reset (memory is kept)
+void      target_abort(bsl_target_t *t);
+
+/// feed one byte from host. Returns number of response bytes in t->out
+uint16_t  target_input(bsl_target_t *t, uint8_t byte);
+
+/// get next chunk streamed by dump stub. Returns number of bytes in t->out (0=done)
+uint16_t  target_stream(bsl_target_t *t);
+
+/// read memory of target model (for checking results)
+uint8_t   target_peek(bsl_target_t *t, uint32_t addr);
+
+/// load device and/or adapter model (NULL or ""=skip) from model file of tools/timing_fit. Returns 1 on success
+uint8_t   target_loadModel(const char *file, const char *device, const char *adapter, target_timing_t *timing, target_adapter_t *link);
+
+#endif // _BSL_TARGET_H_
+
+// end of file
@@ -0,0 +1,249 @@
+/**
+  \file dump_archive.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief list, extract and compare dumps of a deduplicated archive
+
+  tool for archives written by the flasher with option --archive (see
+  archive.h). Dumps are compared via their block hashes first, so only
+  blocks with different content are compared bytewise.
+
+  usage: dump_archive dir list
+         dump_archive dir extract name outfile (.s19 or .txt)
+         dump_archive dir diff name1 name2
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <dirent.h>
+#define _MAIN_
+  #include "globals.h"
+#undef _MAIN_
+#include "archive.h"
+#include "hexfile.h"
+#include "misc.h"
+
+
+/**
+  \fn static int compare_hash(const void *a, const void *b)
+
+  \brief compare block hashes for qsort()
+*/
+static int compare_hash(const void *a, const void *b) {
+
+  return(memcmp(a, b, ARCHIVE_HASH));
+
+} // compare_hash
+
+
+
+/**
+  \fn static int list_dumps(archive_t *ar)
+
+  \brief list dumps in archive with deduplication statistics
+
+  \return exit code
+*/
+static int list_dumps(archive_t *ar) {
+
+  char            path[ARCHIVE_PATHLEN+20], name[ARCHIVE_PATHLEN];
+  DIR             *dir;
+  struct dirent   *entry;
+  uint8_t         *hash, *all = NULL;
+  uint32_t        addrStart, numBytes, numBlocks, numAll = 0, numDistinct = 0, numDumps = 0, i;
+  size_t          len;
+
+  snprintf(path, sizeof(path), "%s/dumps", ar->dir);
+  dir = opendir(path);
+  if (!dir) {
+    fprintf(stderr, "error: cannot open '%s'\n", path);
+    return(1);
+  }
+
+  // print manifests and collect all block hashes
+  printf("  %-32s %10s %10s %8s\n", "dump", "start", "bytes", "blocks");
+  while ((entry = readdir(dir)) != NULL) {
+    len = strlen(entry->d_name);
+    if ((len < 5) || (strcmp(entry->d_name + len - 4, ".idx")) || (len - 4 >= sizeof(name)))
+      continue;
+    memcpy(name, entry->d_name, len - 4);
+    name[len - 4] = '\0';
+    numBlocks = archive_manifest(ar, name, &addrStart, &numBytes, &hash);
+    if (numBlocks == 0)
+      continue;
+    printf("  %-32s %#10x %10u %8u\n", name, (unsigned) addrStart, (unsigned) numBytes, (unsigned) numBlocks);
+    all = (uint8_t*) realloc(all, (size_t) (numAll + numBlocks) * ARCHIVE_HASH);
+    if (!all) {
+      fprintf(stderr, "error: cannot allocate memory\n");
+      return(1);
+    }
+    memcpy(all + (size_t) numAll * ARCHIVE_HASH, hash, (size_t) numBlocks * ARCHIVE_HASH);
+    numAll += numBlocks;
+    numDumps++;
+    free(hash);
+  }
+  closedir(dir);
+
+  // number of distinct blocks = stored blocks
+  if (numAll > 0) {
+    qsort(all, numAll, ARCHIVE_HASH, compare_hash);
+    for (i=0; i<numAll; i++)
+      if ((i == 0) || (memcmp(all + (size_t) i * ARCHIVE_HASH, all + (size_t) (i-1) * ARCHIVE_HASH, ARCHIVE_HASH)))
+        numDistinct++;
+  }
+  free(all);
+  printf("  %u dumps, %u blocks referenced, %u stored", (unsigned) numDumps, (unsigned) numAll, (unsigned) numDistinct);
+  if (numDistinct > 0)
+    printf(" (deduplication %1.1f:1)", (float) numAll / (float) numDistinct);
+  printf("\n");
+
+  return(0);
+
+} // list_dumps
+
+
+
+/**
+  \fn static int extract_dump(archive_t *ar, const char *name, char *fileOut)
+
+  \brief extract dump to s19 or txt file
+
+  \return exit code
+*/
+static int extract_dump(archive_t *ar, const char *name, char *fileOut) {
+
+  char        *buf;
+  const char  *dot;
+  uint32_t    addrStart, numBytes;
+
+  buf = archive_read(ar, name, &addrStart, &numBytes);
+  if (!buf) {
+    fprintf(stderr, "error: dump '%s' not found or corrupted\n", name);
+    return(1);
+  }
+  dot = strrchr(fileOut, '.');
+  if (dot && !strcmp(dot, ".s19"))
+    export_s19(fileOut, buf, addrStart, numBytes);
+  else if (dot && !strcmp(dot, ".txt"))
+    export_txt(fileOut, buf, addrStart, numBytes);
+  else {
+    fprintf(stderr, "error: unsupported export type '%s'\n", dot ? dot : fileOut);
+    free(buf);
+    return(1);
+  }
+  printf("  extracted '%s' (0x%04x, %uB) to '%s'\n", name, (unsigned) addrStart, (unsigned) numBytes, fileOut);
+  free(buf);
+
+  return(0);
+
+} // extract_dump
+
+
+
+/**
+  \fn static int diff_dumps(archive_t *ar, const char *name1, const char *name2)
+
+  \brief print address ranges which differ between two dumps
+
+  \return exit code: 0=identical, 1=different, 2=error
+*/
+static int diff_dumps(archive_t *ar, const char *name1, const char *name2) {
+
+  char      *buf1, *buf2;
+  uint8_t   *hash1, *hash2;
+  uint32_t  start1, bytes1, start2, bytes2, blocks1, blocks2, addr, stop, first = 0;
+  uint32_t  numDiff = 0, numRanges = 0, numSame = 0;
+  uint8_t   differ, inRange = 0;
+
+  blocks1 = archive_manifest(ar, name1, &start1, &bytes1, &hash1);
+  blocks2 = archive_manifest(ar, name2, &start2, &bytes2, &hash2);
+  buf1 = archive_read(ar, name1, &start1, &bytes1);
+  buf2 = archive_read(ar, name2, &start2, &bytes2);
+  if ((!blocks1) || (!blocks2) || (!buf1) || (!buf2)) {
+    fprintf(stderr, "error: dump '%s' not found or corrupted\n", ((!blocks1) || (!buf1)) ? name1 : name2);
+    return(2);
+  }
+
+  // compare union of both ranges. Blocks with same address and hash are skipped
+  addr = (start1 < start2) ? start1 : start2;
+  stop = ((start1 + bytes1) > (start2 + bytes2)) ? (start1 + bytes1) : (start2 + bytes2);
+  while (addr <= stop) {
+    if ((addr < stop) && (start1 == start2) && (((addr - start1) % ARCHIVE_BLOCK) == 0) && (addr + ARCHIVE_BLOCK <= start1 + bytes1) &&
+        (addr + ARCHIVE_BLOCK <= start2 + bytes2) && (!inRange) &&
+        (!memcmp(hash1 + ((addr - start1) / ARCHIVE_BLOCK) * ARCHIVE_HASH, hash2 + ((addr - start2) / ARCHIVE_BLOCK) * ARCHIVE_HASH, ARCHIVE_HASH))) {
+      addr += ARCHIVE_BLOCK;
+      numSame++;
+      continue;
+    }
+    if (addr == stop)
+      differ = 0;
+    else if ((addr < start1) || (addr >= start1 + bytes1) || (addr < start2) || (addr >= start2 + bytes2))
+      differ = 1;
+    else
+      differ = (buf1[addr - start1] != buf2[addr - start2]);
+    if (differ && (!inRange)) {
+      first   = addr;
+      inRange = 1;
+    }
+    else if ((!differ) && inRange) {
+      printf("  0x%04x - 0x%04x  %uB\n", (unsigned) first, (unsigned) (addr - 1), (unsigned) (addr - first));
+      numDiff += addr - first;
+      numRanges++;
+      inRange = 0;
+    }
+    addr++;
+  }
+  printf("  %uB differ in %u ranges, %u blocks identical by hash\n", (unsigned) numDiff, (unsigned) numRanges, (unsigned) numSame);
+  free(hash1);
+  free(hash2);
+  free(buf1);
+  free(buf2);
+
+  return(numDiff > 0);
+
+} // diff_dumps
+
+
+
+/**
+  \fn int main(int argc, char *argv[])
+
+  \brief main routine of archive tool
+*/
+int main(int argc, char *argv[]) {
+
+  archive_t   *ar;
+  int         res;
+
+  if ((argc == 3) && (!strcmp(argv[2], "list"))) {
+    ar  = archive_open(argv[1]);
+    res = list_dumps(ar);
+  }
+  else if ((argc == 5) && (!strcmp(argv[2], "extract"))) {
+    ar  = archive_open(argv[1]);
+    res = extract_dump(ar, argv[3], argv[4]);
+  }
+  else if ((argc == 5) && (!strcmp(argv[2], "diff"))) {
+    ar  = archive_open(argv[1]);
+    res = diff_dumps(ar, argv[3], argv[4]);
+  }
+  else {
+    printf("usage: %s dir list | extract name outfile | diff name1 name2\n", argv[0]);
+    printf("  list                    list dumps and deduplication ratio\n");
+    printf("  extract name outfile    save dump as s19 file or table (.s19 or .txt)\n");
+    printf("  diff name1 name2        print address ranges which differ\n");
+    return(2);
+  }
+  archive_close(ar);
+
+  return(res);
+
+} // main
+
+// end of file
@@ -0,0 +1,775 @@
+/**
+  \file scale.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief scale test of multi-port programming with many simulated targets
+
+  hosts N simulated BSL targets (see bsl_target.c) on pseudo terminals in a
+  single process and drives all of them with one flasher process, either via
+  multiple ports (-p p1,p2,.., single threaded reactor) or via gang programming
+  (-J, one worker per port). Line and processing time are emulated per
+  target without blocking the other targets. For each N the aggregate
+  throughput, the distribution of session durations (from the --json
+  records), and CPU time and peak RSS of the flasher are printed and saved to
+  a JSON file. Port setup time (from start of flasher to first byte) is
+  reported separately from the active time (first to last byte).
+  Only duplex UART mode is emulated.
+
+  usage: scale [-f flasher] [-n N1,N2,..] [-s kB] [-k kB] [-b baud] [-g] [-T] [-o file]
+*/
+
+// include files
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <errno.h>
+#include <termios.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "bsl_target.h"
+
+
+// max. number of simulated targets and of N values
+#define SCALE_MAX_TARGETS   4096
+#define SCALE_MAX_STEPS     16
+
+// size of response queue per target [B]
+#define SCALE_QUEUE         1024
+
+// start address of P-flash
+#define FLASH_START         0x8000
+
+
+/// simulated target on a pseudo terminal
+typedef struct {
+  bsl_target_t  t;                      // target model
+  int           fdMaster;               // master side, served by this process
+  int           fdSlave;                // slave side, kept open so the flasher can open and close it
+  char          name[32];               // name of pseudo terminal
+  uint32_t      baud;                   // baudrate set by flasher
+  uint8_t       out[SCALE_QUEUE];       // queued response
+  uint16_t      numOut;                 // number of queued bytes
+  uint64_t      due;                    // time when queued response is complete on the line [us]
+} scale_target_t;
+
+
+/// result for one number of targets
+typedef struct {
+  uint32_t    numTargets;               // number of simulated targets
+  uint32_t    numOk;                    // number of successfully programmed targets
+  uint32_t    numFailed;                // number of targets without successful session (incl. missing records)
+  int         status;                   // exit code of flasher
+  double      wall;                     // wall time of flasher [s]
+  double      setup;                    // start of flasher to first byte [s]
+  double      active;                   // first to last byte [s]
+  uint64_t    payload;                  // image bytes written and verified
+  double      p50, p90, p99, max;       // session duration [ms]
+  double      cpu;                      // CPU time of flasher (user+system) [s]
+  double      rss;                      // peak RSS of flasher [kB]
+  double      cpuSim;                   // CPU time of this process for serving the targets [s]
+  char        error[100];               // first error message of flasher
+} scale_result_t;
+
+
+// settings
+static const char *s_flasher = "./STM8_serial_flasher";
+static uint16_t   s_flashKB  = 32;
+static uint16_t   s_imageKB  = 4;
+static uint32_t   s_baudCfg  = 115200;
+static uint8_t    s_gang     = 0;
+static uint8_t    s_timing   = 1;
+static char       s_dir[100];
+
+// targets of current step
+static scale_target_t   *s_targets = NULL;
+static uint32_t         s_numTargets = 0;
+
+
+
+/**
+  \fn static uint64_t time_us(void)
+
+  \brief monotonic time in [us]
+*/
+static uint64_t time_us(void) {
+
+  struct timespec   ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return((uint64_t) ts.tv_sec * 1000000 + (uint64_t) ts.tv_nsec / 1000);
+
+} // time_us
+
+
+
+/**
+  \fn static void remove_dir(void)
+
+  \brief remove working directory incl. files (registered via atexit())
+*/
+static void remove_dir(void) {
+
+  const char  *files[] = { "image.s19", "jobs.txt", "sessions.json", "flasher.log" };
+  char        path[200];
+  uint32_t    i;
+
+  for (i=0; i<sizeof(files)/sizeof(files[0]); i++) {
+    sprintf(path, "%s/%s", s_dir, files[i]);
+    unlink(path);
+  }
+  rmdir(s_dir);
+
+} // remove_dir
+
+
+
+/**
+  \fn static void print_log(void)
+
+  \brief print last lines of flasher log, as working directory is removed at exit
+*/
+static void print_log(void) {
+
+  FILE      *fp;
+  char      file[200], line[20][200];
+  uint32_t  num = 0, i;
+
+  sprintf(file, "%s/flasher.log", s_dir);
+  if (!(fp = fopen(file, "r")))
+    return;
+  while (fgets(line[num % 20], sizeof(line[0]), fp))
+    num++;
+  fclose(fp);
+  for (i=(num > 20) ? num-20 : 0; i<num; i++)
+    fprintf(stderr, "    | %s", line[i % 20]);
+
+} // print_log
+
+
+
+/**
+  \fn static double cpu_s(const struct rusage *ru)
+
+  \brief CPU time (user+system) of resource usage in [s]
+*/
+static double cpu_s(const struct rusage *ru) {
+
+  return((double) (ru->ru_utime.tv_sec + ru->ru_stime.tv_sec) + (double) (ru->ru_utime.tv_usec + ru->ru_stime.tv_usec) / 1e6);
+
+} // cpu_s
+
+
+
+/**
+  \fn static uint64_t line_us(const scale_target_t *s, uint32_t numBytes)
+
+  \brief line time for number of bytes (start + 8 data + parity + stop bit)
+*/
+static uint64_t line_us(const scale_target_t *s, uint32_t numBytes) {
+
+  if (!s_timing)
+    return(0);
+  return((uint64_t) numBytes * 11 * 1000000 / s->baud);
+
+} // line_us
+
+
+
+/**
+  \fn static void update_baud(scale_target_t *s)
+
+  \brief use baudrate set by flasher on pseudo terminal, else the configured one
+*/
+static void update_baud(scale_target_t *s) {
+
+  static const struct { speed_t speed; uint32_t baud; } table[] = {
+    {B4800, 4800}, {B9600, 9600}, {B19200, 19200}, {B38400, 38400}, {B57600, 57600},
+    {B115200, 115200}, {B230400, 230400}, {B460800, 460800}, {B921600, 921600},
+#ifdef B1000000
+    {B1000000, 1000000},
+#endif
+  };
+  struct termios    tio;
+  speed_t           speed;
+  uint8_t           i;
+
+  s->baud = s_baudCfg;
+  if (tcgetattr(s->fdSlave, &tio))
+    return;
+  speed = cfgetospeed(&tio);
+  for (i=0; i<sizeof(table)/sizeof(table[0]); i++)
+    if (table[i].speed == speed)
+      s->baud = table[i].baud;
+
+} // update_baud
+
+
+
+/**
+  \fn static uint32_t write_image(const char *file, uint16_t imageKB)
+
+  \brief create s19 file with pseudo-random content at start of P-flash
+
+  \return number of data bytes in image
+*/
+static uint32_t write_image(const char *file, uint16_t imageKB) {
+
+  FILE      *fp;
+  uint32_t  size = (uint32_t) imageKB * 1024, seed = 0x12345678;
+  uint32_t  addr, i;
+  uint8_t   data[32], chk;
+
+  if (!(fp = fopen(file, "w"))) {
+    fprintf(stderr, "scale: cannot create '%s'\n", file);
+    exit(1);
+  }
+  for (addr=FLASH_START; addr<FLASH_START+size; addr+=sizeof(data)) {
+    chk = (uint8_t) (sizeof(data) + 3) + (uint8_t) (addr >> 8) + (uint8_t) addr;
+    fprintf(fp, "S1%02X%04X", (unsigned) (sizeof(data) + 3), (unsigned) addr);
+    for (i=0; i<sizeof(data); i++) {
+      seed = seed * 1103515245 + 12345;
+      data[i] = (uint8_t) (seed >> 16);
+      chk += data[i];
+      fprintf(fp, "%02X", data[i]);
+    }
+    fprintf(fp, "%02X\n", (uint8_t) ~chk);
+  }
+  fprintf(fp, "S9030000FC\n");
+  fclose(fp);
+
+  return(size);
+
+} // write_image
+
+
+
+/**
+  \fn static void create_targets(uint32_t numTargets)
+
+  \brief create simulated targets on pseudo terminals
+*/
+static void create_targets(uint32_t numTargets) {
+
+  scale_target_t    *s;
+  struct termios    tio;
+  char              *name;
+  int               pkt = 1;
+  uint32_t          i;
+
+  s_targets = (scale_target_t*) calloc(numTargets, sizeof(scale_target_t));
+  if (!s_targets) {
+    fprintf(stderr, "scale: cannot allocate memory\n");
+    exit(1);
+  }
+  for (i=0; i<numTargets; i++) {
+    s = &(s_targets[i]);
+    s->fdMaster = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if ((s->fdMaster < 0) || grantpt(s->fdMaster) || unlockpt(s->fdMaster) || (!(name = ptsname(s->fdMaster)))) {
+      fprintf(stderr, "scale: cannot create pseudo terminal %d: %s\n", (int) i, strerror(errno));
+      exit(1);
+    }
+    strncpy(s->name, name, sizeof(s->name)-1);
+    s->fdSlave = open(s->name, O_RDWR | O_NOCTTY);
+    if (s->fdSlave < 0) {
+      fprintf(stderr, "scale: cannot open '%s': %s\n", s->name, strerror(errno));
+      exit(1);
+    }
+    tcgetattr(s->fdSlave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(s->fdSlave, TCSANOW, &tio);
+    ioctl(s->fdMaster, TIOCPKT, &pkt);
+    update_baud(s);
+    target_init(&(s->t), s_flashKB);
+  }
+  s_numTargets = numTargets;
+
+} // create_targets
+
+
+
+/**
+  \fn static void free_targets(void)
+
+  \brief close pseudo terminals and release target models
+*/
+static void free_targets(void) {
+
+  uint32_t  i;
+
+  for (i=0; i<s_numTargets; i++) {
+    target_free(&(s_targets[i].t));
+    close(s_targets[i].fdSlave);
+    close(s_targets[i].fdMaster);
+  }
+  free(s_targets);
+  s_targets    = NULL;
+  s_numTargets = 0;
+
+} // free_targets
+
+
+
+/**
+  \fn static uint8_t serve_input(scale_target_t *s, uint64_t now)
+
+  \brief read data from flasher, feed target model and queue response
+
+  \return 1 if data was received, else 0
+*/
+static uint8_t serve_input(scale_target_t *s, uint64_t now) {
+
+  uint8_t   pkt[520];
+  uint64_t  t;
+  int       len, i;
+
+  len = read(s->fdMaster, pkt, sizeof(pkt));
+  if (len <= 0)
+    return(0);
+
+  // flush by flasher = reset of STM8: abort pending command, get new baudrate
+  if (pkt[0] != TIOCPKT_DATA) {
+    if (pkt[0] & (TIOCPKT_FLUSHREAD | TIOCPKT_FLUSHWRITE)) {
+      target_abort(&(s->t));
+      update_baud(s);
+    }
+    return(0);
+  }
+
+  // response is complete after line time of request, processing and line time of response
+  t = ((s->numOut > 0) && (s->due > now)) ? s->due : now;
+  t += line_us(s, len-1);
+  for (i=1; i<len; i++) {
+    if (target_input(&(s->t), pkt[i])) {
+      if (s->numOut + s->t.numOut > SCALE_QUEUE)
+        continue;
+      memcpy(s->out + s->numOut, s->t.out, s->t.numOut);
+      s->numOut += s->t.numOut;
+      t += (s_timing ? s->t.delay : 0) + line_us(s, s->t.numOut);
+    }
+  }
+  if (s->numOut > 0)
+    s->due = t;
+
+  return(1);
+
+} // serve_input
+
+
+
+/**
+  \fn static uint8_t serve_output(scale_target_t *s, uint64_t now)
+
+  \brief send queued response if its line time has passed
+
+  \return 1 if data was sent, else 0
+*/
+static uint8_t serve_output(scale_target_t *s, uint64_t now) {
+
+  int       len;
+
+  if ((s->numOut == 0) || (s->due > now))
+    return(0);
+  len = write(s->fdMaster, s->out, s->numOut);
+  if (len <= 0)
+    return(0);
+  memmove(s->out, s->out + len, s->numOut - len);
+  s->numOut -= len;
+  return(1);
+
+} // serve_output
+
+
+
+/**
+  \fn static int wait_events(struct pollfd *pfd, uint32_t num, uint64_t timeout)
+
+  \brief wait for data from flasher with timeout [us]
+*/
+static int wait_events(struct pollfd *pfd, uint32_t num, uint64_t timeout) {
+
+#if defined(__linux__)
+  struct timespec   ts;
+
+  ts.tv_sec  = timeout / 1000000;
+  ts.tv_nsec = (timeout % 1000000) * 1000;
+  return(ppoll(pfd, num, &ts, NULL));
+#else
+  return(poll(pfd, num, (int) ((timeout + 999) / 1000)));
+#endif
+
+} // wait_events
+
+
+
+/**
+  \fn static int compare_double(const void *a, const void *b)
+
+  \brief compare doubles for qsort()
+*/
+static int compare_double(const void *a, const void *b) {
+
+  double  x = *(const double*) a, y = *(const double*) b;
+
+  return((x > y) - (x < y));
+
+} // compare_double
+
+
+
+/**
+  \fn static double percentile(const double *val, uint32_t num, double p)
+
+  \brief percentile of sorted array
+*/
+static double percentile(const double *val, uint32_t num, double p) {
+
+  if (num == 0)
+    return(0.0);
+  return(val[(uint32_t) ((num - 1) * p / 100.0 + 0.5)]);
+
+} // percentile
+
+
+
+/**
+  \fn static void read_records(const char *file, scale_result_t *r)
+
+  \brief get session durations and payload from JSON records of flasher
+
+  with multiple ports there is one record per target (job 0). In gang mode a
+  failed attempt is retried (new record with same job number), therefore a
+  target counts as ok if any attempt of its job succeeded
+*/
+static void read_records(const char *file, scale_result_t *r) {
+
+  char          line[4096], *p;
+  double        *dur;
+  uint8_t       *done;
+  long long     us;
+  uint32_t      num = 0, numRecords = 0, job;
+  FILE          *fp;
+
+  dur  = (double*) malloc((r->numTargets + 1) * sizeof(double));
+  done = (uint8_t*) calloc(r->numTargets + 1, 1);
+  if ((!dur) || (!done) || (!(fp = fopen(file, "r")))) {
+    free(dur);
+    free(done);
+    r->numFailed = r->numTargets;
+    return;
+  }
+  while (fgets(line, sizeof(line), fp)) {
+    job = 0;
+    if ((p = strstr(line, "\"job\":")))
+      job = strtoul(p + 6, NULL, 10);
+    if (job == 0)
+      job = ++numRecords;
+    if ((job > r->numTargets) || (done[job]) || (!strstr(line, "\"status\":\"ok\"")))
+      continue;
+    done[job] = 1;
+    r->numOk++;
+    if ((p = strstr(line, "\"payload\":")))
+      r->payload += strtoul(p + 10, NULL, 10);
+    if ((p = strstr(line, "\"duration_us\":")) && (sscanf(p + 14, "%lld", &us) == 1))
+      dur[num++] = (double) us / 1000.0;
+  }
+  fclose(fp);
+  free(done);
+  r->numFailed = r->numTargets - r->numOk;
+
+  // distribution of session durations
+  qsort(dur, num, sizeof(double), compare_double);
+  r->p50 = percentile(dur, num, 50.0);
+  r->p90 = percentile(dur, num, 90.0);
+  r->p99 = percentile(dur, num, 99.0);
+  r->max = (num > 0) ? dur[num-1] : 0.0;
+  free(dur);
+
+} // read_records
+
+
+
+/**
+  \fn static void run_step(scale_result_t *r, const char *image)
+
+  \brief create N targets, run flasher against them and store result
+*/
+static void run_step(scale_result_t *r, const char *image) {
+
+  char            *ports, json[200], log[200], jobs[200], baud[20];
+  const char      *argv[30];
+  struct pollfd   *pfd;
+  struct rusage   ru, ruSelf0, ruSelf1;
+  uint64_t        start, now, next, first = 0, last = 0;
+  uint32_t        i;
+  int             argc = 0, status = 0, fd;
+  pid_t           pid;
+  FILE            *fp;
+
+  // create targets and list of ports
+  create_targets(r->numTargets);
+  ports = (char*) malloc((r->numTargets + 1) * sizeof(s_targets[0].name));
+  pfd   = (struct pollfd*) malloc((r->numTargets + 1) * sizeof(struct pollfd));
+  if ((!ports) || (!pfd)) {
+    fprintf(stderr, "scale: cannot allocate memory\n");
+    exit(1);
+  }
+  ports[0] = '\0';
+  for (i=0; i<r->numTargets; i++) {
+    if (i > 0)
+      strcat(ports, ",");
+    strcat(ports, s_targets[i].name);
+    pfd[i].fd     = s_targets[i].fdMaster;
+    pfd[i].events = POLLIN;
+  }
+
+  // commandline of flasher. Gang mode: one job per target
+  sprintf(json, "%s/sessions.json", s_dir);
+  sprintf(log,  "%s/flasher.log", s_dir);
+  sprintf(jobs, "%s/jobs.txt", s_dir);
+  sprintf(baud, "%d", (int) s_baudCfg);
+  unlink(json);
+  argv[argc++] = s_flasher;
+  argv[argc++] = "-p";  argv[argc++] = ports;
+  argv[argc++] = "-b";  argv[argc++] = baud;
+  argv[argc++] = "-u";  argv[argc++] = "0";
+  argv[argc++] = "-Q";  argv[argc++] = "-j";  argv[argc++] = "-x";
+  argv[argc++] = "--json";  argv[argc++] = json;
+  if (s_gang) {
+    if (!(fp = fopen(jobs, "w"))) {
+      fprintf(stderr, "scale: cannot create '%s'\n", jobs);
+      exit(1);
+    }
+    fprintf(fp, "%s %d\n", image, (int) r->numTargets);
+    fclose(fp);
+    argv[argc++] = "-J";  argv[argc++] = jobs;
+  }
+  else {
+    argv[argc++] = "-w";  argv[argc++] = image;
+  }
+  argv[argc] = NULL;
+
+  // start flasher
+  getrusage(RUSAGE_SELF, &ruSelf0);
+  start = time_us();
+  pid = fork();
+  if (pid == 0) {
+    fd = open(log, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    dup2(fd, STDOUT_FILENO);
+    dup2(fd, STDERR_FILENO);
+    execv(s_flasher, (char * const *) argv);
+    _exit(127);
+  }
+  if (pid < 0) {
+    perror("scale: cannot start flasher");
+    exit(1);
+  }
+
+  // serve all targets until flasher terminates
+  memset(&ru, 0, sizeof(ru));
+  while (wait4(pid, &status, WNOHANG, &ru) == 0) {
+
+    // wait for data or until next response is due (max. 10ms to check flasher)
+    now  = time_us();
+    next = now + 10000;
+    for (i=0; i<r->numTargets; i++)
+      if ((s_targets[i].numOut > 0) && (s_targets[i].due < next))
+        next = s_targets[i].due;
+    if ((wait_events(pfd, r->numTargets, (next > now) ? next - now : 0) < 0) && (errno != EINTR)) {
+      perror("scale: poll failed");
+      break;
+    }
+
+    // process requests and due responses
+    now = time_us();
+    for (i=0; i<r->numTargets; i++) {
+      if ((pfd[i].revents & POLLIN) && (serve_input(&(s_targets[i]), now))) {
+        if (first == 0)
+          first = now;
+        last = now;
+      }
+      if (serve_output(&(s_targets[i]), now))
+        last = now;
+    }
+  }
+  now = time_us();
+  getrusage(RUSAGE_SELF, &ruSelf1);
+
+  // store result
+  r->status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+  r->wall   = (double) (now - start) / 1e6;
+  r->setup  = (first > 0) ? (double) (first - start) / 1e6 : r->wall;
+  r->active = (first > 0) ? (double) (last - first) / 1e6 : 0.0;
+  r->cpu    = cpu_s(&ru);
+  #if defined(__APPLE__)
+    r->rss  = (double) ru.ru_maxrss / 1024.0;   // bytes on macOS
+  #else
+    r->rss  = (double) ru.ru_maxrss;            // kB on Linux
+  #endif
+  r->cpuSim = cpu_s(&ruSelf1) - cpu_s(&ruSelf0);
+  read_records(json, r);
+
+  // keep first error message of failed flasher, e.g. a limit of the number of ports
+  if ((r->status != 0) && (fp = fopen(log, "r"))) {
+    while (fgets(r->error, sizeof(r->error), fp) && (!strstr(r->error, "error")));
+    fclose(fp);
+    r->error[strcspn(r->error, "\r\n")] = '\0';
+  }
+
+  free(ports);
+  free(pfd);
+  free_targets();
+
+} // run_step
+
+
+
+/**
+  \fn int main(int argc, char *argv[])
+
+  \brief main routine of scale test
+*/
+int main(int argc, char *argv[]) {
+
+  const char      *fileOut = "scale.json", *list = "64,256,1024";
+  scale_result_t  res[SCALE_MAX_STEPS], *r;
+  uint32_t        numSteps = 0, imgBytes, i;
+  double          perSession;
+  int             arg;
+  char            image[200], *p;
+  struct rlimit   lim;
+  FILE            *fp;
+
+  // parse commandline
+  for (arg=1; arg<argc; arg++) {
+    if (!strcmp(argv[arg], "-f") && (arg<argc-1))
+      s_flasher = argv[++arg];
+    else if (!strcmp(argv[arg], "-n") && (arg<argc-1))
+      list = argv[++arg];
+    else if (!strcmp(argv[arg], "-s") && (arg<argc-1))
+      s_flashKB = atoi(argv[++arg]);
+    else if (!strcmp(argv[arg], "-k") && (arg<argc-1))
+      s_imageKB = atoi(argv[++arg]);
+    else if (!strcmp(argv[arg], "-b") && (arg<argc-1))
+      s_baudCfg = atoi(argv[++arg]);
+    else if (!strcmp(argv[arg], "-g"))
+      s_gang = 1;
+    else if (!strcmp(argv[arg], "-T"))
+      s_timing = 0;
+    else if (!strcmp(argv[arg], "-o") && (arg<argc-1))
+      fileOut = argv[++arg];
+    else {
+      printf("usage: %s [-f flasher] [-n N1,N2,..] [-s kB] [-k kB] [-b baud] [-g] [-T] [-o file]\n", argv[0]);
+      printf("  -f flasher   flasher binary (default: ./STM8_serial_flasher)\n");
+      printf("  -n N1,N2,..  numbers of simulated targets, max. %d (default: 64,256,1024)\n", SCALE_MAX_TARGETS);
+      printf("  -s kB        flash size of targets: 8 (STM8L), 32, 128 or 256 (STM8S) (default: 32)\n");
+      printf("  -k kB        size of image written to each target (default: 4)\n");
+      printf("  -b baud      baudrate (default: 115200)\n");
+      printf("  -g           gang programming with job file (default: multiple ports)\n");
+      printf("  -T           don't emulate line and processing time (host overhead only)\n");
+      printf("  -o file      JSON output file (default: scale.json)\n");
+      return(1);
+    }
+  }
+  for (p=(char*) list; *p && (numSteps < SCALE_MAX_STEPS); ) {
+    memset(&(res[numSteps]), 0, sizeof(scale_result_t));
+    res[numSteps].numTargets = strtoul(p, &p, 10);
+    if ((res[numSteps].numTargets < 2) || (res[numSteps].numTargets > SCALE_MAX_TARGETS)) {
+      fprintf(stderr, "scale: number of targets must be 2..%d\n", SCALE_MAX_TARGETS);
+      return(1);
+    }
+    numSteps++;
+    if (*p == ',')
+      p++;
+  }
+  if ((s_imageKB < 1) || (s_imageKB > s_flashKB)) {
+    fprintf(stderr, "scale: image size must be 1..%dkB\n", (int) s_flashKB);
+    return(1);
+  }
+
+  // each target needs 2 descriptors here and 1 in flasher (inherited limit)
+  getrlimit(RLIMIT_NOFILE, &lim);
+  lim.rlim_cur = lim.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &lim);
+  for (i=0; i<numSteps; i++) {
+    if (2 * res[i].numTargets + 20 > lim.rlim_cur) {
+      fprintf(stderr, "scale: %d targets exceed limit of %d open files\n", (int) res[i].numTargets, (int) lim.rlim_cur);
+      return(1);
+    }
+  }
+
+  // working directory for image, job file, records and log. Removed also on error
+  strcpy(s_dir, "/tmp/stm8_scale_XXXXXX");
+  if (!mkdtemp(s_dir)) {
+    perror("scale: cannot create working directory");
+    return(1);
+  }
+  atexit(remove_dir);
+  sprintf(image, "%s/image.s19", s_dir);
+  imgBytes = write_image(image, s_imageKB);
+  signal(SIGPIPE, SIG_IGN);
+
+  // loop over number of targets
+  printf("  %s, %dkB image on %dkB devices, %d Baud%s\n", s_gang ? "gang programming" : "multiple ports", (int) s_imageKB,
+    (int) s_flashKB, (int) s_baudCfg, s_timing ? "" : ", no line time");
+  printf("  %7s %6s %8s %8s %10s %9s %9s %9s %7s %9s %9s\n", "targets", "failed", "setup", "active", "aggr. B/s",
+    "p50 [ms]", "p99 [ms]", "max [ms]", "CPU", "RSS [kB]", "kB/sess.");
+  for (i=0; i<numSteps; i++) {
+    r = &(res[i]);
+    run_step(r, image);
+
+    // memory per session from increase of RSS between steps
+    if (i == 0)
+      perSession = r->rss / r->numTargets;
+    else
+      perSession = (r->rss - res[i-1].rss) / (double) (r->numTargets - res[i-1].numTargets);
+    printf("  %7d %6d %7.2fs %7.2fs %10.0f %9.1f %9.1f %9.1f %6.1f%% %9.0f %9.2f\n", (int) r->numTargets, (int) r->numFailed,
+      r->setup, r->active, (r->active > 0) ? (double) r->payload / r->active : 0.0, r->p50, r->p99, r->max,
+      (r->wall > 0) ? 100.0 * r->cpu / r->wall : 0.0, r->rss, perSession);
+    if (r->status != 0) {
+      fprintf(stderr, "  flasher exit code %d: '%s'\n", r->status, r->error);
+      print_log();
+    }
+    fflush(stdout);
+  }
+
+  // save results
+  if (!(fp = fopen(fileOut, "w"))) {
+    fprintf(stderr, "scale: cannot create '%s'\n", fileOut);
+    return(1);
+  }
+  fprintf(fp, "{\"date\":%lld,\"mode\":\"%s\",\"timing\":%d,\"flash_kB\":%d,\"image_bytes\":%d,\"baud\":%d,\"steps\":[\n",
+    (long long) time(NULL), s_gang ? "gang" : "ports", (int) s_timing, (int) s_flashKB, (int) imgBytes, (int) s_baudCfg);
+  for (i=0; i<numSteps; i++) {
+    r = &(res[i]);
+    fprintf(fp, "%s{\"targets\":%d,\"ok\":%d,\"failed\":%d,\"exit\":%d,\"wall_s\":%.3f,\"setup_s\":%.3f,\"active_s\":%.3f,"
+      "\"payload\":%llu,\"throughput_Bps\":%.0f,\"session_ms\":{\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f,\"max\":%.1f},"
+      "\"cpu_s\":%.3f,\"rss_kB\":%.0f,\"rss_per_session_kB\":%.2f,\"sim_cpu_s\":%.3f}", (i > 0) ? ",\n" : "",
+      (int) r->numTargets, (int) r->numOk, (int) r->numFailed, r->status, r->wall, r->setup, r->active,
+      (unsigned long long) r->payload, (r->active > 0) ? (double) r->payload / r->active : 0.0, r->p50, r->p90, r->p99,
+      r->max, r->cpu, r->rss, r->rss / r->numTargets, r->cpuSim);
+  }
+  fprintf(fp, "\n]}\n");
+  fclose(fp);
+  printf("  results saved to '%s'\n", fileOut);
+
+  // working directory is removed at exit
+  for (i=0; (i<numSteps) && (res[i].numFailed == 0) && (res[i].status == 0); i++);
+
+  return(i < numSteps);
+
+} // main
+
+// end of file
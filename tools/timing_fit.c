@@ -0,0 +1,648 @@
+/**
+  \file timing_fit.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief fit simulator timing models to captured hardware traces
+
+  reads timeline traces of real sessions (option --timeline, Chrome trace
+  format, see trace.h) and fits a timing model of the device and of the
+  USB-serial adapter, which is loaded by bsl_sim -M (see target_loadModel()).
+  Each send is paired with the following received bytes of the same port and
+  classified by BSL command, stage (command, address, data) and phase. The
+  response time minus line time is the residual of an exchange:
+    residual = device processing + adapter latency + alignment to USB frames
+  The alignment (quantum) is detected from the arrival times of simple ACKs,
+  which cluster at a fixed phase modulo the quantum. The latency is the low
+  end of the simple ACK residuals, device times are the median residual per
+  class minus latency and mean alignment. Only duplex UART mode (8E1) is
+  supported, i.e. received bytes contain no echo.
+
+  usage: timing_fit [-b baud] [-d device] [-a adapter] [-o modelfile] trace.json [...]
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+
+// max. number of models in model file
+#define FIT_MAX_MODELS    200
+
+// max. number of trace files
+#define FIT_MAX_FILES     100
+
+// event types
+#define EV_PHASE          0
+#define EV_COMMAND        1
+#define EV_SEND           2
+#define EV_RECEIVE        3
+
+// exchange classes
+#define CL_CMD            0       // ACK of command byte (READ, WRITE, ERASE, GO)
+#define CL_ADDR           1       // ACK of address
+#define CL_RAM            2       // ACK of WRITE data to RAM
+#define CL_PROG           3       // ACK of WRITE data to flash or EEPROM
+#define CL_MASS           4       // ACK of mass erase
+#define CL_SECTOR         5       // ACK of sector erase (per sector)
+#define CL_READ           6       // READ data (per byte)
+#define CL_NUM            7
+
+
+/// event of timeline trace
+typedef struct {
+  uint32_t    tid;                // timeline row (port)
+  uint8_t     type;               // EV_*
+  char        name[24];           // phase, command or io name
+  uint64_t    start, end;         // time span [us]
+  int32_t     bytes;              // number of bytes (io only)
+} fit_event_t;
+
+
+/// samples of an exchange class
+typedef struct {
+  double      *val;               // residual [us]
+  double      *num;               // number of sectors or bytes (CL_SECTOR, CL_READ)
+  double      *ready;             // end of send plus line time [us]
+  double      *arrive;            // end of receive [us]
+  uint8_t     *file;              // index of trace file (time base)
+  uint32_t    numSamples;         // number of samples
+} fit_class_t;
+
+
+// names for output
+static const char *s_className[CL_NUM] = { "command ACK", "address ACK", "WRITE RAM", "WRITE flash", "mass erase", "sector erase", "READ byte" };
+static const char *s_classKey[CL_NUM]  = { "ackCmd", "ackAddr", "ackData", "progBlock", "eraseMass", "eraseSector", "readByte" };
+
+// settings and samples
+static uint32_t     s_baud = 115200;
+static fit_class_t  s_class[CL_NUM];
+static const uint32_t s_quantum[] = { 125, 250, 500, 1000, 2000, 4000, 8000, 16000 };
+#define NUM_QUANTUM   (sizeof(s_quantum)/sizeof(s_quantum[0]))
+static double       s_phaseSum[FIT_MAX_FILES][NUM_QUANTUM][2];  // sum of unit vectors of ACK arrival phase per file and quantum
+static uint8_t      s_numFiles = 0;         // number of trace files read
+
+
+
+/**
+  \fn static uint8_t json_num(const char *line, const char *key, double *val)
+
+  \brief get number after key in JSON line. Returns 1 if found
+*/
+static uint8_t json_num(const char *line, const char *key, double *val) {
+
+  const char  *p = strstr(line, key);
+
+  if (!p)
+    return(0);
+  *val = strtod(p + strlen(key), NULL);
+  return(1);
+
+} // json_num
+
+
+
+/**
+  \fn static uint8_t json_str(const char *line, const char *key, char *buf, size_t size)
+
+  \brief get string after key in JSON line. Returns 1 if found
+*/
+static uint8_t json_str(const char *line, const char *key, char *buf, size_t size) {
+
+  const char  *p = strstr(line, key);
+  size_t      i;
+
+  if (!p)
+    return(0);
+  p += strlen(key);
+  for (i=0; (i<size-1) && (p[i]) && (p[i] != '"'); i++)
+    buf[i] = p[i];
+  buf[i] = '\0';
+  return(1);
+
+} // json_str
+
+
+
+/**
+  \fn static int compare_event(const void *a, const void *b)
+
+  \brief sort events by port, start and end time
+*/
+static int compare_event(const void *a, const void *b) {
+
+  const fit_event_t *x = (const fit_event_t*) a, *y = (const fit_event_t*) b;
+
+  if (x->tid != y->tid)
+    return((x->tid > y->tid) - (x->tid < y->tid));
+  if (x->start != y->start)
+    return((x->start > y->start) - (x->start < y->start));
+  return((x->end > y->end) - (x->end < y->end));
+
+} // compare_event
+
+
+
+/**
+  \fn static int compare_double(const void *a, const void *b)
+
+  \brief compare doubles for qsort()
+*/
+static int compare_double(const void *a, const void *b) {
+
+  double  x = *(const double*) a, y = *(const double*) b;
+
+  return((x > y) - (x < y));
+
+} // compare_double
+
+
+
+/**
+  \fn static double line_us(uint32_t numBytes)
+
+  \brief line time for number of bytes (start + 8 data + parity + stop bit)
+*/
+static double line_us(uint32_t numBytes) {
+
+  return((double) numBytes * 11.0 * 1e6 / (double) s_baud);
+
+} // line_us
+
+
+
+/**
+  \fn static void add_sample(uint8_t cl, double val, double num, double ready, double arrive)
+
+  \brief add residual to exchange class
+*/
+static void add_sample(uint8_t cl, double val, double num, double ready, double arrive) {
+
+  fit_class_t   *c = &(s_class[cl]);
+
+  c->val    = (double*) realloc(c->val, (c->numSamples + 1) * sizeof(double));
+  c->num    = (double*) realloc(c->num, (c->numSamples + 1) * sizeof(double));
+  c->ready  = (double*) realloc(c->ready, (c->numSamples + 1) * sizeof(double));
+  c->arrive = (double*) realloc(c->arrive, (c->numSamples + 1) * sizeof(double));
+  c->file   = (uint8_t*) realloc(c->file, (c->numSamples + 1) * sizeof(uint8_t));
+  if ((!c->val) || (!c->num) || (!c->ready) || (!c->arrive) || (!c->file)) {
+    fprintf(stderr, "timing_fit: cannot allocate memory\n");
+    exit(1);
+  }
+  c->val[c->numSamples]    = val;
+  c->num[c->numSamples]    = num;
+  c->ready[c->numSamples]  = ready;
+  c->arrive[c->numSamples] = arrive;
+  c->file[c->numSamples]   = s_numFiles;
+  c->numSamples++;
+
+} // add_sample
+
+
+
+/**
+  \fn static void add_exchange(const fit_event_t *cmd, const fit_event_t *phase, uint8_t stage, int32_t lenTx, uint64_t sendEnd, int32_t lenRx, uint64_t rxEnd)
+
+  \brief classify completed exchange and store its residual
+*/
+static void add_exchange(const fit_event_t *cmd, const fit_event_t *phase, uint8_t stage, int32_t lenTx, uint64_t sendEnd, int32_t lenRx, uint64_t rxEnd) {
+
+  double    res, ready;
+  uint8_t   prog, q;
+
+  // only exchanges of READ, WRITE, ERASE and GO with a response (SYNC and GET have variable responses)
+  if ((!cmd) || (lenRx < 1) || (rxEnd < sendEnd))
+    return;
+  if (strcmp(cmd->name, "READ") && strcmp(cmd->name, "WRITE") && strcmp(cmd->name, "ERASE") && strcmp(cmd->name, "GO"))
+    return;
+  ready = (double) sendEnd + line_us(lenTx + lenRx);
+  res   = (double) rxEnd - ready;
+  if (res < 0)
+    res = 0;
+
+  // simple ACKs: residual and arrival phase for adapter model
+  if ((stage <= 1) && (lenRx == 1)) {
+    add_sample((stage == 0) ? CL_CMD : CL_ADDR, res, 1, ready, rxEnd);
+    for (q=0; q<NUM_QUANTUM; q++) {
+      s_phaseSum[s_numFiles][q][0] += cos(2.0 * M_PI * (double) (rxEnd % s_quantum[q]) / (double) s_quantum[q]);
+      s_phaseSum[s_numFiles][q][1] += sin(2.0 * M_PI * (double) (rxEnd % s_quantum[q]) / (double) s_quantum[q]);
+    }
+  }
+
+  // data stage
+  else if (stage == 2) {
+    prog = (phase) && ((!strcmp(phase->name, "write")) || (!strcmp(phase->name, "activate")));
+    if (!strcmp(cmd->name, "WRITE") && (lenRx == 1))
+      add_sample(prog ? CL_PROG : CL_RAM, res, 1, ready, rxEnd);
+    else if (!strcmp(cmd->name, "ERASE") && (lenRx == 1))
+      add_sample((lenTx <= 2) ? CL_MASS : CL_SECTOR, res, (lenTx <= 2) ? 1 : lenTx-2, ready, rxEnd);
+    else if (!strcmp(cmd->name, "READ") && (lenRx > 16))   // short reads are dominated by alignment
+      add_sample(CL_READ, res, lenRx-1, ready, rxEnd);
+  }
+
+} // add_exchange
+
+
+
+/**
+  \fn static uint32_t read_trace(const char *file)
+
+  \brief read timeline trace and add its exchanges to the classes
+
+  \return number of exchanges
+*/
+static uint32_t read_trace(const char *file) {
+
+  char          line[1000], ph[4], cat[20];
+  fit_event_t   *ev = NULL, *spans = NULL, e, *cmd, *phase, *curCmd, *curPhase;
+  uint32_t      numEv = 0, numSpans = 0, numExchanges = 0, i, k, iSpan, lastTid = 0;
+  double        val;
+  uint8_t       stage = 0, open = 0;
+  int32_t       lenTx = 0, lenRx = 0;
+  uint64_t      sendEnd = 0, rxEnd = 0;
+  const fit_event_t *lastCmd = NULL, *lastPhase = NULL;
+  FILE          *fp;
+
+  if (s_numFiles >= FIT_MAX_FILES) {
+    fprintf(stderr, "timing_fit: more than %d trace files\n", FIT_MAX_FILES);
+    exit(1);
+  }
+  if (!(fp = fopen(file, "r"))) {
+    fprintf(stderr, "timing_fit: cannot open '%s'\n", file);
+    exit(1);
+  }
+
+  // collect phase and command spans (X or B/E events) and io events
+  while (fgets(line, sizeof(line), fp)) {
+    memset(&e, 0, sizeof(e));
+    if ((!json_str(line, "\"ph\":\"", ph, sizeof(ph))) || (!json_str(line, "\"cat\":\"", cat, sizeof(cat))))
+      continue;
+    if ((!json_str(line, "\"name\":\"", e.name, sizeof(e.name))) || (!json_num(line, "\"ts\":", &val)))
+      continue;
+    e.start = (uint64_t) val;
+    e.tid   = json_num(line, "\"tid\":", &val) ? (uint32_t) val : 0;
+    e.bytes = json_num(line, "\"bytes\":", &val) ? (int32_t) val : 0;
+    if (!strcmp(cat, "phase"))
+      e.type = EV_PHASE;
+    else if (!strcmp(cat, "command"))
+      e.type = EV_COMMAND;
+    else if ((!strcmp(cat, "io")) && (!strcmp(e.name, "send")))
+      e.type = EV_SEND;
+    else if ((!strcmp(cat, "io")) && ((!strcmp(e.name, "receive")) || (!strcmp(e.name, "ACK wait"))))
+      e.type = EV_RECEIVE;
+    else
+      continue;
+
+    // end of span started with B -> complete last open span with same name
+    if (ph[0] == 'E') {
+      for (k=numSpans; k>0; k--) {
+        if ((spans[k-1].end == 0) && (spans[k-1].tid == e.tid) && (spans[k-1].type == e.type) && (!strcmp(spans[k-1].name, e.name))) {
+          spans[k-1].end = e.start;
+          break;
+        }
+      }
+      continue;
+    }
+    if ((ph[0] != 'X') && (ph[0] != 'B'))
+      continue;
+    e.end = (ph[0] == 'X') ? e.start + (json_num(line, "\"dur\":", &val) ? (uint64_t) val : 0) : 0;
+    if (e.type <= EV_COMMAND) {
+      spans = (fit_event_t*) realloc(spans, (numSpans + 1) * sizeof(fit_event_t));
+      if (spans)
+        spans[numSpans++] = e;
+    }
+    else {
+      ev = (fit_event_t*) realloc(ev, (numEv + 1) * sizeof(fit_event_t));
+      if (ev)
+        ev[numEv++] = e;
+    }
+    if (((e.type <= EV_COMMAND) && (!spans)) || ((e.type > EV_COMMAND) && (!ev))) {
+      fprintf(stderr, "timing_fit: cannot allocate memory\n");
+      exit(1);
+    }
+  }
+  fclose(fp);
+  if (numSpans > 0)
+    qsort(spans, numSpans, sizeof(fit_event_t), compare_event);
+  if (numEv > 0)
+    qsort(ev, numEv, sizeof(fit_event_t), compare_event);
+
+  // pair each send with the following received bytes of the same port
+  iSpan   = 0;
+  curCmd  = curPhase = NULL;
+  for (i=0; i<=numEv; i++) {
+
+    // complete previous exchange on next send, new port or end of trace
+    if ((open) && ((i == numEv) || (ev[i].type == EV_SEND) || (ev[i].tid != lastTid))) {
+      add_exchange(lastCmd, lastPhase, stage, lenTx, sendEnd, lenRx, rxEnd);
+      numExchanges++;
+      open = 0;
+    }
+    if (i == numEv)
+      break;
+
+    // received bytes of current exchange
+    if (ev[i].type == EV_RECEIVE) {
+      if ((open) && (ev[i].bytes > 0)) {
+        lenRx += ev[i].bytes;
+        rxEnd  = ev[i].end;
+      }
+      continue;
+    }
+
+    // find command and phase containing send. Spans are sorted like events -> advance to last started span
+    if (ev[i].tid != lastTid)
+      curCmd = curPhase = NULL;
+    for (; (iSpan<numSpans) && ((spans[iSpan].tid < ev[i].tid) || ((spans[iSpan].tid == ev[i].tid) && (spans[iSpan].start <= ev[i].start))); iSpan++) {
+      if (spans[iSpan].tid != ev[i].tid)
+        continue;
+      if (spans[iSpan].type == EV_COMMAND)
+        curCmd = &(spans[iSpan]);
+      else
+        curPhase = &(spans[iSpan]);
+    }
+    cmd   = ((curCmd) && (curCmd->end >= ev[i].start)) ? curCmd : NULL;
+    phase = ((curPhase) && ((curPhase->end >= ev[i].start) || (curPhase->end == 0))) ? curPhase : NULL;
+
+    // stage = number of sends within same command
+    stage = ((cmd) && (cmd == lastCmd) && (ev[i].tid == lastTid)) ? stage + 1 : 0;
+    lastCmd   = cmd;
+    lastPhase = phase;
+    lastTid   = ev[i].tid;
+    lenTx     = ev[i].bytes;
+    sendEnd   = ev[i].end;
+    lenRx     = 0;
+    rxEnd     = 0;
+    open      = 1;
+  }
+
+  // next file has own time base, i.e. USB frame phase
+  s_numFiles++;
+
+  free(ev);
+  free(spans);
+  return(numExchanges);
+
+} // read_trace
+
+
+
+/**
+  \fn static double percentile(fit_class_t *c, double p)
+
+  \brief percentile of residuals of class (sorts samples)
+*/
+static double percentile(fit_class_t *c, double p) {
+
+  double    *tmp;
+  double    val;
+
+  if (c->numSamples == 0)
+    return(0.0);
+  tmp = (double*) malloc(c->numSamples * sizeof(double));
+  if (!tmp)
+    return(0.0);
+  memcpy(tmp, c->val, c->numSamples * sizeof(double));
+  qsort(tmp, c->numSamples, sizeof(double), compare_double);
+  val = tmp[(uint32_t) ((c->numSamples - 1) * p / 100.0 + 0.5)];
+  free(tmp);
+  return(val);
+
+} // percentile
+
+
+
+/**
+  \fn static double median_per_unit(fit_class_t *c, double offset)
+
+  \brief median of (residual - offset) / number of units, e.g. per sector or byte
+*/
+static double median_per_unit(fit_class_t *c, double offset) {
+
+  fit_class_t   tmp;
+  double        val;
+  uint32_t      i;
+
+  memset(&tmp, 0, sizeof(tmp));
+  tmp.val = (double*) malloc((c->numSamples + 1) * sizeof(double));
+  if (!tmp.val)
+    return(0.0);
+  for (i=0; i<c->numSamples; i++)
+    tmp.val[i] = (c->val[i] - offset > 0) ? (c->val[i] - offset) / c->num[i] : 0.0;
+  tmp.numSamples = c->numSamples;
+  val = percentile(&tmp, 50.0);
+  free(tmp.val);
+  return(val);
+
+} // median_per_unit
+
+
+
+/**
+  \fn static double fit_aligned(fit_class_t *c, uint32_t quantum, const double *phase, double base)
+
+  \brief fit time per unit x of class, where the response arrives at the next USB frame
+
+  the arrival of a response is predicted as the next frame boundary after
+  ready + base + num * x, with frame boundaries at phase + k * quantum. As the
+  host sends shortly after a previous arrival, the alignment is not uniform and
+  the median residual is biased. Instead the x with the fewest mispredicted
+  arrivals is searched, the middle of this range is returned. Without
+  alignment the median of (residual - base) / num is returned.
+*/
+static double fit_aligned(fit_class_t *c, uint32_t quantum, const double *phase, double base) {
+
+  double    x, xMax = 0, step, pred, bestStart = 0, bestEnd = 0;
+  uint32_t  i, cost, bestCost = UINT32_MAX;
+  uint8_t   inBest = 0;
+
+  if (quantum == 0)
+    return(median_per_unit(c, base));
+
+  // search range and resolution
+  for (i=0; i<c->numSamples; i++)
+    if ((c->val[i] - base) / c->num[i] > xMax)
+      xMax = (c->val[i] - base) / c->num[i];
+  xMax += quantum;
+  step  = (xMax < 1000) ? 0.5 : xMax / 2000;
+
+  // find first range of x with minimum number of mispredicted arrivals
+  for (x=0; x<=xMax; x+=step) {
+    cost = 0;
+    for (i=0; i<c->numSamples; i++) {
+      pred = ceil((c->ready[i] + base + c->num[i] * x - phase[c->file[i]]) / quantum) * quantum + phase[c->file[i]];
+      if (fabs(pred - c->arrive[i]) > quantum / 2.0)
+        cost++;
+    }
+    if (cost < bestCost) {
+      bestCost  = cost;
+      bestStart = bestEnd = x;
+      inBest    = 1;
+    }
+    else if ((cost == bestCost) && (inBest))
+      bestEnd = x;
+    else
+      inBest = 0;
+  }
+
+  return((bestStart + bestEnd) / 2.0);
+
+} // fit_aligned
+
+
+
+/**
+  \fn static void save_models(const char *file, const char *device, const char *lineDevice, const char *adapter, const char *lineAdapter)
+
+  \brief replace or add device and adapter model in model file
+*/
+static void save_models(const char *file, const char *device, const char *lineDevice, const char *adapter, const char *lineAdapter) {
+
+  char      *lines[FIT_MAX_MODELS], line[1000], kind[20], name[200];
+  uint32_t  numLines = 0, i;
+  FILE      *fp;
+
+  // keep other models
+  if ((fp = fopen(file, "r"))) {
+    while (fgets(line, sizeof(line), fp) && (numLines < FIT_MAX_MODELS)) {
+      if ((sscanf(line, "%19s %199s", kind, name) == 2) && (((!strcmp(kind, "device")) && (!strcmp(name, device))) ||
+          ((!strcmp(kind, "adapter")) && (!strcmp(name, adapter)))))
+        continue;
+      lines[numLines++] = strdup(line);
+    }
+    fclose(fp);
+  }
+
+  // write file with new models
+  if (!(fp = fopen(file, "w"))) {
+    fprintf(stderr, "timing_fit: cannot create '%s'\n", file);
+    exit(1);
+  }
+  if (numLines == 0)
+    fprintf(fp, "# STM8 timing models for bsl_sim -M (see tools/timing_fit.c), times in [us]\n");
+  for (i=0; i<numLines; i++) {
+    fputs(lines[i], fp);
+    free(lines[i]);
+  }
+  fprintf(fp, "%s\n%s\n", lineDevice, lineAdapter);
+  fclose(fp);
+
+} // save_models
+
+
+
+/**
+  \fn int main(int argc, char *argv[])
+
+  \brief main routine of timing model fitter
+*/
+int main(int argc, char *argv[]) {
+
+  const char  *device = "device", *adapter = "adapter", *fileOut = NULL;
+  char        lineDevice[500], lineAdapter[200];
+  double      conc[NUM_QUANTUM], phase[FIT_MAX_FILES], fit[CL_NUM], latency, ackCmd = 0, val;
+  uint32_t    numExchanges = 0, numAck, quantum = 0, len;
+  uint8_t     cl, q, f;
+  int         arg;
+
+  // parse commandline
+  for (arg=1; arg<argc; arg++) {
+    if (!strcmp(argv[arg], "-b") && (arg<argc-1))
+      s_baud = atoi(argv[++arg]);
+    else if (!strcmp(argv[arg], "-d") && (arg<argc-1))
+      device = argv[++arg];
+    else if (!strcmp(argv[arg], "-a") && (arg<argc-1))
+      adapter = argv[++arg];
+    else if (!strcmp(argv[arg], "-o") && (arg<argc-1))
+      fileOut = argv[++arg];
+    else if (argv[arg][0] == '-')
+      break;
+    else
+      numExchanges += read_trace(argv[arg]);
+  }
+  if ((arg < argc) || (numExchanges == 0) || (s_baud == 0)) {
+    printf("usage: %s [-b baud] [-d device] [-a adapter] [-o modelfile] trace.json [...]\n", argv[0]);
+    printf("  -b baud       baudrate of captured sessions (default: 115200)\n");
+    printf("  -d device     name of device model (default: device)\n");
+    printf("  -a adapter    name of adapter model (default: adapter)\n");
+    printf("  -o modelfile  add or replace models in file for bsl_sim -M (default: print only)\n");
+    printf("  trace.json    timeline of duplex sessions on same device and adapter (flasher option --timeline)\n");
+    return(1);
+  }
+  numAck = s_class[CL_CMD].numSamples + s_class[CL_ADDR].numSamples;
+  if (numAck == 0) {
+    fprintf(stderr, "timing_fit: no command or address ACKs found in %d exchanges\n", (int) numExchanges);
+    return(1);
+  }
+
+  // adapter: largest quantum with clustered ACK arrival phase (Rayleigh test). Phase per file
+  for (q=0; q<NUM_QUANTUM; q++) {
+    conc[q] = 0.0;
+    for (f=0; f<s_numFiles; f++)
+      conc[q] += sqrt(s_phaseSum[f][q][0] * s_phaseSum[f][q][0] + s_phaseSum[f][q][1] * s_phaseSum[f][q][1]) / (double) numAck;
+    if ((numAck >= 20) && (conc[q] > 0.5)) {
+      quantum = s_quantum[q];
+      for (f=0; f<s_numFiles; f++)
+        phase[f] = fmod(atan2(s_phaseSum[f][q][1], s_phaseSum[f][q][0]) / (2.0 * M_PI) * quantum + quantum, quantum);
+    }
+  }
+
+  // print residuals per class
+  printf("  %d exchanges at %d Baud\n", (int) numExchanges, (int) s_baud);
+  printf("  %-14s %8s %10s %10s %10s\n", "class", "samples", "p10 [us]", "p50 [us]", "p90 [us]");
+  for (cl=0; cl<CL_NUM; cl++) {
+    if (s_class[cl].numSamples > 0)
+      printf("  %-14s %8d %10.0f %10.0f %10.0f\n", s_className[cl], (int) s_class[cl].numSamples, percentile(&(s_class[cl]), 10.0),
+        percentile(&(s_class[cl]), 50.0), percentile(&(s_class[cl]), 90.0));
+  }
+  printf("  ACK arrival phase concentration:");
+  for (q=0; q<NUM_QUANTUM; q++)
+    printf(" %dus=%1.2f", (int) s_quantum[q], conc[q]);
+  printf("\n");
+
+  // adapter latency = fastest simple ACK. Latency and device time add up, i.e. the common part is assigned to the adapter
+  latency = -1;
+  for (cl=CL_CMD; cl<=CL_ADDR; cl++) {
+    if (s_class[cl].numSamples > 0) {
+      fit[cl] = fit_aligned(&(s_class[cl]), quantum, phase, 0.0);
+      if ((latency < 0) || (fit[cl] < latency))
+        latency = fit[cl];
+    }
+  }
+
+  // device model: fitted time minus adapter latency. Classes without samples are omitted
+  len = sprintf(lineDevice, "device %s", device);
+  for (cl=0; cl<CL_NUM; cl++) {
+    if (s_class[cl].numSamples == 0)
+      continue;
+    if (cl == CL_SECTOR)
+      val = fit_aligned(&(s_class[cl]), quantum, phase, latency);
+    else if (cl == CL_READ)
+      val = fit_aligned(&(s_class[cl]), quantum, phase, latency + ackCmd);
+    else
+      val = ((cl <= CL_ADDR) ? fit[cl] : fit_aligned(&(s_class[cl]), quantum, phase, 0.0)) - latency;
+    if (val < 0)
+      val = 0;
+    if (cl == CL_CMD)
+      ackCmd = val;
+    len += sprintf(lineDevice + len, " %s=%d", s_classKey[cl], (int) (val + 0.5));
+  }
+  sprintf(lineAdapter, "adapter %s latency=%d quantum=%d", adapter, (int) (latency + 0.5), (int) quantum);
+  printf("  %s\n  %s\n", lineDevice, lineAdapter);
+
+  // save to model file
+  if (fileOut) {
+    save_models(fileOut, device, lineDevice, adapter, lineAdapter);
+    printf("  models saved to '%s'\n", fileOut);
+  }
+
+  return(0);
+
+} // main
+
+// end of file
@@ -0,0 +1,355 @@
+/**
+  \file trace.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief implementation of timeline trace in Chrome trace-event format
+
+  implementation of an in-memory event recorder. Concurrent sessions reserve
+  event slots via an atomic counter, so recording doesn't block. A slot is
+  published after it is completely written. Names are stored as pointers to
+  static strings and only formatted when the trace is written. Timestamps are
+  relative to trace_open()
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "trace.h"
+#include "misc.h"
+#include "globals.h"
+
+
+// max. number of named timeline rows
+#define TRACE_MAX_NAMES     256
+
+
+/// recorded event
+typedef struct {
+  const char    *cat;         // category
+  const char    *name;        // name of span or counter
+  uint64_t      ts;           // start time [us]
+  uint64_t      dur;          // duration [us] (complete events only)
+  uint32_t      tid;          // timeline row
+  int32_t       arg;          // byte count or counter value (<0=none)
+  char          ph;           // event type: B, E, X or C
+  uint8_t       ready;        // slot completely written
+} trace_event_t;
+
+
+// event buffer and recording state
+static trace_event_t  *s_event = NULL;
+static uint32_t       s_numEvents = 0;
+static uint32_t       s_numWriters = 0;   // threads currently recording (see trace_close())
+static uint64_t       s_timeStart;
+static char           s_file[1000];
+static uint8_t        s_atexit = 0;
+
+// names of timeline rows
+static uint32_t       s_nameTid[TRACE_MAX_NAMES];
+static char           s_name[TRACE_MAX_NAMES][64];
+static uint8_t        s_nameReady[TRACE_MAX_NAMES];
+static uint32_t       s_numNames = 0;
+
+
+
+/**
+  \fn static trace_event_t *trace_enter(void)
+
+  \brief start recording in calling thread
+
+  \return event buffer, or NULL if not recording. Must be followed by trace_leave()
+*/
+static trace_event_t *trace_enter(void) {
+
+  __atomic_fetch_add(&s_numWriters, 1, __ATOMIC_SEQ_CST);
+  return(__atomic_load_n(&s_event, __ATOMIC_SEQ_CST));
+
+} // trace_enter
+
+
+
+/**
+  \fn static void trace_leave(void)
+
+  \brief end recording in calling thread (see trace_enter())
+*/
+static void trace_leave(void) {
+
+  __atomic_fetch_sub(&s_numWriters, 1, __ATOMIC_RELEASE);
+
+} // trace_leave
+
+
+
+/**
+  \fn static void trace_add(char ph, uint32_t tid, const char *cat, const char *name, uint64_t ts, uint64_t dur, int32_t arg)
+
+  \brief store event in next free slot (lock-free)
+*/
+static void trace_add(char ph, uint32_t tid, const char *cat, const char *name, uint64_t ts, uint64_t dur, int32_t arg) {
+
+  uint32_t        idx;
+  trace_event_t   *event, *ev;
+
+  event = trace_enter();
+  if (!event) {
+    trace_leave();
+    return;
+  }
+  idx = __atomic_fetch_add(&s_numEvents, 1, __ATOMIC_RELAXED);
+  if (idx < TRACE_MAX_EVENTS) {
+    ev = &(event[idx]);
+    ev->ph   = ph;
+    ev->tid  = tid;
+    ev->cat  = cat;
+    ev->name = name;
+    ev->ts   = (ts > s_timeStart) ? ts - s_timeStart : 0;
+    ev->dur  = dur;
+    ev->arg  = arg;
+    __atomic_store_n(&(ev->ready), 1, __ATOMIC_RELEASE);
+  }
+  trace_leave();
+
+} // trace_add
+
+
+
+/**
+  \fn static void trace_string(FILE *fp, const char *str)
+
+  \brief write string to JSON file with escaped quote and backslash, e.g. for port '\\.\COM10'
+*/
+static void trace_string(FILE *fp, const char *str) {
+
+  for (; *str; str++) {
+    if ((*str == '"') || (*str == '\\'))
+      fputc('\\', fp);
+    if ((uint8_t) *str >= 0x20)
+      fputc(*str, fp);
+  }
+
+} // trace_string
+
+
+
+/**
+  \fn void trace_open(const char *filename)
+
+  \brief start recording
+
+  \param[in] filename   name of trace file (written on trace_close())
+
+  allocate event buffer and start recording. The trace is also written if
+  the application terminates via Exit() due to an error
+*/
+void trace_open(const char *filename) {
+
+  s_event = (trace_event_t*) calloc(TRACE_MAX_EVENTS, sizeof(trace_event_t));
+  if (!s_event) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'trace_open()': cannot allocate memory buffers, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+  strncpy(s_file, filename, sizeof(s_file)-1);
+  s_numEvents = 0;
+  s_numNames  = 0;
+  memset(s_nameReady, 0, sizeof(s_nameReady));
+  s_timeStart = time_us();
+
+  // write trace also on error exit
+  if (!s_atexit) {
+    atexit(trace_close);
+    s_atexit = 1;
+  }
+
+} // trace_open
+
+
+
+/**
+  \fn void trace_close(void)
+
+  \brief write trace file and stop recording
+
+  stop recording first and wait until other threads have left the recorder,
+  as at exit after an error other sessions may still be running. Events
+  reserved but not yet written are skipped
+*/
+void trace_close(void) {
+
+  FILE            *fp;
+  trace_event_t   *event, *ev;
+  uint32_t        i, num;
+
+  // stop recording
+  event = __atomic_exchange_n(&s_event, NULL, __ATOMIC_SEQ_CST);
+  if (!event)
+    return;
+  while (__atomic_load_n(&s_numWriters, __ATOMIC_ACQUIRE) > 0)
+    ;
+
+  // don't call Exit() here, as also called at exit
+  if (!(fp = fopen(s_file, "w"))) {
+    free(event);
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'trace_close()': cannot open file '%s'\n\n", s_file);
+    setConsoleColor(PRM_COLOR_DEFAULT);
+    return;
+  }
+
+  // names of timeline rows
+  fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  fprintf(fp, "{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\",\"args\":{\"name\":\"STM8_serial_flasher\"}}");
+  for (i=0; (i<s_numNames) && (i<TRACE_MAX_NAMES); i++) {
+    if (!__atomic_load_n(&(s_nameReady[i]), __ATOMIC_ACQUIRE))
+      continue;
+    fprintf(fp, ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":\"", s_nameTid[i]);
+    trace_string(fp, s_name[i]);
+    fprintf(fp, "\"}}");
+  }
+
+  // recorded events
+  num = (s_numEvents < TRACE_MAX_EVENTS) ? s_numEvents : TRACE_MAX_EVENTS;
+  for (i=0; i<num; i++) {
+    ev = &(event[i]);
+    if (!__atomic_load_n(&(ev->ready), __ATOMIC_ACQUIRE))
+      continue;
+    if (ev->ph == 'C') {
+      fprintf(fp, ",\n{\"ph\":\"C\",\"pid\":1,\"tid\":%u,\"id\":%u,\"ts\":%llu,\"name\":\"", ev->tid, ev->tid, (unsigned long long) ev->ts);
+      trace_string(fp, ev->name);
+      fprintf(fp, "\",\"args\":{\"bytes\":%d}}", (int) ev->arg);
+    }
+    else {
+      fprintf(fp, ",\n{\"ph\":\"%c\",\"pid\":1,\"tid\":%u,\"ts\":%llu,\"cat\":\"", ev->ph, ev->tid, (unsigned long long) ev->ts);
+      trace_string(fp, ev->cat);
+      fprintf(fp, "\",\"name\":\"");
+      trace_string(fp, ev->name);
+      fprintf(fp, "\"");
+      if (ev->ph == 'X')
+        fprintf(fp, ",\"dur\":%llu", (unsigned long long) ev->dur);
+      if (ev->arg >= 0)
+        fprintf(fp, ",\"args\":{\"bytes\":%d}", (int) ev->arg);
+      fprintf(fp, "}");
+    }
+  }
+  fprintf(fp, "\n]}\n");
+  fclose(fp);
+
+  if (s_numEvents > TRACE_MAX_EVENTS)
+    fprintf(stderr, "  warning: trace buffer full, %u events dropped\n", s_numEvents - TRACE_MAX_EVENTS);
+
+  // release buffer
+  free(event);
+
+} // trace_close
+
+
+
+/**
+  \fn void trace_threadName(uint32_t tid, const char *name)
+
+  \brief set name of timeline row
+
+  \param[in] tid    timeline row (see TRACE_TID())
+  \param[in] name   name of row, e.g. port name
+*/
+void trace_threadName(uint32_t tid, const char *name) {
+
+  uint32_t    i, idx;
+
+  if (!trace_enter()) {
+    trace_leave();
+    return;
+  }
+
+  // name already set (or being set)
+  for (i=0; i<__atomic_load_n(&s_numNames, __ATOMIC_ACQUIRE); i++) {
+    if ((__atomic_load_n(&(s_nameReady[i]), __ATOMIC_ACQUIRE)) && (s_nameTid[i] == tid)) {
+      trace_leave();
+      return;
+    }
+  }
+
+  // add new name and publish it after it is written
+  idx = __atomic_load_n(&s_numNames, __ATOMIC_ACQUIRE);
+  while (idx < TRACE_MAX_NAMES) {
+    if (__atomic_compare_exchange_n(&s_numNames, &idx, idx+1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      s_nameTid[idx] = tid;
+      strncpy(s_name[idx], name, sizeof(s_name[idx])-1);
+      __atomic_store_n(&(s_nameReady[idx]), 1, __ATOMIC_RELEASE);
+      break;
+    }
+  }
+  trace_leave();
+
+} // trace_threadName
+
+
+
+/**
+  \fn void trace_begin(uint32_t tid, const char *cat, const char *name)
+
+  \brief begin span on timeline row
+*/
+void trace_begin(uint32_t tid, const char *cat, const char *name) {
+
+  if (__atomic_load_n(&s_event, __ATOMIC_RELAXED))
+    trace_add('B', tid, cat, name, time_us(), 0, -1);
+
+} // trace_begin
+
+
+
+/**
+  \fn void trace_end(uint32_t tid, const char *cat, const char *name)
+
+  \brief end span on timeline row
+*/
+void trace_end(uint32_t tid, const char *cat, const char *name) {
+
+  if (__atomic_load_n(&s_event, __ATOMIC_RELAXED))
+    trace_add('E', tid, cat, name, time_us(), 0, -1);
+
+} // trace_end
+
+
+
+/**
+  \fn void trace_complete(uint32_t tid, const char *cat, const char *name, uint64_t start, uint64_t end, int32_t bytes)
+
+  \brief add span with known start and end time
+
+  \param[in] tid      timeline row
+  \param[in] cat      category
+  \param[in] name     name of span
+  \param[in] start    start time [us] (see time_us())
+  \param[in] end      end time [us]
+  \param[in] bytes    number of bytes transferred (<0=none)
+*/
+void trace_complete(uint32_t tid, const char *cat, const char *name, uint64_t start, uint64_t end, int32_t bytes) {
+
+  if (__atomic_load_n(&s_event, __ATOMIC_RELAXED))
+    trace_add('X', tid, cat, name, start, (end > start) ? end - start : 0, bytes);
+
+} // trace_complete
+
+
+
+/**
+  \fn void trace_counter(uint32_t tid, const char *name, int32_t value)
+
+  \brief add counter value
+*/
+void trace_counter(uint32_t tid, const char *name, int32_t value) {
+
+  if (__atomic_load_n(&s_event, __ATOMIC_RELAXED))
+    trace_add('C', tid, "", name, time_us(), 0, value);
+
+} // trace_counter
+
+// end of file
@@ -0,0 +1,56 @@
+/**
+  \file trace.h
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief declaration of timeline trace in Chrome trace-event format
+
+  declaration of routines for recording protocol activity (phases, BSL
+  commands, send/receive, ACK waits, bytes in flight) with us timestamps.
+  Events are stored in memory and written as Chrome trace-event JSON when
+  done, for display in chrome://tracing or Perfetto. One timeline row (tid)
+  per port. If tracing is not enabled, all routines return immediately.
+*/
+
+// for including file only once
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+
+// include files
+#include <stdint.h>
+
+
+/// max. number of recorded events. Further events are dropped
+#define TRACE_MAX_EVENTS    1000000
+
+/// timeline row for port handle
+#define TRACE_TID(h)        ((uint32_t) (uintptr_t) (h))
+
+
+/// start recording. Trace is written to file on trace_close() or exit
+void        trace_open(const char *filename);
+
+/// write trace file and stop recording
+void        trace_close(void);
+
+/// set name of timeline row (name is copied)
+void        trace_threadName(uint32_t tid, const char *name);
+
+/// begin span (name and category must be static strings)
+void        trace_begin(uint32_t tid, const char *cat, const char *name);
+
+/// end span started with trace_begin()
+void        trace_end(uint32_t tid, const char *cat, const char *name);
+
+/// complete span with start and end time [us] (see time_us()). Optional byte count arg (<0=none)
+void        trace_complete(uint32_t tid, const char *cat, const char *name, uint64_t start, uint64_t end, int32_t bytes);
+
+/// counter value
+void        trace_counter(uint32_t tid, const char *name, int32_t value);
+
+#endif // _TRACE_H_
+
+// end of file
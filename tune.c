@@ -0,0 +1,450 @@
+/**
+  \file tune.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief implementation of link auto-tuner and port profiles
+
+  implementation of a coordinate search over the link parameters. Each trial
+  uploads and verifies the firmware with the session state machine (see
+  bsl_sm.c) and measures the throughput. A setting is only accepted if it
+  completed without timeout, NACK or corrupted response, and a parameter is
+  only changed from its default if this is >2% faster. Defaults and the
+  baudrate ceiling are taken from the adapter table (see adapter.h).
+  Profiles are stored as text, one line per port, in ~/.STM8_serial_flasher_profiles:
+    # key baudrate write read latency echo throughput
+    usb:A50285BI 460800 128 256 1 0 35120
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "tune.h"
+#include "adapter.h"
+#include "image.h"
+#include "reactor.h"
+#include "misc.h"
+#include "globals.h"
+
+
+// candidates for coordinate search (default from adapter table or first)
+static const uint32_t s_baud[]    = { 57600, 115200, 230400, 460800, 921600 };
+static const uint16_t s_write[]   = { 128, 64, 32 };
+static const uint16_t s_read[]    = { 256, 128, 64 };
+static const uint8_t  s_latency[] = { 16, 4, 2, 1 };
+#define NUM(x)  (sizeof(x)/sizeof(x[0]))
+
+// min. improvement for changing a parameter from its default [%]
+#define TUNE_MIN_GAIN   2.0
+
+
+
+/**
+  \fn static void profile_file(char *file, uint32_t size)
+
+  \brief name of profile file in home directory
+*/
+static void profile_file(char *file, uint32_t size) {
+
+  const char  *home = getenv("HOME");
+
+  if (!home)
+    home = getenv("USERPROFILE");
+  snprintf(file, size, "%s/.STM8_serial_flasher_profiles", home ? home : ".");
+
+} // profile_file
+
+
+
+/**
+  \fn void tune_key(const char *port, char *key, uint32_t size)
+
+  \brief get key of port for profile
+
+  \param[in]  port    name of port
+  \param[out] key     "usb:<serial>" if the USB adapter has a serial number, else "port:<name>"
+  \param[in]  size    size of key buffer
+*/
+void tune_key(const char *port, char *key, uint32_t size) {
+
+  char      serial[80];
+  uint32_t  i;
+
+  if (get_port_serial(port, serial, sizeof(serial)))
+    snprintf(key, size, "usb:%s", serial);
+  else
+    snprintf(key, size, "port:%s", port);
+
+  // key must not contain whitespace (file format)
+  for (i=0; key[i]; i++)
+    if ((key[i] == ' ') || (key[i] == '\t'))
+      key[i] = '_';
+
+} // tune_key
+
+
+
+/**
+  \fn uint8_t tune_load(const char *port, tune_profile_t *profile)
+
+  \brief load profile of port
+
+  \param[in]  port      name of port
+  \param[out] profile   profile of port (only valid if found)
+
+  \return 1 if a profile for the port exists, else 0
+*/
+uint8_t tune_load(const char *port, tune_profile_t *profile) {
+
+  char      file[1000], line[300], key[100];
+  unsigned  baud, write, read, latency, echo;
+  float     throughput;
+  FILE      *fp;
+  uint8_t   found = 0;
+
+  tune_key(port, key, sizeof(key));
+  profile_file(file, sizeof(file));
+  if (!(fp = fopen(file, "r")))
+    return(0);
+  while ((!found) && fgets(line, sizeof(line), fp)) {
+    if (line[0] == '#')
+      continue;
+    memset(profile, 0, sizeof(tune_profile_t));
+    if (sscanf(line, "%99s %u %u %u %u %u %f", profile->key, &baud, &write, &read, &latency, &echo, &throughput) != 7)
+      continue;
+    if (strcmp(profile->key, key))
+      continue;
+    profile->baudrate   = baud;
+    profile->writeSize  = write;
+    profile->readSize   = read;
+    profile->latency    = latency;
+    profile->echoBlock  = echo;
+    profile->throughput = throughput;
+    found = 1;
+  }
+  fclose(fp);
+
+  return(found);
+
+} // tune_load
+
+
+
+/**
+  \fn uint8_t tune_apply(const char *port, tune_profile_t *profile)
+
+  \brief load profile of port and apply adapter settings
+
+  \param[in]  port      name of port
+  \param[out] profile   profile of port (only valid if found)
+
+  \return 1 if a profile was found, else 0 (profile is cleared)
+
+  limit baudrate to adapter and print profile. Baudrate, frame sizes, echo
+  strategy and latency timer are applied by the caller. The latency timer
+  must be set after init_port(), which sets the adapter default
+*/
+uint8_t tune_apply(const char *port, tune_profile_t *profile) {
+
+  const adapter_profile_t   *adapter;
+
+  if (!tune_load(port, profile)) {
+    memset(profile, 0, sizeof(tune_profile_t));
+    return(0);
+  }
+  if ((adapter = adapter_find(port)) && (profile->baudrate > adapter->maxBaud))
+    profile->baudrate = adapter->maxBaud;
+  printf("  profile '%s': %d Baud, write %dB, read %dB, latency %dms, echo %s\n", profile->key, (int) profile->baudrate,
+    (int) profile->writeSize, (int) profile->readSize, (int) profile->latency, profile->echoBlock ? "block" : "byte");
+  fflush(stdout);
+  return(1);
+
+} // tune_apply
+
+
+
+/**
+  \fn uint16_t tune_frameSize(const char *ports)
+
+  \brief get WRITE frame size for ports
+
+  \param[in] ports     name of port or comma separated list
+
+  \return smallest WRITE frame size of all port profiles or adapter defaults, or IMAGE_FRAMESIZE if none
+
+  WRITE frames are pre-built once per image and shared by all ports, see image.h
+*/
+uint16_t tune_frameSize(const char *ports) {
+
+  char                      *list, *tok;
+  tune_profile_t            profile;
+  const adapter_profile_t   *adapter;
+  uint16_t                  size = IMAGE_FRAMESIZE;
+
+  if (!(list = strdup(ports)))
+    return(size);
+  for (tok=strtok(list, ","); tok; tok=strtok(NULL, ",")) {
+    if (tune_load(tok, &profile)) {
+      if ((profile.writeSize > 0) && (profile.writeSize < size))
+        size = profile.writeSize;
+    }
+    else if ((adapter = adapter_find(tok)) && (adapter->writeSize < size))
+      size = adapter->writeSize;
+  }
+  free(list);
+  return(size);
+
+} // tune_frameSize
+
+
+
+/**
+  \fn void tune_save(const tune_profile_t *profile)
+
+  \brief store profile of port
+
+  \param[in] profile    profile to store. An existing profile with same key is replaced
+*/
+void tune_save(const tune_profile_t *profile) {
+
+  char      file[1000], tmp[1010], line[300], key[100];
+  FILE      *fpIn, *fpOut;
+
+  // copy other profiles to temporary file
+  profile_file(file, sizeof(file));
+  snprintf(tmp, sizeof(tmp), "%s.tmp", file);
+  if (!(fpOut = fopen(tmp, "w"))) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'tune_save()': cannot create '%s', exit!\n\n", tmp);
+    Exit(1, g_pauseOnExit);
+  }
+  fprintf(fpOut, "# key baudrate write read latency echo throughput\n");
+  if ((fpIn = fopen(file, "r"))) {
+    while (fgets(line, sizeof(line), fpIn)) {
+      if ((line[0] == '#') || (sscanf(line, "%99s", key) != 1) || (!strcmp(key, profile->key)))
+        continue;
+      fputs(line, fpOut);
+    }
+    fclose(fpIn);
+  }
+
+  // append new profile and replace file
+  fprintf(fpOut, "%s %d %d %d %d %d %1.0f\n", profile->key, (int) profile->baudrate, (int) profile->writeSize,
+    (int) profile->readSize, (int) profile->latency, (int) profile->echoBlock, profile->throughput);
+  if (fclose(fpOut) || rename(tmp, file)) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'tune_save()': cannot write '%s', exit!\n\n", file);
+    Exit(1, g_pauseOnExit);
+  }
+
+} // tune_save
+
+
+
+/**
+  \fn static float tune_trial(HANDLE fd, const char *port, const bsl_sm_cfg_t *cfg, image_t *image, uint8_t resetSTM8, const tune_profile_t *trial)
+
+  \brief upload and verify image with given link parameters
+
+  \param[in] fd         handle of port
+  \param[in] port       name of port
+  \param[in] cfg        session settings
+  \param[in] image      private copy of image (re-framed for the trial)
+  \param[in] resetSTM8  reset STM8 via DTR before trial (required for a new baudrate)
+  \param[in] trial      link parameters to test
+
+  \return throughput [B/s], or 0 if the trial failed or had link errors
+*/
+static float tune_trial(HANDLE fd, const char *port, const bsl_sm_cfg_t *cfg, image_t *image, uint8_t resetSTM8, const tune_profile_t *trial) {
+
+  bsl_sm_cfg_t  cfgTrial = *cfg;
+  bsl_sm_t      sm;
+  uint32_t      errors;
+  float         throughput = 0.0;
+
+  // apply link parameters
+  if (trial->latency > 0)
+    set_port_latency(port, trial->latency);
+  image_reframe(image, trial->writeSize);
+  cfgTrial.image      = image;
+  cfgTrial.flashErase = 0;
+  cfgTrial.verifyUpload = 1;
+  cfgTrial.jumpFlash  = 0;
+  cfgTrial.baudrate   = trial->baudrate;
+  cfgTrial.linkAdapt  = 0;
+  cfgTrial.readSize   = trial->readSize;
+  cfgTrial.echoBlock  = trial->echoBlock;
+  set_baudrate(fd, trial->baudrate);
+
+  // BSL detects baudrate only once after reset
+  if (resetSTM8 == 1) {
+    pulse_DTR(fd, 10);
+    flush_port(fd);
+    SLEEP(5);                       // allow BSL to initialize
+  }
+
+  // upload and verify
+  printf("    %6d Baud, write %3dB, read %3dB, latency ", (int) trial->baudrate, (int) trial->writeSize, (int) trial->readSize);
+  if (trial->latency > 0)
+    printf("%3dms", (int) trial->latency);
+  else
+    printf("  n/a");
+  printf(", echo %-5s ... ", (cfg->UARTmode != 2) ? "n/a" : (trial->echoBlock ? "block" : "byte"));
+  fflush(stdout);
+  bsl_sm_init(&sm, fd, port, &cfgTrial);
+  reactor_run(&sm, 1, 0);
+
+  // only accept error-free trials
+  errors = sm.link.numTimeout + sm.link.numNack + sm.link.numCorrupt;
+  if (sm.status != SM_STATUS_OK)
+    printf("failed in phase '%s'\n", bsl_sm_phaseName(sm.phase));
+  else if (errors > 0)
+    printf("%d errors\n", (int) errors);
+  else {
+    throughput = (float) sm.bytesPayload * 1000000.0 / (float) (sm.timeEnd - sm.timeStart);
+    printf("%1.1fkB/s\n", throughput / 1000.0);
+  }
+  fflush(stdout);
+
+  return(throughput);
+
+} // tune_trial
+
+
+
+/**
+  \fn static void tune_accept(tune_profile_t *best, const tune_profile_t *trial, float throughput)
+
+  \brief accept trial if it is the first successful one or significantly faster
+*/
+static void tune_accept(tune_profile_t *best, const tune_profile_t *trial, float throughput) {
+
+  if ((throughput > 0.0) && ((best->throughput == 0.0) || (throughput > best->throughput * (1.0 + TUNE_MIN_GAIN/100.0)))) {
+    *best = *trial;
+    best->throughput = throughput;
+  }
+
+} // tune_accept
+
+
+
+/**
+  \fn uint8_t tune_run(HANDLE fd, const char *port, const bsl_sm_cfg_t *cfg, uint8_t resetSTM8, tune_profile_t *best)
+
+  \brief benchmark link parameters and store best setting in profile
+
+  \param[in]  fd          handle of opened port
+  \param[in]  port        name of port
+  \param[in]  cfg         session settings incl. firmware image (required as test data)
+  \param[in]  resetSTM8   reset method. Baudrate is only tuned with reset via DTR (-R 1)
+  \param[out] best        best setting
+
+  \return 1 if a working setting was found and stored, else 0
+
+  the parameters are tuned one after the other (baudrate, latency timer,
+  WRITE size, READ size, echo strategy), each with the best setting found so
+  far. Without reset via DTR the STM8 keeps the baudrate detected at the first
+  SYNC, so only the configured baudrate is used. Each trial writes the
+  firmware, i.e. after tuning the STM8 contains the firmware.
+*/
+uint8_t tune_run(HANDLE fd, const char *port, const bsl_sm_cfg_t *cfg, uint8_t resetSTM8, tune_profile_t *best) {
+
+  tune_profile_t            trial;
+  image_t                   *image;
+  const adapter_profile_t   *adapter;
+  uint32_t                  i;
+
+  // test data is the firmware to upload
+  if (!cfg->image) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'tune_run()': option --tune requires a firmware file (-w), exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+  image = image_patch(cfg->image, cfg->image->addrStart, 0, cfg->image->data);
+
+  // start with defaults
+  memset(best, 0, sizeof(tune_profile_t));
+  tune_key(port, best->key, sizeof(best->key));
+  best->baudrate  = cfg->baudrate;
+  best->writeSize = IMAGE_FRAMESIZE;
+  best->readSize  = 256;
+  best->latency   = get_port_latency(port);
+  if ((adapter = adapter_find(port))) {
+    best->writeSize = adapter->writeSize;
+    best->readSize  = adapter->readSize;
+    best->echoBlock = adapter->echoBlock;
+    printf("  tune '%s' (%s, %s)\n", port, best->key, adapter->name);
+  }
+  else
+    printf("  tune '%s' (%s)\n", port, best->key);
+
+  // baudrate: test all up to adapter limit with reset via DTR, else only configured
+  if (resetSTM8 == 1) {
+    for (i=0; i<NUM(s_baud); i++) {
+      if ((adapter) && (s_baud[i] > adapter->maxBaud))
+        continue;
+      trial = *best;
+      trial.baudrate = s_baud[i];
+      tune_accept(best, &trial, tune_trial(fd, port, cfg, image, resetSTM8, &trial));
+    }
+  }
+  else {
+    printf("    baudrate is not tuned (requires reset via DTR, -R 1)\n");
+    trial = *best;
+    tune_accept(best, &trial, tune_trial(fd, port, cfg, image, resetSTM8, &trial));
+  }
+  if (best->throughput == 0.0) {
+    image_release(image);
+    set_baudrate(fd, cfg->baudrate);
+    return(0);
+  }
+
+  // latency timer of USB adapter (if supported)
+  if (best->latency > 0) {
+    for (i=0; i<NUM(s_latency); i++) {
+      trial = *best;
+      trial.latency = s_latency[i];
+      if (trial.latency != best->latency)
+        tune_accept(best, &trial, tune_trial(fd, port, cfg, image, resetSTM8, &trial));
+    }
+    set_port_latency(port, best->latency);
+  }
+
+  // frame sizes
+  for (i=0; i<NUM(s_write); i++) {
+    trial = *best;
+    trial.writeSize = s_write[i];
+    if (trial.writeSize != best->writeSize)
+      tune_accept(best, &trial, tune_trial(fd, port, cfg, image, resetSTM8, &trial));
+  }
+  for (i=0; i<NUM(s_read); i++) {
+    trial = *best;
+    trial.readSize = s_read[i];
+    if (trial.readSize != best->readSize)
+      tune_accept(best, &trial, tune_trial(fd, port, cfg, image, resetSTM8, &trial));
+  }
+
+  // echo strategy (only reply mode)
+  if (cfg->UARTmode == 2) {
+    trial = *best;
+    trial.echoBlock = !best->echoBlock;
+    tune_accept(best, &trial, tune_trial(fd, port, cfg, image, resetSTM8, &trial));
+  }
+
+  // store result
+  image_release(image);
+  tune_save(best);
+  printf("  best: %d Baud, write %dB, read %dB, latency %dms, echo %s: %1.1fkB/s\n", (int) best->baudrate,
+    (int) best->writeSize, (int) best->readSize, (int) best->latency, best->echoBlock ? "block" : "byte",
+    best->throughput / 1000.0);
+  fflush(stdout);
+
+  return(1);
+
+} // tune_run
+
+// end of file
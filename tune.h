@@ -0,0 +1,61 @@
+/**
+  \file tune.h
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief declaration of link auto-tuner and port profiles
+
+  declaration of routines for benchmarking a connected STM8 with different
+  link parameters (baudrate, WRITE and READ frame size, adapter latency timer,
+  echo strategy in reply mode) and for storing the best setting in a profile
+  per port. Profiles are keyed by the serial number of the USB adapter, so
+  they follow the adapter to another USB port. They are loaded automatically
+  by later runs.
+*/
+
+// for including file only once
+#ifndef _TUNE_H_
+#define _TUNE_H_
+
+
+// include files
+#include <stdint.h>
+#include "serial_comm.h"
+#include "bsl_sm.h"
+
+
+/// link parameters of a port
+typedef struct {
+  char        key[100];           ///< USB serial number ("usb:...") or port name ("port:...")
+  uint32_t    baudrate;           ///< baudrate [Baud]
+  uint16_t    writeSize;          ///< bytes per WRITE frame (1..128)
+  uint16_t    readSize;           ///< bytes per READ command (1..256)
+  uint8_t     latency;            ///< latency timer of USB adapter [ms] (0=not supported)
+  uint8_t     echoBlock;          ///< reply mode: echo all received bytes at once (0=bytewise)
+  float       throughput;         ///< measured throughput [B/s]
+} tune_profile_t;
+
+
+/// get key of port for profile (USB serial number if available, else port name)
+void        tune_key(const char *port, char *key, uint32_t size);
+
+/// load profile of port. Returns 1 if found
+uint8_t     tune_load(const char *port, tune_profile_t *profile);
+
+/// load profile of port and set latency timer of USB adapter. Returns 1 if found
+uint8_t     tune_apply(const char *port, tune_profile_t *profile);
+
+/// get smallest WRITE frame size of profiles of ports (comma separated list)
+uint16_t    tune_frameSize(const char *ports);
+
+/// store profile of port (replaces existing profile with same key)
+void        tune_save(const tune_profile_t *profile);
+
+/// benchmark link parameters on port and store best setting. Returns 1 on success
+uint8_t     tune_run(HANDLE fd, const char *port, const bsl_sm_cfg_t *cfg, uint8_t resetSTM8, tune_profile_t *best);
+
+#endif // _TUNE_H_
+
+// end of file
@@ -0,0 +1,566 @@
+/**
+  \file updater.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief implementation of resident updater protocol
+
+  implementation of the host side of the BSL_activate updater. Each command
+  is a single CRC16 protected frame and is answered by a single response
+  frame. A lost or corrupted frame is repeated after the response timeout,
+  which is derived from line time, flash program time and measured latency
+  like for the ROM bootloader (see rto.h). Only the duplex UART mode is
+  supported (8E1, like the updater).
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "updater.h"
+#include "bootloader.h"
+#include "serial_comm.h"
+#include "trace.h"
+#include "rto.h"
+#include "misc.h"
+#include "globals.h"
+
+
+/// number of attempts per command
+#define UPD_RETRY             3
+
+/// CRC computation time of updater per byte [us] (16MHz, bitwise)
+#define UPD_CRC_US            10
+
+
+// port state
+static rto_t      s_rto;                  // measured response latency
+static uint32_t   s_baudrate = UPD_BAUD_INIT; // baudrate of port [Baud]
+static uint32_t   s_timeout = 0;          // current port timeout [ms], 0=unknown
+
+
+
+/**
+  \fn uint16_t upd_crc16(uint16_t crc, const uint8_t *buf, uint32_t numBytes)
+
+  \brief CRC16-CCITT (polynomial 0x1021) of buffer
+
+  \param[in] crc        start value (0xFFFF) or CRC of previous data
+  \param[in] buf        data
+  \param[in] numBytes   number of bytes
+
+  \return updated CRC
+*/
+uint16_t upd_crc16(uint16_t crc, const uint8_t *buf, uint32_t numBytes) {
+
+  uint32_t  i;
+  uint8_t   bit;
+
+  for (i=0; i<numBytes; i++) {
+    crc ^= (uint16_t) buf[i] << 8;
+    for (bit=0; bit<8; bit++)
+      crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+  }
+  return(crc);
+
+} // upd_crc16
+
+
+
+/**
+  \fn static void upd_setTimeout(HANDLE ptrPort, uint16_t lenTx, uint16_t lenRx, uint32_t device)
+
+  \brief set port timeout for next response (rounded up to 100ms, see bsl_setTimeout())
+*/
+static void upd_setTimeout(HANDLE ptrPort, uint16_t lenTx, uint16_t lenRx, uint32_t device) {
+
+  uint32_t  timeout;
+
+  timeout = rto_timeout(&s_rto, rto_transfer(s_baudrate, 0, lenTx, lenRx), device);
+  timeout = (timeout + 99999) / 100000 * 100;
+  if (timeout != s_timeout) {
+    set_timeout(ptrPort, timeout);
+    s_timeout = timeout;
+  }
+
+} // upd_setTimeout
+
+
+
+/**
+  \fn static uint8_t upd_receive(HANDLE ptrPort, uint8_t *resp, uint8_t *lenResp)
+
+  \brief receive response frame
+
+  \return status of response, or 0 on timeout or corrupted response
+*/
+static uint8_t upd_receive(HANDLE ptrPort, uint8_t *resp, uint8_t *lenResp) {
+
+  uint8_t   Rx[UPD_READ_MAX+5];
+  uint16_t  crc;
+  uint8_t   len;
+
+  if ((receive_port(ptrPort, 3, (char*) Rx) != 3) || (Rx[0] != UPD_SOF_TARGET))
+    return(0);
+  len = Rx[2];
+  if ((len > UPD_READ_MAX) || (receive_port(ptrPort, len+2, (char*) (Rx+3)) != (uint32_t) (len+2)))
+    return(0);
+  crc = upd_crc16(0xFFFF, Rx+1, len+2);
+  if ((Rx[3+len] != (uint8_t) (crc >> 8)) || (Rx[4+len] != (uint8_t) crc))
+    return(0);
+  memcpy(resp, Rx+3, len);
+  *lenResp = len;
+  return(Rx[1]);
+
+} // upd_receive
+
+
+
+/**
+  \fn static uint8_t upd_command(HANDLE ptrPort, const char *func, uint8_t cmd, const uint8_t *payload, uint8_t len, uint8_t *resp, uint8_t lenResp, uint32_t device)
+
+  \brief send command frame and receive response, repeat on errors
+
+  \param[in]  ptrPort   handle to communication port
+  \param[in]  func      name of calling function for error message
+  \param[in]  cmd       command code
+  \param[in]  payload   command parameters
+  \param[in]  len       number of parameter bytes
+  \param[out] resp      response payload (or NULL)
+  \param[in]  lenResp   expected number of response bytes
+  \param[in]  device    max. processing time of updater [us]
+
+  \return UPD_ACK or UPD_NACK. Exits if the updater doesn't respond
+*/
+static uint8_t upd_command(HANDLE ptrPort, const char *func, uint8_t cmd, const uint8_t *payload, uint8_t len, uint8_t *resp, uint8_t lenResp, uint32_t device) {
+
+  uint8_t   Tx[UPD_PAYLOAD_MAX+5], Rx[UPD_READ_MAX];
+  uint8_t   retry, status, lenRx;
+  uint16_t  crc;
+  uint64_t  timeTx;
+
+  // construct frame
+  Tx[0] = UPD_SOF_HOST;
+  Tx[1] = cmd;
+  Tx[2] = len;
+  if (len > 0)
+    memcpy(Tx+3, payload, len);
+  crc = upd_crc16(0xFFFF, Tx+1, len+2);
+  Tx[3+len] = (uint8_t) (crc >> 8);
+  Tx[4+len] = (uint8_t) crc;
+
+  for (retry=0; retry<UPD_RETRY; retry++) {
+
+    // send frame and wait for response
+    upd_setTimeout(ptrPort, len+5, lenResp+5, device);
+    timeTx = time_us();
+    if (send_port(ptrPort, len+5, (char*) Tx) != (uint32_t) (len+5)) {
+      setConsoleColor(PRM_COLOR_RED);
+      fprintf(stderr, "\n\nerror in '%s()': sending command failed, exit!\n\n", func);
+      Exit(1, g_pauseOnExit);
+    }
+    status = upd_receive(ptrPort, Rx, &lenRx);
+
+    // refused command is not repeated
+    if (status == UPD_NACK)
+      return(UPD_NACK);
+
+    // valid response. Latency is only measured without device time
+    if ((status == UPD_ACK) && (lenRx == lenResp)) {
+      if (device == 0)
+        rto_sample(&s_rto, (uint32_t) (time_us() - timeTx), rto_transfer(s_baudrate, 0, len+5, lenResp+5));
+      if (resp)
+        memcpy(resp, Rx, lenRx);
+      return(UPD_ACK);
+    }
+
+    // timeout, corrupted response or CRC error on STM8 -> discard pending bytes and repeat
+    flush_port(ptrPort);
+
+  } // loop over retries
+
+  setConsoleColor(PRM_COLOR_RED);
+  fprintf(stderr, "\n\nerror in '%s()': no response from updater, exit!\n\n", func);
+  Exit(1, g_pauseOnExit);
+
+  // avoid compiler warnings
+  return(0);
+
+} // upd_command
+
+
+
+/**
+  \fn uint8_t upd_detect(HANDLE ptrPort, int flashsize, uint8_t family, upd_info_t *info)
+
+  \brief read updater descriptor via ROM bootloader
+
+  \param[in]  ptrPort     handle to communication port (BSL synchronized)
+  \param[in]  flashsize   size of flash [kB] (see bsl_getInfo())
+  \param[in]  family      STM8S or STM8L (see bsl_getInfo())
+  \param[out] info        properties of updater
+
+  \return 1 if an updater is installed, else 0
+
+  the descriptor is located at the end of the first kB of EEPROM. Devices with
+  less EEPROM (e.g. STM8S005/S007 with 128B) cannot hold an updater
+*/
+uint8_t upd_detect(HANDLE ptrPort, int flashsize, uint8_t family, upd_info_t *info) {
+
+  uint8_t   desc[UPD_DESC_SIZE], chk;
+  uint8_t   i;
+
+  if ((family != STM8S) || (flashsize < 32))
+    return(0);
+
+  // check if descriptor exists (bsl_memRead() terminates on NACK)
+  if (!bsl_memCheck(ptrPort, UPD_DESC_ADDR+UPD_DESC_SIZE-1))
+    return(0);
+
+  // read and check descriptor
+  bsl_memRead(ptrPort, UPD_DESC_ADDR, UPD_DESC_SIZE, (char*) desc, 0);
+  chk = 0;
+  for (i=0; i<UPD_DESC_SIZE-1; i++)
+    chk ^= desc[i];
+  if ((desc[0] != 'U') || (desc[1] != 'P') || (desc[2] != UPD_VERSION) || (desc[7] != chk))
+    return(0);
+
+  // get properties
+  info->version   = desc[2];
+  info->entry     = ((uint16_t) desc[3] << 8) | desc[4];
+  info->appStart  = ((uint32_t) desc[5] << 8) | desc[6];
+  info->flashEnd  = PFLASH_START + (uint32_t) flashsize * 1024;
+  info->blockSize = 128;
+  if (g_verbose)
+    printf("  found updater v%d (entry 0x%04x, application 0x%04x)\n", (int) info->version, (int) info->entry, (int) info->appStart);
+  return(1);
+
+} // upd_detect
+
+
+
+/**
+  \fn uint8_t upd_writable(const upd_info_t *info, const image_t *image)
+
+  \brief check if updater can write image
+
+  \param[in] info     properties of updater
+  \param[in] image    image to upload (NULL=none)
+
+  \return 1 if all address ranges of image are in application area of P-flash or in EEPROM, else 0
+*/
+uint8_t upd_writable(const upd_info_t *info, const image_t *image) {
+
+  uint32_t  idx, len, start, end;
+
+  if (!image)
+    return(1);
+  for (idx=0; (len=image_range(image, &idx)) > 0; idx+=len) {
+    start = image->addrStart + idx;
+    end   = start + len;
+    if ((start >= info->appStart) && (end <= info->flashEnd))
+      continue;
+    if ((start >= 0x4000) && (end <= UPD_DESC_ADDR))
+      continue;
+    return(0);
+  }
+  return(1);
+
+} // upd_writable
+
+
+
+/**
+  \fn uint8_t upd_start(HANDLE ptrPort, upd_info_t *info, uint32_t baudrate)
+
+  \brief start updater and switch to baudrate
+
+  \param[in]     ptrPort    handle to communication port (BSL synchronized)
+  \param[in,out] info       properties of updater (updated from updater)
+  \param[in]     baudrate   baudrate for upload [Baud]
+
+  \return communication status (0=ok)
+*/
+uint8_t upd_start(HANDLE ptrPort, upd_info_t *info, uint32_t baudrate) {
+
+  uint8_t   Tx[4], Rx[7];
+
+  // leave ROM bootloader
+  bsl_jumpTo(ptrPort, info->entry);
+
+  // connect with start baudrate
+  printf("  connect updater with %gkBaud ... ", (float) baudrate / 1000.0);
+  fflush(stdout);
+  trace_begin(TRACE_TID(ptrPort), "command", "updater");
+  set_baudrate(ptrPort, UPD_BAUD_INIT);
+  s_baudrate = UPD_BAUD_INIT;
+  s_timeout  = 0;
+  rto_init(&s_rto);
+  upd_command(ptrPort, "upd_start", UPD_INFO, NULL, 0, Rx, 7, 0);
+  info->version   = Rx[0];
+  info->blockSize = Rx[3];
+  info->appStart  = ((uint32_t) Rx[4] << 16) | ((uint32_t) Rx[5] << 8) | Rx[6];
+
+  // change baudrate. The response is sent with the old one
+  if (baudrate != UPD_BAUD_INIT) {
+    Tx[0] = (uint8_t) (baudrate >> 24);
+    Tx[1] = (uint8_t) (baudrate >> 16);
+    Tx[2] = (uint8_t) (baudrate >> 8);
+    Tx[3] = (uint8_t) baudrate;
+    if (upd_command(ptrPort, "upd_start", UPD_BAUD, Tx, 4, NULL, 0, 0) != UPD_ACK) {
+      setConsoleColor(PRM_COLOR_RED);
+      fprintf(stderr, "\n\nerror in 'upd_start()': baudrate %d not supported by updater, exit!\n\n", (int) baudrate);
+      Exit(1, g_pauseOnExit);
+    }
+    set_baudrate(ptrPort, baudrate);
+    s_baudrate = baudrate;
+    upd_command(ptrPort, "upd_start", UPD_INFO, NULL, 0, Rx, 7, 0);
+  }
+  trace_end(TRACE_TID(ptrPort), "command", "updater");
+  printf("ok\n");
+  fflush(stdout);
+
+  return(0);
+
+} // upd_start
+
+
+
+/**
+  \fn uint8_t upd_erase(HANDLE ptrPort, const upd_info_t *info)
+
+  \brief erase application area of P-flash
+
+  \param[in] ptrPort    handle to communication port
+  \param[in] info       properties of updater
+
+  \return communication status (0=ok)
+*/
+uint8_t upd_erase(HANDLE ptrPort, const upd_info_t *info) {
+
+  uint32_t  numBlocks = (info->flashEnd - info->appStart) / info->blockSize;
+
+  printf("  erase flash from 0x%04x ... ", (int) info->appStart);
+  fflush(stdout);
+  if (upd_command(ptrPort, "upd_erase", UPD_ERASE, NULL, 0, NULL, 0, numBlocks * rto_program(info->appStart, info->blockSize)) != UPD_ACK) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'upd_erase()': erase refused, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+  printf("ok\n");
+  fflush(stdout);
+
+  return(0);
+
+} // upd_erase
+
+
+
+/**
+  \fn uint8_t upd_imageWrite(HANDLE ptrPort, const upd_info_t *info, const image_t *image, uint8_t verbose)
+
+  \brief upload image in flash blocks
+
+  \param[in] ptrPort    handle to communication port
+  \param[in] info       properties of updater
+  \param[in] image      prepared image
+  \param[in] verbose    print output to console?
+
+  \return communication status (0=ok)
+
+  each flash block is sent in a single frame and programmed in a single cycle.
+  Like for the pre-built BSL frames, empty (=all zero) blocks are skipped
+*/
+uint8_t upd_imageWrite(HANDLE ptrPort, const upd_info_t *info, const image_t *image, uint8_t verbose) {
+
+  uint8_t   Tx[UPD_PAYLOAD_MAX];
+  uint32_t  addr, first, start, end, len, i, idx, lenRange, numBytes = 0;
+
+  // print message
+  if (verbose) {
+    printf("  write 0B starting from 0x%04x ", (int) image->addrStart);
+    fflush(stdout);
+  }
+
+  // loop over address ranges and flash blocks
+  for (idx=0; (lenRange=image_range(image, &idx)) > 0; idx+=lenRange) {
+    first = image->addrStart + idx;
+    end   = first + lenRange;
+    for (addr=first - (first % info->blockSize); addr<end; addr+=info->blockSize) {
+
+      // part of block covered by range, skip if empty
+      start = (addr < first) ? first : addr;
+      len   = ((addr + info->blockSize < end) ? addr + info->blockSize : end) - start;
+      for (i=0; (i<len) && (image->data[start - image->addrStart + i] == 0); i++);
+      if (i == len)
+        continue;
+
+      // send address and data
+      Tx[0] = (uint8_t) (start >> 16);
+      Tx[1] = (uint8_t) (start >> 8);
+      Tx[2] = (uint8_t) start;
+      memcpy(Tx+3, image->data + (start - image->addrStart), len);
+      trace_begin(TRACE_TID(ptrPort), "command", "WRITE");
+      if (upd_command(ptrPort, "upd_imageWrite", UPD_WRITE, Tx, (uint8_t) (len+3), NULL, 0, rto_program(start, (uint16_t) len)) != UPD_ACK) {
+        setConsoleColor(PRM_COLOR_RED);
+        fprintf(stderr, "\n\nerror in 'upd_imageWrite()': write to 0x%04x refused, exit!\n\n", (int) start);
+        Exit(1, g_pauseOnExit);
+      }
+      trace_end(TRACE_TID(ptrPort), "command", "WRITE");
+      numBytes += len;
+
+      // print progress
+      if (((numBytes % 1024) == 0) && (verbose)) {
+        if (numBytes > 1024)
+          printf("%c  write %1.1fkB starting from 0x%04x ", '\r', (float) numBytes/1024.0, (int) image->addrStart);
+        else
+          printf("%c  write %dB starting from 0x%04x ", '\r', numBytes, (int) image->addrStart);
+        fflush(stdout);
+      }
+
+    } // loop over blocks
+  } // loop over ranges
+
+  // print message
+  if (verbose) {
+    if (numBytes > 1024)
+      printf("%c  write %1.1fkB starting from 0x%04x ... ok   \n", '\r', (float) numBytes/1024.0, (int) image->addrStart);
+    else
+      printf("%c  write %dB starting from 0x%04x ... ok   \n", '\r', numBytes, (int) image->addrStart);
+    fflush(stdout);
+  }
+
+  return(0);
+
+} // upd_imageWrite
+
+
+
+/**
+  \fn uint8_t upd_verify(HANDLE ptrPort, const image_t *image)
+
+  \brief verify image via CRC16 of memory range
+
+  \param[in] ptrPort    handle to communication port
+  \param[in] image      prepared image
+
+  \return communication status (0=ok). Exits on mismatch
+
+  instead of reading back the memory, the updater calculates the CRC of
+  the image range, i.e. only a few bytes are transferred. Merged images are
+  verified per address range
+*/
+uint8_t upd_verify(HANDLE ptrPort, const image_t *image) {
+
+  uint8_t   Tx[6], Rx[2];
+  uint16_t  crc;
+  uint32_t  idx, len, addr;
+
+  printf("  verify memory ... ");
+  fflush(stdout);
+  for (idx=0; (len=image_range(image, &idx)) > 0; idx+=len) {
+    addr = image->addrStart + idx;
+    Tx[0] = (uint8_t) (addr >> 16);
+    Tx[1] = (uint8_t) (addr >> 8);
+    Tx[2] = (uint8_t) addr;
+    Tx[3] = (uint8_t) (len >> 16);
+    Tx[4] = (uint8_t) (len >> 8);
+    Tx[5] = (uint8_t) len;
+    trace_begin(TRACE_TID(ptrPort), "command", "CRC");
+    if (upd_command(ptrPort, "upd_verify", UPD_CRC, Tx, 6, Rx, 2, len * UPD_CRC_US) != UPD_ACK) {
+      setConsoleColor(PRM_COLOR_RED);
+      fprintf(stderr, "\n\nerror in 'upd_verify()': CRC refused, exit!\n\n");
+      Exit(1, g_pauseOnExit);
+    }
+    trace_end(TRACE_TID(ptrPort), "command", "CRC");
+    crc = upd_crc16(0xFFFF, (const uint8_t*) image->data + idx, len);
+    if ((((uint16_t) Rx[0] << 8) | Rx[1]) != crc) {
+      printf("failed at 0x%04x (CRC16 0x%04x vs 0x%04x), exit!\n", (int) addr, (int) (((uint16_t) Rx[0] << 8) | Rx[1]), (int) crc);
+      Exit(1, g_pauseOnExit);
+    }
+  }
+  printf("ok\n");
+
+  return(0);
+
+} // upd_verify
+
+
+
+/**
+  \fn uint8_t upd_memRead(HANDLE ptrPort, uint32_t addrStart, uint32_t numBytes, char *buf)
+
+  \brief read memory range
+
+  \param[in]  ptrPort     handle to communication port
+  \param[in]  addrStart   starting address to read from
+  \param[in]  numBytes    number of bytes to read
+  \param[out] buf         buffer to store data to
+
+  \return communication status (0=ok)
+*/
+uint8_t upd_memRead(HANDLE ptrPort, uint32_t addrStart, uint32_t numBytes, char *buf) {
+
+  uint8_t   Tx[4];
+  uint32_t  addr, len;
+
+  printf("  read  %dB starting from 0x%04x ... ", (int) numBytes, (int) addrStart);
+  fflush(stdout);
+  for (addr=addrStart; addr<addrStart+numBytes; addr+=len) {
+    len = addrStart + numBytes - addr;
+    if (len > UPD_READ_MAX)
+      len = UPD_READ_MAX;
+    Tx[0] = (uint8_t) (addr >> 16);
+    Tx[1] = (uint8_t) (addr >> 8);
+    Tx[2] = (uint8_t) addr;
+    Tx[3] = (uint8_t) len;
+    if (upd_command(ptrPort, "upd_memRead", UPD_READ, Tx, 4, (uint8_t*) (buf + (addr - addrStart)), (uint8_t) len, 0) != UPD_ACK) {
+      setConsoleColor(PRM_COLOR_RED);
+      fprintf(stderr, "\n\nerror in 'upd_memRead()': read from 0x%04x refused, exit!\n\n", (int) addr);
+      Exit(1, g_pauseOnExit);
+    }
+  }
+  printf("ok\n");
+  fflush(stdout);
+
+  return(0);
+
+} // upd_memRead
+
+
+
+/**
+  \fn uint8_t upd_jumpTo(HANDLE ptrPort, uint32_t addr)
+
+  \brief leave updater and jump to address
+
+  \param[in] ptrPort    handle to communication port
+  \param[in] addr       address to jump to (16b range)
+
+  \return communication status (0=ok)
+*/
+uint8_t upd_jumpTo(HANDLE ptrPort, uint32_t addr) {
+
+  uint8_t   Tx[3];
+
+  printf("  jump to address 0x%04x ... ", (int) addr);
+  fflush(stdout);
+  Tx[0] = (uint8_t) (addr >> 16);
+  Tx[1] = (uint8_t) (addr >> 8);
+  Tx[2] = (uint8_t) addr;
+  if (upd_command(ptrPort, "upd_jumpTo", UPD_GO, Tx, 3, NULL, 0, 0) != UPD_ACK) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'upd_jumpTo()': jump refused, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+  printf("ok\n");
+  fflush(stdout);
+
+  return(0);
+
+} // upd_jumpTo
+
+// end of file
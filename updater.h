@@ -0,0 +1,103 @@
+/**
+  \file updater.h
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief declaration of resident updater protocol
+
+  declaration of routines for the optional flash-resident updater of
+  BSL_activate (see BSL_activate/updater.h for the frame format). The updater
+  is detected via a descriptor in EEPROM, which is read with the ROM
+  bootloader, and is started with the BSL GO command. It receives CRC16
+  protected WRITE frames of a complete flash block with a single response,
+  at up to 1MBaud, and doesn't require the RAM routines.
+*/
+
+// for including file only once
+#ifndef _UPDATER_H_
+#define _UPDATER_H_
+
+
+// include files
+#include <stdint.h>
+#include "serial_comm.h"
+#include "image.h"
+
+
+/// supported protocol version
+#define UPD_VERSION           0x01
+
+/// address of descriptor in EEPROM
+#define UPD_DESC_ADDR         0x43F8
+
+/// size of descriptor [B]
+#define UPD_DESC_SIZE         8
+
+/// baudrate of updater after start [Baud]
+#define UPD_BAUD_INIT         115200
+
+/// max. payload of a frame [B] (3B address + 1 block)
+#define UPD_PAYLOAD_MAX       (3+128)
+
+/// max. number of bytes per UPD_READ
+#define UPD_READ_MAX          128
+
+// frame start and commands (host -> STM8)
+#define UPD_SOF_HOST          0x5A      // start of host frame
+#define UPD_INFO              'I'       // get version, flash size, block size, application start
+#define UPD_BAUD              'B'       // set baudrate after response
+#define UPD_WRITE             'W'       // write up to 1 block
+#define UPD_READ              'R'       // read up to UPD_READ_MAX bytes
+#define UPD_CRC               'C'       // CRC16 of memory range
+#define UPD_ERASE             'E'       // erase application area
+#define UPD_GO                'G'       // jump to address after response
+
+// frame start and status (STM8 -> host)
+#define UPD_SOF_TARGET        0xA5      // start of target frame
+#define UPD_ACK               0x79      // command executed
+#define UPD_NACK              0x1F      // command refused
+#define UPD_CRCERR            0x2E      // frame CRC error -> repeat
+
+
+/// properties of resident updater
+typedef struct {
+  uint8_t     version;          ///< protocol version
+  uint16_t    entry;            ///< address of updater entry (for BSL GO)
+  uint32_t    appStart;         ///< first P-flash address writable by updater
+  uint32_t    flashEnd;         ///< end of P-flash (exclusive)
+  uint16_t    blockSize;        ///< flash block size [B]
+} upd_info_t;
+
+
+/// CRC16-CCITT of buffer (init 0xFFFF)
+uint16_t    upd_crc16(uint16_t crc, const uint8_t *buf, uint32_t numBytes);
+
+/// read updater descriptor via ROM bootloader. Returns 1 if an updater is installed
+uint8_t     upd_detect(HANDLE ptrPort, int flashsize, uint8_t family, upd_info_t *info);
+
+/// check if updater can write image (application area or EEPROM). Returns 1 if yes
+uint8_t     upd_writable(const upd_info_t *info, const image_t *image);
+
+/// start updater via BSL GO and switch to given baudrate
+uint8_t     upd_start(HANDLE ptrPort, upd_info_t *info, uint32_t baudrate);
+
+/// erase application area of P-flash
+uint8_t     upd_erase(HANDLE ptrPort, const upd_info_t *info);
+
+/// upload image in flash blocks
+uint8_t     upd_imageWrite(HANDLE ptrPort, const upd_info_t *info, const image_t *image, uint8_t verbose);
+
+/// verify image via CRC16 of memory range
+uint8_t     upd_verify(HANDLE ptrPort, const image_t *image);
+
+/// read memory range
+uint8_t     upd_memRead(HANDLE ptrPort, uint32_t addrStart, uint32_t numBytes, char *buf);
+
+/// leave updater and jump to address
+uint8_t     upd_jumpTo(HANDLE ptrPort, uint32_t addr);
+
+#endif // _UPDATER_H_
+
+// end of file
@@ -0,0 +1,294 @@
+/**
+  \file watch.c
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief implementation of firmware directory watcher
+
+  implementation of routines for watching a release directory for new or changed
+  firmware files (*.s19, *.hex, *.ihx, *.elf). Each file is parsed, validated and
+  framed in a background thread and then published as current image (see image.h),
+  so the programming line never waits for parsing.
+  Under Linux inotify is used, other Posix systems poll the directory once per second.
+*/
+
+// include files
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "watch.h"
+#include "image.h"
+#include "misc.h"
+#include "globals.h"
+
+// OS specific: Posix
+#if defined(__APPLE__) || defined(__unix__)
+  #include <pthread.h>
+  #include <dirent.h>
+  #include <unistd.h>
+  #include <sys/stat.h>
+  #include <poll.h>
+  #if defined(__linux__)
+    #include <sys/inotify.h>
+  #endif
+#endif
+
+
+#if defined(__APPLE__) || defined(__unix__)
+
+// state of watcher thread
+static char         s_dir[1000];          // watched directory
+static uint8_t      s_verbose;            // print messages
+static volatile int s_stop;               // request thread to terminate
+static pthread_t    s_thread;             // watcher thread
+static time_t       s_lastTime;           // mtime of newest prepared file
+static char         s_lastName[1000];     // name of newest prepared file
+
+
+
+/**
+  \fn static uint8_t is_firmware(const char *name)
+
+  \brief check if file is a firmware file
+
+  \param[in] name   file name
+
+  \return 1 if file extension is a supported firmware format, else 0
+*/
+static uint8_t is_firmware(const char *name) {
+
+  const char  *dot = strrchr(name, '.');
+
+  if (!dot)
+    return(0);
+  return(!strcmp(dot, ".s19") || !strcmp(dot, ".hex") || !strcmp(dot, ".ihx") || !strcmp(dot, ".elf"));
+
+} // is_firmware
+
+
+
+/**
+  \fn static void prepare_file(const char *name)
+
+  \brief prepare firmware file and publish as current image
+
+  \param[in] name   file name within watched directory
+
+  load, validate and frame firmware file. On success it replaces the current
+  image, on error the current image is kept
+*/
+static void prepare_file(const char *name) {
+
+  char        path[2100];
+  image_t     *image;
+  jmp_buf     env, *prev;
+  struct stat st;
+
+  // compose full path
+  snprintf(path, sizeof(path), "%s/%s", s_dir, name);
+  if ((stat(path, &st) != 0) || (!S_ISREG(st.st_mode)))
+    return;
+
+  // parse file. On error keep current image
+  prev = setExitHandler(&env);
+  if (setjmp(env) == 0)
+    image = image_load(path, 0);
+  else
+    image = NULL;
+  setExitHandler(prev);
+  if (!image) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n  watch: skip invalid firmware '%s'\n", name);
+    setConsoleColor(PRM_COLOR_DEFAULT);
+    return;
+  }
+
+  // switch current image
+  image_publish(image);
+  s_lastTime = st.st_mtime;
+  strncpy(s_lastName, name, sizeof(s_lastName)-1);
+  if (s_verbose) {
+    printf("\n  watch: prepared '%s' (%d frames, CRC32 0x%08x)\n", name, (int) image->numFrames, image->crc);
+    fflush(stdout);
+  }
+
+} // prepare_file
+
+
+
+/**
+  \fn static void scan_dir(void)
+
+  \brief prepare newest firmware in directory
+
+  scan watched directory and prepare the most recently modified firmware file,
+  if it is newer than the current image
+*/
+static void scan_dir(void) {
+
+  DIR             *dir;
+  struct dirent   *ent;
+  struct stat     st;
+  char            path[2100], newest[1000];
+  time_t          newestTime = 0;
+
+  // find newest firmware file
+  newest[0] = '\0';
+  if (!(dir = opendir(s_dir)))
+    return;
+  while ((ent = readdir(dir)) != NULL) {
+    if (!is_firmware(ent->d_name))
+      continue;
+    snprintf(path, sizeof(path), "%s/%s", s_dir, ent->d_name);
+    if ((stat(path, &st) == 0) && (st.st_mtime >= newestTime)) {
+      newestTime = st.st_mtime;
+      strncpy(newest, ent->d_name, sizeof(newest)-1);
+      newest[sizeof(newest)-1] = '\0';
+    }
+  }
+  closedir(dir);
+
+  // prepare if new or changed
+  if ((newest[0] != '\0') && ((newestTime > s_lastTime) || strcmp(newest, s_lastName)))
+    prepare_file(newest);
+
+} // scan_dir
+
+
+
+/**
+  \fn static void *watch_thread(void *arg)
+
+  \brief background thread watching the directory
+
+  \param[in] arg    not used
+
+  wait for files being closed after writing or moved into the directory
+  and prepare them. Uses inotify under Linux, else polls once per second
+*/
+static void *watch_thread(void *arg) {
+
+#if defined(__linux__)
+
+  int                   fd, wd, len, i;
+  char                  buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  struct inotify_event  *ev;
+  struct pollfd         pfd;
+
+  // register for completed writes and atomic renames (e.g. CI copy + mv)
+  fd = inotify_init1(IN_NONBLOCK);
+  wd = (fd < 0) ? -1 : inotify_add_watch(fd, s_dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+  if (wd < 0) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n  watch: inotify not available for '%s', poll instead\n", s_dir);
+    setConsoleColor(PRM_COLOR_DEFAULT);
+    if (fd >= 0)
+      close(fd);
+    while (!s_stop) {
+      SLEEP(1000);
+      scan_dir();
+    }
+    return(NULL);
+  }
+
+  // process events until stop is requested (check flag every 200ms)
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  while (!s_stop) {
+    if (poll(&pfd, 1, 200) <= 0)
+      continue;
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+      for (i=0; i<len; i+=sizeof(struct inotify_event)+ev->len) {
+        ev = (struct inotify_event*) (buf+i);
+        if ((ev->len > 0) && is_firmware(ev->name))
+          prepare_file(ev->name);
+      }
+    }
+  }
+  close(fd);
+
+#else // __linux__
+
+  // no inotify -> poll directory
+  while (!s_stop) {
+    SLEEP(1000);
+    scan_dir();
+  }
+
+#endif // __linux__
+
+  return(NULL);
+
+} // watch_thread
+
+#endif // __APPLE__ || __unix__
+
+
+
+/**
+  \fn void watch_start(const char *dir, uint8_t verbose)
+
+  \brief prepare newest firmware in directory and start watching it
+
+  \param[in] dir        directory to watch
+  \param[in] verbose    print message for each prepared image
+
+  prepare the newest firmware file in the directory synchronously, then start
+  a background thread which prepares new or changed files and switches the
+  current image (see image_acquire())
+*/
+void watch_start(const char *dir, uint8_t verbose) {
+
+#if defined(__APPLE__) || defined(__unix__)
+
+  // store parameters
+  strncpy(s_dir, dir, sizeof(s_dir)-1);
+  s_verbose  = verbose;
+  s_stop     = 0;
+  s_lastTime = 0;
+  s_lastName[0] = '\0';
+
+  // prepare newest image already present
+  scan_dir();
+
+  // start background thread
+  if (pthread_create(&s_thread, NULL, watch_thread, NULL) != 0) {
+    setConsoleColor(PRM_COLOR_RED);
+    fprintf(stderr, "\n\nerror in 'watch_start()': cannot start thread, exit!\n\n");
+    Exit(1, g_pauseOnExit);
+  }
+
+#else
+
+  setConsoleColor(PRM_COLOR_RED);
+  fprintf(stderr, "\n\nerror in 'watch_start()': not supported on this OS, exit!\n\n");
+  Exit(1, g_pauseOnExit);
+
+#endif // __APPLE__ || __unix__
+
+} // watch_start
+
+
+
+/**
+  \fn void watch_stop(void)
+
+  \brief stop watching directory
+
+  terminate background thread. The current image remains valid
+*/
+void watch_stop(void) {
+
+#if defined(__APPLE__) || defined(__unix__)
+
+  s_stop = 1;
+  pthread_join(s_thread, NULL);
+
+#endif // __APPLE__ || __unix__
+
+} // watch_stop
+
+// end of file
@@ -0,0 +1,31 @@
+/**
+  \file watch.h
+
+  \author G. Icking-Konert
+  \date 2026-10-18
+  \version 0.1
+
+  \brief declaration of firmware directory watcher
+
+  declaration of routines for watching a release directory for new or changed
+  firmware files and preparing them ahead of time (see image.h)
+*/
+
+// for including file only once
+#ifndef _WATCH_H_
+#define _WATCH_H_
+
+
+// include files
+#include <stdint.h>
+
+
+/// prepare newest firmware in directory and start watching it in background
+void    watch_start(const char *dir, uint8_t verbose);
+
+/// stop watching directory
+void    watch_stop(void);
+
+#endif // _WATCH_H_
+
+// end of file